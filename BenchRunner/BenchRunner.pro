@@ -0,0 +1,15 @@
+QT += core
+QT -= gui
+
+CONFIG += c++17
+CONFIG += console
+CONFIG -= app_bundle
+
+# 无界面的推理测试程序，可以无人值守运行，结果输出为JSON/CSV
+# 例：BenchRunner --model <模型目录> --images <图片目录> --threads 1,2,4-8 --duration 30 --json result.json
+
+SOURCES += \
+    main.cpp
+
+# 推理公共代码，以及SMore sdk和opencv
+include(../MultiThreadTest/core.pri)
@@ -0,0 +1,535 @@
+﻿#include <QCommandLineParser>
+#include <QCoreApplication>
+#include <QDateTime>
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QSaveFile>
+#include <QSysInfo>
+#include <QThread>
+
+#include <algorithm>
+#include <cstdio>
+
+#include "benchmarkreport.h"
+#include "benchmarkrun.h"
+#include "framecorpus.h"
+#include "preprocess.h"
+#include "resulthandlers.h"
+#include "syntheticbackend.h"
+#include "threadsweep.h"
+#include "tracing.h"
+
+// 解析线程数列表，例如 "1,2,4-8"
+static QList<int> parseThreadList(const QString &text, bool *ok)
+{
+    QList<int> threads;
+    *ok = true;
+    for (const QString &part : text.split(','))
+    {
+        if (part.trimmed().isEmpty())
+        {
+            continue;
+        }
+        QStringList range = part.split('-');
+        int first = range.value(0).trimmed().toInt(ok);
+        int last = range.size() > 1 && *ok ? range.value(1).trimmed().toInt(ok) : first;
+        if (!*ok || range.size() > 2 || first < 1 || last < first)
+        {
+            *ok = false;
+            return {};
+        }
+        for (int i = first; i <= last; ++i)
+        {
+            threads << i;
+        }
+    }
+    *ok = !threads.isEmpty();
+    return threads;
+}
+
+static bool writeFile(const QString &path, const QByteArray &data)
+{
+    QSaveFile file(path);
+    return file.open(QIODevice::WriteOnly) && file.write(data) == data.size() && file.commit();
+}
+
+int main(int argc, char *argv[])
+{
+    QCoreApplication a(argc, argv);
+    QCoreApplication::setApplicationName("BenchRunner");
+
+    QCommandLineParser parser;
+    parser.setApplicationDescription("无界面的多线程推理测试，按线程数逐个测量吞吐量和延迟分位数");
+    parser.addHelpOption();
+
+    QCommandLineOption modelOption("model", "模型目录（model.vimosln所在的文件夹）", "dir");
+    QCommandLineOption imagesOption("images", "图片目录，启动时全部预加载到内存", "dir");
+    QCommandLineOption threadsOption("threads", "要测量的送图线程数，例如 1,2,4-8", "list", "1");
+    QCommandLineOption pipelinesOption("pipelines", "pipelines数（也是推理工作线程数），默认取最大的线程数", "n", "0");
+    QCommandLineOption warmupOption("warmup", "每路预热的张数，不计入统计", "n", "10");
+    QCommandLineOption coldOption("cold", "开始送图前不预热pipelines，第一张图带着延迟初始化的耗时");
+    QCommandLineOption durationOption("duration", "每个线程数测量的秒数", "sec", "10");
+    QCommandLineOption iterationsOption("iterations", "每路测量的张数，大于0时代替--duration", "n", "0");
+    QCommandLineOption pacingOption("pacing", "送图节奏：takt（按节拍）、unthrottled（送一张等一张）或 open（开环，按--arrival的到达时刻送图，"
+                                    "耗时从预定到达时刻算起）", "mode", "takt");
+    QCommandLineOption taktOption("takt-ms", "节拍间隔", "ms", "100");
+    QCommandLineOption arrivalOption("arrival", QString("开环送图的到达方式，指定时--pacing默认为open；没有给rate时按--takt-ms：%1")
+                                     .arg(QString::fromUtf8(arrivalSpecHelp())), "spec");
+    QCommandLineOption batchOption("batch", "最大批大小", "n", "1");
+    QCommandLineOption tileOption("tile", QString("切图推理：每张图切成重叠的块，由多个pipelines并行推理后拼回整图，"
+                                                  "耗时按整张图统计：%1").arg(QString::fromUtf8(tileSpecHelp())), "spec");
+    QCommandLineOption preprocessOption("preprocess", QString("预加载时把图转成模型的输入格式（8位BGR，可选缩放），"
+                                                              "默认只转换格式不缩放：%1").arg(QString::fromUtf8(preprocessSpecHelp())), "spec");
+    QCommandLineOption batchWaitOption("batch-wait-us", "凑批的最长等待时间", "us", "0");
+    QCommandLineOption cpuOption("cpu", "用CPU推理");
+    QCommandLineOption deviceOption("device", "GPU编号", "id", "0");
+    QCommandLineOption devicesOption("devices", "多设备，代替--cpu/--device：GPU编号列表如 0,1；cpu 或 cpu:0-15 表示用CPU推理；"
+                                                "可以用@限定核，如 0,1@0-31", "spec");
+    QCommandLineOption pinOption("pin", "把推理线程、送图线程和帧数据绑到设备所在NUMA节点的核上");
+    QCommandLineOption sweepOption("auto-sweep", "自动扫描：从1逐个增加到--threads中最大的线程数，吞吐量饱和或p99超出节拍时停止，并给出推荐的线程数");
+    QCommandLineOption scalePipelinesOption("scale-pipelines", "自动扫描时pipelines数随线程数增加（每一步重新创建引擎）");
+    QCommandLineOption backendOption("backend", "推理后端：vimo（思谋SDK）或 synthetic（模拟后端，不需要模型和GPU）", "name", "vimo");
+    QCommandLineOption syntheticOption("synthetic", QString("模拟后端的参数：%1").arg(QString::fromUtf8(syntheticBackendSpecHelp())),
+                                       "spec", "dist=lognormal,mean=30,stddev=3");
+    QCommandLineOption jsonOption("json", "把结果写成JSON", "file");
+    QCommandLineOption csvOption("csv", "把结果写成CSV", "file");
+    QCommandLineOption postOption("post", QString("推理结果的后处理，在单独的线程中按顺序执行：%1")
+                                              .arg(QString::fromUtf8(resultHandlersSpecHelp())), "spec");
+    QCommandLineOption postThreadsOption("post-threads", "后处理线程数", "n", "1");
+    QCommandLineOption traceOption("trace", "记录各阶段的耗时，写成Chrome trace JSON，用ui.perfetto.dev打开", "file");
+    QCommandLineOption traceBufferOption("trace-buffer", "每个线程最多记录的span数，超出的丢弃", "n", "65536");
+    QCommandLineOption logOption("log", "每张图写一条二进制结果日志，文件为<prefix>.0001.rlog……，用ResultLogTool统计", "prefix");
+    QCommandLineOption logMaxOption("log-max-mb", "单个结果日志文件的大小，写满后换下一个", "mb", "256");
+    QCommandLineOption logFilesOption("log-max-files", "最多保留的结果日志文件数，0为不限", "n", "0");
+    QCommandLineOption cacheOption("cache", "按图像内容缓存推理结果，重复的图只算哈希、查表，不再推理；"
+                                            "各轮共用一个缓存，数值为缓存的上限", "mb");
+    parser.addOptions({modelOption, imagesOption, threadsOption, pipelinesOption, warmupOption, coldOption,
+                       durationOption, iterationsOption, pacingOption, taktOption, arrivalOption, batchOption,
+                       batchWaitOption, tileOption, preprocessOption, cpuOption, deviceOption, devicesOption, pinOption, sweepOption, scalePipelinesOption,
+                       backendOption, syntheticOption, jsonOption, csvOption, postOption, postThreadsOption,
+                       traceOption, traceBufferOption, logOption, logMaxOption, logFilesOption, cacheOption});
+    parser.process(a);
+
+    QString backendName = parser.value(backendOption);
+    if (backendName != "vimo" && backendName != "synthetic")
+    {
+        std::fprintf(stderr, "无效的推理后端: %s\n", qPrintable(backendName));
+        return 1;
+    }
+    bool synthetic = backendName == "synthetic";
+
+    // 模拟后端不需要模型
+    if ((!synthetic && !parser.isSet(modelOption)) || !parser.isSet(imagesOption))
+    {
+        std::fprintf(stderr, "必须指定 --model 和 --images\n");
+        parser.showHelp(1);
+    }
+
+    SyntheticBackendConfig syntheticConfig;
+    std::string specError;
+    if (synthetic && !parseSyntheticBackendSpec(parser.value(syntheticOption).toStdString(), syntheticConfig, &specError))
+    {
+        std::fprintf(stderr, "无效的模拟后端参数: %s\n", specError.c_str());
+        return 1;
+    }
+
+    bool ok = false;
+    QList<int> threadList = parseThreadList(parser.value(threadsOption), &ok);
+    if (!ok)
+    {
+        std::fprintf(stderr, "无效的线程数列表: %s\n", qPrintable(parser.value(threadsOption)));
+        return 1;
+    }
+
+    QString pacing = parser.isSet(arrivalOption) && !parser.isSet(pacingOption) ? "open" : parser.value(pacingOption);
+    if (pacing != "takt" && pacing != "unthrottled" && pacing != "open")
+    {
+        std::fprintf(stderr, "无效的送图节奏: %s\n", qPrintable(pacing));
+        return 1;
+    }
+
+    // 默认每路的到达率和节拍一致，例如100ms即600pcs/min
+    ArrivalConfig arrival;
+    arrival.ratePerSec = 1000.0 / std::max(1, parser.value(taktOption).toInt());
+    if (!parseArrivalSpec(parser.value(arrivalOption).toStdString(), arrival, &specError))
+    {
+        std::fprintf(stderr, "无效的到达方式: %s\n", specError.c_str());
+        return 1;
+    }
+
+    // 图片只解码一次，所有轮次共用，测量时不读盘也不解码
+    FrameCorpusConfig corpusConfig;
+    corpusConfig.imageFolderPath = parser.value(imagesOption);
+    if (!parsePreprocessSpec(parser.value(preprocessOption).toStdString(), corpusConfig.preprocess, &specError))
+    {
+        std::fprintf(stderr, "无效的预处理参数: %s\n", specError.c_str());
+        return 1;
+    }
+    auto corpus = std::make_shared<FrameCorpus>(corpusConfig);
+    std::string error;
+    if (!corpus->load(&error))
+    {
+        std::fprintf(stderr, "图片加载失败: %s\n", error.c_str());
+        return 1;
+    }
+    std::printf("loaded %d frames (%.1f MB) in %.0f ms, preprocess %s\n",
+                corpus->size(), corpus->stats().bytes / 1048576.0, corpus->stats().loadMs,
+                corpusConfig.preprocess.enabled ? preprocessIsa() : "off");
+
+    // 模型只加载一次，所有轮次共用同一组pipelines（--scale-pipelines时每一步重新创建）
+    InferenceEngineConfig engineConfig;
+    engineConfig.modelDir = parser.value(modelOption).toLocal8Bit().toStdString();
+    engineConfig.pipelineCount = parser.value(pipelinesOption).toInt();
+    if (engineConfig.pipelineCount <= 0)
+    {
+        engineConfig.pipelineCount = *std::max_element(threadList.begin(), threadList.end());
+    }
+
+    // 设备放置：pipelines按顺序轮流分到各个设备上，每个设备一组工作线程
+    DeviceSpec deviceSpec;
+    deviceSpec.useGpu = !parser.isSet(cpuOption);
+    deviceSpec.deviceIds = {parser.value(deviceOption).toInt()};
+    if (parser.isSet(devicesOption) && !parseDeviceSpec(parser.value(devicesOption).toStdString(), deviceSpec, &error))
+    {
+        std::fprintf(stderr, "%s\n", error.c_str());
+        return 1;
+    }
+    bool pin = parser.isSet(pinOption);
+    std::vector<DevicePlacement> placements = planDevicePlacement(deviceSpec, pin);
+    engineConfig.useGpu = deviceSpec.useGpu;
+    engineConfig.deviceId = placements.front().deviceId;
+    for (const DevicePlacement &placement : placements)
+    {
+        engineConfig.deviceIds.push_back(placement.deviceId);
+        std::printf("%s %d: numa node %d, cpus %s\n", placement.useGpu ? "gpu" : "cpu", placement.deviceId,
+                    placement.numaNode, pin ? formatCpuList(placement.cpus).c_str() : "(not pinned)");
+    }
+    EngineFactory engineFactory = [engineConfig, synthetic, syntheticConfig](int pipelineCount) {
+        InferenceEngineConfig config = engineConfig;
+        config.pipelineCount = pipelineCount;
+        if (synthetic)
+        {
+            config.backend = std::make_shared<SyntheticBackend>(syntheticConfig);
+        }
+        return std::make_shared<InferenceEngine>(config);
+    };
+
+    bool scalePipelines = parser.isSet(sweepOption) && parser.isSet(scalePipelinesOption);
+    std::shared_ptr<InferenceEngine> engine = engineFactory(scalePipelines ? 1 : engineConfig.pipelineCount);
+    if (!engine->load(&error))
+    {
+        std::fprintf(stderr, "模型加载失败: %s\n", error.c_str());
+        return 1;
+    }
+    InferenceEngineLoadStats loadStats = engine->loadStats();
+    std::string moduleId = engine->moduleId();
+    std::printf("module %s, %d pipelines, load %.0f ms, create %.0f ms, module graph %.1f ms%s\n",
+                engine->moduleId().c_str(), engine->pipelineCount(),
+                loadStats.solutionLoadMs, loadStats.pipelineCreateMs,
+                loadStats.moduleResolveMs, loadStats.moduleGraphCached ? " (cached)" : "");
+
+    // 绑核时每个设备所在的节点上各放一份帧数据，送图线程只读本节点上的那一份
+    std::vector<int> replicas(placements.size(), 0);
+    if (pin)
+    {
+        for (size_t i = 0; i < placements.size(); ++i)
+        {
+            replicas[i] = corpus->addReplica(placements[i].cpus);
+        }
+    }
+
+    // 各路错开起始帧，避免所有路同时送同一张图
+    BenchmarkFrameSource frames = [corpus, replicas](int stream, long long sequence, int shard) {
+        int replica = shard < (int)replicas.size() ? replicas[shard] : 0;
+        return corpus->frame((int)((stream + sequence) % corpus->size()), replica);
+    };
+
+    BenchmarkRunConfig runConfig;
+    runConfig.pacing = pacing == "takt" ? PacingMode::Takt
+                       : pacing == "open" ? PacingMode::OpenLoop
+                                          : PacingMode::Unthrottled;
+    runConfig.taktMs = parser.value(taktOption).toInt();
+    runConfig.arrival = arrival;
+    runConfig.warmupIterations = parser.value(warmupOption).toInt();
+    runConfig.warmUpEngine = !parser.isSet(coldOption);
+    runConfig.durationSec = parser.value(durationOption).toDouble();
+    runConfig.iterations = parser.value(iterationsOption).toLongLong();
+    runConfig.maxBatchSize = parser.value(batchOption).toInt();
+    runConfig.maxBatchWaitUs = parser.value(batchWaitOption).toInt();
+    runConfig.placement = placements;
+    if (parser.isSet(tileOption))
+    {
+        runConfig.tiled = true;
+        if (!parseTileSpec(parser.value(tileOption).toStdString(), runConfig.tiling, &specError))
+        {
+            std::fprintf(stderr, "无效的切图参数: %s\n", specError.c_str());
+            return 1;
+        }
+    }
+
+    // 各轮共用同一组处理器，结果文件中包含所有轮次
+    if (parser.isSet(postOption))
+    {
+        std::shared_ptr<IInferenceBackend> backend = engine->backend();
+        ResultFormatter formatter = [backend](const InferenceOutput &output) {
+            return backend->describeOutput(output);
+        };
+        if (!createResultHandlers(parser.value(postOption).toStdString(), formatter, runConfig.postHandlers, &error))
+        {
+            std::fprintf(stderr, "无效的后处理参数: %s\n", error.c_str());
+            return 1;
+        }
+        runConfig.postThreads = parser.value(postThreadsOption).toInt();
+    }
+
+    // 各轮写进同一组结果日志，按时间段区分
+    if (parser.isSet(logOption))
+    {
+        ResultLogConfig logConfig;
+        logConfig.path = parser.value(logOption).toLocal8Bit().toStdString();
+        logConfig.maxFileBytes = parser.value(logMaxOption).toLongLong() << 20;
+        logConfig.maxFiles = parser.value(logFilesOption).toInt();
+        runConfig.resultLog = std::make_shared<ResultLogWriter>(logConfig);
+        if (!runConfig.resultLog->open(&error))
+        {
+            std::fprintf(stderr, "%s\n", error.c_str());
+            return 1;
+        }
+    }
+
+    if (parser.isSet(cacheOption))
+    {
+        ResultCacheConfig cacheConfig;
+        cacheConfig.maxBytes = parser.value(cacheOption).toLongLong() << 20;
+        runConfig.resultCache = std::make_shared<ResultCache>(cacheConfig);
+    }
+
+    // 从第一轮开始记录，模型加载不在trace中
+    if (parser.isSet(traceOption))
+    {
+        TraceRecorder::instance().setBufferCapacity(parser.value(traceBufferOption).toInt());
+        TraceRecorder::instance().setEnabled(true);
+    }
+
+    std::printf("\n%8s %12s %10s %10s %10s %10s %10s %9s %10s\n",
+                "threads", "throughput", "p50(ms)", "p99(ms)", "p99.9(ms)", "max(ms)", "e2e p99", "overruns", "ttfr(ms)");
+
+    QJsonArray runs;
+    QStringList csv;
+    csv << benchmarkCsvHeader();
+    int exitCode = 0;
+    auto report = [&](const BenchmarkRunResult &result) {
+        runs.append(benchmarkRunToJson(result));
+        csv << benchmarkRunToCsv(result);
+
+        if (!result.ok)
+        {
+            std::fprintf(stderr, "%d threads failed: %s\n", result.config.threadCount, result.error.c_str());
+            exitCode = 1;
+            return;
+        }
+
+        const BenchmarkStreamResult &total = result.total;
+        std::printf("%8d %12.2f %10.2f %10.2f %10.2f %10.2f %10.2f %9lld %10.1f\n",
+                    result.config.threadCount, result.throughput(),
+                    total.latency.percentileMs(50), total.latency.percentileMs(99),
+                    total.latency.percentileMs(99.9), total.latency.maxMs(),
+                    total.endToEnd.percentileMs(99), total.overruns, result.timeToFirstResultMs);
+        if (result.warmupMs > 0)
+        {
+            // 预热只在引擎第一次使用时做，之后的各轮都是热启动
+            std::printf("%8s warm-up %.0f ms, first run %.2f ms, warm run %.2f ms\n", "",
+                        result.warmupMs, result.firstRunMs, result.warmRunMs);
+        }
+        if (total.failed > 0)
+        {
+            std::printf("%8s %lld failed\n", "", total.failed);
+        }
+        if (result.config.tiled)
+        {
+            std::printf("%8s %d tiles per image, latency is per whole image\n", "", result.tilesPerImage);
+        }
+        if (result.config.pacing == PacingMode::OpenLoop)
+        {
+            // 开环时e2e从预定到达时刻算起；迟到是送图线程被阻塞、没能按时送出的帧
+            std::printf("%8s %s arrival: %lld late, %lld dropped\n", "",
+                        arrivalModeName(result.config.arrival.mode), total.late, total.dropped);
+        }
+        if (result.config.resultCache)
+        {
+            // 缓存的统计是累计的，命中数按本轮测量阶段给出
+            const ResultCacheStats &cache = result.resultCache;
+            long long lookups = cache.hits + cache.misses;
+            std::printf("%8s result cache: %lld of %lld cached, %lld entries, %.1f MB, hash %.3f ms per image\n", "",
+                        total.cached, total.completed, cache.entries, cache.bytes / 1048576.0,
+                        lookups > 0 ? cache.hashMs / lookups : 0.0);
+        }
+        const PostProcessStats &post = result.postProcess;
+        if (!post.handlers.empty())
+        {
+            // 每个处理器单独给出耗时，看是哪一步拖慢了后处理
+            std::printf("%8s post: %lld processed, %lld dropped, queue p99 %.2f ms, total p99 %.2f ms\n", "",
+                        post.processed, post.dropped, post.queue.percentileMs(99), post.total.percentileMs(99));
+            for (const PostProcessHandlerStats &handler : post.handlers)
+            {
+                std::printf("%8s   %-12s p50 %.3f ms, p99 %.3f ms, max %.3f ms%s\n", "", handler.name.c_str(),
+                            handler.latency.percentileMs(50), handler.latency.percentileMs(99), handler.latency.maxMs(),
+                            handler.failed > 0 ? qPrintable(QString(", %1 failed").arg(handler.failed)) : "");
+            }
+        }
+        if (result.devices.size() > 1 || pin)
+        {
+            for (const DeviceUsage &device : result.devices)
+            {
+                std::printf("%8s %s %d: %.2f/s, utilization %.0f%%\n", "", device.useGpu ? "gpu" : "cpu",
+                            device.deviceId, device.throughput, device.utilization * 100);
+            }
+        }
+    };
+
+    QJsonObject sweepObject;
+    if (parser.isSet(sweepOption))
+    {
+        ThreadSweepConfig sweepConfig;
+        sweepConfig.run = runConfig;
+        sweepConfig.maxThreads = *std::max_element(threadList.begin(), threadList.end());
+        sweepConfig.scalePipelines = scalePipelines;
+        sweepConfig.fixedPipelines = engineConfig.pipelineCount;
+
+        // 固定pipelines数时共用已经加载好的引擎；否则先释放它，每一步重新创建
+        std::shared_ptr<InferenceEngine> sharedEngine = scalePipelines ? nullptr : engine;
+        engine.reset();
+        EngineFactory sweepFactory = [&](int pipelineCount) {
+            return sharedEngine ? sharedEngine : engineFactory(pipelineCount);
+        };
+
+        ThreadSweepResult sweep = runThreadSweep(sweepConfig, sweepFactory, frames, [&](const ThreadSweepStep &step) {
+            report(step.result);
+        });
+
+        std::printf("\nstopped: %s\n", sweep.stopReason.c_str());
+        if (sweep.recommendedThreads > 0)
+        {
+            std::printf("recommended threads for %.0f ms budget: %d\n", sweep.budgetMs, sweep.recommendedThreads);
+        }
+        else
+        {
+            std::printf("no thread count meets the %.0f ms budget\n", sweep.budgetMs);
+        }
+
+        sweepObject["stop_reason"] = QString::fromStdString(sweep.stopReason);
+        sweepObject["budget_ms"] = sweep.budgetMs;
+        sweepObject["recommended_threads"] = sweep.recommendedThreads;
+        sweepObject["scale_pipelines"] = scalePipelines;
+    }
+    else
+    {
+        for (int threads : threadList)
+        {
+            runConfig.threadCount = threads;
+            report(runBenchmark(runConfig, engine, frames));
+        }
+    }
+
+    if (parser.isSet(traceOption))
+    {
+        TraceRecorder::instance().setEnabled(false);
+        TraceStats traceStats = TraceRecorder::instance().stats();
+        if (!TraceRecorder::instance().exportChromeTrace(parser.value(traceOption).toLocal8Bit().toStdString(), &error))
+        {
+            std::fprintf(stderr, "%s\n", error.c_str());
+            exitCode = 1;
+        }
+        else
+        {
+            std::printf("\ntrace: %lld spans from %d threads (%lld dropped) -> %s\n", traceStats.events,
+                        traceStats.threads, traceStats.dropped, qPrintable(parser.value(traceOption)));
+        }
+    }
+
+    if (runConfig.resultLog)
+    {
+        runConfig.resultLog->close();
+        ResultLogStats logStats = runConfig.resultLog->stats();
+        std::printf("\nresult log: %lld records in %d file(s), %lld dropped -> %s\n", logStats.written,
+                    logStats.files, logStats.dropped, logStats.currentFile.c_str());
+        if (!logStats.error.empty())
+        {
+            std::fprintf(stderr, "%s\n", logStats.error.c_str());
+            exitCode = 1;
+        }
+    }
+
+    if (parser.isSet(jsonOption))
+    {
+        QJsonObject meta;
+        meta["timestamp"] = QDateTime::currentDateTime().toString(Qt::ISODate);
+        meta["host"] = QSysInfo::machineHostName();
+        meta["os"] = QSysInfo::prettyProductName();
+        meta["cpu_threads"] = QThread::idealThreadCount();
+        if (synthetic)
+        {
+            meta["backend"] = "synthetic";
+            meta["synthetic_spec"] = parser.value(syntheticOption);
+        }
+        else
+        {
+#ifdef SMORE_STUB_BACKEND
+            meta["backend"] = "stub";
+#else
+            meta["backend"] = "vimo";
+#endif
+        }
+#ifdef SMORE_BUILD_PROFILE
+        meta["build"] = SMORE_BUILD_PROFILE;
+#endif
+        meta["model_dir"] = parser.value(modelOption);
+        meta["image_dir"] = parser.value(imagesOption);
+        meta["frames"] = corpus->size();
+        meta["preprocess"] = parser.value(preprocessOption);
+        meta["module"] = QString::fromStdString(moduleId);
+        meta["pipelines"] = engineConfig.pipelineCount;
+        meta["use_gpu"] = engineConfig.useGpu;
+        meta["device"] = engineConfig.deviceId;
+        meta["pin_numa"] = pin;
+        QJsonArray deviceArray;
+        for (const DevicePlacement &placement : placements)
+        {
+            QJsonObject device;
+            device["device"] = placement.deviceId;
+            device["numa_node"] = placement.numaNode;
+            device["cpus"] = QString::fromStdString(formatCpuList(placement.cpus));
+            deviceArray.append(device);
+        }
+        meta["devices"] = deviceArray;
+        meta["solution_load_ms"] = loadStats.solutionLoadMs;
+        meta["pipeline_create_ms"] = loadStats.pipelineCreateMs;
+        meta["module_resolve_ms"] = loadStats.moduleResolveMs;
+        meta["module_graph_cached"] = loadStats.moduleGraphCached;
+
+        QJsonObject root;
+        root["meta"] = meta;
+        root["runs"] = runs;
+        if (!sweepObject.isEmpty())
+        {
+            root["sweep"] = sweepObject;
+        }
+        if (!writeFile(parser.value(jsonOption), QJsonDocument(root).toJson()))
+        {
+            std::fprintf(stderr, "写入失败: %s\n", qPrintable(parser.value(jsonOption)));
+            exitCode = 1;
+        }
+    }
+
+    if (parser.isSet(csvOption))
+    {
+        if (!writeFile(parser.value(csvOption), (csv.join('\n') + '\n').toUtf8()))
+        {
+            std::fprintf(stderr, "写入失败: %s\n", qPrintable(parser.value(csvOption)));
+            exitCode = 1;
+        }
+    }
+
+    return exitCode;
+}
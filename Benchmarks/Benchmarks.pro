@@ -0,0 +1,36 @@
+QT += core gui widgets
+
+CONFIG += c++17
+CONFIG += console
+CONFIG -= app_bundle
+
+# 微基准测试，用例按被测模块分文件：bench_<模块>.cpp
+# 运行：Benchmarks --filter=<子串> --min-time=<秒> --out=<json文件>
+# 和基线比较：Benchmarks --compare=<基线json> [--threshold=<百分比>]
+
+SOURCES += \
+    bench_batching.cpp \
+    bench_gui.cpp \
+    bench_imageio.cpp \
+    bench_latency.cpp \
+    bench_pool.cpp \
+    bench_postprocess.cpp \
+    bench_preprocess.cpp \
+    bench_resultcache.cpp \
+    bench_resultlog.cpp \
+    bench_queue.cpp \
+    bench_tiling.cpp \
+    bench_tracing.cpp \
+    benchcompare.cpp \
+    benchfixtures.cpp \
+    benchharness.cpp \
+    main.cpp
+
+HEADERS += \
+    benchcompare.h \
+    benchfixtures.h \
+    benchharness.h \
+    ../MultiThreadTest/sparklinedelegate.h
+
+# 被测的推理公共代码，以及SMore sdk和opencv
+include(../MultiThreadTest/core.pri)
@@ -0,0 +1,132 @@
+﻿#include "benchharness.h"
+#include "benchfixtures.h"
+
+#include <algorithm>
+#include <atomic>
+#include <map>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "inferencepool.h"
+#include "syntheticbackend.h"
+
+// 模拟产线：kStreamCount路相机同时送图，每路每轮kFramesPerStream张
+static const int kStreamCount = 8;
+static const int kFramesPerStream = 4;
+static const int kPipelineCount = 2;
+
+// 加载solution很慢，同一个进程里所有用例共用一个引擎
+// 没有设置模型目录时使用模拟后端（固定10ms，每多一张增加30%），照样能比较凑批参数
+static std::shared_ptr<InferenceEngine> sharedEngine()
+{
+    static std::mutex mutex;
+    static std::shared_ptr<InferenceEngine> engine;
+    std::lock_guard<std::mutex> locker(mutex);
+    if(!engine)
+    {
+        InferenceEngineConfig config;
+        config.modelDir = benchModelDir().toStdString();
+        config.pipelineCount = kPipelineCount;
+        if(config.modelDir.empty())
+        {
+            SyntheticBackendConfig synthetic;
+            synthetic.distribution = SyntheticLatency::Fixed;
+            synthetic.meanMs = 10;
+            config.backend = std::make_shared<SyntheticBackend>(synthetic);
+        }
+        engine = std::make_shared<InferenceEngine>(config);
+    }
+    return engine;
+}
+
+static double percentile(std::vector<double> &values, double p)
+{
+    if(values.empty())
+    {
+        return 0;
+    }
+    size_t index = std::min(values.size() - 1, (size_t)(p * values.size()));
+    std::nth_element(values.begin(), values.begin() + index, values.end());
+    return values[index];
+}
+
+// 参数：最大批大小，凑批等待时间(us)
+static void batchArgs(bench::Benchmark *benchmark)
+{
+    for(int batch : {1, 2, 4, 8})
+    {
+        for(int waitUs : {0, 1000, 5000})
+        {
+            if(batch == 1 && waitUs > 0)
+            {
+                continue;
+            }
+            benchmark->args({batch, waitUs});
+        }
+    }
+}
+
+// 对比不同的凑批参数下的吞吐量和单张延迟（入队到拿到结果）
+static void BM_InferencePoolBatching(bench::State &state)
+{
+    std::shared_ptr<InferenceEngine> engine = sharedEngine();
+    std::string error;
+    if(!engine->load(&error))
+    {
+        state.skipWithError("模型加载失败：" + error);
+    }
+
+    InferencePoolConfig config;
+    config.workerCount = kPipelineCount;
+    config.queueCapacity = kStreamCount * 2;
+    config.maxBatchSize = (int)state.range(0);
+    config.maxBatchWaitUs = (int)state.range(1);
+    InferencePool pool(engine, config);
+    pool.start();
+
+    cv::Mat image = makeBenchImage(1024, 768);
+    std::mutex latencyMutex;
+    std::vector<double> latencies;
+    std::atomic<long long> failed(0);
+
+    while(state.keepRunning())
+    {
+        std::vector<std::thread> streams;
+        for(int s = 0; s < kStreamCount; ++s)
+        {
+            streams.emplace_back([&]() {
+                for(int i = 0; i < kFramesPerStream; ++i)
+                {
+                    InferenceResult result = pool.submit(image).get();
+                    if(result.status != InferenceStatus::Ok)
+                    {
+                        ++failed;
+                        continue;
+                    }
+                    std::lock_guard<std::mutex> locker(latencyMutex);
+                    latencies.push_back(result.queueMs + result.inferMs);
+                }
+            });
+        }
+        for(auto &stream : streams)
+        {
+            stream.join();
+        }
+    }
+
+    pool.shutdown(true);
+    if(failed > 0)
+    {
+        state.skipWithError("推理失败");
+    }
+
+    state.setItemsProcessed(state.iterations() * kStreamCount * kFramesPerStream);
+    state.setCounter("p50_ms", percentile(latencies, 0.50));
+    state.setCounter("p99_ms", percentile(latencies, 0.99));
+    if(pool.batchCount() > 0)
+    {
+        state.setCounter("avg_batch", (double)pool.completedCount() / pool.batchCount());
+    }
+}
+SMORE_BENCHMARK(BM_InferencePoolBatching)->apply(batchArgs);
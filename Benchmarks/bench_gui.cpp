@@ -0,0 +1,190 @@
+﻿#include "benchharness.h"
+
+#include <QApplication>
+#include <QImage>
+#include <QPainter>
+#include <QStandardItemModel>
+#include <QStyleOptionViewItem>
+
+#include <cmath>
+#include <memory>
+#include <vector>
+
+#include "mpmcqueue.h"
+#include "sparklinedelegate.h"
+
+// 原来的界面更新方式：工作线程每推理一张就发一个inferCompleted信号，
+// 以队列连接投递到界面线程的事件循环
+class SampleEmitter : public QObject
+{
+    Q_OBJECT
+
+signals:
+    void inferCompleted(int index, double ms);
+};
+
+class SampleReceiver : public QObject
+{
+    Q_OBJECT
+
+public:
+    long long count = 0;
+    double sum = 0;
+
+public slots:
+    void onInferCompleted(int index, double ms)
+    {
+        Q_UNUSED(index);
+        ++count;
+        sum += ms;
+    }
+};
+
+// 投递参数个信号，再由事件循环逐个派发到槽函数
+static void BM_QueuedSignalRoundTrip(bench::State &state)
+{
+    int batch = (int)state.range(0);
+    SampleEmitter emitter;
+    SampleReceiver receiver;
+    QObject::connect(&emitter, &SampleEmitter::inferCompleted,
+                     &receiver, &SampleReceiver::onInferCompleted, Qt::QueuedConnection);
+
+    while(state.keepRunning())
+    {
+        for(int i = 0; i < batch; ++i)
+        {
+            emit emitter.inferCompleted(0, 30.0 + i);
+        }
+        QCoreApplication::sendPostedEvents(&receiver, QEvent::MetaCall);
+    }
+
+    if(receiver.count != state.iterations() * batch)
+    {
+        state.skipWithError("信号丢失");
+    }
+    state.setItemsProcessed(state.iterations() * batch);
+}
+SMORE_BENCHMARK(BM_QueuedSignalRoundTrip)->arg(1)->arg(32);
+
+// 现在的方式：工作线程写无锁队列，界面定时器一次取完；和上面的用例一一对应
+static void BM_SampleQueueRoundTrip(bench::State &state)
+{
+    int batch = (int)state.range(0);
+    MpmcQueue<double> queue(256);
+    long long count = 0;
+
+    while(state.keepRunning())
+    {
+        for(int i = 0; i < batch; ++i)
+        {
+            queue.tryPush(30.0 + i);
+        }
+        double ms = 0;
+        while(queue.tryPop(ms))
+        {
+            ++count;
+        }
+    }
+
+    if(count != state.iterations() * batch)
+    {
+        state.skipWithError("样本丢失");
+    }
+    state.setItemsProcessed(state.iterations() * batch);
+}
+SMORE_BENCHMARK(BM_SampleQueueRoundTrip)->arg(1)->arg(32);
+
+// 画一个曲线单元格（180x50，和界面上的列宽一致）
+// 参数：历史点数
+static void BM_SparklineDelegatePaint(bench::State &state)
+{
+    int points = (int)state.range(0);
+    std::shared_ptr<SparklineHistory> history = std::make_shared<SparklineHistory>(points);
+    for(int i = 0; i < points; ++i)
+    {
+        history->append(30.0 + 5.0 * std::sin(i * 0.3) + (i % 7) * 0.4);
+    }
+
+    QStandardItemModel model(1, 1);
+    QModelIndex index = model.index(0, 0);
+    model.setData(index, QVariant::fromValue(SparklineHistoryPtr(history)), Qt::UserRole);
+
+    QImage canvas(180, 50, QImage::Format_ARGB32_Premultiplied);
+    canvas.fill(Qt::white);
+    QStyleOptionViewItem option;
+    option.rect = canvas.rect();
+    option.palette = QApplication::palette();
+    option.state = QStyle::State_Enabled;
+
+    SparklineDelegate delegate;
+    QPainter painter(&canvas);
+    while(state.keepRunning())
+    {
+        delegate.paint(&painter, option, index);
+    }
+    painter.end();
+
+    state.setItemsProcessed(state.iterations());
+}
+SMORE_BENCHMARK(BM_SparklineDelegatePaint)->arg(30)->arg(120)->arg(600)->arg(3000);
+
+// 界面刷新一次：每路追加新点后画一次曲线单元格，和refreshTable()中的顺序一致
+// 参数：路数，每路的历史点数
+static void BM_SparklineRefresh(bench::State &state)
+{
+    int rows = (int)state.range(0);
+    int points = (int)state.range(1);
+    std::vector<std::shared_ptr<SparklineHistory>> histories;
+    QStandardItemModel model(rows, 1);
+    for(int row = 0; row < rows; ++row)
+    {
+        histories.push_back(std::make_shared<SparklineHistory>(points));
+        for(int i = 0; i < points; ++i)
+        {
+            histories.back()->append(30.0 + 5.0 * std::sin(i * 0.3) + (i % 7) * 0.4);
+        }
+        model.setData(model.index(row, 0), QVariant::fromValue(SparklineHistoryPtr(histories.back())), Qt::UserRole);
+    }
+
+    QImage canvas(180, 50, QImage::Format_ARGB32_Premultiplied);
+    canvas.fill(Qt::white);
+    QStyleOptionViewItem option;
+    option.rect = canvas.rect();
+    option.palette = QApplication::palette();
+    option.state = QStyle::State_Enabled;
+
+    SparklineDelegate delegate;
+    QPainter painter(&canvas);
+    long long tick = 0;
+    while(state.keepRunning())
+    {
+        for(int row = 0; row < rows; ++row)
+        {
+            histories[row]->append(30.0 + 5.0 * std::sin(tick * 0.3) + (tick % 7) * 0.4);
+            delegate.paint(&painter, option, model.index(row, 0));
+        }
+        ++tick;
+    }
+    painter.end();
+
+    state.setItemsProcessed(state.iterations() * rows);
+}
+SMORE_BENCHMARK(BM_SparklineRefresh)->args({32, 30})->args({32, 3000});
+
+// 追加一个点：窗口最小最大值和折线的维护
+// 参数：历史点数
+static void BM_SparklineHistoryAppend(bench::State &state)
+{
+    int points = (int)state.range(0);
+    SparklineHistory history(points);
+    long long i = 0;
+    while(state.keepRunning())
+    {
+        history.append(30.0 + 5.0 * std::sin(i * 0.3) + (i % 7) * 0.4);
+        ++i;
+    }
+    state.setItemsProcessed(state.iterations());
+}
+SMORE_BENCHMARK(BM_SparklineHistoryAppend)->arg(30)->arg(3000);
+
+#include "bench_gui.moc"
@@ -0,0 +1,70 @@
+﻿#include "benchharness.h"
+#include "benchfixtures.h"
+
+#include <QFileInfo>
+
+#include "imageio.h"
+#include "mappedimage.h"
+
+// 参数：图片格式（BenchImageFormat），图片宽度（高度为宽度的3/4）
+static void imageArgs(bench::Benchmark *benchmark)
+{
+    for(int width : {1024, 2448, 5472})
+    {
+        for(int format = 0; format < BenchImageFormatCount; ++format)
+        {
+            benchmark->args({format, width});
+        }
+    }
+}
+
+// 原来的读取方式：readAll + 拷贝到std::vector + imdecode
+static void BM_LoadMatFromPath(bench::State &state)
+{
+    QString path = benchImageFile((int)state.range(0), (int)state.range(1));
+    if(path.isEmpty())
+    {
+        state.skipWithError("无法生成测试图片");
+    }
+
+    while(state.keepRunning())
+    {
+        cv::Mat image = loadMatFromPath(path);
+        if(image.empty())
+        {
+            state.skipWithError("解码失败");
+        }
+    }
+
+    state.setBytesProcessed(state.iterations() * QFileInfo(path).size());
+    state.setLabel(benchImageFormatName((int)state.range(0)));
+}
+
+// 内存映射读取，解码到复用缓冲区；无压缩BMP不解码
+static void BM_MappedImageReader(bench::State &state)
+{
+    QString path = benchImageFile((int)state.range(0), (int)state.range(1));
+    if(path.isEmpty())
+    {
+        state.skipWithError("无法生成测试图片");
+    }
+
+    MappedImageReader reader;
+    bool zeroCopy = false;
+    while(state.keepRunning())
+    {
+        cv::Mat image;
+        std::shared_ptr<void> keepAlive;
+        if(!reader.read(path, image, keepAlive))
+        {
+            state.skipWithError("解码失败");
+        }
+        zeroCopy = reader.lastReadWasZeroCopy();
+    }
+
+    state.setBytesProcessed(state.iterations() * QFileInfo(path).size());
+    state.setLabel(std::string(benchImageFormatName((int)state.range(0))) + (zeroCopy ? " zero-copy" : ""));
+}
+
+SMORE_BENCHMARK(BM_LoadMatFromPath)->apply(imageArgs);
+SMORE_BENCHMARK(BM_MappedImageReader)->apply(imageArgs);
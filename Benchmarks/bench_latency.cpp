@@ -0,0 +1,64 @@
+﻿#include "benchharness.h"
+
+#include <atomic>
+#include <thread>
+#include <vector>
+
+#include "latencyhistogram.h"
+
+// 记录一次的开销，要求远小于1us，不影响被测的推理耗时
+// 参数：同时记录到同一个直方图的线程数（本线程之外的干扰线程）
+static void BM_LatencyHistogramRecord(bench::State &state)
+{
+    LatencyHistogram histogram;
+
+    std::atomic<bool> quit(false);
+    std::vector<std::thread> noise;
+    for(int i = 0; i < (int)state.range(0); ++i)
+    {
+        noise.emplace_back([&]() {
+            uint64_t value = 1000;
+            while(!quit.load(std::memory_order_relaxed))
+            {
+                histogram.record(value);
+                value = value * 6364136223846793005ULL + 1442695040888963407ULL;
+                value >>= 34;
+            }
+        });
+    }
+
+    // 伪随机的30ms上下的耗时，覆盖多个桶
+    uint64_t value = 30000000;
+    while(state.keepRunning())
+    {
+        histogram.record(value);
+        value = 20000000 + (value * 2862933555777941757ULL + 3037000493ULL) % 20000000;
+    }
+
+    quit = true;
+    for(auto &thread : noise)
+    {
+        thread.join();
+    }
+    state.setItemsProcessed(state.iterations());
+}
+SMORE_BENCHMARK(BM_LatencyHistogramRecord)->arg(0)->arg(1)->arg(3);
+
+// 取快照并计算分位数（界面刷新时的开销）
+static void BM_LatencyHistogramSnapshot(bench::State &state)
+{
+    LatencyHistogram histogram;
+    for(uint64_t i = 1; i <= 100000; ++i)
+    {
+        histogram.record(i * 997);
+    }
+
+    double sink = 0;
+    while(state.keepRunning())
+    {
+        LatencySnapshot snapshot = histogram.snapshot();
+        sink += snapshot.percentileMs(50) + snapshot.percentileMs(99);
+    }
+    state.setCounter("p99_ms", sink > 0 ? histogram.snapshot().percentileMs(99) : 0);
+}
+SMORE_BENCHMARK(BM_LatencyHistogramSnapshot);
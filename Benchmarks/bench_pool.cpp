@@ -0,0 +1,127 @@
+﻿#include "benchharness.h"
+#include "benchfixtures.h"
+
+#include "inferencepool.h"
+#include "vimoapi.h"
+
+using namespace smartmore;
+
+// 从cv::Mat构造vimo::Request，每次推理都要做一次
+// 参数：图片宽度（高度为宽度的3/4）
+static void BM_RequestFromMat(bench::State &state)
+{
+    int width = (int)state.range(0);
+    cv::Mat image = makeBenchImage(width, width * 3 / 4);
+    while(state.keepRunning())
+    {
+        vimo::Request request(image);
+        if(request.image().empty())
+        {
+            state.skipWithError("空请求");
+        }
+    }
+    state.setItemsProcessed(state.iterations());
+}
+SMORE_BENCHMARK(BM_RequestFromMat)->arg(1024)->arg(5472);
+
+// 借出并归还一个会话
+static void BM_EngineCheckout(bench::State &state)
+{
+    // 模拟后端耗时为0，测出来的就是引擎和线程池自身的开销
+    std::shared_ptr<InferenceEngine> engine = makeSyntheticEngine((int)state.range(0), 0);
+    std::string error;
+    if(!engine->load(&error))
+    {
+        state.skipWithError("引擎加载失败：" + error);
+    }
+
+    while(state.keepRunning())
+    {
+        InferenceEngine::Lease lease = engine->checkout();
+        if(!lease)
+        {
+            state.skipWithError("借不到会话");
+        }
+    }
+    state.setItemsProcessed(state.iterations());
+}
+SMORE_BENCHMARK(BM_EngineCheckout)->arg(1)->arg(8);
+
+// 提交一张图并等结果：入队、唤醒工作线程、借会话、回调、future
+// 参数：工作线程数，最大批大小
+static void BM_InferencePoolRoundTrip(bench::State &state)
+{
+    int workers = (int)state.range(0);
+    std::shared_ptr<InferenceEngine> engine = makeSyntheticEngine(workers, 0);
+
+    InferencePoolConfig config;
+    config.workerCount = workers;
+    config.queueCapacity = 16;
+    config.maxBatchSize = (int)state.range(1);
+    InferencePool pool(engine, config);
+    std::string error;
+    if(!pool.start(&error))
+    {
+        state.skipWithError("线程池启动失败：" + error);
+    }
+
+    cv::Mat image = makeBenchImage(64, 48);
+    long long failed = 0;
+    double queueMs = 0;
+    while(state.keepRunning())
+    {
+        InferenceResult result = pool.submit(image).get();
+        if(result.status != InferenceStatus::Ok)
+        {
+            ++failed;
+        }
+        queueMs += result.queueMs;
+    }
+
+    pool.shutdown(true);
+    if(failed > 0)
+    {
+        state.skipWithError("推理失败");
+    }
+    state.setItemsProcessed(state.iterations());
+    state.setCounter("queue_us", state.iterations() > 0 ? queueMs * 1000 / state.iterations() : 0);
+}
+SMORE_BENCHMARK(BM_InferencePoolRoundTrip)->args({1, 1})->args({4, 1})->args({4, 4});
+
+// 停止一个还有排队任务的线程池：排空（有预算）或者直接放弃
+// 参数：排队的任务数，是否排空；每张图模拟推理2ms，工作线程2个
+static void BM_InferencePoolShutdown(bench::State &state)
+{
+    int queued = (int)state.range(0);
+    bool drain = state.range(1) != 0;
+
+    std::shared_ptr<InferenceEngine> engine = makeSyntheticEngine(2, 2);
+
+    InferencePoolConfig config;
+    config.workerCount = 2;
+    config.queueCapacity = queued;
+    cv::Mat image = makeBenchImage(64, 48);
+
+    double abandoned = 0;
+    while(state.keepRunning())
+    {
+        state.pauseTiming();
+        InferencePool pool(engine, config);
+        std::string error;
+        if(!pool.start(&error))
+        {
+            state.skipWithError("线程池启动失败：" + error);
+        }
+        for(int i = 0; i < queued; i++)
+        {
+            pool.submit(image, InferenceCallback());
+        }
+        state.resumeTiming();
+
+        // 排空的预算是10ms，排队的图多于预算内能做完的，剩下的要放弃
+        InferencePoolShutdownStats stats = pool.shutdown(drain, std::chrono::milliseconds(10));
+        abandoned += stats.abandoned;
+    }
+    state.setCounter("abandoned", state.iterations() > 0 ? abandoned / state.iterations() : 0);
+}
+SMORE_BENCHMARK(BM_InferencePoolShutdown)->args({16, 0})->args({16, 1})->args({64, 1});
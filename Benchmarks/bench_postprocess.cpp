@@ -0,0 +1,61 @@
+﻿#include "benchharness.h"
+#include "benchfixtures.h"
+
+#include "resulthandlers.h"
+
+// 什么也不做的处理器，测的是后处理阶段自身的开销
+class NullHandler : public IResultHandler
+{
+public:
+    const char *name() const override { return "null"; }
+    void handle(PostProcessItem &item) override { (void)item; }
+};
+
+// 推理线程把一张结果交给后处理的开销（分配、入队、唤醒），要求远小于一次推理
+// 参数：后处理线程数
+static void BM_PostProcessSubmit(bench::State &state)
+{
+    PostProcessConfig config;
+    config.threadCount = (int)state.range(0);
+    config.queueCapacity = 4096;
+    PostProcessStage stage(config);
+    stage.addHandler(std::make_shared<NullHandler>());
+    stage.start();
+
+    // 图像只共用数据，不拷贝
+    cv::Mat image = makeBenchImage(1024, 768);
+    long long sequence = 0;
+    while(state.keepRunning())
+    {
+        PostProcessStage::ItemPtr item(new PostProcessItem);
+        item->sequence = sequence++;
+        item->image = image;
+        item->output.payload = std::vector<int>(4);
+        stage.submit(std::move(item));
+    }
+
+    stage.shutdown(true);
+    PostProcessStats stats = stage.stats();
+    state.setCounter("dropped", (double)stats.dropped);
+    state.setCounter("queue_p99_us", stats.queue.percentileMs(99) * 1000);
+    state.setItemsProcessed(state.iterations());
+}
+SMORE_BENCHMARK(BM_PostProcessSubmit)->arg(1)->arg(2);
+
+// 画一张叠加图（拷贝到画布、画框、写字），不保存
+// 参数：图片宽度（高度为宽度的3/4），灰度图
+static void BM_OverlayRender(bench::State &state)
+{
+    int width = (int)state.range(0);
+    OverlayHandler overlay;
+    PostProcessItem item;
+    item.image = makeBenchImage(width, width * 3 / 4, CV_8UC1);
+    item.verdict = ResultVerdict::Pass;
+    while(state.keepRunning())
+    {
+        overlay.handle(item);
+    }
+    state.setItemsProcessed(state.iterations());
+    state.setBytesProcessed(state.iterations() * (long long)item.image.total());
+}
+SMORE_BENCHMARK(BM_OverlayRender)->arg(1024)->arg(5472);
@@ -0,0 +1,132 @@
+﻿#include "benchharness.h"
+#include "benchfixtures.h"
+
+#include "preprocess.h"
+
+// 预处理内核和OpenCV通用实现的对比
+// 实现：0为cv::cvtColor/convertTo/resize组合，1为标量内核，2为SIMD内核（AVX2或NEON，CPU不支持时同标量）
+enum PreprocessImpl
+{
+    PreprocessOpenCv = 0,
+    PreprocessScalar,
+    PreprocessSimd,
+};
+
+static const char *preprocessImplName(int impl)
+{
+    switch(impl)
+    {
+    case PreprocessOpenCv: return "opencv";
+    case PreprocessScalar: return "scalar";
+    default: return preprocessIsa();
+    }
+}
+
+// OpenCV的做法：先转8位，再转BGR，最后缩放，每一步都生成一张完整的中间图
+static void openCvPreprocess(const cv::Mat &src, cv::Mat &dst, const PreprocessConfig &config)
+{
+    cv::Mat image = src;
+    if(image.depth() == CV_16U)
+    {
+        cv::Mat narrowed;
+        image.convertTo(narrowed, CV_8U, 255.0 / ((1 << config.bits) - 1));
+        image = narrowed;
+    }
+    if(image.channels() == 1)
+    {
+        cv::Mat bgr;
+        cv::cvtColor(image, bgr, cv::COLOR_GRAY2BGR);
+        image = bgr;
+    }
+    else if(image.channels() == 4)
+    {
+        cv::Mat bgr;
+        cv::cvtColor(image, bgr, cv::COLOR_BGRA2BGR);
+        image = bgr;
+    }
+    if(config.width > 0 && config.height > 0)
+    {
+        cv::resize(image, dst, cv::Size(config.width, config.height), 0, 0, cv::INTER_LINEAR);
+    }
+    else
+    {
+        dst = image;
+    }
+}
+
+static void runPreprocess(bench::State &state, int type, int width, int targetWidth)
+{
+    int impl = (int)state.range(0);
+    cv::Mat src = makeBenchImage(width, width * 3 / 4, type);
+
+    PreprocessConfig config;
+    config.width = targetWidth;
+    config.height = targetWidth * 3 / 4;
+    config.simd = impl == PreprocessSimd;
+    FramePreprocessor preprocessor(config);
+
+    cv::Mat dst;
+    while(state.keepRunning())
+    {
+        if(impl == PreprocessOpenCv)
+        {
+            openCvPreprocess(src, dst, config);
+        }
+        else if(!preprocessor.process(src, dst))
+        {
+            state.skipWithError("预处理失败");
+        }
+    }
+
+    state.setItemsProcessed(state.iterations());
+    state.setBytesProcessed(state.iterations() * (long long)(src.total() * src.elemSize()));
+    state.setLabel(preprocessImplName(impl));
+}
+
+// 参数：实现，图片宽度（高度为宽度的3/4）
+static void implArgs(bench::Benchmark *benchmark)
+{
+    for(int width : {2448, 5472})
+    {
+        for(int impl = PreprocessOpenCv; impl <= PreprocessSimd; ++impl)
+        {
+            benchmark->args({impl, width});
+        }
+    }
+}
+
+// 灰度BMP/PNG：展开成3通道
+static void BM_GrayToBgr(bench::State &state)
+{
+    runPreprocess(state, CV_8UC1, (int)state.range(1), 0);
+}
+
+// 带透明通道的PNG：去掉alpha
+static void BM_BgraToBgr(bench::State &state)
+{
+    runPreprocess(state, CV_8UC4, (int)state.range(1), 0);
+}
+
+// 16位彩色TIFF：缩放到8位
+static void BM_Narrow16(bench::State &state)
+{
+    runPreprocess(state, CV_16UC3, (int)state.range(1), 0);
+}
+
+// 16位灰度TIFF到1024x768的模型输入：缩放到8位、展开通道和缩放一起完成
+static void BM_PreprocessToModel(bench::State &state)
+{
+    runPreprocess(state, CV_16UC1, (int)state.range(1), 1024);
+}
+
+// 已经是8位BGR时只缩放
+static void BM_ResizeToModel(bench::State &state)
+{
+    runPreprocess(state, CV_8UC3, (int)state.range(1), 1024);
+}
+
+SMORE_BENCHMARK(BM_GrayToBgr)->apply(implArgs);
+SMORE_BENCHMARK(BM_BgraToBgr)->apply(implArgs);
+SMORE_BENCHMARK(BM_Narrow16)->apply(implArgs);
+SMORE_BENCHMARK(BM_PreprocessToModel)->apply(implArgs);
+SMORE_BENCHMARK(BM_ResizeToModel)->apply(implArgs);
@@ -0,0 +1,98 @@
+﻿#include "benchharness.h"
+
+#include <atomic>
+#include <memory>
+#include <thread>
+#include <vector>
+
+#include "mpmcqueue.h"
+
+// 单线程入队+出队一次，队列本身的最低开销
+static void BM_MpmcQueuePushPop(bench::State &state)
+{
+    MpmcQueue<double> queue(256);
+    double value = 0;
+    while(state.keepRunning())
+    {
+        queue.tryPush(value + 1);
+        queue.tryPop(value);
+    }
+    state.setItemsProcessed(state.iterations());
+}
+SMORE_BENCHMARK(BM_MpmcQueuePushPop);
+
+// 推理线程池里的任务是unique_ptr，出入队都是移动
+static void BM_MpmcQueueUniquePtr(bench::State &state)
+{
+    MpmcQueue<std::unique_ptr<int>> queue(256);
+    std::unique_ptr<int> item(new int(1));
+    while(state.keepRunning())
+    {
+        queue.tryPush(std::move(item));
+        queue.tryPop(item);
+    }
+    state.setItemsProcessed(state.iterations());
+}
+SMORE_BENCHMARK(BM_MpmcQueueUniquePtr);
+
+// 有竞争时的吞吐量：本线程生产，参数个消费线程抢着出队
+// 队列满时生产者让出CPU后重试，每轮迭代保证送出一个元素
+static void BM_MpmcQueueContended(bench::State &state)
+{
+    MpmcQueue<double> queue(256);
+    std::atomic<bool> quit(false);
+    std::atomic<long long> consumed(0);
+    std::vector<std::thread> consumers;
+    for(int i = 0; i < (int)state.range(0); ++i)
+    {
+        consumers.emplace_back([&]() {
+            double value = 0;
+            long long count = 0;
+            for(;;)
+            {
+                if(queue.tryPop(value))
+                {
+                    ++count;
+                }
+                else if(quit.load(std::memory_order_acquire))
+                {
+                    // 看到quit之前那次失败的出队可能读到的是旧状态，再取一遍
+                    while(queue.tryPop(value))
+                    {
+                        ++count;
+                    }
+                    break;
+                }
+                else
+                {
+                    std::this_thread::yield();
+                }
+            }
+            consumed += count;
+        });
+    }
+
+    long long retries = 0;
+    double value = 1;
+    while(state.keepRunning())
+    {
+        while(!queue.tryPush(value))
+        {
+            ++retries;
+            std::this_thread::yield();
+        }
+    }
+
+    quit.store(true, std::memory_order_release);
+    for(auto &consumer : consumers)
+    {
+        consumer.join();
+    }
+    if(consumed != state.iterations())
+    {
+        state.skipWithError("元素丢失");
+    }
+    state.setItemsProcessed(state.iterations());
+    state.setCounter("retries_per_item", state.iterations() > 0 ? (double)retries / state.iterations() : 0);
+}
+SMORE_BENCHMARK(BM_MpmcQueueContended)->arg(1)->arg(2)->arg(4);
@@ -0,0 +1,94 @@
+﻿#include "benchharness.h"
+#include "benchfixtures.h"
+
+#include "inferencepool.h"
+#include "resultcache.h"
+#include "syntheticbackend.h"
+
+// 算一张图的内容哈希，命中缓存时的主要开销
+// 参数：图片宽度（高度为宽度的3/4），是否为ROI（不连续，逐行计算）
+static void BM_HashImage(bench::State &state)
+{
+    int width = (int)state.range(0);
+    cv::Mat image = makeBenchImage(width, width * 3 / 4);
+    if(state.range(1))
+    {
+        image = image(cv::Rect(1, 1, width - 2, width * 3 / 4 - 2));
+    }
+
+    unsigned long long hash = 0;
+    while(state.keepRunning())
+    {
+        hash += hashImage(image);
+    }
+    state.setCounter("hash", (double)(hash & 0xffff));
+    state.setBytesProcessed(state.iterations() * (long long)(image.total() * image.elemSize()));
+}
+SMORE_BENCHMARK(BM_HashImage)->args({1024, 0})->args({5472, 0})->args({5472, 1});
+
+// 查一次表：命中时拷贝一份结果并移到LRU的前端
+// 参数：缓存中的条目数
+static void BM_ResultCacheLookup(bench::State &state)
+{
+    int entries = (int)state.range(0);
+    ResultCache cache;
+    InferenceOutput output;
+    output.payload = SyntheticResponse();
+    for(int i = 0; i < entries; ++i)
+    {
+        ResultCacheKey key;
+        key.hash = (unsigned long long)i * 0x9E3779B97F4A7C15ULL;
+        cache.store(key, output, 256);
+    }
+
+    long long i = 0;
+    while(state.keepRunning())
+    {
+        ResultCacheKey key;
+        key.hash = (unsigned long long)(i++ % entries) * 0x9E3779B97F4A7C15ULL;
+        InferenceOutput found;
+        if(!cache.lookup(key, found))
+        {
+            state.skipWithError("没有命中");
+        }
+    }
+    state.setItemsProcessed(state.iterations());
+}
+SMORE_BENCHMARK(BM_ResultCacheLookup)->arg(16)->arg(4096);
+
+// 反复提交同一张图并等结果：缓存关闭时每次都推理，打开时第二次起只算哈希查表
+// 参数：是否使用缓存，图片宽度（高度为宽度的3/4）
+static void BM_CachedResubmit(bench::State &state)
+{
+    bool cached = state.range(0) != 0;
+    int width = (int)state.range(1);
+
+    InferencePoolConfig config;
+    config.workerCount = 1;
+    config.queueCapacity = 16;
+    if(cached)
+    {
+        config.resultCache = std::make_shared<ResultCache>();
+    }
+    InferencePool pool(makeSyntheticEngine(1, 5), config);
+    std::string error;
+    if(!pool.start(&error))
+    {
+        state.skipWithError("线程池启动失败：" + error);
+        return;
+    }
+
+    cv::Mat image = makeBenchImage(width, width * 3 / 4);
+    while(state.keepRunning())
+    {
+        InferenceResult result = pool.submit(image).get();
+        if(result.status != InferenceStatus::Ok)
+        {
+            state.skipWithError(result.error);
+        }
+    }
+    state.setCounter("cached", (double)pool.cachedCount());
+    state.setItemsProcessed(state.iterations());
+    pool.shutdown();
+}
+SMORE_BENCHMARK(BM_CachedResubmit)->args({0, 1024})->args({1, 1024})->args({1, 5472});
@@ -0,0 +1,109 @@
+﻿#include "benchharness.h"
+
+#include "resultlog.h"
+
+#include <filesystem>
+#include <system_error>
+#include <thread>
+
+namespace fs = std::filesystem;
+
+// 每个用例用一个新的临时目录，结束时删掉
+static std::string resultLogBenchPrefix(const char *name)
+{
+    fs::path dir = fs::temp_directory_path() / "smore-bench-resultlog" / name;
+    std::error_code ec;
+    fs::remove_all(dir, ec);
+    fs::create_directories(dir, ec);
+    return (dir / "results").string();
+}
+
+static ResultLogRecord makeRecord(long long sequence)
+{
+    ResultLogRecord record;
+    record.timestampUs = ResultLogWriter::nowUs();
+    record.sequence = sequence;
+    record.stream = (int)(sequence & 7);
+    record.fetchMs = 0.1f;
+    record.queueMs = 0.5f;
+    record.inferMs = 30.f;
+    record.totalMs = 30.6f;
+    return record;
+}
+
+// 推理回调中写一条结果日志的开销（取时间、拷进无锁队列），写文件在后台线程
+// 1000张/秒时要求远小于1ms的1%（10us）
+static void BM_ResultLogAppend(bench::State &state)
+{
+    ResultLogConfig config;
+    config.path = resultLogBenchPrefix("append");
+    config.maxFileBytes = 64LL << 20;
+    config.maxFiles = 2;
+    ResultLogWriter writer(config);
+    std::string error;
+    if(!writer.open(&error))
+    {
+        state.skipWithError(error);
+        return;
+    }
+
+    long long sequence = 0;
+    while(state.keepRunning())
+    {
+        writer.append(makeRecord(sequence++));
+    }
+
+    writer.close();
+    ResultLogStats stats = writer.stats();
+    state.setCounter("dropped", (double)stats.dropped);
+    state.setCounter("files", stats.files);
+    state.setItemsProcessed(state.iterations());
+    state.setBytesProcessed(stats.written * (long long)sizeof(ResultLogRecord));
+    std::error_code ec;
+    fs::remove_all(fs::path(config.path).parent_path(), ec);
+}
+SMORE_BENCHMARK(BM_ResultLogAppend);
+
+// 离线工具读日志的速度
+// 参数：记录数
+static void BM_ResultLogRead(bench::State &state)
+{
+    ResultLogConfig config;
+    config.path = resultLogBenchPrefix("read");
+    {
+        ResultLogWriter writer(config);
+        std::string error;
+        if(!writer.open(&error))
+        {
+            state.skipWithError(error);
+            return;
+        }
+        for(long long i = 0; i < state.range(0); ++i)
+        {
+            // 队列满时等写线程取走
+            while(!writer.append(makeRecord(i)))
+            {
+                std::this_thread::yield();
+            }
+        }
+    }
+    std::vector<std::string> files = resultLogFiles(config.path);
+
+    long long records = 0;
+    while(state.keepRunning())
+    {
+        for(const std::string &file : files)
+        {
+            readResultLog(file, [&records](const ResultLogRecord &) {
+                ++records;
+                return true;
+            });
+        }
+    }
+
+    state.setItemsProcessed(records);
+    state.setBytesProcessed(records * (long long)sizeof(ResultLogRecord));
+    std::error_code ec;
+    fs::remove_all(fs::path(config.path).parent_path(), ec);
+}
+SMORE_BENCHMARK(BM_ResultLogRead)->arg(1 << 20);
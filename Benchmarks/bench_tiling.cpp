@@ -0,0 +1,98 @@
+﻿#include "benchharness.h"
+#include "benchfixtures.h"
+
+#include "tiledinference.h"
+
+// 20M像素的检测图（5472x3648）
+static const int kLargeWidth = 5472;
+static const int kLargeHeight = 3648;
+
+// 拼接时合并重叠区域的检测框
+// 参数：每张图的目标间距（像素），间距越小框越多
+static void BM_MergeDetections(bench::State &state)
+{
+    TileConfig tiling;
+    std::vector<cv::Rect> tiles = planTiles(cv::Size(kLargeWidth, kLargeHeight), tiling);
+    int spacing = (int)state.range(0);
+    const int size = 64;
+
+    // 和模拟后端一样：原图上的网格目标，各块输出和自己相交的部分
+    std::vector<InferenceDetection> boxes;
+    for(const cv::Rect &tile : tiles)
+    {
+        for(int y = spacing / 2; y < kLargeHeight; y += spacing)
+        {
+            for(int x = spacing / 2; x < kLargeWidth; x += spacing)
+            {
+                cv::Rect object(x, y, size, size);
+                cv::Rect visible = object & tile;
+                if(visible.area() > 0)
+                {
+                    InferenceDetection detection;
+                    detection.box = cv::Rect2f(visible);
+                    detection.score = (float)visible.area() / object.area();
+                    boxes.push_back(detection);
+                }
+            }
+        }
+    }
+
+    size_t kept = 0;
+    while(state.keepRunning())
+    {
+        kept = mergeDetections(boxes, tiling.nmsIou, tiling.mergeCover).size();
+    }
+    state.setCounter("boxes", (double)boxes.size());
+    state.setCounter("kept", (double)kept);
+    state.setItemsProcessed(state.iterations() * (long long)boxes.size());
+}
+SMORE_BENCHMARK(BM_MergeDetections)->arg(300)->arg(100);
+
+// 一张20M像素的图从提交到拼完的耗时：整图一次推理和切成1024的块并行推理
+// 模拟后端每百万像素5ms，和真实模型一样大图更慢
+// 参数：pipelines数，是否切图
+static void BM_TiledInference(bench::State &state)
+{
+    int pipelines = (int)state.range(0);
+    bool tiled = state.range(1) != 0;
+
+    std::shared_ptr<InferenceEngine> engine = makeSyntheticEngine(pipelines, 1, 5, 300);
+
+    InferencePoolConfig config;
+    config.workerCount = pipelines;
+    config.queueCapacity = 64;
+    InferencePool pool(engine, config);
+    std::string error;
+    if(!pool.start(&error))
+    {
+        state.skipWithError("线程池启动失败：" + error);
+        return;
+    }
+
+    TileConfig tiling;
+    TiledInference tiler(pool, tiling);
+    cv::Mat image = makeBenchImage(kLargeWidth, kLargeHeight);
+    while(state.keepRunning())
+    {
+        if(tiled)
+        {
+            TiledInferenceResult result = tiler.submit(image).get();
+            if(result.status != InferenceStatus::Ok)
+            {
+                state.skipWithError(result.error);
+            }
+        }
+        else
+        {
+            InferenceResult result = pool.submit(image).get();
+            if(result.status != InferenceStatus::Ok)
+            {
+                state.skipWithError(result.error);
+            }
+        }
+    }
+    state.setCounter("tiles", tiled ? (double)planTiles(image.size(), tiling).size() : 1.0);
+    state.setItemsProcessed(state.iterations());
+    pool.shutdown();
+}
+SMORE_BENCHMARK(BM_TiledInference)->args({1, 0})->args({1, 1})->args({4, 1})->args({8, 1});
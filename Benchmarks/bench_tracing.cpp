@@ -0,0 +1,61 @@
+﻿#include "benchharness.h"
+
+#include <sstream>
+
+#include "tracing.h"
+
+// 一个span的开销；参数0：跟踪关闭（送图循环中常驻的开销，要求只有几纳秒），1：跟踪打开
+static void BM_TraceSpan(bench::State &state)
+{
+    TraceRecorder &recorder = TraceRecorder::instance();
+    recorder.clear();
+    recorder.setEnabled(state.range(0) != 0);
+
+    // 缓冲区满了之后只计数不记录，比正常记录快，所以每记满一次清空一次
+    const long long kClearEvery = 16384;
+    long long count = 0;
+    while(state.keepRunning())
+    {
+        TraceSpan span("bench", "bench", count);
+        if(++count % kClearEvery == 0)
+        {
+            span.finish();
+            state.pauseTiming();
+            recorder.clear();
+            state.resumeTiming();
+        }
+    }
+
+    recorder.setEnabled(false);
+    recorder.clear();
+    state.setItemsProcessed(state.iterations());
+}
+SMORE_BENCHMARK(BM_TraceSpan)->arg(0)->arg(1);
+
+// 导出Chrome trace JSON，参数：span数
+static void BM_TraceExport(bench::State &state)
+{
+    TraceRecorder &recorder = TraceRecorder::instance();
+    recorder.clear();
+    recorder.setEnabled(true);
+    auto begin = TraceRecorder::Clock::now();
+    for(long long i = 0; i < state.range(0); ++i)
+    {
+        recorder.record("bench", "bench", begin, begin + std::chrono::microseconds(i), i,
+                        i % 2 == 0 ? TraceFlow::Out : TraceFlow::In);
+    }
+    recorder.setEnabled(false);
+
+    size_t bytes = 0;
+    while(state.keepRunning())
+    {
+        std::ostringstream out;
+        recorder.writeChromeTrace(out);
+        bytes = out.str().size();
+    }
+
+    recorder.clear();
+    state.setItemsProcessed(state.iterations() * state.range(0));
+    state.setBytesProcessed(state.iterations() * (long long)bytes);
+}
+SMORE_BENCHMARK(BM_TraceExport)->arg(1024)->arg(16384);
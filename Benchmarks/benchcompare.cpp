@@ -0,0 +1,113 @@
+﻿#include "benchcompare.h"
+
+#include <QFile>
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QMap>
+#include <QStringList>
+
+#include <cstdio>
+
+static bool readResults(const QString &path, QJsonObject &context, QMap<QString, QJsonObject> &benchmarks,
+                        QStringList &order)
+{
+    QFile file(path);
+    if(!file.open(QIODevice::ReadOnly))
+    {
+        std::fprintf(stderr, "无法读取: %s\n", qPrintable(path));
+        return false;
+    }
+
+    QJsonParseError error;
+    QJsonDocument document = QJsonDocument::fromJson(file.readAll(), &error);
+    if(document.isNull())
+    {
+        std::fprintf(stderr, "%s 不是有效的JSON: %s\n", qPrintable(path), qPrintable(error.errorString()));
+        return false;
+    }
+
+    QJsonObject root = document.object();
+    context = root.value("context").toObject();
+    for(const QJsonValue &value : root.value("benchmarks").toArray())
+    {
+        QJsonObject benchmark = value.toObject();
+        QString name = benchmark.value("name").toString();
+        if(!benchmarks.contains(name))
+        {
+            order << name;
+        }
+        benchmarks[name] = benchmark;
+    }
+    return true;
+}
+
+int compareBenchmarkResults(const QString &baselinePath, const QString &currentPath, double thresholdPercent)
+{
+    QJsonObject baseContext, currentContext;
+    QMap<QString, QJsonObject> baseline, current;
+    QStringList baseOrder, currentOrder;
+    if(!readResults(baselinePath, baseContext, baseline, baseOrder)
+        || !readResults(currentPath, currentContext, current, currentOrder))
+    {
+        return -1;
+    }
+
+    // 不同配置编出来的数据没有可比性
+    for(const char *key : {"library_build_type", "smore_build", "smore_backend"})
+    {
+        QString before = baseContext.value(key).toString();
+        QString after = currentContext.value(key).toString();
+        if(before != after)
+        {
+            std::printf("警告: %s 不一致（基线 %s，本次 %s）\n", key, qPrintable(before), qPrintable(after));
+        }
+    }
+
+    std::printf("%-48s %14s %14s %9s\n", "Benchmark", "Baseline(ns)", "Current(ns)", "Change");
+    std::printf("%s\n", std::string(88, '-').c_str());
+
+    int regressions = 0;
+    for(const QString &name : currentOrder)
+    {
+        const QJsonObject &after = current[name];
+        if(!baseline.contains(name))
+        {
+            std::printf("%-48s %14s %14.0f %9s\n", qPrintable(name), "-", after.value("real_time").toDouble(), "new");
+            continue;
+        }
+
+        const QJsonObject &before = baseline[name];
+        if(before.value("error_occurred").toBool() || after.value("error_occurred").toBool())
+        {
+            std::printf("%-48s %14s %14s %9s\n", qPrintable(name), "-", "-", "skipped");
+            continue;
+        }
+
+        double beforeNs = before.value("real_time").toDouble();
+        double afterNs = after.value("real_time").toDouble();
+        double change = beforeNs > 0 ? (afterNs - beforeNs) / beforeNs * 100.0 : 0;
+        const char *verdict = "";
+        if(change > thresholdPercent)
+        {
+            verdict = "  退步";
+            ++regressions;
+        }
+        else if(change < -thresholdPercent)
+        {
+            verdict = "  改进";
+        }
+        std::printf("%-48s %14.0f %14.0f %+8.1f%%%s\n", qPrintable(name), beforeNs, afterNs, change, verdict);
+    }
+
+    for(const QString &name : baseOrder)
+    {
+        if(!current.contains(name))
+        {
+            std::printf("%-48s %14.0f %14s %9s\n", qPrintable(name), baseline[name].value("real_time").toDouble(), "-", "missing");
+        }
+    }
+
+    std::printf("\n%d 个用例变慢超过 %.1f%%\n", regressions, thresholdPercent);
+    return regressions;
+}
@@ -0,0 +1,12 @@
+﻿#ifndef BENCHCOMPARE_H
+#define BENCHCOMPARE_H
+
+#include <QString>
+
+// 比较两份Benchmarks输出的JSON（基线和本次），逐个用例打印墙钟时间的变化
+// 变慢超过thresholdPercent的记为退步；两边的编译配置、推理后端不一致时给出警告
+// 返回退步的用例数，文件读不出来时返回-1
+int compareBenchmarkResults(const QString &baselinePath, const QString &currentPath,
+                            double thresholdPercent);
+
+#endif // BENCHCOMPARE_H
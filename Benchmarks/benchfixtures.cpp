@@ -0,0 +1,160 @@
+﻿#include "benchfixtures.h"
+
+#include <QFile>
+#include <QMap>
+#include <QTemporaryDir>
+
+#include <cstring>
+
+#include "inferenceengine.h"
+#include "syntheticbackend.h"
+
+const char *benchImageFormatName(int format)
+{
+    switch (format) {
+    case BenchBmp: return "bmp";
+    case BenchBmpTopDown: return "bmp-topdown";
+    case BenchJpeg: return "jpg";
+    case BenchPng: return "png";
+    case BenchTiff: return "tif";
+    default: return "unknown";
+    }
+}
+
+cv::Mat makeBenchImage(int width, int height, int type)
+{
+    cv::Mat image(height, width, type);
+    int channels = image.channels();
+    bool wide = image.depth() == CV_16U;
+
+    quint32 seed = 12345;
+    for(int y = 0; y < height; ++y)
+    {
+        uchar *row8 = image.ptr<uchar>(y);
+        ushort *row16 = image.ptr<ushort>(y);
+        for(int x = 0; x < width; ++x)
+        {
+            for(int c = 0; c < channels; ++c)
+            {
+                seed = seed * 1664525u + 1013904223u;
+                int value = ((x + y * (c + 1)) & 0xFF) ^ ((seed >> 24) & 0x1F);
+                if(wide)
+                {
+                    row16[x * channels + c] = (ushort)(value * 257);
+                }
+                else
+                {
+                    row8[x * channels + c] = (uchar)value;
+                }
+            }
+        }
+    }
+    return image;
+}
+
+// 写一张自上而下存储（高度为负）的24位BMP
+static bool writeTopDownBmp(const QString &path, const cv::Mat &bgr)
+{
+    int width = bgr.cols;
+    int height = bgr.rows;
+    quint32 stride = ((width * 24 + 31) / 32) * 4;
+    quint32 pixelOffset = 14 + 40;
+    quint32 fileSize = pixelOffset + stride * height;
+
+    QByteArray data(fileSize, 0);
+    uchar *p = reinterpret_cast<uchar *>(data.data());
+    auto put16 = [](uchar *dst, quint16 v) { std::memcpy(dst, &v, 2); };
+    auto put32 = [](uchar *dst, quint32 v) { std::memcpy(dst, &v, 4); };
+
+    p[0] = 'B';
+    p[1] = 'M';
+    put32(p + 2, fileSize);
+    put32(p + 10, pixelOffset);
+    put32(p + 14, 40);
+    put32(p + 18, (quint32)width);
+    put32(p + 22, (quint32)(-height));
+    put16(p + 26, 1);
+    put16(p + 28, 24);
+    put32(p + 34, stride * height);
+
+    for(int y = 0; y < height; ++y)
+    {
+        std::memcpy(p + pixelOffset + y * stride, bgr.ptr<uchar>(y), width * 3);
+    }
+
+    QFile file(path);
+    return file.open(QFile::WriteOnly) && file.write(data) == data.size();
+}
+
+QString benchImageFile(int format, int width)
+{
+    static QTemporaryDir dir;
+    static QMap<QString, QString> cache;
+
+    QString key = QString("%1_%2").arg(benchImageFormatName(format)).arg(width);
+    if(cache.contains(key))
+    {
+        return cache[key];
+    }
+    if(!dir.isValid())
+    {
+        return QString();
+    }
+
+    cv::Mat image = makeBenchImage(width, width * 3 / 4);
+    QString path;
+    bool ok = false;
+    if(format == BenchBmpTopDown)
+    {
+        path = dir.filePath(key + ".bmp");
+        ok = writeTopDownBmp(path, image);
+    }
+    else
+    {
+        QString suffix = format == BenchBmp ? ".bmp" : QString(".") + benchImageFormatName(format);
+        path = dir.filePath(key + suffix);
+
+        std::vector<uchar> encoded;
+        if(cv::imencode(suffix.toStdString(), image, encoded))
+        {
+            QFile file(path);
+            ok = file.open(QFile::WriteOnly)
+                 && file.write(reinterpret_cast<const char *>(encoded.data()), (qint64)encoded.size()) == (qint64)encoded.size();
+        }
+    }
+
+    if(!ok)
+    {
+        return QString();
+    }
+    cache[key] = path;
+    return path;
+}
+
+QString benchModelDir()
+{
+    QString dir = qEnvironmentVariable("SMORE_BENCH_MODEL_DIR");
+#ifdef SMORE_STUB_BACKEND
+    if(dir.isEmpty())
+    {
+        dir = QStringLiteral("stub-model");
+    }
+#endif
+    return dir;
+}
+
+std::shared_ptr<InferenceEngine> makeSyntheticEngine(int pipelineCount, double meanMs,
+                                                     double msPerMegapixel, int objectSpacing)
+{
+    SyntheticBackendConfig synthetic;
+    synthetic.distribution = SyntheticLatency::Fixed;
+    synthetic.meanMs = meanMs;
+    synthetic.msPerMegapixel = msPerMegapixel;
+    synthetic.objectSpacing = objectSpacing;
+    synthetic.moduleCount = 1;
+
+    InferenceEngineConfig config;
+    config.pipelineCount = pipelineCount;
+    config.backend = std::make_shared<SyntheticBackend>(synthetic);
+    return std::make_shared<InferenceEngine>(config);
+}
@@ -0,0 +1,40 @@
+﻿#ifndef BENCHFIXTURES_H
+#define BENCHFIXTURES_H
+
+#include <QString>
+
+#include <memory>
+
+#include <opencv2/opencv.hpp>
+
+class InferenceEngine;
+
+// 基准测试用的图片格式，用作用例参数
+enum BenchImageFormat
+{
+    BenchBmp = 0,       // OpenCV写出的BMP（自下而上）
+    BenchBmpTopDown,    // 自上而下的BMP（可以零拷贝）
+    BenchJpeg,
+    BenchPng,
+    BenchTiff,
+    BenchImageFormatCount
+};
+
+const char *benchImageFormatName(int format);
+
+// 生成确定性的测试图：渐变加上伪随机纹理，让jpg/png的压缩率接近真实图片
+cv::Mat makeBenchImage(int width, int height, int type = CV_8UC3);
+
+// 生成（并缓存）宽为width、高为width*3/4的测试图片文件，返回路径；失败返回空
+QString benchImageFile(int format, int width);
+
+// 推理相关用例使用的模型目录：环境变量SMORE_BENCH_MODEL_DIR；
+// 桩实现下不需要真实模型，没有设置时也返回一个占位路径。返回空时推理用例改用模拟后端
+QString benchModelDir();
+
+// 使用模拟后端的推理引擎：固定耗时meanMs，加上每百万像素msPerMegapixel；
+// objectSpacing大于0时按网格输出检测框（见SyntheticBackendConfig）
+std::shared_ptr<InferenceEngine> makeSyntheticEngine(int pipelineCount, double meanMs,
+                                                     double msPerMegapixel = 0, int objectSpacing = 0);
+
+#endif // BENCHFIXTURES_H
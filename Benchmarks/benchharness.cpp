@@ -0,0 +1,405 @@
+﻿#include "benchharness.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <ctime>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <sstream>
+
+namespace bench {
+
+State::State(long long maxIterations, const std::vector<long long> &args)
+    : mMaxIterations(maxIterations)
+    , mArgs(args)
+{
+}
+
+bool State::keepRunning()
+{
+    if (!mStarted)
+    {
+        mStarted = true;
+        resumeTiming();
+    }
+
+    if (mIterations < mMaxIterations && mError.empty())
+    {
+        ++mIterations;
+        return true;
+    }
+
+    pauseTiming();
+    return false;
+}
+
+void State::pauseTiming()
+{
+    if (mRunning)
+    {
+        mElapsed += Clock::now() - mStart;
+        mRunning = false;
+    }
+}
+
+void State::resumeTiming()
+{
+    if (!mRunning)
+    {
+        mStart = Clock::now();
+        mRunning = true;
+    }
+}
+
+long long State::range(int index) const
+{
+    return index < (int)mArgs.size() ? mArgs[index] : 0;
+}
+
+void State::skipWithError(const std::string &error)
+{
+    mError = error;
+}
+
+Benchmark::Benchmark(const std::string &name, Function fn)
+    : mName(name)
+    , mFn(std::move(fn))
+{
+}
+
+Benchmark *Benchmark::arg(long long value)
+{
+    mArgSets.push_back({value});
+    return this;
+}
+
+Benchmark *Benchmark::args(const std::vector<long long> &values)
+{
+    mArgSets.push_back(values);
+    return this;
+}
+
+Benchmark *Benchmark::apply(void (*fn)(Benchmark *benchmark))
+{
+    fn(this);
+    return this;
+}
+
+Benchmark *Benchmark::iterations(long long count)
+{
+    mFixedIterations = count;
+    return this;
+}
+
+static std::vector<Benchmark *> &registry()
+{
+    static std::vector<Benchmark *> benchmarks;
+    return benchmarks;
+}
+
+Benchmark *registerBenchmark(const std::string &name, Function fn)
+{
+    Benchmark *benchmark = new Benchmark(name, std::move(fn));
+    registry().push_back(benchmark);
+    return benchmark;
+}
+
+static std::map<std::string, std::string> &contextEntries()
+{
+    static std::map<std::string, std::string> entries;
+    return entries;
+}
+
+void setContext(const std::string &key, const std::string &value)
+{
+    contextEntries()[key] = value;
+}
+
+// 单个用例一次完整运行的结果
+struct Result
+{
+    std::string name;
+    long long iterations = 0;
+    double realNs = 0;      // 每次迭代的墙钟时间
+    double cpuNs = 0;       // 每次迭代的进程CPU时间
+    double bytesPerSecond = 0;
+    double itemsPerSecond = 0;
+    std::string label;
+    std::map<std::string, double> counters;
+    std::string error;
+};
+
+struct Runner
+{
+    double minTime = 0.5;
+
+    Result run(Benchmark &benchmark, const std::vector<long long> &args)
+    {
+        Result result;
+        result.name = benchmark.mName;
+        for (long long value : args)
+        {
+            result.name += "/" + std::to_string(value);
+        }
+
+        // 和Google Benchmark一样，迭代次数从1开始按耗时放大，直到单次运行超过minTime
+        long long iterations = benchmark.mFixedIterations > 0 ? benchmark.mFixedIterations : 1;
+        for (;;)
+        {
+            State state(iterations, args);
+            std::clock_t cpuStart = std::clock();
+            benchmark.mFn(state);
+            std::clock_t cpuEnd = std::clock();
+
+            if (state.hasError())
+            {
+                result.error = state.mError;
+                return result;
+            }
+
+            double seconds = std::chrono::duration<double>(state.mElapsed).count();
+            bool enough = benchmark.mFixedIterations > 0 || seconds >= minTime || iterations >= 1000000000LL;
+            if (enough)
+            {
+                long long done = std::max(1LL, state.mIterations);
+                result.iterations = done;
+                result.realNs = seconds * 1e9 / done;
+                result.cpuNs = (double)(cpuEnd - cpuStart) / CLOCKS_PER_SEC * 1e9 / done;
+                if (seconds > 0)
+                {
+                    result.bytesPerSecond = state.mBytesProcessed / seconds;
+                    result.itemsPerSecond = state.mItemsProcessed / seconds;
+                }
+                result.label = state.mLabel;
+                result.counters = state.mCounters;
+                return result;
+            }
+
+            double multiplier = seconds > 0 ? minTime * 1.4 / seconds : 100.0;
+            multiplier = std::min(100.0, std::max(2.0, multiplier));
+            iterations = (long long)(iterations * multiplier);
+        }
+    }
+};
+
+static std::string jsonEscape(const std::string &text)
+{
+    std::string out;
+    for (char c : text)
+    {
+        switch (c) {
+        case '"': out += "\\\""; break;
+        case '\\': out += "\\\\"; break;
+        case '\n': out += "\\n"; break;
+        default: out += c; break;
+        }
+    }
+    return out;
+}
+
+static void writeJson(const std::string &path, const std::vector<Result> &results)
+{
+    std::ofstream out(path);
+    if (!out)
+    {
+        std::cerr << "无法写入: " << path << std::endl;
+        return;
+    }
+
+    char date[64];
+    std::time_t now = std::time(nullptr);
+    std::strftime(date, sizeof(date), "%Y-%m-%dT%H:%M:%S", std::localtime(&now));
+
+    out << std::setprecision(12);
+    out << "{\n  \"context\": {\n    \"date\": \"" << date << "\",\n"
+        << "    \"library_build_type\": \""
+#ifdef NDEBUG
+        << "release"
+#else
+        << "debug"
+#endif
+        << "\"";
+    for (const auto &entry : contextEntries())
+    {
+        out << ",\n    \"" << jsonEscape(entry.first) << "\": \"" << jsonEscape(entry.second) << "\"";
+    }
+    out << "\n  },\n  \"benchmarks\": [";
+
+    for (size_t i = 0; i < results.size(); ++i)
+    {
+        const Result &r = results[i];
+        out << (i ? ",\n" : "\n") << "    {\n"
+            << "      \"name\": \"" << jsonEscape(r.name) << "\",\n"
+            << "      \"run_name\": \"" << jsonEscape(r.name) << "\",\n"
+            << "      \"run_type\": \"iteration\",\n";
+        if (!r.error.empty())
+        {
+            out << "      \"error_occurred\": true,\n"
+                << "      \"error_message\": \"" << jsonEscape(r.error) << "\"\n    }";
+            continue;
+        }
+        out << "      \"iterations\": " << r.iterations << ",\n"
+            << "      \"real_time\": " << r.realNs << ",\n"
+            << "      \"cpu_time\": " << r.cpuNs << ",\n"
+            << "      \"time_unit\": \"ns\"";
+        if (r.bytesPerSecond > 0)
+        {
+            out << ",\n      \"bytes_per_second\": " << r.bytesPerSecond;
+        }
+        if (r.itemsPerSecond > 0)
+        {
+            out << ",\n      \"items_per_second\": " << r.itemsPerSecond;
+        }
+        if (!r.label.empty())
+        {
+            out << ",\n      \"label\": \"" << jsonEscape(r.label) << "\"";
+        }
+        for (const auto &counter : r.counters)
+        {
+            out << ",\n      \"" << jsonEscape(counter.first) << "\": " << counter.second;
+        }
+        out << "\n    }";
+    }
+    out << "\n  ]\n}\n";
+}
+
+static void printResult(const Result &r)
+{
+    std::ostringstream line;
+    line << std::left << std::setw(48) << r.name;
+    if (!r.error.empty())
+    {
+        line << " ERROR: " << r.error;
+        std::cout << line.str() << std::endl;
+        return;
+    }
+
+    line << std::right << std::fixed << std::setprecision(0)
+         << std::setw(14) << r.realNs << " ns"
+         << std::setw(14) << r.cpuNs << " ns"
+         << std::setw(12) << r.iterations;
+    if (r.bytesPerSecond > 0)
+    {
+        line << std::setprecision(1) << " " << r.bytesPerSecond / (1024.0 * 1024.0) << "MiB/s";
+    }
+    if (r.itemsPerSecond > 0)
+    {
+        line << std::setprecision(1) << " " << r.itemsPerSecond << " items/s";
+    }
+    for (const auto &counter : r.counters)
+    {
+        line << std::setprecision(3) << " " << counter.first << "=" << counter.second;
+    }
+    if (!r.label.empty())
+    {
+        line << " " << r.label;
+    }
+    std::cout << line.str() << std::endl;
+}
+
+int runAll(int argc, char *argv[])
+{
+    Runner runner;
+    std::string filter;
+    std::string outPath;
+    int repetitions = 1;
+
+    for (int i = 1; i < argc; ++i)
+    {
+        const char *arg = argv[i];
+        if (std::strncmp(arg, "--filter=", 9) == 0)
+        {
+            filter = arg + 9;
+        }
+        else if (std::strncmp(arg, "--min-time=", 11) == 0)
+        {
+            runner.minTime = std::atof(arg + 11);
+        }
+        else if (std::strncmp(arg, "--out=", 6) == 0)
+        {
+            outPath = arg + 6;
+        }
+        else if (std::strncmp(arg, "--repetitions=", 14) == 0)
+        {
+            repetitions = std::max(1, std::atoi(arg + 14));
+        }
+        else
+        {
+            std::cerr << "未知参数: " << arg << std::endl;
+            return 1;
+        }
+    }
+
+    std::cout << std::left << std::setw(48) << "Benchmark"
+              << std::right << std::setw(17) << "Time"
+              << std::setw(17) << "CPU"
+              << std::setw(12) << "Iterations" << std::endl;
+    std::cout << std::string(94, '-') << std::endl;
+
+    std::vector<Result> results;
+    for (Benchmark *benchmark : registry())
+    {
+        std::vector<std::vector<long long>> argSets = benchmark->argSets();
+        if (argSets.empty())
+        {
+            argSets.push_back({});
+        }
+
+        for (const auto &args : argSets)
+        {
+            std::string name = benchmark->name();
+            for (long long value : args)
+            {
+                name += "/" + std::to_string(value);
+            }
+            if (!filter.empty() && name.find(filter) == std::string::npos)
+            {
+                continue;
+            }
+
+            // 重复运行时取墙钟时间的中位数，并记下各次之间的离散程度
+            std::vector<Result> runs;
+            for (int r = 0; r < repetitions; ++r)
+            {
+                runs.push_back(runner.run(*benchmark, args));
+                if (!runs.back().error.empty())
+                {
+                    break;
+                }
+            }
+            std::sort(runs.begin(), runs.end(), [](const Result &a, const Result &b) {
+                return a.realNs < b.realNs;
+            });
+            Result result = runs[runs.size() / 2];
+            if (runs.size() > 1 && result.error.empty() && result.realNs > 0)
+            {
+                double mean = 0;
+                for (const Result &run : runs)
+                {
+                    mean += run.realNs / runs.size();
+                }
+                double variance = 0;
+                for (const Result &run : runs)
+                {
+                    variance += (run.realNs - mean) * (run.realNs - mean) / runs.size();
+                }
+                result.counters["repetitions"] = (double)runs.size();
+                result.counters["cv_pct"] = mean > 0 ? 100.0 * std::sqrt(variance) / mean : 0;
+            }
+            printResult(result);
+            results.push_back(result);
+        }
+    }
+
+    if (!outPath.empty())
+    {
+        writeJson(outPath, results);
+    }
+    return 0;
+}
+
+} // namespace bench
@@ -0,0 +1,117 @@
+﻿#ifndef BENCHHARNESS_H
+#define BENCHHARNESS_H
+
+// 一个很小的微基准框架，用法和输出格式都仿照Google Benchmark：
+//
+//   static void BM_Something(bench::State &state)
+//   {
+//       while (state.keepRunning())
+//       {
+//           ...
+//       }
+//   }
+//   SMORE_BENCHMARK(BM_Something)->arg(256)->arg(4096);
+//
+// 命令行参数：
+//   --filter=<子串>          只运行名字中包含该子串的用例
+//   --min-time=<秒>          每个用例最少运行的时间，默认0.5
+//   --out=<文件>             把结果写成Google Benchmark格式的JSON
+//   --repetitions=<n>        每个用例重复运行n次，取中位数，减小波动
+
+#include <chrono>
+#include <functional>
+#include <map>
+#include <string>
+#include <vector>
+
+namespace bench {
+
+class State
+{
+public:
+    State(long long maxIterations, const std::vector<long long> &args);
+
+    // 每轮循环调用一次，返回false时结束
+    bool keepRunning();
+
+    // 暂停/恢复计时，用于排除每轮循环里的准备工作
+    void pauseTiming();
+    void resumeTiming();
+
+    long long range(int index = 0) const;
+    long long iterations() const { return mIterations; }
+
+    void setBytesProcessed(long long bytes) { mBytesProcessed = bytes; }
+    void setItemsProcessed(long long items) { mItemsProcessed = items; }
+    void setLabel(const std::string &label) { mLabel = label; }
+    void setCounter(const std::string &name, double value) { mCounters[name] = value; }
+
+    // 环境不满足时跳过该用例
+    void skipWithError(const std::string &error);
+    bool hasError() const { return !mError.empty(); }
+
+private:
+    friend struct Runner;
+
+    using Clock = std::chrono::steady_clock;
+
+    long long mMaxIterations;
+    long long mIterations = 0;
+    std::vector<long long> mArgs;
+    bool mStarted = false;
+    bool mRunning = false;
+    Clock::time_point mStart;
+    Clock::duration mElapsed{0};
+
+    long long mBytesProcessed = 0;
+    long long mItemsProcessed = 0;
+    std::string mLabel;
+    std::map<std::string, double> mCounters;
+    std::string mError;
+};
+
+using Function = std::function<void(State &)>;
+
+class Benchmark
+{
+public:
+    Benchmark(const std::string &name, Function fn);
+
+    // 增加一组参数，每组参数单独运行一次
+    Benchmark *arg(long long value);
+    Benchmark *args(const std::vector<long long> &values);
+
+    // 用一个函数批量设置参数，和Google Benchmark的Apply一样
+    Benchmark *apply(void (*fn)(Benchmark *benchmark));
+
+    // 固定迭代次数，不再自动增长
+    Benchmark *iterations(long long count);
+
+    const std::string &name() const { return mName; }
+    const std::vector<std::vector<long long>> &argSets() const { return mArgSets; }
+
+private:
+    friend struct Runner;
+
+    std::string mName;
+    Function mFn;
+    std::vector<std::vector<long long>> mArgSets;
+    long long mFixedIterations = 0;
+};
+
+Benchmark *registerBenchmark(const std::string &name, Function fn);
+
+// 写进JSON的context里的附加信息（编译配置、推理后端等），比较结果时用来核对环境
+void setContext(const std::string &key, const std::string &value);
+
+// 运行所有注册的用例，返回进程退出码
+int runAll(int argc, char *argv[]);
+
+} // namespace bench
+
+#define SMORE_BENCH_CONCAT2(a, b) a##b
+#define SMORE_BENCH_CONCAT(a, b) SMORE_BENCH_CONCAT2(a, b)
+#define SMORE_BENCHMARK(fn) \
+    [[maybe_unused]] static ::bench::Benchmark *SMORE_BENCH_CONCAT(smore_bench_, __LINE__) = ::bench::registerBenchmark(#fn, fn)
+
+#endif // BENCHHARNESS_H
@@ -0,0 +1,95 @@
+﻿#include <QApplication>
+#include <QCoreApplication>
+#include <QDir>
+#include <QFile>
+
+#include <cstdio>
+#include <cstring>
+#include <vector>
+
+#include "benchcompare.h"
+#include "benchharness.h"
+
+// 除了benchharness的参数，还支持：
+//   --compare=<基线json>     运行之后和基线比较，有用例变慢时返回1
+//   --against=<结果json>     和--compare一起使用时不运行，只比较两份已有的结果
+//   --threshold=<百分比>     变慢多少算退步，默认10
+int main(int argc, char *argv[])
+{
+    // 曲线绘制的用例需要QApplication，没有显示器的机器上用offscreen平台
+    if(!qEnvironmentVariableIsSet("QT_QPA_PLATFORM"))
+    {
+        qputenv("QT_QPA_PLATFORM", "offscreen");
+    }
+    QApplication a(argc, argv);
+
+#ifdef SMORE_STUB_BACKEND
+    bench::setContext("smore_backend", "stub");
+#else
+    bench::setContext("smore_backend", "vimo");
+#endif
+#ifdef SMORE_BUILD_PROFILE
+    bench::setContext("smore_build", SMORE_BUILD_PROFILE);
+#endif
+
+    QString baselinePath;
+    QString againstPath;
+    QString outPath;
+    double threshold = 10;
+    std::vector<char *> harnessArgs{argv[0]};
+    for(int i = 1; i < argc; ++i)
+    {
+        if(std::strncmp(argv[i], "--compare=", 10) == 0)
+        {
+            baselinePath = QString::fromLocal8Bit(argv[i] + 10);
+        }
+        else if(std::strncmp(argv[i], "--against=", 10) == 0)
+        {
+            againstPath = QString::fromLocal8Bit(argv[i] + 10);
+        }
+        else if(std::strncmp(argv[i], "--threshold=", 12) == 0)
+        {
+            threshold = QString(argv[i] + 12).toDouble();
+        }
+        else
+        {
+            if(std::strncmp(argv[i], "--out=", 6) == 0)
+            {
+                outPath = QString::fromLocal8Bit(argv[i] + 6);
+            }
+            harnessArgs.push_back(argv[i]);
+        }
+    }
+
+    auto exitCode = [](int regressions) {
+        return regressions < 0 ? 2 : (regressions > 0 ? 1 : 0);
+    };
+
+    if(!baselinePath.isEmpty() && !againstPath.isEmpty())
+    {
+        return exitCode(compareBenchmarkResults(baselinePath, againstPath, threshold));
+    }
+
+    // 要比较但没有指定--out时，结果先写到临时文件
+    QByteArray tempOut;
+    if(!baselinePath.isEmpty() && outPath.isEmpty())
+    {
+        outPath = QDir::temp().filePath(QString("smore-bench-%1.json").arg(QCoreApplication::applicationPid()));
+        tempOut = ("--out=" + outPath).toLocal8Bit();
+        harnessArgs.push_back(tempOut.data());
+    }
+
+    int code = bench::runAll((int)harnessArgs.size(), harnessArgs.data());
+    if(code != 0 || baselinePath.isEmpty())
+    {
+        return code;
+    }
+
+    std::printf("\n");
+    int regressions = compareBenchmarkResults(baselinePath, outPath, threshold);
+    if(!tempOut.isEmpty())
+    {
+        QFile::remove(outPath);
+    }
+    return exitCode(regressions);
+}
@@ -12,12 +12,15 @@ CONFIG += console
 
 SOURCES += \
     main.cpp \
-    mainwindow.cpp
+    mainwindow.cpp \
+    sweepdialog.cpp
 
 HEADERS += \
     SMoreDemo.h \
     mainwindow.h \
-    sparklinedelegate.h
+    sparklinedelegate.h \
+    sweepchart.h \
+    sweepdialog.h
 
 FORMS += \
     mainwindow.ui
@@ -28,16 +31,5 @@ else: unix:!android: target.path = /opt/$${TARGET}/bin
 !isEmpty(target.path): INSTALLS += target
 
 
-# 使用SMore的sdk v3
-INCLUDEPATH += G:\workData\company\SMore\ViMoCloud\sdk_3.14\include
-LIBS +=        G:\workData\company\SMore\ViMoCloud\sdk_3.14\lib\vimo_inference.lib
-
-# opencv
-INCLUDEPATH += D:/Qt/opencv4.4.0/include
-INCLUDEPATH += D:/Qt/opencv4.4.0/include/opencv2
-CONFIG(release, debug|release){
-LIBS += -LD:/Qt/opencv4.4.0/x64/vc15/lib/ -lopencv_world440
-}
-else{
-LIBS += -LD:/Qt/opencv4.4.0/x64/vc15/lib/ -lopencv_world440d
-}
+# 推理公共代码、SMore sdk和opencv
+include(core.pri)
@@ -8,7 +8,8 @@
 #include <string>
 
 #include <opencv2/opencv.hpp>
-#include "vimo_inference/vimo_inference.h"
+#include "vimoapi.h"
+#include "latencyhistogram.h"
 
 using namespace smartmore;
 
@@ -29,7 +30,7 @@ int SMoreTest()
         /* ============================================== */
 
         using Clock = std::chrono::steady_clock;
-        using Ms = std::chrono::milliseconds;
+        using Ms = std::chrono::duration<double, std::milli>;
 
         /* =================== 加载模型 =================== */
         vimo::Solution solution;
@@ -60,15 +61,18 @@ int SMoreTest()
         }
 
         /* =================== worker =================== */
-        auto worker = [](vimo::Pipelines& pipelines,
-                         vimo::Request& req,
-                         int idx) -> long long
+        LatencyHistogram latency;
+
+        auto worker = [&latency](vimo::Pipelines& pipelines,
+                                 vimo::Request& req,
+                                 int idx) -> double
         {
             vimo::Pipelines::UADResponseList rsps;
 
             auto start = Clock::now();
             pipelines.Run(req, rsps);
             auto end = Clock::now();
+            latency.record(end - start);
 
             auto cost =
                 std::chrono::duration_cast<Ms>(end - start).count();
@@ -83,7 +87,7 @@ int SMoreTest()
 
             auto total_start = Clock::now();
 
-            std::vector<std::future<long long>> futures;
+            std::vector<std::future<double>> futures;
             futures.reserve(thread_num);
 
             for (int i = 0; i < thread_num; ++i)
@@ -98,7 +102,7 @@ int SMoreTest()
             }
 
             // 收集每个线程的耗时
-            std::vector<long long> thread_costs(thread_num);
+            std::vector<double> thread_costs(thread_num);
             for (int i = 0; i < thread_num; ++i)
             {
                 thread_costs[i] = futures[i].get();
@@ -119,6 +123,13 @@ int SMoreTest()
                       << total_cost << " ms\n";
         }
 
+        /* ======== 汇总 ======== */
+        LatencySnapshot snapshot = latency.snapshot();
+        std::cout << "\nRun latency (ms): p50 " << snapshot.percentileMs(50)
+                  << ", p99 " << snapshot.percentileMs(99)
+                  << ", max " << snapshot.maxMs()
+                  << ", mean " << snapshot.meanMs() << "\n";
+
         std::cout << "\nDone." << std::endl;
     }
     catch (const vimo::VimoException& e)
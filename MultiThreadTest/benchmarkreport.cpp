@@ -0,0 +1,248 @@
+﻿#include "benchmarkreport.h"
+
+#include <QJsonArray>
+
+const char *pacingModeName(PacingMode pacing)
+{
+    switch (pacing) {
+    case PacingMode::Takt: return "takt";
+    case PacingMode::Unthrottled: return "unthrottled";
+    case PacingMode::OpenLoop: return "open";
+    }
+    return "unknown";
+}
+
+const char *arrivalModeName(ArrivalMode mode)
+{
+    switch (mode) {
+    case ArrivalMode::Fixed: return "fixed";
+    case ArrivalMode::Poisson: return "poisson";
+    case ArrivalMode::Replay: return "replay";
+    }
+    return "unknown";
+}
+
+// 输出的分位数，JSON的键和CSV的列都由它生成
+static const struct
+{
+    const char *name;
+    double percentile;
+} kPercentiles[] = {
+    {"p50", 50},
+    {"p90", 90},
+    {"p95", 95},
+    {"p99", 99},
+    {"p999", 99.9},
+};
+
+QJsonObject latencyToJson(const LatencySnapshot &snapshot)
+{
+    QJsonObject object;
+    object["count"] = (double)snapshot.count;
+    object["mean_ms"] = snapshot.meanMs();
+    object["min_ms"] = snapshot.count > 0 ? snapshot.minNs / 1e6 : 0.0;
+    object["max_ms"] = snapshot.maxMs();
+    for (const auto &p : kPercentiles)
+    {
+        object[QString("%1_ms").arg(p.name)] = snapshot.percentileMs(p.percentile);
+    }
+    return object;
+}
+
+static QJsonObject streamToJson(const BenchmarkStreamResult &stream, double wallSec)
+{
+    QJsonObject object;
+    object["completed"] = (double)stream.completed;
+    object["failed"] = (double)stream.failed;
+    object["overruns"] = (double)stream.overruns;
+    object["late"] = (double)stream.late;
+    object["dropped"] = (double)stream.dropped;
+    object["cached"] = (double)stream.cached;
+    object["throughput"] = wallSec > 0 ? stream.completed / wallSec : 0.0;
+    object["infer"] = latencyToJson(stream.latency);
+    object["end_to_end"] = latencyToJson(stream.endToEnd);
+    return object;
+}
+
+QJsonObject benchmarkRunToJson(const BenchmarkRunResult &result)
+{
+    const BenchmarkRunConfig &config = result.config;
+
+    QJsonObject configObject;
+    configObject["threads"] = config.threadCount;
+    configObject["pacing"] = pacingModeName(config.pacing);
+    configObject["takt_ms"] = config.taktMs;
+    if (config.pacing == PacingMode::OpenLoop)
+    {
+        QJsonObject arrival;
+        arrival["mode"] = arrivalModeName(config.arrival.mode);
+        arrival["rate_per_sec"] = config.arrival.ratePerSec;
+        arrival["replay_speed"] = config.arrival.replaySpeed;
+        arrival["late_ms"] = config.arrival.lateMs;
+        arrival["max_lag_ms"] = config.arrival.maxLagMs;
+        configObject["arrival"] = arrival;
+    }
+    configObject["warmup_iterations"] = config.warmupIterations;
+    configObject["duration_sec"] = config.durationSec;
+    configObject["iterations"] = (double)config.iterations;
+    configObject["max_batch_size"] = config.maxBatchSize;
+    configObject["max_batch_wait_us"] = config.maxBatchWaitUs;
+    if (config.tiled)
+    {
+        QJsonObject tiling;
+        tiling["tile_width"] = config.tiling.tileWidth;
+        tiling["tile_height"] = config.tiling.tileHeight;
+        tiling["overlap"] = config.tiling.overlap;
+        tiling["nms_iou"] = config.tiling.nmsIou;
+        tiling["tiles_per_image"] = result.tilesPerImage;
+        configObject["tiling"] = tiling;
+    }
+
+    if (config.resultCache)
+    {
+        configObject["result_cache_bytes"] = (double)config.resultCache->maxBytes();
+        configObject["result_cache_bypass"] = config.resultCache->isBypassed();
+    }
+
+    QJsonObject object;
+    object["config"] = configObject;
+    object["ok"] = result.ok;
+    if (!result.ok)
+    {
+        object["error"] = QString::fromStdString(result.error);
+        return object;
+    }
+
+    object["wall_sec"] = result.wallSec;
+    object["cancelled"] = result.cancelled;
+    object["shutdown_ms"] = result.shutdownMs;
+
+    // 启动阶段单独给出，不混进稳态的分位数
+    QJsonObject startup;
+    startup["cold_start"] = result.coldStart;
+    startup["load_ms"] = result.loadMs;
+    startup["warmup_ms"] = result.warmupMs;
+    startup["first_run_ms"] = result.firstRunMs;
+    startup["warm_run_ms"] = result.warmRunMs;
+    startup["time_to_first_result_ms"] = result.timeToFirstResultMs;
+    object["startup"] = startup;
+    object["total"] = streamToJson(result.total, result.wallSec);
+
+    QJsonArray streams;
+    for (const auto &stream : result.streams)
+    {
+        streams.append(streamToJson(stream, result.wallSec));
+    }
+    object["streams"] = streams;
+
+    QJsonArray devices;
+    for (const auto &device : result.devices)
+    {
+        QJsonObject deviceObject;
+        deviceObject["use_gpu"] = device.useGpu;
+        deviceObject["device"] = device.deviceId;
+        deviceObject["numa_node"] = device.numaNode;
+        deviceObject["cpus"] = QString::fromStdString(device.cpus);
+        deviceObject["sessions"] = device.sessions;
+        deviceObject["completed"] = (double)device.completed;
+        deviceObject["throughput"] = device.throughput;
+        deviceObject["utilization"] = device.utilization;
+        devices.append(deviceObject);
+    }
+    object["devices"] = devices;
+
+    const PostProcessStats &post = result.postProcess;
+    if (!post.handlers.empty())
+    {
+        QJsonObject postObject;
+        postObject["submitted"] = (double)post.submitted;
+        postObject["processed"] = (double)post.processed;
+        postObject["dropped"] = (double)post.dropped;
+        postObject["queue"] = latencyToJson(post.queue);
+        postObject["total"] = latencyToJson(post.total);
+        QJsonArray handlers;
+        for (const PostProcessHandlerStats &handler : post.handlers)
+        {
+            QJsonObject handlerObject = latencyToJson(handler.latency);
+            handlerObject["name"] = QString::fromStdString(handler.name);
+            handlerObject["failed"] = (double)handler.failed;
+            handlers.append(handlerObject);
+        }
+        postObject["handlers"] = handlers;
+        object["postprocess"] = postObject;
+    }
+
+    if (config.resultCache)
+    {
+        const ResultCacheStats &cache = result.resultCache;
+        QJsonObject cacheObject;
+        cacheObject["hits"] = (double)cache.hits;
+        cacheObject["misses"] = (double)cache.misses;
+        cacheObject["hit_rate"] = cache.hitRate();
+        cacheObject["inserts"] = (double)cache.inserts;
+        cacheObject["evictions"] = (double)cache.evictions;
+        cacheObject["entries"] = (double)cache.entries;
+        cacheObject["bytes"] = (double)cache.bytes;
+        cacheObject["hashed_bytes"] = (double)cache.hashedBytes;
+        cacheObject["hash_ms"] = cache.hashMs;
+        object["result_cache"] = cacheObject;
+    }
+    return object;
+}
+
+QString benchmarkCsvHeader()
+{
+    QStringList columns;
+    columns << "threads" << "pacing" << "takt_ms" << "stream"
+            << "completed" << "failed" << "overruns" << "late" << "dropped" << "cached" << "throughput";
+    for (const char *prefix : {"infer", "e2e"})
+    {
+        for (const auto &p : kPercentiles)
+        {
+            columns << QString("%1_%2_ms").arg(prefix, p.name);
+        }
+        columns << QString("%1_max_ms").arg(prefix) << QString("%1_mean_ms").arg(prefix);
+    }
+    return columns.join(',');
+}
+
+static QString streamToCsv(const BenchmarkRunResult &result, const QString &name, const BenchmarkStreamResult &stream)
+{
+    QStringList fields;
+    fields << QString::number(result.config.threadCount)
+           << pacingModeName(result.config.pacing)
+           << QString::number(result.config.taktMs)
+           << name
+           << QString::number(stream.completed)
+           << QString::number(stream.failed)
+           << QString::number(stream.overruns)
+           << QString::number(stream.late)
+           << QString::number(stream.dropped)
+           << QString::number(stream.cached)
+           << QString::number(result.wallSec > 0 ? stream.completed / result.wallSec : 0.0, 'f', 3);
+    for (const LatencySnapshot *snapshot : {&stream.latency, &stream.endToEnd})
+    {
+        for (const auto &p : kPercentiles)
+        {
+            fields << QString::number(snapshot->percentileMs(p.percentile), 'f', 3);
+        }
+        fields << QString::number(snapshot->maxMs(), 'f', 3) << QString::number(snapshot->meanMs(), 'f', 3);
+    }
+    return fields.join(',');
+}
+
+QStringList benchmarkRunToCsv(const BenchmarkRunResult &result)
+{
+    QStringList rows;
+    if (!result.ok)
+    {
+        return rows;
+    }
+
+    rows << streamToCsv(result, "all", result.total);
+    for (int i = 0; i < (int)result.streams.size(); ++i)
+    {
+        rows << streamToCsv(result, QString::number(i), result.streams[i]);
+    }
+    return rows;
+}
@@ -0,0 +1,22 @@
+﻿#ifndef BENCHMARKREPORT_H
+#define BENCHMARKREPORT_H
+
+#include <QJsonObject>
+#include <QString>
+#include <QStringList>
+
+#include "benchmarkrun.h"
+
+// 把测试结果整理成JSON/CSV，便于无人值守地跑完之后比较不同SDK版本的结果
+// JSON：一轮一个对象，含配置、合计和每一路；CSV：每一路一行，合计一行（stream列为all）
+
+const char *pacingModeName(PacingMode pacing);
+const char *arrivalModeName(ArrivalMode mode);
+
+QJsonObject latencyToJson(const LatencySnapshot &snapshot);
+QJsonObject benchmarkRunToJson(const BenchmarkRunResult &result);
+
+QString benchmarkCsvHeader();
+QStringList benchmarkRunToCsv(const BenchmarkRunResult &result);
+
+#endif // BENCHMARKREPORT_H
@@ -0,0 +1,486 @@
+﻿#include "benchmarkrun.h"
+#include "taktscheduler.h"
+#include "tracing.h"
+
+#include <algorithm>
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+
+using Clock = std::chrono::steady_clock;
+
+namespace {
+
+// 一路的记录端，测量阶段之外的结果不记录
+struct StreamRecorder
+{
+    LatencyHistogram latency;
+    LatencyHistogram endToEnd;
+    std::atomic<long long> failed{0};
+    std::atomic<long long> late{0};
+    std::atomic<long long> dropped{0};
+    std::atomic<long long> cached{0};
+
+    // endToEndMs小于0时取排队加推理的耗时
+    void record(const InferenceResult &result, bool measured, double endToEndMs = -1)
+    {
+        if (!measured)
+        {
+            return;
+        }
+        if (result.status == InferenceStatus::Ok)
+        {
+            latency.recordMs(result.inferMs);
+            if (result.cached)
+            {
+                ++cached;
+            }
+            endToEnd.recordMs(endToEndMs >= 0 ? endToEndMs : result.queueMs + result.inferMs);
+        }
+        else if (result.status == InferenceStatus::Failed)
+        {
+            // 停止时被拒绝、放弃的任务不算失败
+            ++failed;
+        }
+    }
+};
+
+// 切图推理的结果按整张图计入统计，输出换成合并后的检测框（后端没有检测框时为各块的原始输出）
+InferenceResult tiledToResult(TiledInferenceResult &tiled)
+{
+    InferenceResult result;
+    result.status = tiled.status;
+    result.error = std::move(tiled.error);
+    result.queueMs = tiled.queueMs;
+    result.inferMs = tiled.inferMs;
+    result.traceId = tiled.traceId;
+    if (tiled.hasDetections)
+    {
+        result.output.payload = std::move(tiled.detections);
+    }
+    else
+    {
+        result.output.payload = std::move(tiled.tileOutputs);
+    }
+    return result;
+}
+
+} // namespace
+
+BenchmarkRunResult runBenchmark(const BenchmarkRunConfig &config,
+                                const std::shared_ptr<InferenceEngine> &engine,
+                                const BenchmarkFrameSource &frames,
+                                const CancellationToken &cancel)
+{
+    BenchmarkRunResult result;
+    result.config = config;
+    const int threadCount = std::max(1, config.threadCount);
+
+    auto runStart = Clock::now();
+    result.coldStart = !engine->isLoaded();
+    if (!engine->load(&result.error))
+    {
+        return result;
+    }
+    if (result.coldStart)
+    {
+        result.loadMs = std::chrono::duration<double, std::milli>(Clock::now() - runStart).count();
+    }
+
+    // 切图时预热和队列容量都按块计算
+    std::vector<cv::Rect> firstTiles;
+    if (config.tiled)
+    {
+        firstTiles = planTiles(frames(0, 0, 0).size(), config.tiling);
+        result.tilesPerImage = (int)firstTiles.size();
+    }
+
+    if (config.warmUpEngine && !engine->isWarm())
+    {
+        auto warmupStart = Clock::now();
+        cv::Mat warmupImage = frames(0, 0, 0);
+        if (!firstTiles.empty())
+        {
+            warmupImage = warmupImage(firstTiles.front());
+        }
+        if (!engine->warmUp(warmupImage, &result.error))
+        {
+            return result;
+        }
+        result.warmupMs = std::chrono::duration<double, std::milli>(Clock::now() - warmupStart).count();
+        InferenceEngineLoadStats stats = engine->loadStats();
+        result.firstRunMs = stats.firstRunMs;
+        result.warmRunMs = stats.warmRunMs;
+    }
+
+    // 第一张成功的结果相对runStart的时刻（纳秒），-1表示还没有
+    std::atomic<long long> firstResultNs(-1);
+    auto noteResult = [&](const InferenceResult &r) {
+        if (r.status == InferenceStatus::Ok && firstResultNs.load(std::memory_order_relaxed) < 0)
+        {
+            long long expected = -1;
+            long long ns = std::chrono::duration_cast<std::chrono::nanoseconds>(Clock::now() - runStart).count();
+            firstResultNs.compare_exchange_strong(expected, ns);
+        }
+    };
+
+    // 后处理阶段要比线程池活得长，线程池析构时排空的任务还会回调到这里
+    std::unique_ptr<PostProcessStage> post;
+    if (!config.postHandlers.empty())
+    {
+        PostProcessConfig postConfig;
+        postConfig.threadCount = config.postThreads;
+        postConfig.queueCapacity = std::max(256, threadCount * 16);
+        post.reset(new PostProcessStage(postConfig));
+        for (const auto &handler : config.postHandlers)
+        {
+            post->addHandler(handler);
+        }
+        post->start();
+    }
+
+    // 推理成功的结果连同原图一起移交给后处理，工作线程不等后处理
+    auto postResult = [&](InferenceResult &r, int stream, long long sequence, cv::Mat image) {
+        if (!post || r.status != InferenceStatus::Ok)
+        {
+            return;
+        }
+        PostProcessStage::ItemPtr item(new PostProcessItem);
+        item->stream = stream;
+        item->sequence = sequence;
+        item->image = std::move(image);
+        item->output = std::move(r.output);
+        item->queueMs = r.queueMs;
+        item->inferMs = r.inferMs;
+        item->traceId = r.traceId;
+        post->submit(std::move(item));
+    };
+
+    // 结果日志只在回调中拷一条定长记录进队列，写文件在日志自己的线程中
+    ResultLogWriter *resultLog = config.resultLog.get();
+    auto logResult = [resultLog](const InferenceResult &r, int stream, long long sequence, bool measured,
+                                 float fetchMs, Clock::time_point startTime) {
+        if (!resultLog)
+        {
+            return;
+        }
+        ResultLogRecord record;
+        record.timestampUs = ResultLogWriter::nowUs();
+        record.sequence = sequence;
+        record.stream = stream;
+        record.status = (uint8_t)r.status;
+        record.batchSize = (uint8_t)std::min(r.batchSize, 255);
+        record.flags = measured ? 0 : kResultLogWarmup;
+        record.fetchMs = fetchMs;
+        record.queueMs = (float)r.queueMs;
+        record.inferMs = (float)r.inferMs;
+        record.totalMs = std::chrono::duration<float, std::milli>(Clock::now() - startTime).count();
+        resultLog->append(record);
+    };
+
+    // 每个pipelines配一个工作线程，队列留出每路两张的余量
+    InferencePoolConfig poolConfig;
+    poolConfig.workerCount = engine->pipelineCount();
+    poolConfig.queueCapacity = threadCount * 2 * std::max(1, result.tilesPerImage);
+    poolConfig.maxBatchSize = config.maxBatchSize;
+    poolConfig.maxBatchWaitUs = config.maxBatchWaitUs;
+    poolConfig.resultCache = config.resultCache;
+    ShardedInferencePool pool(engine, poolConfig, config.placement);
+    if (!pool.start(&result.error))
+    {
+        return result;
+    }
+
+    // 各路的相位在一个节拍内均匀错开
+    TaktScheduler takt;
+    std::chrono::microseconds period = std::chrono::milliseconds(std::max(1, config.taktMs));
+    std::vector<int> taktStreams;
+    if (config.pacing == PacingMode::Takt)
+    {
+        for (int i = 0; i < threadCount; ++i)
+        {
+            taktStreams.push_back(takt.addStream(period, period * i / threadCount));
+        }
+        takt.start();
+    }
+
+    std::vector<std::unique_ptr<StreamRecorder>> recorders;
+    for (int i = 0; i < threadCount; ++i)
+    {
+        recorders.emplace_back(new StreamRecorder);
+    }
+
+    std::atomic<bool> quit(false);
+    // 开环送图的线程睡在预定到达时刻上，结束或者取消时用它叫醒
+    CancellationSource arrivalStop;
+    const bool openLoop = config.pacing == PacingMode::OpenLoop;
+    const auto arrivalStart = Clock::now();
+
+    // 主线程在phaseCond上等各路预热完、测量结束或者被取消，不轮询
+    std::mutex phaseMutex;
+    std::condition_variable phaseCond;
+    int warmedUp = 0;
+    int finished = 0;
+    auto notifyPhase = [&](int &counter) {
+        std::lock_guard<std::mutex> locker(phaseMutex);
+        ++counter;
+        phaseCond.notify_all();
+    };
+
+    auto streamLoop = [&](int stream) {
+        TraceRecorder::setThreadName("stream " + std::to_string(stream));
+        StreamRecorder &recorder = *recorders[stream];
+        int shard = pool.shardForStream(stream);
+        InferencePool &streamPool = pool.shard(shard);
+        std::unique_ptr<TiledInference> tiler;
+        if (config.tiled)
+        {
+            tiler.reset(new TiledInference(streamPool, config.tiling));
+        }
+        if (!config.placement.empty())
+        {
+            pool.pinStreamThread(stream);
+        }
+        std::unique_ptr<ArrivalSchedule> schedule;
+        if (openLoop)
+        {
+            schedule.reset(new ArrivalSchedule(config.arrival, stream, threadCount, arrivalStart));
+        }
+        bool warm = false;
+        for (long long sequence = 0; !quit; ++sequence)
+        {
+            bool measured = sequence >= config.warmupIterations;
+            if (measured && !warm)
+            {
+                warm = true;
+                notifyPhase(warmedUp);
+            }
+            if (config.iterations > 0 && sequence >= config.warmupIterations + config.iterations)
+            {
+                break;
+            }
+
+            if (config.pacing == PacingMode::Takt)
+            {
+                TraceSpan span("takt wait", "stream");
+                if (!takt.waitNext(taktStreams[stream]))
+                {
+                    break;
+                }
+            }
+
+            // 开环：按预定时刻送出；送晚了不顺延，后面的帧照样按原定时刻到达
+            Clock::time_point arrival;
+            if (openLoop)
+            {
+                TraceSpan span("arrival wait", "stream");
+                if (!schedule->next(arrival) || !schedule->waitUntil(arrival, arrivalStop.token()))
+                {
+                    break;
+                }
+                double lagMs = std::chrono::duration<double, std::milli>(Clock::now() - arrival).count();
+                if (config.arrival.maxLagMs > 0 && lagMs > config.arrival.maxLagMs)
+                {
+                    if (measured)
+                    {
+                        ++recorder.dropped;
+                    }
+                    continue;
+                }
+                if (measured && lagMs > schedule->lateMs())
+                {
+                    ++recorder.late;
+                }
+            }
+
+            TraceSpan fetchSpan("fetch frame", "stream");
+            auto fetchStart = Clock::now();
+            cv::Mat image = frames(stream, sequence, shard);
+            auto submitTime = Clock::now();
+            float fetchMs = std::chrono::duration<float, std::milli>(submitTime - fetchStart).count();
+            fetchSpan.finish();
+            // 端到端耗时的起点：开环时是预定到达时刻，其余模式是送图时刻
+            if (!openLoop)
+            {
+                arrival = submitTime;
+            }
+            // 只有后处理需要原图，先留一份头（共用数据），再把图交给线程池
+            cv::Mat postImage = post ? image : cv::Mat();
+            if (config.pacing != PacingMode::Unthrottled)
+            {
+                InferenceCallback onResult = [&recorder, &noteResult, &postResult, &logResult, measured, stream,
+                                              sequence, fetchMs, arrival, openLoop, postImage](InferenceResult &r) {
+                    noteResult(r);
+                    double endToEndMs = openLoop ? std::chrono::duration<double, std::milli>(Clock::now() - arrival).count()
+                                                 : -1;
+                    recorder.record(r, measured, endToEndMs);
+                    logResult(r, stream, sequence, measured, fetchMs, arrival);
+                    postResult(r, stream, sequence, postImage);
+                };
+                if (tiler)
+                {
+                    tiler->submit(image, [onResult](TiledInferenceResult &tiled) {
+                        InferenceResult r = tiledToResult(tiled);
+                        onResult(r);
+                    });
+                }
+                else
+                {
+                    streamPool.submit(std::move(image), std::move(onResult));
+                }
+            }
+            else
+            {
+                InferenceResult r;
+                TraceSpan span("wait result", "stream");
+                if (tiler)
+                {
+                    TiledInferenceResult tiled = tiler->submit(image).get();
+                    r = tiledToResult(tiled);
+                }
+                else
+                {
+                    r = streamPool.submit(std::move(image)).get();
+                }
+                span.finish();
+                noteResult(r);
+                recorder.record(r, measured);
+                logResult(r, stream, sequence, measured, fetchMs, arrival);
+                postResult(r, stream, sequence, std::move(postImage));
+            }
+        }
+
+        // 预热没做完就退出了，也要计入，避免主线程一直等
+        if (!warm)
+        {
+            notifyPhase(warmedUp);
+        }
+        notifyPhase(finished);
+    };
+
+    std::vector<std::thread> threads;
+    for (int i = 0; i < threadCount; ++i)
+    {
+        threads.emplace_back(streamLoop, i);
+    }
+
+    // 取消时唤醒等节拍的送图线程和主线程；送一张等一张的线程等的是正在推理的那张，很快会返回
+    CancellationCallback wakeOnCancel(cancel, [&]() {
+        takt.stop();
+        arrivalStop.cancel();
+        pool.stopAccepting();
+        std::lock_guard<std::mutex> locker(phaseMutex);
+        phaseCond.notify_all();
+    });
+
+    // 等所有路都预热完，再开始计时
+    {
+        std::unique_lock<std::mutex> locker(phaseMutex);
+        phaseCond.wait(locker, [&] {
+            return warmedUp >= threadCount || finished >= threadCount || cancel.isCancelled();
+        });
+    }
+    // 按时长测量时丢掉先预热完的那几路在等待期间的样本；按张数测量时每一张都要算上，不能清空
+    std::vector<long long> overrunsBefore(threadCount, 0);
+    for (int i = 0; i < threadCount; ++i)
+    {
+        if (config.iterations <= 0)
+        {
+            recorders[i]->latency.reset();
+            recorders[i]->endToEnd.reset();
+            recorders[i]->failed = 0;
+            recorders[i]->late = 0;
+            recorders[i]->dropped = 0;
+            recorders[i]->cached = 0;
+        }
+        if (config.pacing == PacingMode::Takt)
+        {
+            overrunsBefore[i] = takt.stats(taktStreams[i]).overrunCount;
+        }
+    }
+    std::vector<DeviceUsage> usageBefore = pool.deviceUsage(0);
+    if (post)
+    {
+        post->resetStats();
+    }
+    auto measureStart = Clock::now();
+
+    // 按时长或者按张数结束
+    auto deadline = measureStart + std::chrono::duration_cast<Clock::duration>(
+                                       std::chrono::duration<double>(config.durationSec));
+    {
+        std::unique_lock<std::mutex> locker(phaseMutex);
+        auto done = [&] { return finished >= threadCount || cancel.isCancelled(); };
+        if (config.iterations > 0)
+        {
+            phaseCond.wait(locker, done);
+        }
+        else
+        {
+            phaseCond.wait_until(locker, deadline, done);
+        }
+    }
+
+    auto stopStart = Clock::now();
+    result.cancelled = cancel.isCancelled();
+    quit = true;
+    takt.stop();
+    arrivalStop.cancel();
+    // 队列满时阻塞在submit()中的送图线程立即返回，不用等队列腾出位置
+    pool.stopAccepting();
+    for (auto &thread : threads)
+    {
+        thread.join();
+    }
+
+    // 正常结束时已经提交的任务做完再统计；被取消时不再等排队的任务，尽快返回
+    pool.shutdown(!result.cancelled);
+    if (post)
+    {
+        post->shutdown(!result.cancelled);
+        result.postProcess = post->stats();
+    }
+    if (config.resultCache)
+    {
+        result.resultCache = config.resultCache->stats();
+    }
+    result.shutdownMs = std::chrono::duration<double, std::milli>(Clock::now() - stopStart).count();
+    result.wallSec = std::chrono::duration<double>(Clock::now() - measureStart).count();
+    result.devices = pool.deviceUsage(result.wallSec, &usageBefore);
+    if (firstResultNs >= 0)
+    {
+        result.timeToFirstResultMs = firstResultNs / 1e6;
+    }
+
+    for (int i = 0; i < threadCount; ++i)
+    {
+        BenchmarkStreamResult stream;
+        stream.latency = recorders[i]->latency.snapshot();
+        stream.endToEnd = recorders[i]->endToEnd.snapshot();
+        stream.latency.elapsedSec = result.wallSec;
+        stream.endToEnd.elapsedSec = result.wallSec;
+        stream.completed = (long long)stream.latency.count;
+        stream.failed = recorders[i]->failed;
+        stream.late = recorders[i]->late;
+        stream.dropped = recorders[i]->dropped;
+        stream.cached = recorders[i]->cached;
+        if (config.pacing == PacingMode::Takt)
+        {
+            stream.overruns = takt.stats(taktStreams[i]).overrunCount - overrunsBefore[i];
+        }
+
+        result.total.completed += stream.completed;
+        result.total.failed += stream.failed;
+        result.total.overruns += stream.overruns;
+        result.total.late += stream.late;
+        result.total.dropped += stream.dropped;
+        result.total.cached += stream.cached;
+        result.total.latency.merge(stream.latency);
+        result.total.endToEnd.merge(stream.endToEnd);
+        result.streams.push_back(std::move(stream));
+    }
+
+    result.ok = true;
+    return result;
+}
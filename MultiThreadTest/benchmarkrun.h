@@ -0,0 +1,115 @@
+﻿#ifndef BENCHMARKRUN_H
+#define BENCHMARKRUN_H
+
+#include <atomic>
+#include <functional>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include <opencv2/opencv.hpp>
+
+#include "cancellation.h"
+#include "latencyhistogram.h"
+#include "loadgenerator.h"
+#include "postprocess.h"
+#include "resultcache.h"
+#include "resultlog.h"
+#include "shardedinferencepool.h"
+#include "tiledinference.h"
+
+// 送图的节奏
+enum class PacingMode
+{
+    Takt,           // 按节拍送图，不等结果（和界面程序的方式一样）
+    Unthrottled,    // 每路送一张等一张，测的是最大吞吐量
+    OpenLoop,       // 按ArrivalConfig的预定到达时刻送图，不等结果；耗时从预定到达时刻算起
+};
+
+struct BenchmarkRunConfig
+{
+    int threadCount = 1;            // 同时送图的路数
+    PacingMode pacing = PacingMode::Takt;
+    int taktMs = 100;               // 节拍，只在Takt模式下使用
+    ArrivalConfig arrival;          // 到达方式，只在OpenLoop模式下使用
+    int warmupIterations = 10;      // 每路先送这么多张不计入统计
+    bool warmUpEngine = true;       // 开始送图之前先用第一张图预热每个pipelines（引擎已经预热过时跳过）
+    double durationSec = 10;        // 预热之后的测量时间
+    long long iterations = 0;       // 每路测量的张数，大于0时代替durationSec
+
+    // 传给线程池的参数
+    int maxBatchSize = 1;
+    int maxBatchWaitUs = 0;
+
+    // 切图推理：每张图切成重叠的块并行推理，再拼回整图；耗时统计的是整张图
+    bool tiled = false;
+    TileConfig tiling;
+
+    // 设备放置，与引擎的deviceIds一一对应；不为空时工作线程和送图线程都绑到设备所在节点的核上
+    std::vector<DevicePlacement> placement;
+
+    // 不为空时推理成功的结果交给异步后处理阶段，依次执行这些处理器
+    std::vector<std::shared_ptr<IResultHandler>> postHandlers;
+    int postThreads = 1;
+
+    // 不为空时每张图（包括预热和失败的）写一条结果日志；由调用方打开和关闭，可以跨多轮使用
+    std::shared_ptr<ResultLogWriter> resultLog;
+
+    // 不为空时按图像内容缓存推理结果，重复的图只查表不推理；由调用方创建，可以跨多轮使用
+    // 纯测推理速度时不设置，或者打开缓存的旁路
+    std::shared_ptr<ResultCache> resultCache;
+};
+
+// 一路的结果
+struct BenchmarkStreamResult
+{
+    long long completed = 0;
+    long long failed = 0;
+    long long overruns = 0;         // 错过的节拍数，Takt模式下有效
+    long long late = 0;             // 晚于预定到达时刻lateMs以上才送出的帧，OpenLoop模式下有效
+    long long dropped = 0;          // 落后超过maxLagMs被丢弃的帧，OpenLoop模式下有效
+    long long cached = 0;           // completed中来自结果缓存的张数
+    LatencySnapshot latency;        // 推理耗时（pipelines.Run）
+    LatencySnapshot endToEnd;       // 排队 + 推理；OpenLoop模式下为从预定到达时刻到推理完成
+};
+
+struct BenchmarkRunResult
+{
+    BenchmarkRunConfig config;
+    bool ok = false;
+    std::string error;
+
+    double wallSec = 0;             // 测量阶段的时长
+    bool cancelled = false;         // 测量被取消，结果只包含取消之前的部分
+    double shutdownMs = 0;          // 从测量结束到送图线程和线程池都停下来的时间
+
+    // 启动阶段，和稳态的推理耗时分开统计
+    bool coldStart = false;         // 本轮开始时引擎还没有加载
+    double loadMs = 0;              // 本轮中加载模型的耗时，热启动时为0
+    double warmupMs = 0;            // 本轮中预热的耗时，已经预热过时为0
+    double firstRunMs = 0;          // 预热时每个pipelines第一次推理的平均耗时（含延迟初始化）
+    double warmRunMs = 0;           // 预热最后一次推理的平均耗时
+    double timeToFirstResultMs = -1;    // 从调用runBenchmark到第一张推理成功，包括加载和预热；没有成功的为-1
+    std::vector<BenchmarkStreamResult> streams;
+    BenchmarkStreamResult total;    // 所有路合并
+    std::vector<DeviceUsage> devices;   // 测量阶段每个设备的利用率和吞吐量
+    PostProcessStats postProcess;       // 测量阶段的后处理统计，没有后处理时为空
+    int tilesPerImage = 0;              // 切图推理时第一张图切成的块数
+    ResultCacheStats resultCache;       // 结束时结果缓存的统计（累计值），没有缓存时为空
+
+    double throughput() const { return wallSec > 0 ? total.completed / wallSec : 0; }
+};
+
+// 第stream路要送的第sequence张图，shard为这一路所在的设备分片（用来选同一NUMA节点上的帧数据）
+using BenchmarkFrameSource = std::function<cv::Mat(int stream, long long sequence, int shard)>;
+
+// 在一个已经创建好的引擎上跑一轮测试；线程池的工作线程数等于引擎的pipelines数
+// 引擎可以在多轮之间复用（例如扫描不同线程数时只加载一次模型）
+// cancel被取消时立即结束测量，排队中的任务不再做
+// 本函数不依赖Qt，可以在命令行程序和界面程序中使用
+BenchmarkRunResult runBenchmark(const BenchmarkRunConfig &config,
+                                const std::shared_ptr<InferenceEngine> &engine,
+                                const BenchmarkFrameSource &frames,
+                                const CancellationToken &cancel = CancellationToken());
+
+#endif // BENCHMARKRUN_H
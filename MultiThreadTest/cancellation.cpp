@@ -0,0 +1,102 @@
+﻿#include "cancellation.h"
+
+#include <thread>
+#include <vector>
+
+bool CancellationToken::isCancelled() const
+{
+    if (!mState)
+    {
+        return false;
+    }
+    std::lock_guard<std::mutex> locker(mState->mutex);
+    return mState->cancelled;
+}
+
+bool CancellationToken::waitUntil(std::chrono::steady_clock::time_point deadline) const
+{
+    if (!mState)
+    {
+        // 不会被取消的令牌就是普通的睡眠
+        std::this_thread::sleep_until(deadline);
+        return false;
+    }
+
+    std::unique_lock<std::mutex> locker(mState->mutex);
+    return mState->cond.wait_until(locker, deadline, [this] { return mState->cancelled; });
+}
+
+int CancellationToken::onCancel(std::function<void()> callback) const
+{
+    if (!mState || !callback)
+    {
+        return -1;
+    }
+
+    {
+        std::lock_guard<std::mutex> locker(mState->mutex);
+        if (!mState->cancelled)
+        {
+            int id = mState->nextId++;
+            mState->callbacks.emplace(id, std::move(callback));
+            return id;
+        }
+    }
+    callback();
+    return -1;
+}
+
+void CancellationToken::removeCallback(int id) const
+{
+    if (!mState || id < 0)
+    {
+        return;
+    }
+
+    // 先等正在执行的回调结束，再从表中删掉
+    std::lock_guard<std::mutex> callbackLocker(mState->callbackMutex);
+    std::lock_guard<std::mutex> locker(mState->mutex);
+    mState->callbacks.erase(id);
+}
+
+CancellationSource::CancellationSource()
+    : mState(std::make_shared<CancellationToken::State>())
+{
+}
+
+void CancellationSource::cancel()
+{
+    std::lock_guard<std::mutex> callbackLocker(mState->callbackMutex);
+    std::vector<std::function<void()>> callbacks;
+    {
+        std::lock_guard<std::mutex> locker(mState->mutex);
+        if (mState->cancelled)
+        {
+            return;
+        }
+        mState->cancelled = true;
+        mState->cancelTime = std::chrono::steady_clock::now();
+        for (auto &entry : mState->callbacks)
+        {
+            callbacks.push_back(entry.second);
+        }
+    }
+    mState->cond.notify_all();
+
+    // 回调在锁外调用，回调中可以访问令牌（isCancelled等）
+    for (auto &callback : callbacks)
+    {
+        callback();
+    }
+}
+
+bool CancellationSource::isCancelled() const
+{
+    return token().isCancelled();
+}
+
+std::chrono::steady_clock::time_point CancellationSource::cancelTime() const
+{
+    std::lock_guard<std::mutex> locker(mState->mutex);
+    return mState->cancelTime;
+}
@@ -0,0 +1,94 @@
+﻿#ifndef CANCELLATION_H
+#define CANCELLATION_H
+
+#include <chrono>
+#include <condition_variable>
+#include <functional>
+#include <map>
+#include <memory>
+#include <mutex>
+
+// 协作式取消：CancellationSource::cancel()之后，从它拿到的所有CancellationToken都看到取消
+// 需要睡眠的线程用waitFor()/waitUntil()等待，取消时立即被唤醒，不用定时醒来检查标志
+// 阻塞在别处（条件变量、节拍调度器、解码队列）的线程，用onCancel()注册一个唤醒它们的回调
+class CancellationToken
+{
+public:
+    // 默认构造的令牌永远不会被取消
+    CancellationToken() = default;
+
+    bool isCancelled() const;
+
+    // 睡到截止时间或者被取消，返回true表示已经取消
+    bool waitUntil(std::chrono::steady_clock::time_point deadline) const;
+    template<typename Rep, typename Period>
+    bool waitFor(std::chrono::duration<Rep, Period> timeout) const
+    {
+        return waitUntil(std::chrono::steady_clock::now()
+                         + std::chrono::duration_cast<std::chrono::steady_clock::duration>(timeout));
+    }
+
+    // 取消时在调用cancel()的线程中调用callback，已经取消的立即调用；返回的编号用于注销
+    // 注销时如果回调正在执行，会等它执行完，注销之后回调引用的对象就可以销毁了
+    // 回调中不能再注册或注销回调
+    int onCancel(std::function<void()> callback) const;
+    void removeCallback(int id) const;
+
+private:
+    friend class CancellationSource;
+
+    struct State
+    {
+        std::mutex mutex;
+        std::condition_variable cond;
+        bool cancelled = false;
+        std::chrono::steady_clock::time_point cancelTime;
+        int nextId = 0;
+        std::map<int, std::function<void()>> callbacks;
+        std::mutex callbackMutex;       // 回调执行期间持有，注销时用来等回调执行完
+    };
+
+    explicit CancellationToken(std::shared_ptr<State> state) : mState(std::move(state)) {}
+
+    std::shared_ptr<State> mState;
+};
+
+// 取消令牌的发起方，只能取消一次；需要重新开始时换一个新的
+class CancellationSource
+{
+public:
+    CancellationSource();
+
+    CancellationToken token() const { return CancellationToken(mState); }
+
+    // 可以重复调用，只有第一次生效
+    void cancel();
+    bool isCancelled() const;
+
+    // 第一次cancel()的时刻，用来统计停止耗时
+    std::chrono::steady_clock::time_point cancelTime() const;
+
+private:
+    std::shared_ptr<CancellationToken::State> mState;
+};
+
+// 在作用域内注册一个取消回调，析构时注销
+class CancellationCallback
+{
+public:
+    CancellationCallback(const CancellationToken &token, std::function<void()> callback)
+        : mToken(token)
+        , mId(token.onCancel(std::move(callback)))
+    {
+    }
+    ~CancellationCallback() { mToken.removeCallback(mId); }
+
+    CancellationCallback(const CancellationCallback &) = delete;
+    CancellationCallback &operator=(const CancellationCallback &) = delete;
+
+private:
+    CancellationToken mToken;
+    int mId;
+};
+
+#endif // CANCELLATION_H
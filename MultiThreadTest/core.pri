@@ -0,0 +1,87 @@
+# 推理相关的公共代码，界面程序和基准测试程序共用
+# 只依赖QtCore、OpenCV和SMore SDK（或桩实现），不依赖界面
+
+INCLUDEPATH += $$PWD
+
+SOURCES += \
+    $$PWD/benchmarkreport.cpp \
+    $$PWD/benchmarkrun.cpp \
+    $$PWD/cancellation.cpp \
+    $$PWD/decodestage.cpp \
+    $$PWD/deviceplacement.cpp \
+    $$PWD/framecorpus.cpp \
+    $$PWD/imageio.cpp \
+    $$PWD/inferenceengine.cpp \
+    $$PWD/inferencepool.cpp \
+    $$PWD/latencyhistogram.cpp \
+    $$PWD/loadgenerator.cpp \
+    $$PWD/mappedimage.cpp \
+    $$PWD/modulegraphcache.cpp \
+    $$PWD/postprocess.cpp \
+    $$PWD/preprocess.cpp \
+    $$PWD/processmemory.cpp \
+    $$PWD/resultcache.cpp \
+    $$PWD/resulthandlers.cpp \
+    $$PWD/resultlog.cpp \
+    $$PWD/shardedinferencepool.cpp \
+    $$PWD/syntheticbackend.cpp \
+    $$PWD/taktscheduler.cpp \
+    $$PWD/threadsweep.cpp \
+    $$PWD/tiledinference.cpp \
+    $$PWD/tracing.cpp \
+    $$PWD/vimobackend.cpp
+
+HEADERS += \
+    $$PWD/benchmarkreport.h \
+    $$PWD/benchmarkrun.h \
+    $$PWD/cancellation.h \
+    $$PWD/decodestage.h \
+    $$PWD/deviceplacement.h \
+    $$PWD/framecorpus.h \
+    $$PWD/imageio.h \
+    $$PWD/inferencebackend.h \
+    $$PWD/inferenceengine.h \
+    $$PWD/inferencepool.h \
+    $$PWD/latencyhistogram.h \
+    $$PWD/loadgenerator.h \
+    $$PWD/mappedimage.h \
+    $$PWD/modulegraphcache.h \
+    $$PWD/mpmcqueue.h \
+    $$PWD/postprocess.h \
+    $$PWD/preprocess.h \
+    $$PWD/processmemory.h \
+    $$PWD/resultcache.h \
+    $$PWD/resulthandlers.h \
+    $$PWD/resultlog.h \
+    $$PWD/shardedinferencepool.h \
+    $$PWD/syntheticbackend.h \
+    $$PWD/taktscheduler.h \
+    $$PWD/threadsweep.h \
+    $$PWD/tiledinference.h \
+    $$PWD/tracing.h \
+    $$PWD/vimoapi.h \
+    $$PWD/vimobackend.h \
+    $$PWD/vimostub.h
+
+# 节拍调度器用timeBeginPeriod提高Windows的定时精度
+win32: LIBS += -lwinmm
+
+# 使用SMore的sdk v3
+# 没有SDK的机器上可以用桩实现编译：qmake CONFIG+=smore_stub
+smore_stub {
+DEFINES += SMORE_STUB_BACKEND
+}
+else{
+INCLUDEPATH += G:\workData\company\SMore\ViMoCloud\sdk_3.14\include
+LIBS +=        G:\workData\company\SMore\ViMoCloud\sdk_3.14\lib\vimo_inference.lib
+}
+
+# opencv
+INCLUDEPATH += D:/Qt/opencv4.4.0/include
+INCLUDEPATH += D:/Qt/opencv4.4.0/include/opencv2
+CONFIG(release, debug|release){
+LIBS += -LD:/Qt/opencv4.4.0/x64/vc15/lib/ -lopencv_world440
+}
+else{
+LIBS += -LD:/Qt/opencv4.4.0/x64/vc15/lib/ -lopencv_world440d
+}
@@ -0,0 +1,215 @@
+﻿#include "decodestage.h"
+#include "imageio.h"
+#include "mappedimage.h"
+#include "tracing.h"
+
+#include <algorithm>
+
+using Clock = std::chrono::steady_clock;
+
+DecodeStage::DecodeStage(const DecodeStageConfig &config)
+    : mConfig(config)
+{
+    mConfig.threadCount = std::max(1, mConfig.threadCount);
+    mConfig.lookahead = std::max(1, mConfig.lookahead);
+
+    mWorkers.reserve(mConfig.threadCount);
+    for (int i = 0; i < mConfig.threadCount; ++i)
+    {
+        mWorkers.emplace_back(&DecodeStage::workerLoop, this);
+    }
+}
+
+DecodeStage::~DecodeStage()
+{
+    stop();
+}
+
+int DecodeStage::addStream(const QStringList &files)
+{
+    std::lock_guard<std::mutex> locker(mMutex);
+    std::unique_ptr<Stream> stream(new Stream);
+    stream->files = files;
+    mStreams.push_back(std::move(stream));
+
+    int id = (int)mStreams.size() - 1;
+    scheduleLocked(id);
+    return id;
+}
+
+bool DecodeStage::next(int stream, DecodedFrame &frame, std::chrono::milliseconds timeout)
+{
+    std::unique_lock<std::mutex> locker(mMutex);
+    if (stream < 0 || stream >= (int)mStreams.size())
+    {
+        return false;
+    }
+
+    Stream &s = *mStreams[stream];
+    auto ready = [&] { return mStopped || s.done.count(s.nextConsumeSeq) > 0; };
+
+    if (!ready())
+    {
+        // 解码跟不上了，推理侧要等
+        auto waitStart = Clock::now();
+        mReadyCond.wait_for(locker, timeout, ready);
+        mStats.starvedCount++;
+        mStats.starvedMs += std::chrono::duration<double, std::milli>(Clock::now() - waitStart).count();
+    }
+
+    auto it = s.done.find(s.nextConsumeSeq);
+    if (mStopped || it == s.done.end())
+    {
+        return false;
+    }
+
+    frame = std::move(it->second);
+    s.done.erase(it);
+    s.nextConsumeSeq++;
+
+    // 取走一帧，补一帧
+    scheduleLocked(stream);
+    return true;
+}
+
+void DecodeStage::stop()
+{
+    {
+        std::lock_guard<std::mutex> locker(mMutex);
+        if (mStopped)
+        {
+            return;
+        }
+        mStopped = true;
+        mTasks.clear();
+    }
+    mTaskCond.notify_all();
+    mReadyCond.notify_all();
+
+    for (auto &worker : mWorkers)
+    {
+        worker.join();
+    }
+    mWorkers.clear();
+}
+
+int DecodeStage::queueDepth(int stream) const
+{
+    std::lock_guard<std::mutex> locker(mMutex);
+    if (stream < 0 || stream >= (int)mStreams.size())
+    {
+        return 0;
+    }
+    return (int)mStreams[stream]->done.size();
+}
+
+DecodeStageStats DecodeStage::stats() const
+{
+    std::lock_guard<std::mutex> locker(mMutex);
+    DecodeStageStats stats = mStats;
+    long long total = stats.decodedCount + stats.failedCount;
+    stats.avgDecodeMs = total > 0 ? mDecodeMsSum / total : 0;
+    stats.avgPreprocessMs = stats.decodedCount > 0 ? mPreprocessMsSum / stats.decodedCount : 0;
+    return stats;
+}
+
+void DecodeStage::scheduleLocked(int stream)
+{
+    Stream &s = *mStreams[stream];
+    if (s.files.isEmpty() || mStopped)
+    {
+        return;
+    }
+
+    // 已解码+正在解码的帧数补足到lookahead
+    bool added = false;
+    while (s.nextSubmitSeq - s.nextConsumeSeq < mConfig.lookahead)
+    {
+        Task task;
+        task.stream = stream;
+        task.seq = s.nextSubmitSeq++;
+        task.fileIndex = s.nextFileIndex;
+        task.path = s.files[s.nextFileIndex];
+        s.nextFileIndex = (s.nextFileIndex + 1) % s.files.size();
+        mTasks.push_back(task);
+        added = true;
+    }
+
+    if (added)
+    {
+        mTaskCond.notify_all();
+    }
+}
+
+void DecodeStage::workerLoop()
+{
+    // 每个解码线程一个读取器，复用各自的缓冲区
+    MappedImageReader reader(mConfig.lookahead + 2);
+    FramePreprocessor preprocessor(mConfig.preprocess);
+    // 预处理的输出也复用：下游用完（引用计数回到1）且尺寸不变时直接覆盖写入，不再每帧分配
+    MatBufferPool convertedBuffers(mConfig.lookahead + 2);
+    TraceRecorder::setThreadName("decode");
+
+    std::unique_lock<std::mutex> locker(mMutex);
+    for (;;)
+    {
+        mTaskCond.wait(locker, [this] { return mStopped || !mTasks.empty(); });
+        if (mStopped)
+        {
+            return;
+        }
+
+        Task task = mTasks.front();
+        mTasks.pop_front();
+
+        // 读文件和解码不持锁
+        locker.unlock();
+        DecodedFrame frame;
+        auto decodeStart = Clock::now();
+        {
+            TraceSpan span("decode frame", "decode");
+            if (mConfig.memoryMapped)
+            {
+                reader.read(task.path, frame.image, frame.keepAlive);
+            }
+            else
+            {
+                frame.image = loadMatFromPath(task.path);
+            }
+        }
+        frame.decodeMs = std::chrono::duration<double, std::milli>(Clock::now() - decodeStart).count();
+
+        // 16位、灰度、BGRA的图在这里就转成模型的输入格式，推理线程和SDK不再转换
+        if (!frame.image.empty() && !preprocessor.isPassThrough(frame.image))
+        {
+            TraceSpan span("preprocess", "decode");
+            auto preprocessStart = Clock::now();
+            cv::Mat &converted = convertedBuffers.acquire();
+            if (preprocessor.process(frame.image, converted))
+            {
+                // 已经拷贝出来了，不再需要文件映射
+                frame.image = converted;
+                frame.keepAlive.reset();
+            }
+            frame.preprocessMs = std::chrono::duration<double, std::milli>(Clock::now() - preprocessStart).count();
+        }
+        frame.path = task.path;
+        frame.fileIndex = task.fileIndex;
+        locker.lock();
+
+        if (frame.image.empty())
+        {
+            mStats.failedCount++;
+        }
+        else
+        {
+            mStats.decodedCount++;
+        }
+        mDecodeMsSum += frame.decodeMs;
+        mPreprocessMsSum += frame.preprocessMs;
+        mStats.maxDecodeMs = std::max(mStats.maxDecodeMs, frame.decodeMs);
+
+        mStreams[task.stream]->done[task.seq] = std::move(frame);
+        mReadyCond.notify_all();
+    }
+}
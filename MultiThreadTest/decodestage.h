@@ -0,0 +1,114 @@
+﻿#ifndef DECODESTAGE_H
+#define DECODESTAGE_H
+
+#include <QString>
+#include <QStringList>
+
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include <opencv2/opencv.hpp>
+
+#include "preprocess.h"
+
+// 解码完成的一帧
+struct DecodedFrame
+{
+    cv::Mat image;          // 解码失败时为空
+    std::shared_ptr<void> keepAlive;    // 零拷贝时持有文件映射，image用完之前不能释放
+    QString path;
+    int fileIndex = -1;     // 在该路图像文件列表中的下标
+    double decodeMs = 0;    // 读文件+解码的耗时
+    double preprocessMs = 0;    // 转成模型输入格式的耗时
+};
+
+struct DecodeStageConfig
+{
+    int threadCount = 2;    // 解码线程数
+    int lookahead = 4;      // 每路图像预先解码好的帧数
+    bool memoryMapped = true;   // 使用内存映射读取（见MappedImageReader）
+    PreprocessConfig preprocess;    // 解码后在解码线程里转成模型的输入格式
+};
+
+// 解码阶段的统计，用来确定线程数和预取深度
+struct DecodeStageStats
+{
+    long long decodedCount = 0;
+    long long failedCount = 0;
+    double avgDecodeMs = 0;
+    double maxDecodeMs = 0;
+    double avgPreprocessMs = 0;
+    long long starvedCount = 0;     // 取帧时还没有解码好、需要等待的次数
+    double starvedMs = 0;           // 取帧等待的总时间
+};
+
+// 异步预取解码阶段：
+// 每路图像循环读取自己的文件列表，由独立的解码线程池提前解码后面的lookahead帧，
+// 推理侧调用next()时通常直接拿到已经解码好的图，不用再等磁盘和imdecode
+class DecodeStage
+{
+public:
+    explicit DecodeStage(const DecodeStageConfig &config);
+    ~DecodeStage();
+
+    DecodeStage(const DecodeStage &) = delete;
+    DecodeStage &operator=(const DecodeStage &) = delete;
+
+    // 添加一路图像，返回流编号；文件列表会被循环读取
+    int addStream(const QStringList &files);
+
+    // 按顺序取该路的下一帧，最多等待timeout；超时或已停止时返回false
+    bool next(int stream, DecodedFrame &frame, std::chrono::milliseconds timeout);
+
+    // 停止解码线程，正在等待的next()会立即返回false
+    void stop();
+
+    // 该路当前已经解码好、等待被取走的帧数
+    int queueDepth(int stream) const;
+
+    const DecodeStageConfig &config() const { return mConfig; }
+    DecodeStageStats stats() const;
+
+private:
+    struct Stream
+    {
+        QStringList files;
+        int nextFileIndex = 0;                  // 下一个要提交解码的文件
+        long long nextSubmitSeq = 0;            // 下一个要提交解码的序号
+        long long nextConsumeSeq = 0;           // 下一个要被取走的序号
+        std::map<long long, DecodedFrame> done; // 解码完成但还没被取走的帧（解码可能乱序完成）
+    };
+
+    struct Task
+    {
+        int stream;
+        long long seq;
+        int fileIndex;
+        QString path;
+    };
+
+    void scheduleLocked(int stream);
+    void workerLoop();
+
+    DecodeStageConfig mConfig;
+
+    mutable std::mutex mMutex;
+    std::condition_variable mTaskCond;
+    std::condition_variable mReadyCond;
+    std::vector<std::unique_ptr<Stream>> mStreams;
+    std::deque<Task> mTasks;
+    bool mStopped = false;
+    std::vector<std::thread> mWorkers;
+
+    DecodeStageStats mStats;
+    double mDecodeMsSum = 0;
+    double mPreprocessMsSum = 0;
+};
+
+#endif // DECODESTAGE_H
@@ -0,0 +1,410 @@
+﻿#include "deviceplacement.h"
+
+#include <algorithm>
+#include <cstdlib>
+#include <fstream>
+#include <set>
+#include <sstream>
+#include <thread>
+
+#if defined(_WIN32)
+#define NOMINMAX
+#include <windows.h>
+#elif defined(__linux__)
+#include <dirent.h>
+#include <pthread.h>
+#include <sched.h>
+#endif
+
+namespace {
+
+std::string trim(const std::string &text)
+{
+    size_t begin = text.find_first_not_of(" \t\r\n");
+    if (begin == std::string::npos)
+    {
+        return std::string();
+    }
+    size_t end = text.find_last_not_of(" \t\r\n");
+    return text.substr(begin, end - begin + 1);
+}
+
+bool parseInt(const std::string &text, int &value)
+{
+    if (text.empty())
+    {
+        return false;
+    }
+    char *end = nullptr;
+    long parsed = std::strtol(text.c_str(), &end, 10);
+    if (*end != '\0' || parsed < 0)
+    {
+        return false;
+    }
+    value = (int)parsed;
+    return true;
+}
+
+std::vector<int> intersect(const std::vector<int> &a, const std::vector<int> &b)
+{
+    std::set<int> keep(b.begin(), b.end());
+    std::vector<int> out;
+    for (int cpu : a)
+    {
+        if (keep.count(cpu))
+        {
+            out.push_back(cpu);
+        }
+    }
+    return out;
+}
+
+#if defined(__linux__)
+std::string readFirstLine(const std::string &path)
+{
+    std::ifstream file(path);
+    std::string line;
+    std::getline(file, line);
+    return trim(line);
+}
+
+// PCI设备按总线地址排序，和CUDA_DEVICE_ORDER=PCI_BUS_ID时的编号一致
+std::vector<std::string> nvidiaGpuPciDevices()
+{
+    std::vector<std::string> devices;
+    const std::string root = "/sys/bus/pci/devices/";
+    DIR *dir = opendir(root.c_str());
+    if (!dir)
+    {
+        return devices;
+    }
+    while (dirent *entry = readdir(dir))
+    {
+        std::string name = entry->d_name;
+        if (name == "." || name == "..")
+        {
+            continue;
+        }
+        std::string vendor = readFirstLine(root + name + "/vendor");
+        std::string cls = readFirstLine(root + name + "/class");
+        // 0x0300xx为VGA控制器，0x0302xx为3D控制器（计算卡）
+        if (vendor == "0x10de" && (cls.compare(0, 6, "0x0300") == 0 || cls.compare(0, 6, "0x0302") == 0))
+        {
+            devices.push_back(name);
+        }
+    }
+    closedir(dir);
+    std::sort(devices.begin(), devices.end());
+    return devices;
+}
+#endif
+
+} // namespace
+
+bool parseCpuList(const std::string &text, std::vector<int> &cpus)
+{
+    cpus.clear();
+    std::stringstream stream(text);
+    std::string part;
+    while (std::getline(stream, part, ','))
+    {
+        part = trim(part);
+        if (part.empty())
+        {
+            continue;
+        }
+        size_t dash = part.find('-');
+        int first = 0;
+        int last = 0;
+        if (dash == std::string::npos)
+        {
+            if (!parseInt(part, first))
+            {
+                return false;
+            }
+            last = first;
+        }
+        else if (!parseInt(trim(part.substr(0, dash)), first) || !parseInt(trim(part.substr(dash + 1)), last)
+                 || last < first)
+        {
+            return false;
+        }
+        for (int cpu = first; cpu <= last; ++cpu)
+        {
+            cpus.push_back(cpu);
+        }
+    }
+    std::sort(cpus.begin(), cpus.end());
+    cpus.erase(std::unique(cpus.begin(), cpus.end()), cpus.end());
+    return true;
+}
+
+std::string formatCpuList(const std::vector<int> &cpus)
+{
+    std::string text;
+    for (size_t i = 0; i < cpus.size();)
+    {
+        size_t j = i;
+        while (j + 1 < cpus.size() && cpus[j + 1] == cpus[j] + 1)
+        {
+            ++j;
+        }
+        if (!text.empty())
+        {
+            text += ",";
+        }
+        text += std::to_string(cpus[i]);
+        if (j > i)
+        {
+            text += "-" + std::to_string(cpus[j]);
+        }
+        i = j + 1;
+    }
+    return text;
+}
+
+bool parseDeviceSpec(const std::string &text, DeviceSpec &spec, std::string *errorMessage)
+{
+    auto fail = [&](const std::string &message) {
+        if (errorMessage)
+        {
+            *errorMessage = message;
+        }
+        return false;
+    };
+
+    DeviceSpec parsed;
+    std::string devices = trim(text);
+    std::string cpuText;
+    size_t at = devices.find('@');
+    if (at != std::string::npos)
+    {
+        cpuText = devices.substr(at + 1);
+        devices = trim(devices.substr(0, at));
+    }
+
+    if (devices.compare(0, 3, "cpu") == 0)
+    {
+        parsed.useGpu = false;
+        parsed.deviceIds = {0};
+        if (devices.size() > 3)
+        {
+            if (devices[3] != ':' || !cpuText.empty())
+            {
+                return fail("无效的设备: " + text);
+            }
+            cpuText = devices.substr(4);
+        }
+    }
+    else if (!parseCpuList(devices, parsed.deviceIds) || parsed.deviceIds.empty())
+    {
+        return fail("无效的GPU编号列表: " + devices);
+    }
+
+    if (!cpuText.empty() && (!parseCpuList(cpuText, parsed.cpus) || parsed.cpus.empty()))
+    {
+        return fail("无效的核列表: " + cpuText);
+    }
+
+    spec = parsed;
+    return true;
+}
+
+std::vector<DevicePlacement> planDevicePlacement(const DeviceSpec &spec, bool pinThreads)
+{
+    std::vector<DevicePlacement> placements;
+
+    if (spec.useGpu)
+    {
+        for (int deviceId : spec.deviceIds)
+        {
+            DevicePlacement placement;
+            placement.deviceId = deviceId;
+            placement.numaNode = gpuNumaNode(deviceId);
+            if (pinThreads)
+            {
+                placement.cpus = spec.cpus;
+                if (placement.numaNode >= 0)
+                {
+                    std::vector<int> local = numaNodeCpus(placement.numaNode);
+                    std::vector<int> allowed = spec.cpus.empty() ? local : intersect(local, spec.cpus);
+                    // 限定的核都不在这块卡的节点上时，只能用限定的核
+                    if (!allowed.empty())
+                    {
+                        placement.cpus = allowed;
+                    }
+                }
+            }
+            placements.push_back(placement);
+        }
+        return placements;
+    }
+
+    // CPU推理：每个NUMA节点一个"设备"，推理线程只在本节点的核上跑
+    std::vector<int> allowed = spec.cpus.empty() ? onlineCpus() : spec.cpus;
+    if (pinThreads)
+    {
+        for (int node = 0; node < numaNodeCount(); ++node)
+        {
+            std::vector<int> cpus = intersect(numaNodeCpus(node), allowed);
+            if (cpus.empty())
+            {
+                continue;
+            }
+            DevicePlacement placement;
+            placement.useGpu = false;
+            placement.deviceId = (int)placements.size();
+            placement.numaNode = node;
+            placement.cpus = cpus;
+            placements.push_back(placement);
+        }
+    }
+
+    if (placements.empty())
+    {
+        DevicePlacement placement;
+        placement.useGpu = false;
+        placement.deviceId = 0;
+        if (pinThreads || !spec.cpus.empty())
+        {
+            placement.cpus = allowed;
+        }
+        placements.push_back(placement);
+    }
+    return placements;
+}
+
+std::vector<int> onlineCpus()
+{
+    std::vector<int> cpus;
+#if defined(__linux__)
+    parseCpuList(readFirstLine("/sys/devices/system/cpu/online"), cpus);
+#elif defined(_WIN32)
+    // 只考虑第一个处理器组（64核以内）
+    DWORD count = GetActiveProcessorCount(0);
+    for (DWORD i = 0; i < count; ++i)
+    {
+        cpus.push_back((int)i);
+    }
+#endif
+    if (cpus.empty())
+    {
+        for (unsigned i = 0; i < std::max(1u, std::thread::hardware_concurrency()); ++i)
+        {
+            cpus.push_back((int)i);
+        }
+    }
+    return cpus;
+}
+
+int numaNodeCount()
+{
+#if defined(__linux__)
+    std::vector<int> nodes;
+    if (parseCpuList(readFirstLine("/sys/devices/system/node/online"), nodes) && !nodes.empty())
+    {
+        return nodes.back() + 1;
+    }
+#elif defined(_WIN32)
+    ULONG highest = 0;
+    if (GetNumaHighestNodeNumber(&highest))
+    {
+        return (int)highest + 1;
+    }
+#endif
+    return 1;
+}
+
+std::vector<int> numaNodeCpus(int node)
+{
+    std::vector<int> cpus;
+#if defined(__linux__)
+    parseCpuList(readFirstLine("/sys/devices/system/node/node" + std::to_string(node) + "/cpulist"), cpus);
+#elif defined(_WIN32)
+    GROUP_AFFINITY affinity = {};
+    if (GetNumaNodeProcessorMaskEx((USHORT)node, &affinity))
+    {
+        for (int bit = 0; bit < 64; ++bit)
+        {
+            if (affinity.Mask & ((KAFFINITY)1 << bit))
+            {
+                cpus.push_back(affinity.Group * 64 + bit);
+            }
+        }
+    }
+#endif
+    // 查不到拓扑时按单节点处理
+    if (cpus.empty() && node == 0 && numaNodeCount() == 1)
+    {
+        cpus = onlineCpus();
+    }
+    return cpus;
+}
+
+int gpuNumaNode(int deviceId)
+{
+    if (const char *env = std::getenv("SMORE_GPU_NUMA_NODES"))
+    {
+        std::stringstream stream(env);
+        std::string item;
+        for (int i = 0; std::getline(stream, item, ','); ++i)
+        {
+            int node = -1;
+            if (i == deviceId && parseInt(trim(item), node))
+            {
+                return node;
+            }
+        }
+    }
+
+#if defined(__linux__)
+    std::vector<std::string> devices = nvidiaGpuPciDevices();
+    if (deviceId >= 0 && deviceId < (int)devices.size())
+    {
+        int node = -1;
+        std::string text = readFirstLine("/sys/bus/pci/devices/" + devices[deviceId] + "/numa_node");
+        // 单节点机器上内核报告-1
+        if (!text.empty() && text[0] != '-' && parseInt(text, node))
+        {
+            return node;
+        }
+    }
+#endif
+    (void)deviceId;
+    return -1;
+}
+
+bool pinCurrentThread(const std::vector<int> &cpus)
+{
+    if (cpus.empty())
+    {
+        return false;
+    }
+
+#if defined(__linux__)
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    for (int cpu : cpus)
+    {
+        if (cpu >= 0 && cpu < CPU_SETSIZE)
+        {
+            CPU_SET(cpu, &set);
+        }
+    }
+    return pthread_setaffinity_np(pthread_self(), sizeof(set), &set) == 0;
+#elif defined(_WIN32)
+    // 线程只能绑在一个处理器组里，取第一个核所在的组
+    GROUP_AFFINITY affinity = {};
+    affinity.Group = (WORD)(cpus.front() / 64);
+    for (int cpu : cpus)
+    {
+        if (cpu / 64 == affinity.Group)
+        {
+            affinity.Mask |= (KAFFINITY)1 << (cpu % 64);
+        }
+    }
+    return SetThreadGroupAffinity(GetCurrentThread(), &affinity, nullptr) != 0;
+#else
+    return false;
+#endif
+}
@@ -0,0 +1,51 @@
+﻿#ifndef DEVICEPLACEMENT_H
+#define DEVICEPLACEMENT_H
+
+#include <string>
+#include <vector>
+
+// 推理设备的描述，由parseDeviceSpec解析：
+//   "0"、"0,1"          使用这些GPU
+//   "cpu"               用CPU推理，使用全部核
+//   "cpu:0-15,32-47"    用CPU推理，只使用这些核
+// GPU也可以限定核："0,1@0-15,32-47"
+struct DeviceSpec
+{
+    bool useGpu = true;
+    std::vector<int> deviceIds{0};
+    std::vector<int> cpus;          // 为空表示不限制
+};
+
+bool parseDeviceSpec(const std::string &text, DeviceSpec &spec, std::string *errorMessage = nullptr);
+
+// "0-3,8,10-11"这样的核列表
+bool parseCpuList(const std::string &text, std::vector<int> &cpus);
+std::string formatCpuList(const std::vector<int> &cpus);
+
+// 一个设备的放置结果：用哪个设备推理，服务它的线程绑在哪些核上
+struct DevicePlacement
+{
+    bool useGpu = true;
+    int deviceId = 0;
+    int numaNode = -1;          // -1表示不知道（单节点机器，或者查不到GPU所在的节点）
+    std::vector<int> cpus;      // 为空表示不绑核
+};
+
+// 为每个设备算出应该绑定的核：
+// GPU取离它最近的NUMA节点上的核；CPU推理按NUMA节点把核分组，每个节点作为一个"设备"
+// pinThreads为false时只分配设备，不绑核
+std::vector<DevicePlacement> planDevicePlacement(const DeviceSpec &spec, bool pinThreads);
+
+// 机器的拓扑，查不到时按单节点处理
+int numaNodeCount();
+std::vector<int> numaNodeCpus(int node);
+std::vector<int> onlineCpus();
+
+// GPU所在的NUMA节点，查不到返回-1
+// 可以用环境变量SMORE_GPU_NUMA_NODES="0,0,1,1"直接指定每块卡所在的节点
+int gpuNumaNode(int deviceId);
+
+// 把调用线程绑到这些核上，cpus为空时什么都不做
+bool pinCurrentThread(const std::vector<int> &cpus);
+
+#endif // DEVICEPLACEMENT_H
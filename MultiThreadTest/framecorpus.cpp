@@ -0,0 +1,294 @@
+﻿#include "framecorpus.h"
+#include "deviceplacement.h"
+#include "imageio.h"
+#include "processmemory.h"
+
+#include <QThread>
+
+#include <atomic>
+#include <chrono>
+#include <cstdlib>
+#include <thread>
+
+#if defined(_WIN32)
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <sys/mman.h>
+#include <unistd.h>
+#endif
+
+using Clock = std::chrono::steady_clock;
+
+// 每帧的起始地址按缓存行对齐
+static const size_t kFrameAlignment = 64;
+
+static size_t pageSize()
+{
+#if defined(_WIN32)
+    SYSTEM_INFO info;
+    GetSystemInfo(&info);
+    return info.dwPageSize;
+#else
+    return (size_t)sysconf(_SC_PAGESIZE);
+#endif
+}
+
+static uchar *allocateStorage(size_t bytes)
+{
+#if defined(_WIN32)
+    return static_cast<uchar *>(VirtualAlloc(nullptr, bytes, MEM_COMMIT | MEM_RESERVE, PAGE_READWRITE));
+#else
+    void *ptr = nullptr;
+    if (posix_memalign(&ptr, pageSize(), bytes) != 0)
+    {
+        return nullptr;
+    }
+    return static_cast<uchar *>(ptr);
+#endif
+}
+
+static void releaseStorage(uchar *ptr)
+{
+#if defined(_WIN32)
+    VirtualFree(ptr, 0, MEM_RELEASE);
+#else
+    std::free(ptr);
+#endif
+}
+
+static bool lockStorage(uchar *ptr, size_t bytes)
+{
+#if defined(_WIN32)
+    // VirtualLock受限于工作集大小，先把工作集放大
+    SIZE_T minSize = 0;
+    SIZE_T maxSize = 0;
+    HANDLE process = GetCurrentProcess();
+    if (GetProcessWorkingSetSize(process, &minSize, &maxSize))
+    {
+        SetProcessWorkingSetSize(process, minSize + bytes, maxSize + bytes);
+    }
+    return VirtualLock(ptr, bytes) != 0;
+#else
+    return mlock(ptr, bytes) == 0;
+#endif
+}
+
+static void unlockStorage(uchar *ptr, size_t bytes)
+{
+#if defined(_WIN32)
+    VirtualUnlock(ptr, bytes);
+#else
+    munlock(ptr, bytes);
+#endif
+}
+
+FrameCorpus::FrameCorpus(const FrameCorpusConfig &config)
+    : mConfig(config)
+{
+}
+
+FrameCorpus::~FrameCorpus()
+{
+    freeStorage();
+}
+
+bool FrameCorpus::load(std::string *errorMessage)
+{
+    std::lock_guard<std::mutex> locker(mMutex);
+    if (mLoaded || !mLoadError.empty())
+    {
+        if (errorMessage)
+        {
+            *errorMessage = mLoadError;
+        }
+        return mLoaded;
+    }
+
+    FrameCorpusStats stats;
+    stats.rssBeforeBytes = currentResidentBytes();
+    auto loadStart = Clock::now();
+
+    QStringList files = listImageFiles(mConfig.imageFolderPath);
+
+    // 多线程解码到临时的cv::Mat
+    std::vector<cv::Mat> decoded(files.size());
+    std::atomic<int> nextIndex(0);
+    int threadCount = mConfig.threadCount > 0 ? mConfig.threadCount : QThread::idealThreadCount();
+    threadCount = qBound(1, threadCount, qMax(1, files.size()));
+
+    std::vector<std::thread> threads;
+    for (int t = 0; t < threadCount; ++t)
+    {
+        threads.emplace_back([&]() {
+            FramePreprocessor preprocessor(mConfig.preprocess);
+            for (int i = nextIndex++; i < files.size(); i = nextIndex++)
+            {
+                cv::Mat image = loadMatFromPath(files[i]);
+                // 不支持的类型原样保存，由SDK转换
+                if (image.empty() || !preprocessor.process(image, decoded[i]))
+                {
+                    decoded[i] = image;
+                }
+            }
+        });
+    }
+    for (auto &thread : threads)
+    {
+        thread.join();
+    }
+
+    // 计算每帧在连续存储区中的偏移
+    std::vector<size_t> offsets(files.size(), 0);
+    size_t total = 0;
+    for (int i = 0; i < files.size(); ++i)
+    {
+        if (decoded[i].empty())
+        {
+            stats.failedCount++;
+            continue;
+        }
+        offsets[i] = total;
+        size_t bytes = decoded[i].total() * decoded[i].elemSize();
+        total += (bytes + kFrameAlignment - 1) / kFrameAlignment * kFrameAlignment;
+    }
+
+    if (total == 0)
+    {
+        mLoadError = "文件夹中没有可用的图片文件";
+    }
+    else
+    {
+        size_t page = pageSize();
+        mStorageBytes = (total + page - 1) / page * page;
+        mStorage = allocateStorage(mStorageBytes);
+        if (mStorage == nullptr)
+        {
+            mStorageBytes = 0;
+            mLoadError = "无法分配帧存储区";
+        }
+    }
+
+    if (mLoadError.empty())
+    {
+        if (mConfig.pageLocked)
+        {
+            stats.pageLocked = lockStorage(mStorage, mStorageBytes);
+        }
+
+        // 拷贝到连续存储区，之后只保留指向存储区的cv::Mat头
+        for (int i = 0; i < files.size(); ++i)
+        {
+            if (decoded[i].empty())
+            {
+                continue;
+            }
+            cv::Mat frame(decoded[i].rows, decoded[i].cols, decoded[i].type(), mStorage + offsets[i]);
+            decoded[i].copyTo(frame);
+            decoded[i].release();
+
+            mFrames.push_back(frame);
+            mPaths << files[i];
+        }
+
+        stats.frameCount = (int)mFrames.size();
+        stats.bytes = (long long)mStorageBytes;
+    }
+
+    stats.loadMs = std::chrono::duration<double, std::milli>(Clock::now() - loadStart).count();
+    stats.rssAfterBytes = currentResidentBytes();
+    mStats = stats;
+    mLoaded = mLoadError.empty();
+
+    if (errorMessage)
+    {
+        *errorMessage = mLoadError;
+    }
+    return mLoaded;
+}
+
+bool FrameCorpus::isLoaded() const
+{
+    std::lock_guard<std::mutex> locker(mMutex);
+    return mLoaded;
+}
+
+int FrameCorpus::addReplica(const std::vector<int> &cpus)
+{
+    std::lock_guard<std::mutex> locker(mMutex);
+    if (!mLoaded || cpus.empty())
+    {
+        return 0;
+    }
+
+    Replica replica;
+    std::thread copier([&]() {
+        if (!pinCurrentThread(cpus))
+        {
+            return;
+        }
+        replica.storage = allocateStorage(mStorageBytes);
+        if (replica.storage == nullptr)
+        {
+            return;
+        }
+
+        // 帧在存储区中的偏移和第一份完全一样
+        for (const cv::Mat &source : mFrames)
+        {
+            cv::Mat frame(source.rows, source.cols, source.type(), replica.storage + (source.data - mStorage));
+            source.copyTo(frame);
+            replica.frames.push_back(frame);
+        }
+        if (mConfig.pageLocked)
+        {
+            replica.pageLocked = lockStorage(replica.storage, mStorageBytes);
+        }
+    });
+    copier.join();
+
+    if (replica.frames.size() != mFrames.size())
+    {
+        if (replica.storage)
+        {
+            releaseStorage(replica.storage);
+        }
+        return 0;
+    }
+
+    mReplicas.push_back(std::move(replica));
+    return (int)mReplicas.size();
+}
+
+FrameCorpusStats FrameCorpus::stats() const
+{
+    std::lock_guard<std::mutex> locker(mMutex);
+    return mStats;
+}
+
+void FrameCorpus::freeStorage()
+{
+    for (Replica &replica : mReplicas)
+    {
+        replica.frames.clear();
+        if (replica.pageLocked)
+        {
+            unlockStorage(replica.storage, mStorageBytes);
+        }
+        releaseStorage(replica.storage);
+    }
+    mReplicas.clear();
+
+    mFrames.clear();
+    mPaths.clear();
+    if (mStorage)
+    {
+        if (mStats.pageLocked)
+        {
+            unlockStorage(mStorage, mStorageBytes);
+        }
+        releaseStorage(mStorage);
+        mStorage = nullptr;
+        mStorageBytes = 0;
+    }
+}
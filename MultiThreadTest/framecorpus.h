@@ -0,0 +1,94 @@
+﻿#ifndef FRAMECORPUS_H
+#define FRAMECORPUS_H
+
+#include <QString>
+#include <QStringList>
+
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include <opencv2/opencv.hpp>
+
+#include "preprocess.h"
+
+struct FrameCorpusConfig
+{
+    QString imageFolderPath;
+    bool pageLocked = false;    // 锁定物理内存，避免帧数据被换出
+    int threadCount = 0;        // 解码线程数，0表示按CPU核数
+    PreprocessConfig preprocess;    // 存储之前转成模型的输入格式，循环推理时不再转换
+};
+
+// 预加载的统计，启动时输出
+struct FrameCorpusStats
+{
+    int frameCount = 0;
+    int failedCount = 0;
+    long long bytes = 0;            // 帧存储区的大小
+    double loadMs = 0;              // 读文件+解码+预处理+拷贝的总耗时
+    bool pageLocked = false;        // 是否真的锁定成功
+    long long rssBeforeBytes = -1;
+    long long rssAfterBytes = -1;
+};
+
+// 预加载的图像库：
+// 把文件夹中的图片一次性解码到一块连续的、只读的内存中，所有线程按下标直接取用，
+// 循环推理时不再重复读盘和解码，也没有任何内存分配，测出来的就是纯推理的耗时
+// 和InferenceEngine一样，load()可以被多个线程同时调用，只会真正加载一次
+class FrameCorpus
+{
+public:
+    explicit FrameCorpus(const FrameCorpusConfig &config);
+    ~FrameCorpus();
+
+    FrameCorpus(const FrameCorpus &) = delete;
+    FrameCorpus &operator=(const FrameCorpus &) = delete;
+
+    bool load(std::string *errorMessage = nullptr);
+    bool isLoaded() const;
+
+    // 以下接口只能在load()成功之后调用
+    int size() const { return (int)mFrames.size(); }
+
+    // 帧数据属于图像库，调用者只能读，不能修改
+    const cv::Mat &frame(int index) const { return mFrames[index]; }
+    const QString &path(int index) const { return mPaths[index]; }
+
+    // 多NUMA节点：在cpus所在的节点上再放一份帧数据，返回副本编号（0是load()时的那一份）
+    // 拷贝在绑到这些核上的线程里完成，按首次访问的策略，物理内存就分配在该节点上
+    // 只能在load()成功之后、开始推理之前调用；失败时返回0，退回到共用第一份
+    int addReplica(const std::vector<int> &cpus);
+    int replicaCount() const { return 1 + (int)mReplicas.size(); }
+    const cv::Mat &frame(int index, int replica) const
+    {
+        return replica > 0 ? mReplicas[replica - 1].frames[index] : mFrames[index];
+    }
+
+    FrameCorpusStats stats() const;
+
+private:
+    struct Replica
+    {
+        uchar *storage = nullptr;
+        bool pageLocked = false;
+        std::vector<cv::Mat> frames;
+    };
+
+    void freeStorage();
+
+    FrameCorpusConfig mConfig;
+
+    mutable std::mutex mMutex;
+    bool mLoaded = false;
+    std::string mLoadError;
+    FrameCorpusStats mStats;
+
+    uchar *mStorage = nullptr;
+    size_t mStorageBytes = 0;
+    std::vector<cv::Mat> mFrames;
+    QStringList mPaths;
+    std::vector<Replica> mReplicas;
+};
+
+#endif // FRAMECORPUS_H
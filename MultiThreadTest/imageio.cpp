@@ -0,0 +1,40 @@
+﻿#include "imageio.h"
+#include "tracing.h"
+
+#include <QDir>
+#include <QFile>
+
+cv::Mat loadMatFromPath(QString imgPath)
+{
+    cv::Mat mat;
+
+    QFile file(imgPath);
+    if(file.exists())
+    {
+        if(file.open(QFile::ReadOnly))
+        {
+            TraceSpan readSpan("read file", "decode");
+            QByteArray data =  file.readAll();
+            std::vector<uchar> imgData(data.begin(), data.end());
+            readSpan.finish();
+
+            TraceSpan span("imdecode", "decode");
+            mat = cv::imdecode(imgData, cv::IMREAD_UNCHANGED);
+        }
+    }
+
+    return mat;
+}
+
+QStringList listImageFiles(const QString &imageFolderPath)
+{
+    QDir imageDir(imageFolderPath);
+    QStringList filters;
+    filters << "*.bmp" << "*.jpg" << "*.jpeg" << "*.png" << "*.tif" << "*.tiff";
+
+    QStringList files;
+    foreach (auto name, imageDir.entryList(filters, QDir::Files, QDir::Name)) {
+        files << imageDir.absoluteFilePath(name);
+    }
+    return files;
+}
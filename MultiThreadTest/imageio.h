@@ -0,0 +1,15 @@
+﻿#ifndef IMAGEIO_H
+#define IMAGEIO_H
+
+#include <QString>
+#include <QStringList>
+
+#include <opencv2/opencv.hpp>
+
+// 读取图片文件并解码（支持中文路径），失败时返回空的cv::Mat
+cv::Mat loadMatFromPath(QString imgPath);
+
+// 列出文件夹中所有支持的图片（按文件名排序），返回绝对路径
+QStringList listImageFiles(const QString &imageFolderPath);
+
+#endif // IMAGEIO_H
@@ -0,0 +1,101 @@
+﻿#ifndef INFERENCEBACKEND_H
+#define INFERENCEBACKEND_H
+
+#include <any>
+#include <memory>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include <opencv2/opencv.hpp>
+
+// 一次推理的输出
+// 内容由后端决定：思谋SDK是UADResponseList，模拟后端是SyntheticResponse，
+// 需要时用std::any_cast取回后端自己的类型；线程池、调度、统计都不关心具体内容
+struct InferenceOutput
+{
+    std::any payload;
+};
+
+// 一个检测框，坐标是送进会话的那张图上的像素坐标
+struct InferenceDetection
+{
+    cv::Rect2f box;
+    float score = 0;
+    int label = 0;
+};
+
+// 一个推理会话，对应思谋SDK的一个pipelines
+// 同一个会话同一时刻只会被一个线程使用（由InferenceEngine的借还保证），实现不需要加锁
+class IInferenceSession
+{
+public:
+    virtual ~IInferenceSession() = default;
+
+    // 失败时抛出std::exception
+    virtual void run(const cv::Mat &image, InferenceOutput &output) = 0;
+
+    // 批量推理，outputs与images一一对应；默认逐张调用run
+    virtual void runBatch(const std::vector<cv::Mat> &images, std::vector<InferenceOutput> &outputs)
+    {
+        outputs.resize(images.size());
+        for (size_t i = 0; i < images.size(); ++i)
+        {
+            run(images[i], outputs[i]);
+        }
+    }
+};
+
+// 推理后端：加载模型、列出模组、创建会话
+// 所有接口失败时抛出std::exception，由InferenceEngine统一转换成错误信息
+class IInferenceBackend
+{
+public:
+    virtual ~IInferenceBackend() = default;
+
+    virtual const char *name() const = 0;
+
+    // 加载modelDir中的模型，只会被调用一次
+    virtual void load(const std::string &modelDir) = 0;
+
+    // load之后可用的模组编号
+    virtual std::vector<std::string> moduleIds() = 0;
+
+    // load之后模组之间的连接关系（上游, 下游），没有的后端返回空
+    virtual std::vector<std::pair<std::string, std::string>> moduleEdges() { return {}; }
+
+    // modelDir中的模型文件，用来判断模型有没有改动过（模组图缓存、热启动）
+    // 没有模型文件的后端返回空，这时不做缓存
+    virtual std::string modelPath(const std::string &modelDir) const
+    {
+        (void)modelDir;
+        return std::string();
+    }
+
+    // 一次推理输出的简短文字描述，保存结果时使用；默认为空
+    virtual std::string describeOutput(const InferenceOutput &output) const
+    {
+        (void)output;
+        return std::string();
+    }
+
+    // 一次推理的输出占用内存的估算，结果缓存按它限制总大小；默认只算InferenceOutput本身
+    virtual size_t outputBytes(const InferenceOutput &output) const
+    {
+        (void)output;
+        return sizeof(InferenceOutput);
+    }
+
+    // 从一次推理的输出中取出检测框，切图推理时用来拼回整图；输出中没有检测框的后端返回false
+    virtual bool detections(const InferenceOutput &output, std::vector<InferenceDetection> &boxes) const
+    {
+        (void)output;
+        (void)boxes;
+        return false;
+    }
+
+    virtual std::unique_ptr<IInferenceSession> createSession(const std::string &moduleId,
+                                                             bool useGpu, int deviceId) = 0;
+};
+
+#endif // INFERENCEBACKEND_H
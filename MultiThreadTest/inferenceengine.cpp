@@ -0,0 +1,379 @@
+﻿#include "inferenceengine.h"
+#include "processmemory.h"
+#include "vimobackend.h"
+
+#include <algorithm>
+#include <thread>
+
+using Clock = std::chrono::steady_clock;
+
+static double msSince(Clock::time_point start)
+{
+    return std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+}
+
+// 列出模组和连接关系，并选出推理使用的模组
+static ModuleGraph resolveModuleGraph(IInferenceBackend &backend)
+{
+    ModuleGraph graph;
+    graph.moduleIds = backend.moduleIds();
+    graph.edges = backend.moduleEdges();
+    if (!graph.moduleIds.empty())
+    {
+        // 找到最新、最大的那个模组;
+        // 因为module id是以数字递增的,排序之后，最后的那个就是我们想要的
+        graph.moduleId = *std::max_element(graph.moduleIds.begin(), graph.moduleIds.end());
+    }
+    return graph;
+}
+
+InferenceEngine::Lease::~Lease()
+{
+    release();
+}
+
+InferenceEngine::Lease::Lease(Lease &&other) noexcept
+    : mEngine(other.mEngine)
+    , mSlot(other.mSlot)
+{
+    other.mEngine = nullptr;
+    other.mSlot = -1;
+}
+
+InferenceEngine::Lease &InferenceEngine::Lease::operator=(Lease &&other) noexcept
+{
+    if (this != &other)
+    {
+        release();
+        mEngine = other.mEngine;
+        mSlot = other.mSlot;
+        other.mEngine = nullptr;
+        other.mSlot = -1;
+    }
+    return *this;
+}
+
+IInferenceSession &InferenceEngine::Lease::session() const
+{
+    // 槽位在加载完成之后就不会再变，这里不需要加锁
+    return *mEngine->mSessions[mSlot];
+}
+
+int InferenceEngine::Lease::deviceIndex() const
+{
+    return mEngine ? mEngine->mSlotDevice[mSlot] : -1;
+}
+
+void InferenceEngine::Lease::release()
+{
+    if (mEngine)
+    {
+        mEngine->giveBack(mSlot);
+        mEngine = nullptr;
+        mSlot = -1;
+    }
+}
+
+InferenceEngine::InferenceEngine(const InferenceEngineConfig &config)
+    : mConfig(config)
+{
+    mConfig.pipelineCount = std::max(1, mConfig.pipelineCount);
+    mDeviceIds = mConfig.deviceIds.empty() ? std::vector<int>{mConfig.deviceId} : mConfig.deviceIds;
+    mBackend = mConfig.backend ? mConfig.backend : std::make_shared<VimoBackend>();
+}
+
+InferenceEngine::~InferenceEngine()
+{
+    // 所有Lease必须在引擎析构之前归还
+}
+
+bool InferenceEngine::load(std::string *errorMessage)
+{
+    std::lock_guard<std::mutex> locker(mLoadMutex);
+    if (mLoaded || !mLoadError.empty())
+    {
+        if (errorMessage)
+        {
+            *errorMessage = mLoadError;
+        }
+        return mLoaded;
+    }
+
+    InferenceEngineLoadStats stats;
+    stats.rssBeforeBytes = currentResidentBytes();
+
+    try
+    {
+        // 指纹在加载之前取，加载期间模型文件被替换时下次isModelCurrent()能发现
+        ModuleGraphCache &cache = ModuleGraphCache::instance();
+        mModelPath = mBackend->modelPath(mConfig.modelDir);
+        bool cacheable = !mModelPath.empty() && cache.fingerprint(mModelPath, mModelFingerprint);
+
+        auto loadStart = Clock::now();
+        mBackend->load(mConfig.modelDir);
+        stats.solutionLoadMs = msSince(loadStart);
+
+        auto resolveStart = Clock::now();
+        stats.moduleGraphCached = cacheable && cache.lookup(mModelPath, mModelFingerprint, mModuleGraph);
+        if (!stats.moduleGraphCached)
+        {
+            mModuleGraph = resolveModuleGraph(*mBackend);
+            if (cacheable && !mModuleGraph.moduleId.empty())
+            {
+                cache.store(mModelPath, mModelFingerprint, mModuleGraph);
+            }
+        }
+        stats.moduleResolveMs = msSince(resolveStart);
+
+        if (mModuleGraph.moduleId.empty())
+        {
+            mLoadError = "error 1 无法从模型中找到有效模组";
+        }
+        else
+        {
+            mModuleId = mModuleGraph.moduleId;
+
+            auto createStart = Clock::now();
+            // 多卡时按顺序轮流分配，每个设备上的pipelines数最多差一个
+            std::vector<std::unique_ptr<IInferenceSession>> sessions;
+            std::vector<int> slotDevice;
+            sessions.reserve(mConfig.pipelineCount);
+            for (int i = 0; i < mConfig.pipelineCount; ++i)
+            {
+                int deviceIndex = i % (int)mDeviceIds.size();
+                sessions.push_back(mBackend->createSession(mModuleId, mConfig.useGpu, mDeviceIds[deviceIndex]));
+                slotDevice.push_back(deviceIndex);
+            }
+            stats.pipelineCreateMs = msSince(createStart);
+
+            std::lock_guard<std::mutex> poolLocker(mPoolMutex);
+            mSessions = std::move(sessions);
+            mSlotDevice = std::move(slotDevice);
+            mFreeSlots.assign(mDeviceIds.size(), std::vector<int>());
+            for (int i = mConfig.pipelineCount - 1; i >= 0; --i)
+            {
+                mFreeSlots[mSlotDevice[i]].push_back(i);
+            }
+        }
+    }
+    catch (const std::exception &e)
+    {
+        mLoadError = e.what();
+    }
+
+    stats.rssAfterBytes = currentResidentBytes();
+    mLoadStats = stats;
+    mLoaded = mLoadError.empty();
+
+    if (errorMessage)
+    {
+        *errorMessage = mLoadError;
+    }
+
+    return mLoaded;
+}
+
+bool InferenceEngine::isLoaded() const
+{
+    std::lock_guard<std::mutex> locker(mLoadMutex);
+    return mLoaded;
+}
+
+bool InferenceEngine::warmUp(const cv::Mat &image, std::string *errorMessage)
+{
+    std::lock_guard<std::mutex> locker(mWarmMutex);
+    if (!mWarmed)
+    {
+        mWarmError = runWarmUp(image);
+        mWarmed = mWarmError.empty();
+    }
+
+    if (errorMessage)
+    {
+        *errorMessage = mWarmError;
+    }
+    return mWarmError.empty();
+}
+
+std::string InferenceEngine::runWarmUp(const cv::Mat &image)
+{
+    if (!load())
+    {
+        return "模型未加载";
+    }
+    if (image.empty())
+    {
+        return "预热的样图为空";
+    }
+
+    // 一次借出全部pipelines，各自在一个线程里空跑，总耗时约等于一个pipelines的预热耗时
+    std::vector<Lease> leases;
+    for (int i = 0; i < pipelineCount(); ++i)
+    {
+        leases.push_back(checkout());
+    }
+
+    const int runs = std::max(1, mConfig.warmupRuns);
+    std::vector<double> firstMs(leases.size(), 0);
+    std::vector<double> lastMs(leases.size(), 0);
+    std::vector<std::string> errors(leases.size());
+    auto warmupStart = Clock::now();
+    std::vector<std::thread> threads;
+    for (size_t i = 0; i < leases.size(); ++i)
+    {
+        threads.emplace_back([&, i]() {
+            try
+            {
+                for (int run = 0; run < runs; ++run)
+                {
+                    InferenceOutput output;
+                    auto runStart = Clock::now();
+                    leases[i]->run(image, output);
+                    (run == 0 ? firstMs[i] : lastMs[i]) = msSince(runStart);
+                }
+            }
+            catch (const std::exception &e)
+            {
+                errors[i] = e.what();
+            }
+        });
+    }
+    for (auto &thread : threads)
+    {
+        thread.join();
+    }
+    double warmupMs = msSince(warmupStart);
+    leases.clear();
+
+    for (const std::string &error : errors)
+    {
+        if (!error.empty())
+        {
+            return error;
+        }
+    }
+
+    std::lock_guard<std::mutex> locker(mLoadMutex);
+    mLoadStats.warmupMs = warmupMs;
+    mLoadStats.firstRunMs = 0;
+    mLoadStats.warmRunMs = 0;
+    for (size_t i = 0; i < firstMs.size(); ++i)
+    {
+        mLoadStats.firstRunMs += firstMs[i] / firstMs.size();
+        mLoadStats.warmRunMs += (runs > 1 ? lastMs[i] : firstMs[i]) / firstMs.size();
+    }
+    return std::string();
+}
+
+bool InferenceEngine::isWarm() const
+{
+    std::lock_guard<std::mutex> locker(mWarmMutex);
+    return mWarmed && mWarmError.empty();
+}
+
+bool InferenceEngine::isModelCurrent() const
+{
+    std::lock_guard<std::mutex> locker(mLoadMutex);
+    if (mModelPath.empty())
+    {
+        return true;
+    }
+
+    // 只是修改时间变了、内容没变（例如重新拷贝了同一个模型）也算没改动
+    ModelFingerprint current;
+    return ModuleGraphCache::instance().fingerprint(mModelPath, current)
+           && current.size == mModelFingerprint.size && current.hash == mModelFingerprint.hash;
+}
+
+InferenceEngine::Lease InferenceEngine::checkout(int deviceIndex)
+{
+    std::unique_lock<std::mutex> locker(mPoolMutex);
+    if (mSessions.empty())
+    {
+        return Lease();
+    }
+
+    int slot = -1;
+    mPoolCond.wait(locker, [&] { return takeFreeSlot(deviceIndex, slot); });
+    return Lease(this, slot);
+}
+
+InferenceEngine::Lease InferenceEngine::tryCheckout(std::chrono::milliseconds timeout, int deviceIndex)
+{
+    std::unique_lock<std::mutex> locker(mPoolMutex);
+    if (mSessions.empty())
+    {
+        return Lease();
+    }
+
+    int slot = -1;
+    if (!mPoolCond.wait_for(locker, timeout, [&] { return takeFreeSlot(deviceIndex, slot); }))
+    {
+        return Lease();
+    }
+    return Lease(this, slot);
+}
+
+bool InferenceEngine::takeFreeSlot(int deviceIndex, int &slot)
+{
+    // 不限设备时从空闲最多的设备上借，让各个设备的负载尽量均衡
+    if (deviceIndex < 0 || deviceIndex >= (int)mFreeSlots.size())
+    {
+        deviceIndex = 0;
+        for (int i = 1; i < (int)mFreeSlots.size(); ++i)
+        {
+            if (mFreeSlots[i].size() > mFreeSlots[deviceIndex].size())
+            {
+                deviceIndex = i;
+            }
+        }
+    }
+
+    std::vector<int> &freeSlots = mFreeSlots[deviceIndex];
+    if (freeSlots.empty())
+    {
+        return false;
+    }
+    slot = freeSlots.back();
+    freeSlots.pop_back();
+    return true;
+}
+
+InferenceEngineLoadStats InferenceEngine::loadStats() const
+{
+    std::lock_guard<std::mutex> locker(mLoadMutex);
+    return mLoadStats;
+}
+
+int InferenceEngine::pipelineCount() const
+{
+    std::lock_guard<std::mutex> locker(mPoolMutex);
+    return (int)mSessions.size();
+}
+
+int InferenceEngine::availableCount() const
+{
+    std::lock_guard<std::mutex> locker(mPoolMutex);
+    int count = 0;
+    for (const auto &freeSlots : mFreeSlots)
+    {
+        count += (int)freeSlots.size();
+    }
+    return count;
+}
+
+int InferenceEngine::deviceSessionCount(int deviceIndex) const
+{
+    std::lock_guard<std::mutex> locker(mPoolMutex);
+    return (int)std::count(mSlotDevice.begin(), mSlotDevice.end(), deviceIndex);
+}
+
+void InferenceEngine::giveBack(int slot)
+{
+    {
+        std::lock_guard<std::mutex> locker(mPoolMutex);
+        mFreeSlots[mSlotDevice[slot]].push_back(slot);
+    }
+    // 等待的线程可能限定了设备，全部唤醒，各自检查自己的设备
+    mPoolCond.notify_all();
+}
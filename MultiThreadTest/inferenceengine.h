@@ -0,0 +1,164 @@
+﻿#ifndef INFERENCEENGINE_H
+#define INFERENCEENGINE_H
+
+#include <chrono>
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include "inferencebackend.h"
+#include "modulegraphcache.h"
+
+// 推理引擎的配置
+struct InferenceEngineConfig
+{
+    std::string modelDir;       // model.vimosln所在的文件夹
+    int pipelineCount = 1;      // pipelines池的大小
+    bool useGpu = true;         // whether to use gpu for inference
+    int deviceId = 0;           // GPU device id, ignore if useGpu == false
+
+    // 多卡：pipelines按顺序轮流创建在这些设备上，为空时全部创建在deviceId上
+    std::vector<int> deviceIds;
+
+    // 推理后端，为空时使用思谋SDK（VimoBackend）
+    std::shared_ptr<IInferenceBackend> backend;
+
+    // warmUp()时每个pipelines空跑的次数
+    int warmupRuns = 2;
+};
+
+// 加载阶段的统计信息，用于和"每个线程各自加载"的方式做对比
+struct InferenceEngineLoadStats
+{
+    double solutionLoadMs = 0;      // LoadFromFile耗时
+    double pipelineCreateMs = 0;    // 创建全部pipelines的耗时
+    long long rssBeforeBytes = -1;  // 加载前的常驻内存
+    long long rssAfterBytes = -1;   // 加载并创建pipelines后的常驻内存
+
+    double moduleResolveMs = 0;     // 解析模组图的耗时，命中缓存时只是查表
+    bool moduleGraphCached = false; // 模组图是否来自缓存
+
+    // 预热：每个pipelines第一次推理的耗时（含延迟初始化）和预热最后一次的耗时，都是各pipelines的平均
+    double warmupMs = 0;            // 预热的总耗时
+    double firstRunMs = 0;
+    double warmRunMs = 0;
+};
+
+// 推理引擎：模型只加载一次，并持有一个推理会话（pipelines）池
+// 工作线程通过checkout()借出一个会话，用完之后由Lease析构自动归还
+// 具体的推理由IInferenceBackend完成，默认是思谋SDK，也可以换成模拟后端
+// 本类不依赖Qt，可以在无界面的程序中使用；定义SMORE_STUB_BACKEND时使用桩SDK
+class InferenceEngine
+{
+public:
+    // 借出的pipelines，析构时自动归还给引擎（RAII）
+    class Lease
+    {
+    public:
+        Lease() = default;
+        ~Lease();
+
+        Lease(Lease &&other) noexcept;
+        Lease &operator=(Lease &&other) noexcept;
+        Lease(const Lease &) = delete;
+        Lease &operator=(const Lease &) = delete;
+
+        bool isValid() const { return mEngine != nullptr; }
+        explicit operator bool() const { return isValid(); }
+
+        // 池中的槽位编号
+        int slot() const { return mSlot; }
+
+        // 槽位所在设备在config().deviceIds中的下标
+        int deviceIndex() const;
+
+        IInferenceSession &session() const;
+        IInferenceSession *operator->() const { return &session(); }
+
+        // 提前归还
+        void release();
+
+    private:
+        friend class InferenceEngine;
+        Lease(InferenceEngine *engine, int slot) : mEngine(engine), mSlot(slot) {}
+
+        InferenceEngine *mEngine = nullptr;
+        int mSlot = -1;
+    };
+
+    explicit InferenceEngine(const InferenceEngineConfig &config);
+    ~InferenceEngine();
+
+    InferenceEngine(const InferenceEngine &) = delete;
+    InferenceEngine &operator=(const InferenceEngine &) = delete;
+
+    // 加载solution并创建pipelines池，可以被多个线程同时调用，只会真正加载一次
+    // 失败时返回false，并通过errorMessage返回原因
+    bool load(std::string *errorMessage = nullptr);
+    bool isLoaded() const;
+
+    // 用一张样图把每个pipelines都空跑config().warmupRuns次，
+    // 让显存分配、算子选择这些延迟初始化在开始测量之前做完
+    // 可以被多个线程同时调用，成功后不再重复；失败时下一次调用重试（热启动复用引擎时也会重试）
+    // 调用时不能有借出的pipelines（在开始送图之前调用）
+    bool warmUp(const cv::Mat &image, std::string *errorMessage = nullptr);
+    bool isWarm() const;
+
+    // 模型文件从加载以来没有改动过，热启动时用来判断引擎还能不能继续用
+    // 后端没有模型文件时总是返回true
+    bool isModelCurrent() const;
+    const ModuleGraph &moduleGraph() const { return mModuleGraph; }
+
+    // 借出一个空闲的pipelines，没有空闲的就一直等
+    // deviceIndex为-1时不限设备，否则只借该设备上的pipelines
+    // 引擎未加载时返回无效的Lease
+    Lease checkout(int deviceIndex = -1);
+
+    // 借出一个空闲的pipelines，最多等待timeout，超时返回无效的Lease
+    Lease tryCheckout(std::chrono::milliseconds timeout, int deviceIndex = -1);
+
+    const InferenceEngineConfig &config() const { return mConfig; }
+    const std::string &moduleId() const { return mModuleId; }
+    const std::shared_ptr<IInferenceBackend> &backend() const { return mBackend; }
+    InferenceEngineLoadStats loadStats() const;
+
+    int pipelineCount() const;
+    int availableCount() const;
+
+    // 实际使用的设备列表，以及每个设备上的pipelines数
+    const std::vector<int> &deviceIds() const { return mDeviceIds; }
+    int deviceCount() const { return (int)mDeviceIds.size(); }
+    int deviceSessionCount(int deviceIndex) const;
+
+private:
+    std::string runWarmUp(const cv::Mat &image);
+    bool takeFreeSlot(int deviceIndex, int &slot);
+    void giveBack(int slot);
+
+    InferenceEngineConfig mConfig;
+
+    mutable std::mutex mLoadMutex;
+    bool mLoaded = false;
+    std::string mLoadError;
+    std::string mModuleId;
+    ModuleGraph mModuleGraph;
+    std::string mModelPath;
+    ModelFingerprint mModelFingerprint;
+    InferenceEngineLoadStats mLoadStats;
+
+    mutable std::mutex mWarmMutex;
+    bool mWarmed = false;
+    std::string mWarmError;
+    std::shared_ptr<IInferenceBackend> mBackend;
+
+    mutable std::mutex mPoolMutex;
+    std::condition_variable mPoolCond;
+    std::vector<int> mDeviceIds;
+    std::vector<std::unique_ptr<IInferenceSession>> mSessions;
+    std::vector<int> mSlotDevice;                   // 每个槽位所在设备的下标
+    std::vector<std::vector<int>> mFreeSlots;       // 按设备分开的空闲槽位
+};
+
+#endif // INFERENCEENGINE_H
@@ -0,0 +1,469 @@
+﻿#include "inferencepool.h"
+#include "deviceplacement.h"
+#include "tracing.h"
+
+#include <algorithm>
+#include <thread>
+
+using Clock = std::chrono::steady_clock;
+
+// 睡眠等待的上限，防止极端情况下丢失唤醒导致线程一直睡下去
+static const std::chrono::milliseconds kWaitSlice(50);
+
+static double msBetween(Clock::time_point start, Clock::time_point end)
+{
+    return std::chrono::duration<double, std::milli>(end - start).count();
+}
+
+InferencePool::InferencePool(std::shared_ptr<InferenceEngine> engine, const InferencePoolConfig &config)
+    : mEngine(std::move(engine))
+    , mConfig(config)
+    , mQueue((size_t)std::max(1, config.queueCapacity))
+{
+    mConfig.workerCount = std::max(1, mConfig.workerCount);
+    mConfig.maxBatchSize = std::max(1, mConfig.maxBatchSize);
+    mConfig.maxBatchWaitUs = std::max(0, mConfig.maxBatchWaitUs);
+}
+
+InferencePool::~InferencePool()
+{
+    shutdown(true);
+}
+
+bool InferencePool::start(std::string *errorMessage)
+{
+    std::lock_guard<std::mutex> locker(mLifecycleMutex);
+    if (mRunning)
+    {
+        return true;
+    }
+
+    if (!mEngine->load(errorMessage))
+    {
+        return false;
+    }
+
+    mStopping = false;
+    mDraining = false;
+    mAccepting = true;
+    mRunning = true;
+
+    {
+        std::lock_guard<std::mutex> waitLocker(mWaitMutex);
+        mActiveWorkers = mConfig.workerCount;
+    }
+    mWorkers.reserve(mConfig.workerCount);
+    for (int i = 0; i < mConfig.workerCount; ++i)
+    {
+        mWorkers.emplace_back(&InferencePool::workerLoop, this);
+    }
+    return true;
+}
+
+bool InferencePool::submit(cv::Mat image, InferenceCallback callback)
+{
+    // 包含队列满时阻塞等待的时间
+    TraceSpan span("submit", "pool");
+    JobPtr job(new Job{std::move(image), std::move(callback), Clock::now()});
+    if (span.isActive())
+    {
+        job->traceId = TraceRecorder::instance().nextFrameId();
+        span.setFrameId(job->traceId, TraceFlow::Out);
+    }
+
+    // 先登记再检查mAccepting，和shutdown()中先清mAccepting再等mSubmitting归零配对（都是顺序一致的原子操作）：
+    // 要么这里看到已经停止、直接拒绝，要么shutdown()等到这次入队结束，再把它和队列中剩下的任务一起取消
+    ++mSubmitting;
+    bool accepted = pushJob(std::move(job));
+    --mSubmitting;
+    return accepted;
+}
+
+bool InferencePool::pushJob(JobPtr job)
+{
+    if (!mAccepting)
+    {
+        finish(*job, InferenceStatus::Rejected);
+        return false;
+    }
+
+    for (;;)
+    {
+        if (mQueue.tryPush(std::move(job)))
+        {
+            ++mSubmitted;
+            notifyNotEmpty();
+            return true;
+        }
+
+        switch (mConfig.policy) {
+        case BackpressurePolicy::Reject:{
+            finish(*job, InferenceStatus::Rejected);
+            return false;
+        }
+        case BackpressurePolicy::DropOldest:{
+            JobPtr oldest;
+            if (mQueue.tryPop(oldest))
+            {
+                finish(*oldest, InferenceStatus::Dropped);
+            }
+        }break;
+        case BackpressurePolicy::Block:{
+            std::unique_lock<std::mutex> locker(mWaitMutex);
+            ++mWaitingProducers;
+            if (mQueue.sizeApprox() >= mQueue.capacity() && mAccepting)
+            {
+                mNotFull.wait_for(locker, kWaitSlice);
+            }
+            --mWaitingProducers;
+        }break;
+        }
+
+        if (!mAccepting)
+        {
+            finish(*job, InferenceStatus::Rejected);
+            return false;
+        }
+    }
+}
+
+std::future<InferenceResult> InferencePool::submit(cv::Mat image)
+{
+    // std::function要求可拷贝，所以promise用shared_ptr包一层
+    auto promise = std::make_shared<std::promise<InferenceResult>>();
+    std::future<InferenceResult> future = promise->get_future();
+    submit(std::move(image), [promise](InferenceResult &result) {
+        promise->set_value(std::move(result));
+    });
+    return future;
+}
+
+void InferencePool::stopAccepting()
+{
+    mAccepting = false;
+    std::lock_guard<std::mutex> waitLocker(mWaitMutex);
+    mNotFull.notify_all();
+}
+
+InferencePoolShutdownStats InferencePool::shutdown(bool drain, std::chrono::milliseconds drainBudget)
+{
+    InferencePoolShutdownStats stats;
+    std::lock_guard<std::mutex> locker(mLifecycleMutex);
+    if (!mRunning)
+    {
+        return stats;
+    }
+
+    auto shutdownStart = Clock::now();
+    mAccepting = false;
+    mDraining = drain;
+    mStopping = true;
+    {
+        std::lock_guard<std::mutex> waitLocker(mWaitMutex);
+        mNotEmpty.notify_all();
+        mNotFull.notify_all();
+    }
+
+    // 排空有预算时，到时间还没做完就改成不排空，工作线程做完手上这一批就退出
+    if (drain && drainBudget.count() >= 0)
+    {
+        std::unique_lock<std::mutex> waitLocker(mWaitMutex);
+        if (!mWorkersExited.wait_for(waitLocker, drainBudget, [this] { return mActiveWorkers == 0; }))
+        {
+            mDraining = false;
+            stats.overBudget = true;
+            mNotEmpty.notify_all();
+        }
+        stats.drainMs = msBetween(shutdownStart, Clock::now());
+    }
+
+    auto joinStart = Clock::now();
+    for (auto &worker : mWorkers)
+    {
+        worker.join();
+    }
+    mWorkers.clear();
+    stats.joinMs = msBetween(joinStart, Clock::now());
+
+    // 和shutdown()并发的submit()可能还在入队，等它们返回；阻塞的生产者已经被唤醒，最多再等一个kWaitSlice
+    while (mSubmitting > 0)
+    {
+        std::this_thread::yield();
+    }
+
+    // 不排空时，队列中剩下的任务（包括上面刚入队的）全部以Cancelled结束
+    JobPtr job;
+    while (mQueue.tryPop(job))
+    {
+        finish(*job, InferenceStatus::Cancelled);
+        ++stats.abandoned;
+    }
+
+    mRunning = false;
+    stats.totalMs = msBetween(shutdownStart, Clock::now());
+    return stats;
+}
+
+void InferencePool::workerLoop()
+{
+    // 绑核要在分配任何缓冲区之前，按首次访问的策略，内存会分配在本节点上
+    pinCurrentThread(mConfig.workerCpus);
+    TraceRecorder::setThreadName(mConfig.deviceIndex >= 0
+                                 ? "infer worker (device " + std::to_string(mConfig.deviceIndex) + ")"
+                                 : "infer worker");
+
+    std::vector<JobPtr> batch;
+    batch.reserve(mConfig.maxBatchSize);
+
+    JobPtr job;
+    while (popJob(job))
+    {
+        batch.push_back(std::move(job));
+        collectBatch(batch);
+        runBatch(batch);
+        batch.clear();
+    }
+
+    // 最后一个退出的工作线程通知shutdown()排空已经完成
+    std::lock_guard<std::mutex> locker(mWaitMutex);
+    if (--mActiveWorkers == 0)
+    {
+        mWorkersExited.notify_all();
+    }
+}
+
+void InferencePool::collectBatch(std::vector<JobPtr> &batch)
+{
+    if (mConfig.maxBatchSize <= 1)
+    {
+        return;
+    }
+
+    // 凑批的截止时间从第一个任务入队时算起，保证任何任务最多多等maxBatchWaitUs
+    auto deadline = batch.front()->enqueueTime + std::chrono::microseconds(mConfig.maxBatchWaitUs);
+    while ((int)batch.size() < mConfig.maxBatchSize)
+    {
+        JobPtr job;
+        if (mQueue.tryPop(job))
+        {
+            notifyNotFull();
+            batch.push_back(std::move(job));
+            continue;
+        }
+
+        if (Clock::now() >= deadline || mStopping)
+        {
+            break;
+        }
+
+        std::unique_lock<std::mutex> locker(mWaitMutex);
+        ++mWaitingConsumers;
+        if (mQueue.sizeApprox() == 0 && !mStopping)
+        {
+            mNotEmpty.wait_until(locker, deadline);
+        }
+        --mWaitingConsumers;
+    }
+}
+
+void InferencePool::runBatch(std::vector<JobPtr> &batch)
+{
+    auto dequeueTime = Clock::now();
+    bool tracing = TraceRecorder::isEnabled();
+
+    std::vector<InferenceResult> results(batch.size());
+    for (size_t i = 0; i < batch.size(); ++i)
+    {
+        results[i].queueMs = msBetween(batch[i]->enqueueTime, dequeueTime);
+        results[i].traceId = batch[i]->traceId;
+        if (tracing)
+        {
+            TraceRecorder::instance().recordAsync("queue", "pool", batch[i]->enqueueTime, dequeueTime,
+                                                  batch[i]->traceId);
+        }
+    }
+
+    // 先按图像内容查结果缓存，命中的任务直接完成，剩下的才借pipelines推理
+    ResultCache *cache = mConfig.resultCache.get();
+    std::vector<ResultCacheKey> keys;
+    std::vector<size_t> pending;
+    pending.reserve(batch.size());
+    if (cache && !cache->isBypassed())
+    {
+        TraceSpan span("cache lookup", "pool", batch.front()->traceId);
+        keys.resize(batch.size());
+        for (size_t i = 0; i < batch.size(); ++i)
+        {
+            auto lookupStart = Clock::now();
+            keys[i] = cache->keyOf(batch[i]->image);
+            if (cache->lookup(keys[i], results[i].output))
+            {
+                results[i].cached = true;
+                results[i].inferMs = msBetween(lookupStart, Clock::now());
+            }
+            else
+            {
+                pending.push_back(i);
+            }
+        }
+    }
+    else
+    {
+        for (size_t i = 0; i < batch.size(); ++i)
+        {
+            pending.push_back(i);
+        }
+    }
+
+    InferenceStatus status = InferenceStatus::Ok;
+    std::string error;
+    double inferMs = 0;
+    if (!pending.empty())
+    {
+        // 从池中借一个会话，作用域结束时自动归还
+        InferenceEngine::Lease lease = mEngine->checkout(mConfig.deviceIndex);
+
+        auto runStart = Clock::now();
+        if (tracing)
+        {
+            TraceRecorder::instance().record("checkout", "pool", dequeueTime, runStart);
+        }
+        try
+        {
+            if (pending.size() == 1)
+            {
+                lease->run(batch[pending[0]]->image, results[pending[0]].output);
+            }
+            else
+            {
+                std::vector<cv::Mat> images;
+                images.reserve(pending.size());
+                for (size_t i : pending)
+                {
+                    images.push_back(std::move(batch[i]->image));
+                }
+                std::vector<InferenceOutput> outputs;
+                lease->runBatch(images, outputs);
+                for (size_t k = 0; k < pending.size() && k < outputs.size(); ++k)
+                {
+                    results[pending[k]].output = std::move(outputs[k]);
+                }
+            }
+        }
+        catch (const std::exception &e)
+        {
+            status = InferenceStatus::Failed;
+            error = e.what();
+        }
+        auto runEnd = Clock::now();
+        inferMs = msBetween(runStart, runEnd);
+        lease.release();
+        if (tracing)
+        {
+            TraceRecorder::instance().record(pending.size() == 1 ? "infer" : "infer batch", "pool", runStart, runEnd,
+                                             batch[pending.front()]->traceId);
+        }
+
+        mBusyNs += std::chrono::duration_cast<std::chrono::nanoseconds>(runEnd - runStart).count();
+        ++mBatches;
+
+        // 回调可能把结果移走，要在回调之前放进缓存
+        if (status == InferenceStatus::Ok && !keys.empty())
+        {
+            const IInferenceBackend &backend = *mEngine->backend();
+            for (size_t i : pending)
+            {
+                cache->store(keys[i], results[i].output, backend.outputBytes(results[i].output));
+            }
+        }
+    }
+
+    mCached += (long long)(batch.size() - pending.size());
+    mCompleted += (long long)batch.size();
+    for (size_t i : pending)
+    {
+        results[i].status = status;
+        results[i].error = error;
+        results[i].inferMs = inferMs;
+        results[i].batchSize = (int)pending.size();
+    }
+    for (size_t i = 0; i < batch.size(); ++i)
+    {
+        if (batch[i]->callback)
+        {
+            // 送图线程上的submit和这里的callback用箭头连起来
+            TraceSpan span("callback", "pool", batch[i]->traceId, TraceFlow::In);
+            batch[i]->callback(results[i]);
+        }
+    }
+}
+
+bool InferencePool::popJob(JobPtr &job)
+{
+    for (;;)
+    {
+        // 停止且不排空（或者排空超出了预算）时，队列中剩下的任务留给shutdown()以Cancelled结束
+        if (mStopping && !mDraining)
+        {
+            return false;
+        }
+
+        if (mQueue.tryPop(job))
+        {
+            notifyNotFull();
+            return true;
+        }
+
+        if (mStopping && !(mDraining && mQueue.sizeApprox() > 0))
+        {
+            return false;
+        }
+
+        // 队列空了，睡一会儿；先登记再复查，保证不会错过生产者的唤醒
+        std::unique_lock<std::mutex> locker(mWaitMutex);
+        ++mWaitingConsumers;
+        if (mQueue.sizeApprox() == 0 && !mStopping)
+        {
+            mNotEmpty.wait_for(locker, kWaitSlice);
+        }
+        --mWaitingConsumers;
+    }
+}
+
+void InferencePool::finish(Job &job, InferenceStatus status)
+{
+    if (status == InferenceStatus::Dropped)
+    {
+        ++mDropped;
+    }
+    else if (status == InferenceStatus::Rejected)
+    {
+        ++mRejected;
+    }
+
+    if (job.callback)
+    {
+        InferenceResult result;
+        result.status = status;
+        result.queueMs = msBetween(job.enqueueTime, Clock::now());
+        job.callback(result);
+    }
+}
+
+void InferencePool::notifyNotEmpty()
+{
+    if (mWaitingConsumers.load() > 0)
+    {
+        std::lock_guard<std::mutex> locker(mWaitMutex);
+        mNotEmpty.notify_one();
+    }
+}
+
+void InferencePool::notifyNotFull()
+{
+    if (mWaitingProducers.load() > 0)
+    {
+        std::lock_guard<std::mutex> locker(mWaitMutex);
+        mNotFull.notify_one();
+    }
+}
@@ -0,0 +1,184 @@
+﻿#ifndef INFERENCEPOOL_H
+#define INFERENCEPOOL_H
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "inferenceengine.h"
+#include "mpmcqueue.h"
+#include "resultcache.h"
+
+// 队列满时的处理策略
+enum class BackpressurePolicy
+{
+    Block,          // 生产者阻塞，直到队列有空位
+    DropOldest,     // 丢弃队列中最旧的任务，给新任务腾位置
+    Reject,         // 直接拒绝新任务
+};
+
+enum class InferenceStatus
+{
+    Ok,
+    Failed,         // 推理抛出了异常
+    Dropped,        // 被DropOldest策略挤掉
+    Rejected,       // 队列满被拒绝，或者线程池已经停止
+    Cancelled,      // 停止时没有排空，被放弃
+};
+
+struct InferenceResult
+{
+    InferenceStatus status = InferenceStatus::Ok;
+    InferenceOutput output;
+    double queueMs = 0;     // 在队列中等待的时间（含凑批的等待）
+    double inferMs = 0;     // 会话推理的耗时（批量推理时为整批的耗时）
+    int batchSize = 1;      // 和本任务一起推理的任务数
+    bool cached = false;    // 结果来自结果缓存，这时inferMs为算哈希和查表的耗时
+    long long traceId = -1; // 跟踪打开时这张图的编号，后续阶段用它关联到同一张图
+    std::string error;
+};
+
+// 一次shutdown()的耗时
+struct InferencePoolShutdownStats
+{
+    double totalMs = 0;             // 从调用shutdown()到返回
+    double drainMs = 0;             // 排空队列用的时间（不排空时为0）
+    double joinMs = 0;              // 等工作线程做完手上那一批并退出的时间
+    long long abandoned = 0;        // 没做、以Cancelled结束的任务数
+    bool overBudget = false;        // 排空没在预算内完成，剩下的任务被放弃
+};
+
+// 完成回调，在工作线程中调用（被丢弃/拒绝时可能在生产者线程中调用）
+using InferenceCallback = std::function<void(InferenceResult &result)>;
+
+struct InferencePoolConfig
+{
+    int workerCount = 1;                                    // 工作线程数
+    int queueCapacity = 16;                                 // 队列容量（向上取整为2的幂）
+    BackpressurePolicy policy = BackpressurePolicy::Block;
+
+    // 动态凑批：工作线程拿到第一个任务后，最多再等maxBatchWaitUs微秒，
+    // 把队列中的任务凑成不超过maxBatchSize的一批，一起交给一个pipelines
+    int maxBatchSize = 1;
+    int maxBatchWaitUs = 0;
+
+    // 设备放置：只借这个设备（引擎deviceIds中的下标）上的pipelines，-1表示不限
+    int deviceIndex = -1;
+    std::vector<int> workerCpus;    // 工作线程绑定的核，为空表示不绑
+
+    // 不为空时工作线程先按图像内容查结果缓存，命中的任务不再借pipelines；多个线程池可以共用一个
+    std::shared_ptr<ResultCache> resultCache;
+};
+
+// 生产者/消费者推理线程池：
+// 生产者把请求放进有界无锁队列，N个工作线程从队列中取任务，再从引擎借pipelines执行
+// 这样相机的进图节奏和推理的并行度就互不牵制
+// 开启凑批后，多路图像的请求会被合并成小批量推理，每个调用者仍然拿到自己的结果
+class InferencePool
+{
+public:
+    InferencePool(std::shared_ptr<InferenceEngine> engine, const InferencePoolConfig &config);
+    ~InferencePool();
+
+    InferencePool(const InferencePool &) = delete;
+    InferencePool &operator=(const InferencePool &) = delete;
+
+    // 加载引擎（如果还没加载）并启动工作线程
+    bool start(std::string *errorMessage = nullptr);
+
+    // 提交任务，完成后通过回调通知；被拒绝时回调会被立即调用，并返回false
+    // 可以和shutdown()并发调用：任务要么被拒绝，要么执行完或以Cancelled结束，回调总会被调用
+    bool submit(cv::Mat image, InferenceCallback callback);
+
+    // 提交任务，通过future获取结果
+    std::future<InferenceResult> submit(cv::Mat image);
+
+    // 停止接收新任务并等待工作线程退出
+    // drain为true时会先把队列中剩下的任务做完，否则剩下的任务以Cancelled结束
+    // drainBudget不为负时排空最多用这么久，超时后剩下的任务也以Cancelled结束；
+    // 正在推理的那一批没法打断，停止耗时的上限是 drainBudget + 一次推理的时间
+    InferencePoolShutdownStats shutdown(bool drain = true,
+                                        std::chrono::milliseconds drainBudget = std::chrono::milliseconds(-1));
+
+    // 不再接收新任务，阻塞在submit()中的生产者立即以Rejected返回；已经排队的任务照常执行
+    // 用于停止时先让送图线程退出，之后再调用shutdown()
+    void stopAccepting();
+
+    bool isRunning() const { return mRunning.load(); }
+
+    const std::shared_ptr<InferenceEngine> &engine() const { return mEngine; }
+
+    size_t queueDepth() const { return mQueue.sizeApprox(); }
+    size_t queueCapacity() const { return mQueue.capacity(); }
+
+    long long submittedCount() const { return mSubmitted.load(); }
+    long long completedCount() const { return mCompleted.load(); }
+    long long droppedCount() const { return mDropped.load(); }
+    long long rejectedCount() const { return mRejected.load(); }
+    long long batchCount() const { return mBatches.load(); }
+    long long cachedCount() const { return mCached.load(); }
+
+    // 所有工作线程推理耗时的总和，除以(时长*工作线程数)就是设备的利用率
+    double busyMs() const { return mBusyNs.load() / 1e6; }
+    int workerCount() const { return mConfig.workerCount; }
+    int deviceIndex() const { return mConfig.deviceIndex; }
+
+private:
+    struct Job
+    {
+        cv::Mat image;
+        InferenceCallback callback;
+        std::chrono::steady_clock::time_point enqueueTime;
+        long long traceId = -1;         // 跟踪打开时关联送图线程和工作线程上的span
+    };
+
+    using JobPtr = std::unique_ptr<Job>;
+
+    void workerLoop();
+    bool pushJob(JobPtr job);
+    bool popJob(JobPtr &job);
+    void collectBatch(std::vector<JobPtr> &batch);
+    void runBatch(std::vector<JobPtr> &batch);
+    void finish(Job &job, InferenceStatus status);
+    void notifyNotEmpty();
+    void notifyNotFull();
+
+    std::shared_ptr<InferenceEngine> mEngine;
+    InferencePoolConfig mConfig;
+
+    MpmcQueue<JobPtr> mQueue;
+
+    // 队列本身是无锁的，这里的锁和条件变量只用于空/满时让线程睡眠
+    std::mutex mWaitMutex;
+    std::condition_variable mNotEmpty;
+    std::condition_variable mNotFull;
+    std::atomic<int> mWaitingConsumers{0};
+    std::atomic<int> mWaitingProducers{0};
+
+    std::atomic<bool> mRunning{false};
+    std::atomic<bool> mAccepting{false};
+    std::atomic<int> mSubmitting{0};                // 正在submit()中的生产者数，shutdown()等它们返回后才最后清空队列
+    std::atomic<bool> mStopping{false};
+    std::atomic<bool> mDraining{false};
+    std::condition_variable mWorkersExited;         // 和mWaitMutex一起使用
+    int mActiveWorkers = 0;                         // 由mWaitMutex保护
+    std::mutex mLifecycleMutex;
+    std::vector<std::thread> mWorkers;
+
+    std::atomic<long long> mSubmitted{0};
+    std::atomic<long long> mCompleted{0};
+    std::atomic<long long> mDropped{0};
+    std::atomic<long long> mRejected{0};
+    std::atomic<long long> mBatches{0};
+    std::atomic<long long> mCached{0};
+    std::atomic<long long> mBusyNs{0};
+};
+
+#endif // INFERENCEPOOL_H
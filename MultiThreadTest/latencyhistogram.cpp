@@ -0,0 +1,226 @@
+﻿#include "latencyhistogram.h"
+
+#include <algorithm>
+#include <cmath>
+#include <iomanip>
+#include <limits>
+
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
+
+static int highestBit(uint64_t value)
+{
+#if defined(_MSC_VER)
+    unsigned long index;
+    _BitScanReverse64(&index, value);
+    return (int)index;
+#else
+    return 63 - __builtin_clzll(value);
+#endif
+}
+
+namespace latency {
+
+int bucketIndex(uint64_t valueNs)
+{
+    if (valueNs < (uint64_t)kSubBucketCount)
+    {
+        return (int)valueNs;
+    }
+
+    // shift段内，取最高位下面的kSubBucketBits位作为小桶下标
+    int shift = highestBit(valueNs) - kSubBucketBits;
+    if (shift > kMaxValueBits - kSubBucketBits)
+    {
+        return kBucketCount - 1;
+    }
+    return (shift + 1) * kSubBucketCount + (int)((valueNs >> shift) - kSubBucketCount);
+}
+
+uint64_t bucketLowerBound(int index)
+{
+    if (index < kSubBucketCount)
+    {
+        return (uint64_t)index;
+    }
+    int shift = index / kSubBucketCount - 1;
+    uint64_t sub = (uint64_t)(index % kSubBucketCount) + kSubBucketCount;
+    return sub << shift;
+}
+
+uint64_t bucketUpperBound(int index)
+{
+    if (index < kSubBucketCount)
+    {
+        return (uint64_t)index;
+    }
+    int shift = index / kSubBucketCount - 1;
+    return bucketLowerBound(index) + ((uint64_t(1) << shift) - 1);
+}
+
+} // namespace latency
+
+double LatencySnapshot::percentileMs(double p) const
+{
+    if (count == 0 || counts.empty())
+    {
+        return 0;
+    }
+
+    p = std::min(100.0, std::max(0.0, p));
+    uint64_t target = std::max<uint64_t>(1, (uint64_t)std::ceil(p / 100.0 * count));
+    uint64_t seen = 0;
+    for (int i = 0; i < (int)counts.size(); ++i)
+    {
+        seen += counts[i];
+        if (seen >= target)
+        {
+            return std::min(latency::bucketUpperBound(i), maxNs) / 1e6;
+        }
+    }
+    return maxNs / 1e6;
+}
+
+double LatencySnapshot::meanMs() const
+{
+    return count > 0 ? sumNs / count / 1e6 : 0;
+}
+
+double LatencySnapshot::throughput() const
+{
+    return elapsedSec > 0 ? count / elapsedSec : 0;
+}
+
+void LatencySnapshot::merge(const LatencySnapshot &other)
+{
+    if (other.count == 0)
+    {
+        elapsedSec = std::max(elapsedSec, other.elapsedSec);
+        return;
+    }
+
+    if (counts.empty())
+    {
+        counts.assign(latency::kBucketCount, 0);
+    }
+    for (int i = 0; i < (int)other.counts.size(); ++i)
+    {
+        counts[i] += other.counts[i];
+    }
+
+    minNs = count > 0 ? std::min(minNs, other.minNs) : other.minNs;
+    maxNs = std::max(maxNs, other.maxNs);
+    count += other.count;
+    sumNs += other.sumNs;
+    elapsedSec = std::max(elapsedSec, other.elapsedSec);
+}
+
+void LatencySnapshot::writePercentileDistribution(std::ostream &out, const char *title) const
+{
+    if (title)
+    {
+        out << "# " << title << "\n";
+    }
+    out << std::setw(12) << "Value" << " " << std::setw(14) << "Percentile" << " "
+        << std::setw(10) << "TotalCount" << " " << std::setw(14) << "1/(1-Percentile)" << "\n\n";
+
+    out << std::fixed;
+    uint64_t seen = 0;
+    for (int i = 0; i < (int)counts.size() && seen < count; ++i)
+    {
+        if (counts[i] == 0)
+        {
+            continue;
+        }
+        seen += counts[i];
+        double percentile = (double)seen / count;
+        double valueMs = std::min(latency::bucketUpperBound(i), maxNs) / 1e6;
+        out << std::setw(12) << std::setprecision(3) << valueMs << " "
+            << std::setw(14) << std::setprecision(12) << percentile << " "
+            << std::setw(10) << seen << " ";
+        if (seen < count)
+        {
+            out << std::setw(14) << std::setprecision(2) << 1.0 / (1.0 - percentile);
+        }
+        out << "\n";
+    }
+
+    out << std::setprecision(3)
+        << "#[Mean    = " << std::setw(12) << meanMs() << ", Max        = " << std::setw(12) << maxMs() << "]\n"
+        << "#[Total count    = " << std::setw(12) << count << ", Throughput = " << std::setw(12) << throughput() << "/s]\n";
+    out.unsetf(std::ios::floatfield);
+}
+
+LatencyHistogram::LatencyHistogram()
+{
+    reset();
+}
+
+void LatencyHistogram::record(uint64_t valueNs)
+{
+    mCounts[latency::bucketIndex(valueNs)].fetch_add(1, std::memory_order_relaxed);
+    mSumNs.fetch_add(valueNs, std::memory_order_relaxed);
+
+    // 最小/最大值只在变化时才需要CAS，稳态下只是一次读
+    uint64_t current = mMinNs.load(std::memory_order_relaxed);
+    while (valueNs < current && !mMinNs.compare_exchange_weak(current, valueNs, std::memory_order_relaxed))
+    {
+    }
+    current = mMaxNs.load(std::memory_order_relaxed);
+    while (valueNs > current && !mMaxNs.compare_exchange_weak(current, valueNs, std::memory_order_relaxed))
+    {
+    }
+
+    // 计数最后加，快照按计数读取时各个桶基本已经更新
+    mCount.fetch_add(1, std::memory_order_release);
+}
+
+void LatencyHistogram::recordMs(double valueMs)
+{
+    record(valueMs > 0 ? (uint64_t)(valueMs * 1e6 + 0.5) : 0);
+}
+
+void LatencyHistogram::record(Clock::duration value)
+{
+    auto ns = std::chrono::duration_cast<std::chrono::nanoseconds>(value).count();
+    record(ns > 0 ? (uint64_t)ns : 0);
+}
+
+LatencySnapshot LatencyHistogram::snapshot() const
+{
+    LatencySnapshot snapshot;
+    snapshot.elapsedSec = std::chrono::duration<double>(
+        Clock::now().time_since_epoch() - Clock::duration(mStartTicks.load())).count();
+
+    uint64_t count = mCount.load(std::memory_order_acquire);
+    if (count == 0)
+    {
+        return snapshot;
+    }
+
+    // 和record()并发时各项之间可能差几次记录，按桶的合计为准
+    snapshot.counts.resize(latency::kBucketCount);
+    for (int i = 0; i < latency::kBucketCount; ++i)
+    {
+        snapshot.counts[i] = mCounts[i].load(std::memory_order_relaxed);
+        snapshot.count += snapshot.counts[i];
+    }
+    snapshot.minNs = mMinNs.load(std::memory_order_relaxed);
+    snapshot.maxNs = mMaxNs.load(std::memory_order_relaxed);
+    snapshot.sumNs = (double)mSumNs.load(std::memory_order_relaxed);
+    return snapshot;
+}
+
+void LatencyHistogram::reset()
+{
+    for (auto &count : mCounts)
+    {
+        count.store(0, std::memory_order_relaxed);
+    }
+    mCount.store(0, std::memory_order_relaxed);
+    mMinNs.store(std::numeric_limits<uint64_t>::max(), std::memory_order_relaxed);
+    mMaxNs.store(0, std::memory_order_relaxed);
+    mSumNs.store(0, std::memory_order_relaxed);
+    mStartTicks.store(Clock::now().time_since_epoch().count(), std::memory_order_release);
+}
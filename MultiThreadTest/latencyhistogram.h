@@ -0,0 +1,79 @@
+﻿#ifndef LATENCYHISTOGRAM_H
+#define LATENCYHISTOGRAM_H
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <ostream>
+#include <vector>
+
+// 对数分桶的延迟直方图（HdrHistogram的思路）：
+// 按2的幂分段，每段再均分成kSubBucketCount个小桶，相对误差不超过1/kSubBucketCount（<0.8%）
+// 以纳秒为单位记录，覆盖1ns到约36分钟，超出的值记在最后一个桶里
+namespace latency {
+const int kSubBucketBits = 7;
+const int kSubBucketCount = 1 << kSubBucketBits;
+const int kMaxValueBits = 40;
+const int kBucketCount = (kMaxValueBits - kSubBucketBits + 2) * kSubBucketCount;
+
+int bucketIndex(uint64_t valueNs);
+uint64_t bucketLowerBound(int index);
+uint64_t bucketUpperBound(int index);   // 该桶中可能的最大值
+} // namespace latency
+
+// 直方图在某一时刻的快照，普通的值类型，可以合并、求分位数、导出
+struct LatencySnapshot
+{
+    std::vector<uint64_t> counts;   // 每个桶的计数，为空表示没有数据
+    uint64_t count = 0;
+    uint64_t minNs = 0;
+    uint64_t maxNs = 0;
+    double sumNs = 0;
+    double elapsedSec = 0;          // 从开始记录到取快照经过的时间
+
+    // p取0~100；返回该分位对应桶的上界（不超过最大值），单位ms
+    double percentileMs(double p) const;
+    double meanMs() const;
+    double maxMs() const { return maxNs / 1e6; }
+    double throughput() const;      // 每秒记录的次数
+
+    // 合并另一个快照，时间取两者中较长的
+    void merge(const LatencySnapshot &other);
+
+    // 导出为HdrHistogram的百分位分布格式（.hgrm），可以直接用HdrHistogram的绘图工具画图
+    void writePercentileDistribution(std::ostream &out, const char *title = nullptr) const;
+};
+
+// 记录端：
+// record()只有几次relaxed原子加，不加锁、不分配内存，多个线程同时记录也是安全的；
+// 一般每个线程/每一路各用一个直方图，需要时再取快照合并
+class LatencyHistogram
+{
+public:
+    using Clock = std::chrono::steady_clock;
+
+    LatencyHistogram();
+
+    LatencyHistogram(const LatencyHistogram &) = delete;
+    LatencyHistogram &operator=(const LatencyHistogram &) = delete;
+
+    void record(uint64_t valueNs);
+    void recordMs(double valueMs);
+    void record(Clock::duration value);
+
+    LatencySnapshot snapshot() const;
+
+    // 清空计数并重新计时；和record()并发时，正在记录的值可能计入新旧任意一边
+    void reset();
+
+private:
+    std::array<std::atomic<uint64_t>, latency::kBucketCount> mCounts;
+    std::atomic<uint64_t> mCount;
+    std::atomic<uint64_t> mMinNs;
+    std::atomic<uint64_t> mMaxNs;
+    std::atomic<uint64_t> mSumNs;
+    std::atomic<Clock::rep> mStartTicks;
+};
+
+#endif // LATENCYHISTOGRAM_H
@@ -0,0 +1,286 @@
+﻿#include "loadgenerator.h"
+
+#include <algorithm>
+#include <cstdlib>
+#include <fstream>
+#include <sstream>
+#include <thread>
+
+namespace {
+
+bool parseDouble(const std::string &text, double &value)
+{
+    char *end = nullptr;
+    value = std::strtod(text.c_str(), &end);
+    return !text.empty() && end && *end == '\0';
+}
+
+std::string trim(const std::string &text)
+{
+    size_t first = text.find_first_not_of(" \t\r");
+    if (first == std::string::npos)
+    {
+        return std::string();
+    }
+    size_t last = text.find_last_not_of(" \t\r");
+    return text.substr(first, last - first + 1);
+}
+
+} // namespace
+
+const std::vector<double> &ArrivalTrace::timesFor(int stream) const
+{
+    auto it = streamMs.find(stream);
+    return it != streamMs.end() ? it->second : sharedMs;
+}
+
+bool loadArrivalTrace(const std::string &path, double unitMs, ArrivalTrace &trace, std::string *errorMessage)
+{
+    auto fail = [&](const std::string &message) {
+        if (errorMessage)
+        {
+            *errorMessage = message;
+        }
+        return false;
+    };
+
+    std::ifstream file(path);
+    if (!file)
+    {
+        return fail("无法打开到达时刻文件: " + path);
+    }
+
+    // 先按原始时间戳读进来，最后统一减去最早的一个
+    std::vector<std::pair<int, double>> rows;
+    std::string line;
+    int lineNumber = 0;
+    while (std::getline(file, line))
+    {
+        ++lineNumber;
+        line = trim(line);
+        if (line.empty() || line[0] == '#')
+        {
+            continue;
+        }
+        std::replace(line.begin(), line.end(), '\t', ',');
+        std::string first = trim(line.substr(0, line.find(',')));
+        std::string second = line.find(',') != std::string::npos ? trim(line.substr(line.find(',') + 1)) : std::string();
+
+        double time = 0;
+        if (!parseDouble(first, time))
+        {
+            // 允许有一行表头
+            if (rows.empty())
+            {
+                continue;
+            }
+            return fail(path + ":" + std::to_string(lineNumber) + " 无效的时间戳: " + first);
+        }
+        double stream = -1;
+        if (!second.empty() && !parseDouble(second.substr(0, second.find(',')), stream))
+        {
+            return fail(path + ":" + std::to_string(lineNumber) + " 无效的路号: " + second);
+        }
+        rows.emplace_back((int)stream, time * unitMs);
+    }
+    if (rows.empty())
+    {
+        return fail("到达时刻文件中没有记录: " + path);
+    }
+
+    double origin = rows.front().second;
+    for (const auto &row : rows)
+    {
+        origin = std::min(origin, row.second);
+    }
+    trace = ArrivalTrace();
+    for (const auto &row : rows)
+    {
+        std::vector<double> &times = row.first >= 0 ? trace.streamMs[row.first] : trace.sharedMs;
+        times.push_back(row.second - origin);
+    }
+    std::sort(trace.sharedMs.begin(), trace.sharedMs.end());
+    for (auto &stream : trace.streamMs)
+    {
+        std::sort(stream.second.begin(), stream.second.end());
+    }
+    return true;
+}
+
+const char *arrivalSpecHelp()
+{
+    return "mode=fixed|poisson|replay, rate=<每路每秒张数>, seed=<种子>, "
+           "replay=<到达时刻文件>, unit=s|ms|us, speed=<回放倍速>, loop=0|1, "
+           "late_ms=<算迟到的延迟>, max_lag_ms=<落后超过就丢帧>";
+}
+
+bool parseArrivalSpec(const std::string &spec, ArrivalConfig &config, std::string *errorMessage)
+{
+    auto fail = [&](const std::string &message) {
+        if (errorMessage)
+        {
+            *errorMessage = message;
+        }
+        return false;
+    };
+
+    // 回放文件最后读，单位可能写在文件名后面
+    std::string replayPath;
+    double unitMs = 1;
+
+    std::stringstream stream(spec);
+    std::string item;
+    while (std::getline(stream, item, ','))
+    {
+        if (item.empty())
+        {
+            continue;
+        }
+        size_t eq = item.find('=');
+        if (eq == std::string::npos)
+        {
+            return fail("缺少'=': " + item);
+        }
+        std::string key = item.substr(0, eq);
+        std::string text = item.substr(eq + 1);
+
+        if (key == "mode")
+        {
+            if (text == "fixed") config.mode = ArrivalMode::Fixed;
+            else if (text == "poisson") config.mode = ArrivalMode::Poisson;
+            else if (text == "replay") config.mode = ArrivalMode::Replay;
+            else return fail("未知的到达方式: " + text);
+            continue;
+        }
+        if (key == "replay")
+        {
+            replayPath = text;
+            config.mode = ArrivalMode::Replay;
+            continue;
+        }
+        if (key == "unit")
+        {
+            if (text == "s") unitMs = 1000;
+            else if (text == "ms") unitMs = 1;
+            else if (text == "us") unitMs = 0.001;
+            else return fail("未知的时间单位: " + text);
+            continue;
+        }
+
+        double value = 0;
+        if (!parseDouble(text, value))
+        {
+            return fail("无效的数值: " + item);
+        }
+        if (key == "rate") config.ratePerSec = value;
+        else if (key == "seed") config.seed = (unsigned long long)value;
+        else if (key == "speed") config.replaySpeed = value;
+        else if (key == "loop") config.replayLoop = value != 0;
+        else if (key == "late_ms") config.lateMs = value;
+        else if (key == "max_lag_ms") config.maxLagMs = value;
+        else return fail("未知的参数: " + key);
+    }
+
+    if (config.ratePerSec <= 0)
+    {
+        return fail("到达率必须大于0");
+    }
+    if (config.replaySpeed <= 0)
+    {
+        return fail("回放倍速必须大于0");
+    }
+    if (config.mode == ArrivalMode::Replay)
+    {
+        if (replayPath.empty() && !config.trace)
+        {
+            return fail("回放模式需要replay=<到达时刻文件>");
+        }
+        if (!replayPath.empty())
+        {
+            std::shared_ptr<ArrivalTrace> trace = std::make_shared<ArrivalTrace>();
+            if (!loadArrivalTrace(replayPath, unitMs, *trace, errorMessage))
+            {
+                return false;
+            }
+            config.trace = trace;
+        }
+    }
+    return true;
+}
+
+ArrivalSchedule::ArrivalSchedule(const ArrivalConfig &config, int stream, int streamCount, Clock::time_point start)
+    : mConfig(config)
+    , mStart(start)
+    , mRandom(config.seed + (unsigned long long)stream)
+    , mGap(std::max(config.ratePerSec, 1e-9) / 1000.0)
+{
+    mIntervalMs = 1000.0 / std::max(mConfig.ratePerSec, 1e-9);
+    if (mConfig.mode == ArrivalMode::Fixed)
+    {
+        mPhaseMs = mIntervalMs * stream / std::max(1, streamCount);
+    }
+    else if (mConfig.mode == ArrivalMode::Replay)
+    {
+        static const std::vector<double> kEmpty;
+        mTimes = mConfig.trace ? &mConfig.trace->timesFor(stream) : &kEmpty;
+        if (mTimes->size() > 1)
+        {
+            mIntervalMs = (mTimes->back() - mTimes->front()) / (mTimes->size() - 1);
+        }
+    }
+    mLateMs = mConfig.lateMs >= 0 ? mConfig.lateMs : mIntervalMs / 2;
+}
+
+bool ArrivalSchedule::next(Clock::time_point &arrival)
+{
+    double offsetMs = 0;
+    switch (mConfig.mode) {
+    case ArrivalMode::Fixed:
+        offsetMs = mPhaseMs + mIntervalMs * mIndex;
+        break;
+    case ArrivalMode::Poisson:
+        mOffsetMs += mGap(mRandom);
+        offsetMs = mOffsetMs;
+        break;
+    case ArrivalMode::Replay:
+    {
+        if (mTimes->empty())
+        {
+            return false;
+        }
+        size_t position = (size_t)(mIndex % (long long)mTimes->size());
+        if (mIndex > 0 && position == 0)
+        {
+            if (!mConfig.replayLoop)
+            {
+                return false;
+            }
+            // 下一轮接在上一轮最后一帧之后，间隔取平均间隔
+            mLoopOffsetMs += mTimes->back() + mIntervalMs;
+        }
+        offsetMs = (mLoopOffsetMs + (*mTimes)[position]) / mConfig.replaySpeed;
+        break;
+    }
+    }
+    ++mIndex;
+    arrival = mStart + std::chrono::duration_cast<Clock::duration>(std::chrono::duration<double, std::milli>(offsetMs));
+    return true;
+}
+
+bool ArrivalSchedule::waitUntil(Clock::time_point arrival, const CancellationToken &cancel) const
+{
+    auto wakeUp = arrival - std::chrono::microseconds(mConfig.spinMarginUs);
+    if (Clock::now() < wakeUp && cancel.waitUntil(wakeUp))
+    {
+        return false;
+    }
+    while (Clock::now() < arrival)
+    {
+        if (cancel.isCancelled())
+        {
+            return false;
+        }
+        std::this_thread::yield();
+    }
+    return !cancel.isCancelled();
+}
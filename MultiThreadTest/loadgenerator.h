@@ -0,0 +1,95 @@
+﻿#ifndef LOADGENERATOR_H
+#define LOADGENERATOR_H
+
+#include <chrono>
+#include <map>
+#include <memory>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "cancellation.h"
+
+// 开环送图：帧按预定的到达时刻送出，不管上一张推理完没有（相机不会因为推理慢了就晚一点拍）
+// 耗时从预定到达时刻算起，送图线程被阻塞、晚发出的时间也算进去，不会漏掉排队延迟（coordinated omission）
+enum class ArrivalMode
+{
+    Fixed,          // 固定间隔
+    Poisson,        // 泊松到达：间隔服从指数分布，平均到达率不变，但会成批地来
+    Replay,         // 按文件中记录的时刻回放（例如产线PLC的触发日志）
+};
+
+// 回放用的到达时刻表
+// 文件每行一个时间戳，可以有第二列指定是哪一路；'#'开头的行和空行忽略
+// 没有指定路的行所有路共用；时间都换算成相对整个文件第一行的毫秒数
+struct ArrivalTrace
+{
+    std::vector<double> sharedMs;
+    std::map<int, std::vector<double>> streamMs;
+
+    // 这一路要回放的时刻，递增
+    const std::vector<double> &timesFor(int stream) const;
+};
+
+// unitMs是文件中时间戳的单位换算成毫秒的倍数：秒为1000，毫秒为1，微秒为0.001
+bool loadArrivalTrace(const std::string &path, double unitMs, ArrivalTrace &trace,
+                      std::string *errorMessage = nullptr);
+
+struct ArrivalConfig
+{
+    ArrivalMode mode = ArrivalMode::Fixed;
+    double ratePerSec = 10;         // 每一路的平均到达率（Fixed、Poisson），600pcs/min即10
+    unsigned long long seed = 1;    // Poisson的随机种子，每一路在此基础上加路号
+
+    std::shared_ptr<const ArrivalTrace> trace;  // Replay
+    double replaySpeed = 1;         // 回放速度的倍数，2表示间隔减半
+    bool replayLoop = true;         // 回放完从头再来，时间接着往后排；否则这一路结束
+
+    // 发出时刻比预定到达时刻晚lateMs以上的帧记为迟到；小于0时取平均间隔的一半
+    double lateMs = -1;
+    // 大于0时，落后预定到达时刻超过maxLagMs的帧直接丢弃并计数（相机缓冲区满了丢帧）；0为从不丢弃
+    double maxLagMs = 0;
+
+    // 和TaktScheduler一样，先睡到到达时刻前spinMarginUs，剩下的时间让出CPU忙等
+    int spinMarginUs = 500;
+};
+
+// 把"mode=poisson,rate=10"、"replay=trigger.csv,unit=s,speed=2"这样的描述解析到config中，
+// 没有出现的键保持原值；键名见arrivalSpecHelp()
+bool parseArrivalSpec(const std::string &spec, ArrivalConfig &config, std::string *errorMessage = nullptr);
+const char *arrivalSpecHelp();
+
+// 一路的到达时刻序列，只在这一路的送图线程中使用
+// 到达时刻只由起点和序号（或者累计的随机间隔）算出，送晚了也不会把后面的时刻往后推
+class ArrivalSchedule
+{
+public:
+    using Clock = std::chrono::steady_clock;
+
+    // 固定间隔时各路的相位在一个间隔内均匀错开
+    ArrivalSchedule(const ArrivalConfig &config, int stream, int streamCount, Clock::time_point start);
+
+    // 下一帧的预定到达时刻；回放完并且不循环时返回false
+    bool next(Clock::time_point &arrival);
+
+    // 等到arrival；已经取消时立即返回false
+    bool waitUntil(Clock::time_point arrival, const CancellationToken &cancel) const;
+
+    // 判定迟到的阈值
+    double lateMs() const { return mLateMs; }
+
+private:
+    ArrivalConfig mConfig;
+    Clock::time_point mStart;
+    double mIntervalMs = 0;         // 平均间隔
+    double mPhaseMs = 0;
+    double mLateMs = 0;
+    long long mIndex = 0;
+    double mOffsetMs = 0;           // Poisson：累计的间隔
+    double mLoopOffsetMs = 0;       // Replay：之前各轮回放占用的时间
+    const std::vector<double> *mTimes = nullptr;
+    std::mt19937_64 mRandom;
+    std::exponential_distribution<double> mGap;
+};
+
+#endif // LOADGENERATOR_H
@@ -1,18 +1,23 @@
 ﻿#include "mainwindow.h"
 #include "ui_mainwindow.h"
-#include "sparklinedelegate.h"
+#include "imageio.h"
+#include "sweepdialog.h"
+#include "syntheticbackend.h"
+#include "tracing.h"
 
 #include <QDebug>
 #include <QtConcurrentRun>
 #include <QElapsedTimer>
-#include <QDeadlineTimer>
 #include <QFileDialog>
 #include <QDir>
+#include <QMessageBox>
+#include <QSaveFile>
 
-#include "vimo_inference/vimo_inference.h"
-using namespace smartmore;
+#include <iostream>
+#include <sstream>
 
-void loadModelAndInfer(QString modelPath);
+#include "vimoapi.h"
+using namespace smartmore;
 
 MainWindow::MainWindow(QWidget *parent)
     : QMainWindow(parent)
@@ -22,36 +27,90 @@ MainWindow::MainWindow(QWidget *parent)
     setWindowTitle("多线程推理耗时测试");
 
     mThreadIndex = 0;
-    mQuitThread = false;
+    TraceRecorder::setThreadName("gui");
 
     ui->lineEdit_modelPath->setText("C:/Users/Administrator/Desktop/vimoModel/vcloud/多线程测试/HRZ-好日子-13-model-16-17-19");
     ui->lineEdit_imagePath->setText("./images");  // 图片文件夹路径
 
     // 初始化tableWidget
-    ui->tableWidget->setColumnCount(3);
-    ui->tableWidget->setHorizontalHeaderLabels(QStringList() << "线程索引" << "当前耗时(ms)" << "历史趋势");
+    ui->tableWidget->setColumnCount(ColumnCount);
+    ui->tableWidget->setHorizontalHeaderLabels(QStringList() << "线程索引" << "当前耗时(ms)"
+                                               << "P50(ms)" << "P99(ms)" << "最大(ms)" << "吞吐量(pcs/s)"
+                                               << "历史趋势");
     // ui->tableWidget->horizontalHeader()->setStretchLastSection(true);
     ui->tableWidget->setEditTriggers(QAbstractItemView::NoEditTriggers);  // 禁止编辑
     
     // 设置历史趋势列的自定义委托（绘制曲线）
-    ui->tableWidget->setItemDelegateForColumn(2, new SparklineDelegate(this));
-    ui->tableWidget->setColumnWidth(2, 180);  // 设置曲线列宽度
+    ui->tableWidget->setItemDelegateForColumn(ColumnHistory, new SparklineDelegate(this));
+    ui->tableWidget->setColumnWidth(ColumnHistory, 180);  // 设置曲线列宽度
 
-    // 连接信号槽（使用Qt::QueuedConnection确保跨线程安全更新UI）
-    connect(this, &MainWindow::inferCompleted, this, &MainWindow::onInferCompleted, Qt::QueuedConnection);
+    mResultCache = std::make_shared<ResultCache>();
+    mResultCache->setBypass(!ui->checkBox_resultCache->isChecked());
+
+    // 工作线程不再逐次发信号，界面以30Hz的频率自己去取新数据
+    mRefreshTimer = new QTimer(this);
+    mRefreshTimer->setInterval(kRefreshIntervalMs);
+    connect(mRefreshTimer, &QTimer::timeout, this, &MainWindow::refreshTable);
 
     on_pushButton_stop_clicked();
 }
 
 MainWindow::~MainWindow()
 {
+    // 关闭窗口时等后台的停止做完；排队中的finishStop()随窗口一起作废，线程对象在这里释放
     on_pushButton_stop_clicked();
+    if(mStopWorker.joinable())
+    {
+        mStopWorker.join();
+    }
+    qDeleteAll(mThreadList);
+    mThreadList.clear();
     delete ui;
 }
 
 void MainWindow::on_pushButton_start_clicked()
 {
-    mQuitThread = false;
+    // 推理后端，为空时使用思谋SDK
+    std::shared_ptr<IInferenceBackend> backend;
+    if(ui->comboBox_backend->currentIndex() == 1)
+    {
+        SyntheticBackendConfig synthetic;
+        std::string error;
+        if(!parseSyntheticBackendSpec(ui->lineEdit_syntheticSpec->text().toStdString(), synthetic, &error))
+        {
+            QMessageBox::warning(this, tr("模拟后端"), tr("参数无效：%1\n可用参数：%2")
+                                 .arg(QString::fromStdString(error), QString::fromUtf8(syntheticBackendSpecHelp())));
+            return;
+        }
+        backend = std::make_shared<SyntheticBackend>(synthetic);
+    }
+
+    // 推理设备，多个设备时按设备分片
+    DeviceSpec devices;
+    {
+        std::string error;
+        if(!parseDeviceSpec(ui->lineEdit_devices->text().toStdString(), devices, &error))
+        {
+            QMessageBox::warning(this, tr("推理设备"), tr("设备无效：%1").arg(QString::fromStdString(error)));
+            return;
+        }
+    }
+
+    // 预处理，解码线程里转成模型的输入格式
+    PreprocessConfig preprocess;
+    {
+        std::string error;
+        if(!parsePreprocessSpec(ui->lineEdit_preprocessSpec->text().toStdString(), preprocess, &error))
+        {
+            QMessageBox::warning(this, tr("预处理"), tr("参数无效：%1\n可用参数：%2")
+                                 .arg(QString::fromStdString(error), QString::fromUtf8(preprocessSpecHelp())));
+            return;
+        }
+    }
+
+    bool pinThreads = ui->checkBox_pinNuma->isChecked();
+    std::vector<DevicePlacement> placements = planDevicePlacement(devices, pinThreads);
+
     mThreadIndex = 0;
     mThreadList.clear();
 
@@ -61,21 +120,177 @@ void MainWindow::on_pushButton_start_clicked()
     
     // 初始化历史数据存储
     mHistoryData.clear();
-    mHistoryData.resize(threadCount);
+    for(int i = 0; i < threadCount; i++)
+    {
+        mHistoryData.push_back(std::make_shared<SparklineHistory>(MAX_HISTORY_POINTS));
+    }
+
+    // 每次开始都重新统计，trace也只保留这一次运行的
+    TraceRecorder::instance().clear();
+    mLatency.clear();
+    for(int i = 0; i < threadCount; i++)
+    {
+        mLatency.push_back(std::make_shared<LatencyHistogram>());
+    }
     
     for(int i = 0; i < threadCount; i++)
     {
-        ui->tableWidget->setItem(i, 0, new QTableWidgetItem(QString::number(i)));
-        ui->tableWidget->setItem(i, 1, new QTableWidgetItem("--"));
-        ui->tableWidget->setItem(i, 2, new QTableWidgetItem());  // 曲线列
+        ui->tableWidget->setItem(i, ColumnIndex, new QTableWidgetItem(QString::number(i)));
+        for(int column = ColumnCurrent; column < ColumnHistory; column++)
+        {
+            ui->tableWidget->setItem(i, column, new QTableWidgetItem("--"));
+        }
+        // 曲线列，单元格一直指向这一路的历史，刷新时只改版本号
+        QTableWidgetItem *historyItem = new QTableWidgetItem();
+        historyItem->setData(Qt::UserRole, QVariant::fromValue(SparklineHistoryPtr(mHistoryData[i])));
+        ui->tableWidget->setItem(i, ColumnHistory, historyItem);
         ui->tableWidget->setRowHeight(i, 50);  // 设置行高以显示曲线
     }
 
+    mRun = std::make_shared<RunContext>();
+    mRun->imageFolderPath = ui->lineEdit_imagePath->text();
+    mRun->latency = mLatency;
+    for(int i = 0; i < threadCount; i++)
+    {
+        mRun->samples.push_back(std::make_shared<MpmcQueue<double>>(kSampleQueueCapacity));
+    }
+
+    // 所有线程共享一个引擎，由第一个拿到它的线程负责加载模型
+    InferenceEngineConfig config;
+    config.modelDir = ui->lineEdit_modelPath->text().toLocal8Bit().data();
+    config.pipelineCount = ui->spinBox_pipelines->value();
+    config.useGpu = devices.useGpu;
+    config.deviceId = placements.front().deviceId;
+    for(const DevicePlacement &placement : placements)
+    {
+        config.deviceIds.push_back(placement.deviceId);
+        qDebug() << (placement.useGpu ? "gpu" : "cpu") << placement.deviceId
+                 << "numa node:" << placement.numaNode
+                 << "cpus:" << (pinThreads ? formatCpuList(placement.cpus).c_str() : "(not pinned)");
+    }
+    config.backend = backend;
+
+    // 热启动：模型、pipelines数、设备和后端参数都没变，模型文件也没改动过，就继续用上次的pipelines
+    QString engineKey = QStringList{ui->lineEdit_modelPath->text(),
+                                    QString::number(config.pipelineCount),
+                                    ui->lineEdit_devices->text(),
+                                    QString::number(pinThreads),
+                                    QString::number(ui->comboBox_backend->currentIndex()),
+                                    ui->lineEdit_syntheticSpec->text()}.join('|');
+    if(mWarmEngine && (engineKey != mWarmEngineKey || !mWarmEngine->isModelCurrent()))
+    {
+        // 先释放旧的，避免两份模型同时占用显存；缓存的是旧模型的结果，一起清掉
+        mWarmEngine.reset();
+        mResultCache->clear();
+    }
+    if(!mWarmEngine)
+    {
+        mWarmEngine = std::make_shared<InferenceEngine>(config);
+        mWarmEngineKey = engineKey;
+    }
+    else
+    {
+        mRun->warmStart = true;
+    }
+    auto engine = mWarmEngine;
+
+    // 每个pipelines配一个工作线程，队列留出每路图像两张的余量（多个分片时每个分片各自一个队列）
+    InferencePoolConfig poolConfig;
+    poolConfig.workerCount = config.pipelineCount;
+    poolConfig.queueCapacity = threadCount * 2;
+    switch (ui->comboBox_backpressure->currentIndex()) {
+    case 1: poolConfig.policy = BackpressurePolicy::DropOldest; break;
+    case 2: poolConfig.policy = BackpressurePolicy::Reject; break;
+    default: poolConfig.policy = BackpressurePolicy::Block; break;
+    }
+    poolConfig.maxBatchSize = ui->spinBox_batchSize->value();
+    poolConfig.maxBatchWaitUs = ui->spinBox_batchWaitUs->value();
+    poolConfig.resultCache = mResultCache;
+    mRun->pool = std::make_shared<ShardedInferencePool>(engine, poolConfig, placements);
+    mRun->pinThreads = pinThreads;
+
+    // 后处理：推理线程只把结果放进队列，判定、写结果文件和画叠加图都在后处理线程中做
+    if(ui->checkBox_postProcess->isChecked())
+    {
+        PostProcessConfig postConfig;
+        postConfig.queueCapacity = qMax(256, threadCount * 16);
+        mRun->post = std::make_shared<PostProcessStage>(postConfig);
+
+        std::shared_ptr<IInferenceBackend> engineBackend = engine->backend();
+        QString resultPath = QDir::current().absoluteFilePath("results.csv");
+        mRun->postStatistics = std::make_shared<ResultStatisticsHandler>();
+        mRun->postWriter = std::make_shared<ResultWriterHandler>(
+            resultPath.toLocal8Bit().toStdString(),
+            [engineBackend](const InferenceOutput &output) { return engineBackend->describeOutput(output); });
+        if(!mRun->postWriter->isOpen())
+        {
+            qDebug() << "无法写入结果文件:" << resultPath;
+        }
+        mRun->post->addHandler(mRun->postStatistics);
+        mRun->post->addHandler(mRun->postWriter);
+        mRun->post->addHandler(std::make_shared<OverlayHandler>());
+        mRun->post->start();
+    }
+
+    // 结果日志：接着上次的文件写，长时间运行后用ResultLogTool离线统计
+    if(ui->checkBox_resultLog->isChecked())
+    {
+        ResultLogConfig logConfig;
+        logConfig.path = QDir::current().absoluteFilePath("logs/results").toLocal8Bit().toStdString();
+        mRun->resultLog = std::make_shared<ResultLogWriter>(logConfig);
+        std::string error;
+        if(!mRun->resultLog->open(&error))
+        {
+            qDebug() << "无法打开结果日志:" << QString::fromStdString(error);
+            mRun->resultLog.reset();
+        }
+    }
+
+    if(ui->checkBox_preload->isChecked())
+    {
+        // 预加载图像库，同样由第一个线程负责加载
+        FrameCorpusConfig corpusConfig;
+        corpusConfig.imageFolderPath = mRun->imageFolderPath;
+        corpusConfig.pageLocked = ui->checkBox_pageLocked->isChecked();
+        corpusConfig.preprocess = preprocess;
+        mRun->corpus = std::make_shared<FrameCorpus>(corpusConfig);
+    }
+    else
+    {
+        // 解码线程池，线程数取CPU核数的一半
+        DecodeStageConfig decodeConfig;
+        decodeConfig.threadCount = qMax(2, QThread::idealThreadCount() / 2);
+        decodeConfig.lookahead = ui->spinBox_lookahead->value();
+        decodeConfig.preprocess = preprocess;
+        mRun->decoder = std::make_shared<DecodeStage>(decodeConfig);
+    }
+
+    // 节拍调度器，时间原点从现在开始算，各路加载完模型后对齐到同一套节拍上
+    mRun->taktPeriod = std::chrono::milliseconds(ui->spinBox_taktMs->value());
+    if(ui->checkBox_staggerPhase->isChecked())
+    {
+        mRun->taktPhaseStep = mRun->taktPeriod / threadCount;
+    }
+    mRun->takt = std::make_shared<TaktScheduler>();
+    mRun->takt->start();
+
+    // 停止时唤醒所有在等节拍、在等队列空位的线程
+    {
+        std::shared_ptr<TaktScheduler> takt = mRun->takt;
+        std::shared_ptr<ShardedInferencePool> pool = mRun->pool;
+        mRun->cancel.token().onCancel([takt, pool]() {
+            takt->stop();
+            pool->stopAccepting();
+        });
+    }
+    mRun->startTime = std::chrono::steady_clock::now();
+
     // 启动若干个线程
     for(int i = 0; i < threadCount; i++)
     {
-        auto functor = [&](){
-            loadAndInfer(ui->lineEdit_modelPath->text(), ui->lineEdit_imagePath->text(), mThreadIndex++);
+        auto run = mRun;
+        auto functor = [=](){
+            loadAndInfer(run, mThreadIndex++);
         };
 
         switch (1) {
@@ -94,36 +309,209 @@ void MainWindow::on_pushButton_start_clicked()
         }
     }
 
-    ui->lineEdit_modelPath->setEnabled(false);
-    ui->pushButton_modelPath->setEnabled(false);
-    ui->lineEdit_imagePath->setEnabled(false);
-    ui->pushButton_imagePath->setEnabled(false);
-    ui->spinBox_threads->setEnabled(false);
-    ui->pushButton_start->setEnabled(false);
-    ui->pushButton_stop->setEnabled(true);
+    setRunning(true);
 }
 
 void MainWindow::on_pushButton_stop_clicked()
 {
-    mQuitThread = true;
-
-    ui->lineEdit_modelPath->setEnabled(true);
-    ui->pushButton_modelPath->setEnabled(true);
-    ui->lineEdit_imagePath->setEnabled(true);
-    ui->pushButton_imagePath->setEnabled(true);
-    ui->spinBox_threads->setEnabled(true);
-    ui->pushButton_start->setEnabled(true);
+    if(!mRun)
+    {
+        setRunning(false);
+        return;
+    }
+    if(mStopping)
+    {
+        return;
+    }
+
+    // 取消令牌立即唤醒所有在等节拍、等解码的送图线程，不用等它们下一次醒来检查标志
+    mStopping = true;
     ui->pushButton_stop->setEnabled(false);
+    mRun->cancel.cancel();
+
+    // 等送图线程退出、关闭线程池都放到后台线程中，界面不会卡住；做完之后回到界面线程收尾
+    auto run = mRun;
+    QList<QThread*> threads = mThreadList;
+    bool drain = ui->checkBox_drainOnStop->isChecked();
+    mStopWorker = std::thread([this, run, threads, drain]() {
+        // 停掉解码阶段，等解码的送图线程立即返回；要等正在解码的图做完，所以放在这里而不是界面线程中
+        if(run->decoder)
+        {
+            run->decoder->stop();
+        }
 
-    foreach (auto thread, mThreadList) {
-        if(thread->isRunning())
+        // 所有线程同时收到取消，逐个wait的总耗时就是最慢那一路的退出耗时
+        for(QThread *thread : threads)
         {
-            thread->wait(3000);
+            thread->wait();
         }
-        thread->deleteLater();
+        double joinMs = std::chrono::duration<double, std::milli>(
+                            std::chrono::steady_clock::now() - run->cancel.cancelTime()).count();
+
+        // 送图线程都退出之后，按策略把队列中剩下的图做完或者放弃，再关闭线程池
+        InferencePoolShutdownStats poolStats = run->pool->shutdown(drain, std::chrono::milliseconds(kStopDrainBudgetMs));
+        if(run->post)
+        {
+            run->post->shutdown(drain);
+        }
+        if(run->resultLog)
+        {
+            run->resultLog->close();
+        }
+        QMetaObject::invokeMethod(this, [this, joinMs, poolStats]() {
+            finishStop(joinMs, poolStats);
+        }, Qt::QueuedConnection);
+    });
+}
+
+void MainWindow::finishStop(double joinMs, const InferencePoolShutdownStats &poolStats)
+{
+    if(mStopWorker.joinable())
+    {
+        mStopWorker.join();
     }
+
+    // 线程都已经退出，可以安全释放
+    qDeleteAll(mThreadList);
     mThreadList.clear();
 
+    double stopMs = std::chrono::duration<double, std::milli>(
+                        std::chrono::steady_clock::now() - mRun->cancel.cancelTime()).count();
+    qDebug() << "stop(ms):" << stopMs
+             << "streams joined(ms):" << joinMs
+             << "pool drain(ms):" << poolStats.drainMs
+             << "pool join(ms):" << poolStats.joinMs
+             << "abandoned:" << poolStats.abandoned
+             << "over budget:" << poolStats.overBudget;
+
+    for(int i = 0; i < mRun->takt->streamCount(); i++)
+    {
+        TaktStreamStats stats = mRun->takt->stats(i);
+        qDebug() << "takt stream" << i
+                 << "released:" << stats.releasedCount
+                 << "overrun:" << stats.overrunCount
+                 << "lateness avg(ms):" << stats.avgLatenessMs
+                 << "max(ms):" << stats.maxLatenessMs;
+    }
+
+    if(mRun->decoder)
+    {
+        DecodeStageStats stats = mRun->decoder->stats();
+        qDebug() << "decoded:" << stats.decodedCount
+                 << "failed:" << stats.failedCount
+                 << "decode avg(ms):" << stats.avgDecodeMs
+                 << "max(ms):" << stats.maxDecodeMs
+                 << "preprocess avg(ms):" << stats.avgPreprocessMs
+                 << "(" << preprocessIsa() << ")"
+                 << "starved:" << stats.starvedCount
+                 << "starved(ms):" << stats.starvedMs;
+    }
+
+    refreshTable();
+    qDebug() << "submitted:" << mRun->pool->submittedCount()
+             << "completed:" << mRun->pool->completedCount()
+             << "dropped:" << mRun->pool->droppedCount()
+             << "rejected:" << mRun->pool->rejectedCount()
+             << "batches:" << mRun->pool->batchCount()
+             << "cached:" << mRun->pool->cachedCount();
+    if(!mResultCache->isBypassed() || mRun->pool->cachedCount() > 0)
+    {
+        ResultCacheStats stats = mResultCache->stats();
+        qDebug() << "result cache hits:" << stats.hits
+                 << "misses:" << stats.misses
+                 << "entries:" << stats.entries
+                 << "bytes:" << stats.bytes
+                 << "evictions:" << stats.evictions
+                 << "hash(ms):" << stats.hashMs;
+    }
+    if(mRun->post)
+    {
+        // 各个处理器的耗时分开给出
+        PostProcessStats stats = mRun->post->stats();
+        qDebug() << "post processed:" << stats.processed
+                 << "dropped:" << stats.dropped
+                 << "queue p99(ms):" << stats.queue.percentileMs(99)
+                 << "total p99(ms):" << stats.total.percentileMs(99)
+                 << "OK:" << mRun->postStatistics->passCount()
+                 << "NG:" << mRun->postStatistics->failCount()
+                 << "results:" << QString::fromStdString(mRun->postWriter->path());
+        for(const PostProcessHandlerStats &handler : stats.handlers)
+        {
+            qDebug() << "  post" << handler.name.c_str()
+                     << "p50(ms):" << handler.latency.percentileMs(50)
+                     << "p99(ms):" << handler.latency.percentileMs(99)
+                     << "max(ms):" << handler.latency.maxMs()
+                     << "failed:" << handler.failed;
+        }
+    }
+    if(mRun->resultLog)
+    {
+        ResultLogStats stats = mRun->resultLog->stats();
+        qDebug() << "result log written:" << stats.written
+                 << "dropped:" << stats.dropped
+                 << "bytes:" << stats.bytes
+                 << "file:" << QString::fromStdString(stats.currentFile);
+        if(!stats.error.empty())
+        {
+            qDebug() << "result log error:" << QString::fromStdString(stats.error);
+        }
+    }
+    qDebug() << "warm start:" << mRun->warmStart
+             << "time to first result(ms):" << (mRun->firstResultNs >= 0 ? mRun->firstResultNs / 1e6 : -1.0);
+    if(mRun->pool->shardCount() > 1 || mRun->pinThreads)
+    {
+        double elapsedSec = std::chrono::duration<double>(std::chrono::steady_clock::now() - mRun->startTime).count();
+        for(const DeviceUsage &usage : mRun->pool->deviceUsage(elapsedSec))
+        {
+            qDebug() << (usage.useGpu ? "gpu" : "cpu") << usage.deviceId
+                     << "numa node:" << usage.numaNode
+                     << "sessions:" << usage.sessions
+                     << "completed:" << usage.completed
+                     << "utilization:" << usage.utilization
+                     << "throughput:" << usage.throughput;
+        }
+    }
+
+    mRun.reset();
+    mStopping = false;
+    setRunning(false);
+}
+
+void MainWindow::setRunning(bool running)
+{
+    ui->lineEdit_modelPath->setEnabled(!running);
+    ui->pushButton_modelPath->setEnabled(!running);
+    ui->lineEdit_imagePath->setEnabled(!running);
+    ui->pushButton_imagePath->setEnabled(!running);
+    ui->spinBox_threads->setEnabled(!running);
+    ui->spinBox_pipelines->setEnabled(!running);
+    ui->comboBox_backpressure->setEnabled(!running);
+    ui->spinBox_lookahead->setEnabled(!running);
+    ui->checkBox_preload->setEnabled(!running);
+    ui->checkBox_pageLocked->setEnabled(!running);
+    ui->spinBox_batchSize->setEnabled(!running);
+    ui->spinBox_batchWaitUs->setEnabled(!running);
+    ui->spinBox_taktMs->setEnabled(!running);
+    ui->checkBox_staggerPhase->setEnabled(!running);
+    ui->comboBox_backend->setEnabled(!running);
+    ui->lineEdit_syntheticSpec->setEnabled(!running);
+    ui->lineEdit_preprocessSpec->setEnabled(!running);
+    ui->lineEdit_devices->setEnabled(!running);
+    ui->checkBox_pinNuma->setEnabled(!running);
+    ui->checkBox_drainOnStop->setEnabled(!running);
+    ui->checkBox_postProcess->setEnabled(!running);
+    ui->checkBox_resultLog->setEnabled(!running);
+    ui->pushButton_start->setEnabled(!running);
+    ui->pushButton_sweep->setEnabled(!running);
+    if(running)
+    {
+        mRefreshTimer->start();
+    }
+    else
+    {
+        mRefreshTimer->stop();
+    }
+    ui->pushButton_stop->setEnabled(running);
 }
 
 void MainWindow::on_pushButton_modelPath_clicked()
@@ -154,164 +542,427 @@ void MainWindow::on_pushButton_imagePath_clicked()
     ui->lineEdit_imagePath->setText(dir);
 }
 
-void MainWindow::onInferCompleted(int index, double elapsed)
+void MainWindow::on_pushButton_export_clicked()
 {
-    // 更新对应线程的推理耗时
-    if(index >= 0 && index < ui->tableWidget->rowCount())
+    if(mLatency.empty())
     {
-        // 更新当前耗时显示
-        QTableWidgetItem *item = ui->tableWidget->item(index, 1);
-        if(item)
-        {
-            item->setText(QString::number(elapsed, 'f', 2));
-        }
-        
-        // 更新历史数据
-        mHistoryData[index].append(elapsed);
-        // 限制历史数据点数
-        while(mHistoryData[index].size() > MAX_HISTORY_POINTS)
+        QMessageBox::information(this, tr("导出统计"), tr("还没有推理数据"));
+        return;
+    }
+
+    QString path = QFileDialog::getSaveFileName(this, tr("导出统计"), "latency.hgrm",
+                                                tr("HdrHistogram (*.hgrm);;文本文件 (*.txt)"));
+    if(path.isEmpty())
+    {
+        return;
+    }
+
+    // 先写合并后的总体分布，再写每一路的分布
+    std::ostringstream out;
+    LatencySnapshot total;
+    std::vector<LatencySnapshot> snapshots;
+    for(const auto &histogram : mLatency)
+    {
+        snapshots.push_back(histogram->snapshot());
+        total.merge(snapshots.back());
+    }
+    total.writePercentileDistribution(out, "all threads");
+    for(int i = 0; i < (int)snapshots.size(); i++)
+    {
+        out << "\n";
+        snapshots[i].writePercentileDistribution(out, ("thread " + std::to_string(i)).c_str());
+    }
+
+    QSaveFile file(path);
+    std::string text = out.str();
+    if(!file.open(QIODevice::WriteOnly | QIODevice::Text)
+        || file.write(text.data(), (qint64)text.size()) != (qint64)text.size()
+        || !file.commit())
+    {
+        QMessageBox::warning(this, tr("导出统计"), tr("写入文件失败：%1").arg(path));
+        return;
+    }
+
+    qDebug() << "exported latency:" << path
+             << "p50(ms):" << total.percentileMs(50)
+             << "p99(ms):" << total.percentileMs(99)
+             << "p99.9(ms):" << total.percentileMs(99.9)
+             << "max(ms):" << total.maxMs();
+}
+
+void MainWindow::on_pushButton_sweep_clicked()
+{
+    // 扫描时用的是同一个模型和图片，界面上的线程数作为扫描的上限
+    SweepSettings settings;
+    settings.modelDir = ui->lineEdit_modelPath->text();
+    settings.imageDir = ui->lineEdit_imagePath->text();
+    settings.maxThreads = ui->spinBox_threads->value();
+    settings.pipelines = ui->spinBox_pipelines->value();
+    settings.taktMs = ui->spinBox_taktMs->value();
+    settings.maxBatchSize = ui->spinBox_batchSize->value();
+    settings.maxBatchWaitUs = ui->spinBox_batchWaitUs->value();
+    settings.synthetic = ui->comboBox_backend->currentIndex() == 1;
+    std::string error;
+    if(settings.synthetic && !parseSyntheticBackendSpec(ui->lineEdit_syntheticSpec->text().toStdString(),
+                                                        settings.syntheticConfig, &error))
+    {
+        QMessageBox::warning(this, tr("模拟后端"), tr("参数无效：%1").arg(QString::fromStdString(error)));
+        return;
+    }
+    if(!parseDeviceSpec(ui->lineEdit_devices->text().toStdString(), settings.devices, &error))
+    {
+        QMessageBox::warning(this, tr("推理设备"), tr("设备无效：%1").arg(QString::fromStdString(error)));
+        return;
+    }
+    settings.pinThreads = ui->checkBox_pinNuma->isChecked();
+    if(!parsePreprocessSpec(ui->lineEdit_preprocessSpec->text().toStdString(), settings.preprocess, &error))
+    {
+        QMessageBox::warning(this, tr("预处理"), tr("参数无效：%1\n可用参数：%2")
+                             .arg(QString::fromStdString(error), QString::fromUtf8(preprocessSpecHelp())));
+        return;
+    }
+
+    SweepDialog dialog(settings, this);
+    dialog.exec();
+}
+
+void MainWindow::on_checkBox_trace_toggled(bool checked)
+{
+    // 运行中也可以切换，关闭时已经记录的span保留到导出或者下一次开始
+    TraceRecorder::instance().setEnabled(checked);
+}
+
+void MainWindow::on_checkBox_resultCache_toggled(bool checked)
+{
+    // 运行中也可以切换，旁路期间已经缓存的结果保留
+    mResultCache->setBypass(!checked);
+}
+
+void MainWindow::on_pushButton_exportTrace_clicked()
+{
+    TraceStats stats = TraceRecorder::instance().stats();
+    if(stats.events == 0)
+    {
+        QMessageBox::information(this, tr("导出trace"), tr("还没有记录trace，先勾选“记录trace”再开始推理"));
+        return;
+    }
+
+    QString path = QFileDialog::getSaveFileName(this, tr("导出trace"), "trace.json",
+                                                tr("Chrome trace (*.json)"));
+    if(path.isEmpty())
+    {
+        return;
+    }
+
+    std::string error;
+    if(!TraceRecorder::instance().exportChromeTrace(path.toLocal8Bit().toStdString(), &error))
+    {
+        QMessageBox::warning(this, tr("导出trace"), tr("写入文件失败：%1").arg(path));
+        return;
+    }
+
+    qDebug() << "exported trace:" << path
+             << "spans:" << stats.events
+             << "dropped:" << stats.dropped
+             << "threads:" << stats.threads;
+}
+
+void MainWindow::refreshTable()
+{
+    if(!mRun)
+    {
+        return;
+    }
+    TraceSpan span("refresh table", "gui");
+
+    int rowCount = qMin(ui->tableWidget->rowCount(), (int)mRun->samples.size());
+    for(int index = 0; index < rowCount; index++)
+    {
+        // 取走这一路自上次刷新以来的所有新数据
+        // 历史是固定容量的环形缓冲，超出的旧点自己滑出
+        SparklineHistory &history = *mHistoryData[index];
+        int fresh = 0;
+        double elapsed = 0;
+        while(mRun->samples[index]->tryPop(elapsed))
         {
-            mHistoryData[index].removeFirst();
+            history.append(elapsed);
+            fresh++;
         }
-        
-        // 更新曲线列的数据（通过UserRole存储）
-        QTableWidgetItem *chartItem = ui->tableWidget->item(index, 2);
-        if(chartItem)
+        if(fresh == 0)
         {
-            chartItem->setData(Qt::UserRole, QVariant::fromValue(mHistoryData[index]));
+            continue;
         }
-        
-        // 触发重绘
-        ui->tableWidget->viewport()->update();
+
+        // 更新当前耗时显示
+        ui->tableWidget->item(index, ColumnCurrent)->setText(QString::number(elapsed, 'f', 2));
+
+        // 更新分位数和吞吐量
+        LatencySnapshot snapshot = mRun->latency[index]->snapshot();
+        ui->tableWidget->item(index, ColumnP50)->setText(QString::number(snapshot.percentileMs(50), 'f', 2));
+        ui->tableWidget->item(index, ColumnP99)->setText(QString::number(snapshot.percentileMs(99), 'f', 2));
+        ui->tableWidget->item(index, ColumnMax)->setText(QString::number(snapshot.maxMs(), 'f', 2));
+        ui->tableWidget->item(index, ColumnThroughput)->setText(QString::number(snapshot.throughput(), 'f', 1));
+
+        // 曲线列只更新版本号，不复制历史数据，单元格的数据变化会自己触发这一格的重绘
+        ui->tableWidget->item(index, ColumnHistory)->setData(SparklineRevisionRole, history.sequence());
     }
 }
 
-cv::Mat loadMatFromPath(QString imgPath)
+void MainWindow::loadAndInfer(std::shared_ptr<RunContext> run, int idx)
 {
-    cv::Mat mat;
+    TraceRecorder::setThreadName("stream " + std::to_string(idx));
 
-    QFile file(imgPath);
-    if(file.exists())
+    // 加载模型并启动线程池，只有第一个调用的线程会真正去加载，其余线程等待其完成
     {
-        if(file.open(QFile::ReadOnly))
+        TraceSpan span("start pool", "stream");
+        std::string error;
+        if(!run->pool->start(&error))
         {
-            QByteArray data =  file.readAll();
-            std::vector<uchar> imgData(data.begin(), data.end());
-            mat = cv::imdecode(imgData, cv::IMREAD_UNCHANGED);
+            qDebug() << idx << "模型加载失败:" << QString::fromStdString(error);
+            return;
+        }
+
+        if(idx == 0 && !run->warmStart)
+        {
+            const auto &engine = run->pool->engine();
+            InferenceEngineLoadStats stats = engine->loadStats();
+            qDebug() << "module:" << engine->moduleId().c_str()
+                     << "pipelines:" << engine->pipelineCount()
+                     << "load(ms):" << stats.solutionLoadMs
+                     << "create(ms):" << stats.pipelineCreateMs
+                     << "module graph(ms):" << stats.moduleResolveMs
+                     << "cached:" << stats.moduleGraphCached
+                     << "rss(MB):" << stats.rssBeforeBytes / 1048576.0 << "->" << stats.rssAfterBytes / 1048576.0;
+        }
+        else if(idx == 0)
+        {
+            qDebug() << "warm start, reuse" << run->pool->engine()->pipelineCount() << "pipelines";
         }
     }
 
-    return mat;
-}
-void MainWindow::loadAndInfer(QString modelPath, QString imageFolderPath, int idx)
-{
-    // 加载模型并创建pipelines
-    vimo::Pipelines pipelines;
-    {
-        std::string model_path = (modelPath + "/model.vimosln").toLocal8Bit().data();
-        bool use_gpu = true;                        // whether to use gpu for inference
-        int device_id = 0;                          // GPU device id, ignore if use_gpu == false
-
-        vimo::Solution solution;  // create an empty solution
-        // std::cout << "load solution from: " << model_path << std::endl;
-        solution.LoadFromFile(model_path);  // load solution from model.vimosln
-
-        // edgeList是一系列std::pair，其中每个std::pair的first为当前节点，second为下一节点
-        // 通过对所有的edgeList进行分析，便可以拼凑出所有完整的流程
-        auto edgeList = solution.GetEdgeList();
-        // qDebug() << "edge list:" << edgeList.size();
-        // foreach (auto edge, edgeList) {
-        //     qDebug() << edge.first.c_str() << "-->" << edge.second.c_str();
-        // }
-
-        auto infoList = solution.GetModuleInfoList();
-        if(infoList.size() <= 0)
+    // 这一路固定送到一个分片，绑核时送图线程也绑到这个分片的核上
+    int shard = run->pool->shardForStream(idx);
+    InferencePool &pool = run->pool->poolForStream(idx);
+    if(run->pinThreads && !run->pool->pinStreamThread(idx))
+    {
+        qDebug() << idx << "绑核失败";
+    }
+
+    int stream = -1;
+    int replica = 0;
+    if(run->corpus)
+    {
+        // 预加载图像库
+        std::string error;
+        if(!run->corpus->load(&error))
         {
-            qDebug() << "error 1" << "无法从模型中找到有效模组";
+            qDebug() << idx << "图像预加载失败:" << QString::fromStdString(error) << run->imageFolderPath;
             return;
         }
 
-        // 找到最新、最大的那个模组;
-        // 因为module id是以数字递增的,排序之后，最后的那个就是我们想要的
-        QMap<QString, vimo::Module::Info> tmpMap;
-        foreach (auto info, infoList) {
-            tmpMap[info.id.c_str()] = info;
+        if(idx == 0)
+        {
+            FrameCorpusStats stats = run->corpus->stats();
+            qDebug() << "corpus frames:" << stats.frameCount
+                     << "failed:" << stats.failedCount
+                     << "size(MB):" << stats.bytes / 1048576.0
+                     << "load(ms):" << stats.loadMs
+                     << "page locked:" << stats.pageLocked
+                     << "rss(MB):" << stats.rssBeforeBytes / 1048576.0 << "->" << stats.rssAfterBytes / 1048576.0;
+        }
+
+        // 绑核时每个分片在自己的节点上复制一份图像库
+        // 由第一个到达的线程一次复制完，其余线程在这里等，保证开始送图之后不会再添加副本
+        if(run->pinThreads)
+        {
+            std::lock_guard<std::mutex> locker(run->replicaMutex);
+            if(run->corpusReplica.empty())
+            {
+                for(int i = 0; i < run->pool->shardCount(); i++)
+                {
+                    run->corpusReplica.push_back(run->corpus->addReplica(run->pool->shardCpus(i)));
+                }
+            }
+            replica = run->corpusReplica[shard];
+        }
+    }
+    else
+    {
+        // 获取文件夹中的所有图片文件
+        QStringList imageFiles = listImageFiles(run->imageFolderPath);
+
+        if(imageFiles.isEmpty())
+        {
+            qDebug() << idx << "文件夹中没有找到图片文件:" << run->imageFolderPath;
+            return;
         }
-        // qDebug() << "keys:---" << tmpMap.keys();
-        auto theModuleInfo = tmpMap[tmpMap.keys().last()];
 
-        pipelines = solution.CreatePipelines(theModuleInfo.id, use_gpu, device_id);
+        qDebug() << idx << "找到" << imageFiles.size() << "张图片，准备推理";
+
+        // 这一路图像交给解码阶段循环预取
+        stream = run->decoder->addStream(imageFiles);
     }
 
-    // 获取文件夹中的所有图片文件
-    QDir imageDir(imageFolderPath);
-    QStringList filters;
-    filters << "*.bmp" << "*.jpg" << "*.jpeg" << "*.png" << "*.tif" << "*.tiff";
-    QStringList imageFiles = imageDir.entryList(filters, QDir::Files, QDir::Name);
-    
-    if(imageFiles.isEmpty())
+    auto interval = std::chrono::duration_cast<std::chrono::milliseconds>(run->taktPeriod);
+
+    // 第一张图先用来预热所有pipelines，只有第一个到这里的线程真正去做，其余线程等它做完；热启动时引擎已经预热过，直接返回
+    // 预热在登记节拍之前做完，预热期间调度器不会给这一路放行节拍，不会记成超拍，也不算进吞吐量
+    DecodedFrame pendingFrame;      // 解码阶段取来预热的图，留作第一拍送出
     {
-        qDebug() << idx << "文件夹中没有找到图片文件:" << imageFolderPath;
-        return;
+        cv::Mat warmImage;
+        if(run->corpus)
+        {
+            warmImage = run->corpus->frame(0, replica);
+        }
+        else
+        {
+            while(!run->cancel.isCancelled())
+            {
+                if(!run->decoder->next(stream, pendingFrame, interval))
+                {
+                    continue;
+                }
+                if(pendingFrame.image.empty())
+                {
+                    qDebug() << idx << "图像加载失败:" << pendingFrame.path;
+                    continue;
+                }
+                warmImage = pendingFrame.image;
+                break;
+            }
+        }
+
+        if(!warmImage.empty())
+        {
+            TraceSpan span("warm up", "stream");
+            const auto &engine = run->pool->engine();
+            std::string error;
+            if(!engine->warmUp(warmImage, &error))
+            {
+                qDebug() << idx << "预热失败:" << QString::fromStdString(error);
+            }
+            else if(idx == 0 && !run->warmStart)
+            {
+                InferenceEngineLoadStats stats = engine->loadStats();
+                qDebug() << "warm-up(ms):" << stats.warmupMs
+                         << "first run(ms):" << stats.firstRunMs
+                         << "warm run(ms):" << stats.warmRunMs;
+            }
+        }
     }
-    
-    qDebug() << idx << "找到" << imageFiles.size() << "张图片，准备推理";
 
     // 目前的工作节拍为600pcs/min，也就是每秒钟需要处理10pcs，也就是两次推理之间的间隔为100ms
     // 推理时间也要算到间隔时间里面，不能说是推理完才开始算间隔时间
-    int interval = 100;
-    QDeadlineTimer dTimer(interval);
-    
+    // 由节拍调度器按绝对时间放行，送图慢了只记超拍，不会把后面的节拍往后推
+    int taktStream = run->takt->addStream(run->taktPeriod, run->taktPhaseStep * idx);
+
     int currentImageIndex = 0;
+    long long sequence = 0;
+    // 吞吐量从这一路预热完、真正开始送图时算起，不含加载模型和预热的时间
+    std::shared_ptr<LatencyHistogram> latency = run->latency[idx];
+    latency->reset();
+    std::shared_ptr<MpmcQueue<double>> samples = run->samples[idx];
 
-    while (mQuitThread == false) {
+    while (!run->cancel.isCancelled()) {
 
-        // 时间还没到，等
-        while(dTimer.hasExpired() == false)
-        {
-            QThread::msleep(1);
-        }
-        // 重新开始计时
-        dTimer.setRemainingTime(interval);
-        
-        // 获取当前要处理的图片路径
-        QString currentImagePath = imageDir.absoluteFilePath(imageFiles[currentImageIndex]);
-        
-        // 加载图片
-        cv::Mat img = loadMatFromPath(currentImagePath);
-        if(img.empty())
+        // 睡到这一路的下一个节拍
         {
-            qDebug() << idx << "图像加载失败:" << currentImagePath;
-            // 跳过这张图片，继续下一张
-            currentImageIndex = (currentImageIndex + 1) % imageFiles.size();
-            continue;
+            TraceSpan span("takt wait", "stream");
+            if(!run->takt->waitNext(taktStream))
+            {
+                break;
+            }
         }
 
-        // 只算推理的耗时
-        QElapsedTimer timer;
-        timer.start();
-
-        try
+        // keepAlive保证图像数据一直有效到推理结束（文件映射或者图像库）
+        cv::Mat img;
+        std::shared_ptr<void> keepAlive;
+        TraceSpan fetchSpan("fetch frame", "stream");
+        auto fetchStart = std::chrono::steady_clock::now();
+        if(run->corpus)
         {
-            // 每次只推理一张图片
-            vimo::Request req(img);
-            vimo::Pipelines::UADResponseList rsp;
-            pipelines.Run(req, rsp);
+            // 直接取图像库中的帧，没有拷贝也没有分配
+            img = run->corpus->frame(currentImageIndex, replica);
+            keepAlive = run->corpus;
+            currentImageIndex = (currentImageIndex + 1) % run->corpus->size();
         }
-        catch (vimo::VimoException &e)
+        else
         {
-            std::cerr << e.what() << std::endl;
+            // 取预先解码好的图片，解码跟不上时最多等一个节拍；第一拍送预热用过的那张
+            DecodedFrame frame;
+            if(!pendingFrame.image.empty())
+            {
+                frame = std::move(pendingFrame);
+                pendingFrame = DecodedFrame();
+            }
+            else if(!run->decoder->next(stream, frame, interval))
+            {
+                continue;
+            }
+
+            if(frame.image.empty())
+            {
+                qDebug() << idx << "图像加载失败:" << frame.path;
+                // 跳过这张图片，继续下一张
+                continue;
+            }
+            img = frame.image;
+            keepAlive = frame.keepAlive;
         }
-
-        // 推理耗时
-        qint64 elapsed = timer.nsecsElapsed();
-        double elapsed_ms = elapsed / (double)(1e6);
-        // qDebug() << idx << "image:" << imageFiles[currentImageIndex] << "elapse(ms):" << elapsed_ms;
-
-        emit inferCompleted(idx, elapsed_ms);
-        
-        // 移动到下一张图片（循环）
-        currentImageIndex = (currentImageIndex + 1) % imageFiles.size();
+        fetchSpan.finish();
+        float fetchMs = std::chrono::duration<float, std::milli>(std::chrono::steady_clock::now() - fetchStart).count();
+
+        // 交给线程池推理，本线程不等结果，直接按节拍准备下一张
+        // 推理耗时只算pipelines.Run本身，不含排队时间；直方图和曲线数据都直接在工作线程中无锁记录
+        // 后处理需要原图时，keepAlive连同图像一起交给后处理，保证数据在后处理结束前有效
+        auto submitTime = std::chrono::steady_clock::now();
+        pool.submit(img, [run, img, keepAlive, latency, samples, idx, sequence, fetchMs, submitTime](InferenceResult &result){
+            if(run->resultLog)
+            {
+                ResultLogRecord record;
+                record.timestampUs = ResultLogWriter::nowUs();
+                record.sequence = sequence;
+                record.stream = idx;
+                record.status = (uint8_t)result.status;
+                record.batchSize = (uint8_t)qMin(result.batchSize, 255);
+                record.fetchMs = fetchMs;
+                record.queueMs = (float)result.queueMs;
+                record.inferMs = (float)result.inferMs;
+                record.totalMs = std::chrono::duration<float, std::milli>(std::chrono::steady_clock::now() - submitTime).count();
+                run->resultLog->append(record);
+            }
+            if(result.status == InferenceStatus::Ok)
+            {
+                if(run->firstResultNs < 0)
+                {
+                    long long expected = -1;
+                    long long ns = std::chrono::duration_cast<std::chrono::nanoseconds>(
+                                       std::chrono::steady_clock::now() - run->startTime).count();
+                    run->firstResultNs.compare_exchange_strong(expected, ns);
+                }
+                latency->recordMs(result.inferMs);
+                samples->tryPush(result.inferMs);
+
+                if(run->post)
+                {
+                    PostProcessStage::ItemPtr item(new PostProcessItem);
+                    item->stream = idx;
+                    item->sequence = sequence;
+                    item->image = img;
+                    item->keepAlive = keepAlive;
+                    item->output = std::move(result.output);
+                    item->queueMs = result.queueMs;
+                    item->inferMs = result.inferMs;
+                    item->traceId = result.traceId;
+                    run->post->submit(std::move(item));
+                }
+            }
+            else if(result.status == InferenceStatus::Failed)
+            {
+                std::cerr << result.error << std::endl;
+            }
+        });
+        sequence++;
     }
 
     qDebug() << "quit thread" << idx;
@@ -3,10 +3,72 @@
 
 #include <QMainWindow>
 #include <QThread>
+#include <QTimer>
 #include <QVector>
 
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <thread>
+
+#include "cancellation.h"
+#include "decodestage.h"
+#include "framecorpus.h"
+#include "latencyhistogram.h"
+#include "mpmcqueue.h"
+#include "resultlog.h"
+#include "resulthandlers.h"
+#include "shardedinferencepool.h"
+#include "sparklinedelegate.h"
+#include "taktscheduler.h"
+
 #pragma execution_character_set("utf-8")
 
+// 一次推理运行中所有图像线程共享的对象
+struct RunContext
+{
+    QString imageFolderPath;
+
+    // 停止时取消，唤醒所有等节拍、等解码的送图线程
+    CancellationSource cancel;
+
+    // 所有线程共享的推理线程池（模型只加载一次）
+    // 每个图像线程只负责按节拍送图，推理由线程池中的工作线程完成
+    // 多个推理设备时线程池按设备分片，第i路固定送到第pool->shardForStream(i)个分片
+    std::shared_ptr<ShardedInferencePool> pool;
+    bool pinThreads = false;                        // 送图线程绑到所在分片的核上
+    std::mutex replicaMutex;
+    std::vector<int> corpusReplica;                 // 每个分片使用的图像库副本编号
+
+    // 图像来源二选一：
+    // decoder 独立的预取解码阶段，推理侧不再等磁盘和解码
+    // corpus  预加载到内存的图像库，循环推理时完全不读盘、不解码
+    std::shared_ptr<DecodeStage> decoder;
+    std::shared_ptr<FrameCorpus> corpus;
+
+    // 推理结果的异步后处理（判定、保存、画叠加图），不需要时为空
+    std::shared_ptr<PostProcessStage> post;
+    std::shared_ptr<ResultStatisticsHandler> postStatistics;
+    std::shared_ptr<ResultWriterHandler> postWriter;
+
+    // 每张图一条的二进制结果日志，不需要时为空
+    std::shared_ptr<ResultLogWriter> resultLog;
+
+    // 所有图像线程共用的节拍调度器，按绝对截止时间放行每一路的送图
+    std::shared_ptr<TaktScheduler> takt;
+    std::chrono::microseconds taktPeriod{100000};
+    std::chrono::microseconds taktPhaseStep{0};     // 相邻两路之间的相位差
+    std::chrono::steady_clock::time_point startTime;   // 点击开始的时刻，用来算设备利用率和出第一张结果的时间
+    std::atomic<long long> firstResultNs{-1};       // 第一张推理成功相对startTime的时刻，-1表示还没有
+    bool warmStart = false;                         // 引擎是上次停止时保留下来的，没有重新加载
+
+    // 每一路的推理耗时直方图，和MainWindow::mLatency是同一组对象
+    std::vector<std::shared_ptr<LatencyHistogram>> latency;
+
+    // 每一路最近的推理耗时，工作线程无锁写入，界面定时取走；界面来不及取时丢弃新的点
+    std::vector<std::shared_ptr<MpmcQueue<double>>> samples;
+};
+
 QT_BEGIN_NAMESPACE
 namespace Ui {
 class MainWindow;
@@ -21,7 +83,7 @@ public:
     MainWindow(QWidget *parent = nullptr);
     ~MainWindow();
 
-    void loadAndInfer(QString modelPath, QString imagePath, int idx);
+    void loadAndInfer(std::shared_ptr<RunContext> run, int idx);
 
 private slots:
     void on_pushButton_start_clicked();
@@ -32,20 +94,73 @@ private slots:
 
     void on_pushButton_stop_clicked();
 
-    void onInferCompleted(int index, double elapsed);
+    void on_pushButton_export_clicked();
+
+    void on_pushButton_sweep_clicked();
+
+    void on_checkBox_trace_toggled(bool checked);
+
+    void on_checkBox_resultCache_toggled(bool checked);
+
+    void on_pushButton_exportTrace_clicked();
 
-signals:
-    void inferCompleted(int index, double interval);
+    // 定时把各路新的推理耗时刷新到表格，只更新有变化的行
+    void refreshTable();
 
 private:
+    // 界面刷新间隔，约30Hz
+    static constexpr int kRefreshIntervalMs = 33;
+    // 每一路缓存的未显示数据点数，超过一次刷新内能产生的点数即可
+    static constexpr int kSampleQueueCapacity = 256;
+    // 停止时排空队列最多等的时间，超时后剩下的图直接放弃
+    static constexpr int kStopDrainBudgetMs = 2000;
+
+    // 表格的列
+    enum Column
+    {
+        ColumnIndex = 0,
+        ColumnCurrent,
+        ColumnP50,
+        ColumnP99,
+        ColumnMax,
+        ColumnThroughput,
+        ColumnHistory,
+        ColumnCount
+    };
+
+    // 运行时禁用参数控件，停止后恢复
+    void setRunning(bool running);
+
     Ui::MainWindow *ui;
 
+    // 停止的后半部分：在界面线程中释放线程对象、输出统计并恢复控件
+    void finishStop(double joinMs, const InferencePoolShutdownStats &poolStats);
+
     std::atomic<int> mThreadIndex;
-    std::atomic<bool> mQuitThread;
 
     QList<QThread*> mThreadList;
 
+    // 停止时等送图线程退出、关闭线程池的后台线程，界面线程不等
+    std::thread mStopWorker;
+    bool mStopping = false;
+
+    // 界面按固定频率刷新，开销和线程数、推理速度无关
+    QTimer *mRefreshTimer;
+
+    // 当前运行共享的对象，停止后释放
+    std::shared_ptr<RunContext> mRun;
+
+    // 停止后保留的引擎（已经加载并预热过的pipelines），下次开始时参数和模型文件都没变就直接使用
+    std::shared_ptr<InferenceEngine> mWarmEngine;
+    QString mWarmEngineKey;
+
+    // 按图像内容缓存的推理结果，跟着引擎走：换了引擎就清空；不勾选“结果缓存”时旁路
+    std::shared_ptr<ResultCache> mResultCache;
+
     // 每个线程的历史耗时数据（用于绘制曲线）
-    QVector<QVector<double>> mHistoryData;
+    std::vector<std::shared_ptr<SparklineHistory>> mHistoryData;
+
+    // 每个线程的推理耗时直方图，在线程池的工作线程中记录，停止后保留到下次开始，用于导出
+    std::vector<std::shared_ptr<LatencyHistogram>> mLatency;
 };
 #endif // MAINWINDOW_H
@@ -0,0 +1,190 @@
+﻿#include "mappedimage.h"
+#include "tracing.h"
+
+#include <QFile>
+
+#include <cstring>
+
+// 按小端读取BMP头中的字段
+template <typename T>
+static T readLE(const uchar *p)
+{
+    T value;
+    std::memcpy(&value, p, sizeof(T));
+    return value;
+}
+
+bool isBufferReusable(const cv::Mat &buffer)
+{
+    // 下游线程释放时用CV_XADD递减引用计数，这里同样用原子操作读取（加0），
+    // 读到1时它们对像素的访问都已经结束，之后覆盖不会和它们的读冲突
+    return buffer.u == nullptr || CV_XADD(&buffer.u->refcount, 0) == 1;
+}
+
+MatBufferPool::MatBufferPool(int maxBuffers)
+    : mMaxBuffers(qMax(1, maxBuffers))
+{
+    mBuffers.reserve(mMaxBuffers);
+}
+
+cv::Mat &MatBufferPool::acquire()
+{
+    for(cv::Mat &buffer : mBuffers)
+    {
+        if(isBufferReusable(buffer))
+        {
+            return buffer;
+        }
+    }
+
+    if((int)mBuffers.size() < mMaxBuffers)
+    {
+        mBuffers.emplace_back();
+        return mBuffers.back();
+    }
+
+    // 缓冲区都还在下游用着，放弃最后一个的引用，让它重新分配
+    mBuffers.back().release();
+    return mBuffers.back();
+}
+
+MappedImageReader::MappedImageReader(int maxPooledBuffers)
+    : mBuffers(maxPooledBuffers)
+{
+}
+
+bool MappedImageReader::read(const QString &path, cv::Mat &image, std::shared_ptr<void> &keepAlive)
+{
+    mLastZeroCopy = false;
+    image.release();
+    keepAlive.reset();
+
+    TraceSpan mapSpan("map file", "decode");
+    std::shared_ptr<QFile> file = std::make_shared<QFile>(path);
+    if(!file->open(QFile::ReadOnly))
+    {
+        return false;
+    }
+
+    qint64 size = file->size();
+    if(size <= 0)
+    {
+        return false;
+    }
+
+    // 私有映射（写时复制），下游万一改了像素也不会写回文件
+    const uchar *data = file->map(0, size, QFileDevice::MapPrivateOption);
+    if(data == nullptr)
+    {
+        return false;
+    }
+    mapSpan.finish();
+
+    try
+    {
+        bool bottomUp = false;
+        cv::Mat bmp = wrapUncompressedBmp(data, size, bottomUp);
+        if(!bmp.empty())
+        {
+            if(bottomUp)
+            {
+                // 行是倒着存的，翻转一次到复用缓冲区，映射用完即可释放
+                TraceSpan span("flip", "decode");
+                cv::Mat &buffer = mBuffers.acquire();
+                cv::flip(bmp, buffer, 0);
+                image = buffer;
+            }
+            else
+            {
+                // 直接使用映射区，映射随keepAlive一起释放
+                image = bmp;
+                keepAlive = file;
+                mLastZeroCopy = true;
+            }
+            return true;
+        }
+
+        // 压缩格式：直接从映射区解码到复用缓冲区
+        TraceSpan span("imdecode", "decode");
+        cv::Mat encoded(1, (int)size, CV_8UC1, const_cast<uchar *>(data));
+        cv::Mat &buffer = mBuffers.acquire();
+        cv::imdecode(encoded, cv::IMREAD_UNCHANGED, &buffer);
+        image = buffer;
+    }
+    catch (const cv::Exception &)
+    {
+        image.release();
+    }
+
+    return !image.empty();
+}
+
+cv::Mat MappedImageReader::wrapUncompressedBmp(const uchar *data, qint64 size, bool &bottomUp)
+{
+    const qint64 kFileHeaderSize = 14;
+    const qint64 kInfoHeaderSize = 40;    // BITMAPINFOHEADER
+
+    bottomUp = false;
+    if(size < kFileHeaderSize + kInfoHeaderSize || data[0] != 'B' || data[1] != 'M')
+    {
+        return cv::Mat();
+    }
+
+    quint32 pixelOffset = readLE<quint32>(data + 10);
+    const uchar *info = data + kFileHeaderSize;
+    quint32 infoSize = readLE<quint32>(info);
+    qint32 width = readLE<qint32>(info + 4);
+    qint32 height = readLE<qint32>(info + 8);
+    quint16 bitCount = readLE<quint16>(info + 14);
+    quint32 compression = readLE<quint32>(info + 16);
+    quint32 colorsUsed = readLE<quint32>(info + 32);
+
+    // 只处理BI_RGB的8位灰度和24位BGR，其余格式交给imdecode，保证结果和原来一致
+    const quint32 BI_RGB = 0;
+    if(infoSize < kInfoHeaderSize || width <= 0 || height == 0 || compression != BI_RGB)
+    {
+        return cv::Mat();
+    }
+    // 头里的长度都来自文件，先用整数比较，确认在文件范围内之后才计算指针
+    if(kFileHeaderSize + (qint64)infoSize > size || pixelOffset < kFileHeaderSize + (qint64)infoSize)
+    {
+        return cv::Mat();
+    }
+
+    int type;
+    switch (bitCount) {
+    case 8: type = CV_8UC1; break;
+    case 24: type = CV_8UC3; break;
+    default: return cv::Mat();
+    }
+
+    // 8位图只有调色板是标准灰度表时才能直接当灰度图用
+    if(bitCount == 8)
+    {
+        quint32 colors = colorsUsed ? colorsUsed : 256;
+        if(colors > 256 || kFileHeaderSize + (qint64)infoSize + (qint64)colors * 4 > size)
+        {
+            return cv::Mat();
+        }
+        const uchar *palette = info + infoSize;
+        for(quint32 i = 0; i < colors; ++i)
+        {
+            const uchar *entry = palette + i * 4;
+            if(entry[0] != i || entry[1] != i || entry[2] != i)
+            {
+                return cv::Mat();
+            }
+        }
+    }
+
+    // 每行按4字节对齐
+    qint64 rows = height < 0 ? -(qint64)height : height;
+    qint64 stride = (((qint64)width * bitCount + 31) / 32) * 4;
+    if((qint64)pixelOffset + stride * rows > size)
+    {
+        return cv::Mat();
+    }
+
+    bottomUp = height > 0;
+    return cv::Mat((int)rows, width, type, const_cast<uchar *>(data + pixelOffset), (size_t)stride);
+}
@@ -0,0 +1,58 @@
+﻿#ifndef MAPPEDIMAGE_H
+#define MAPPEDIMAGE_H
+
+#include <QString>
+
+#include <memory>
+#include <vector>
+
+#include <opencv2/opencv.hpp>
+
+// 复用的缓冲区只被调用者自己引用（或者还没有分配）时返回true，可以安全地覆盖
+bool isBufferReusable(const cv::Mat &buffer);
+
+// 复用的cv::Mat缓冲区：交给下游的图用完之后（引用计数回到1）再次写入，尺寸不变时不再分配
+// 只能在一个线程中使用
+class MatBufferPool
+{
+public:
+    // maxBuffers：最多缓存多少个缓冲区，一般取下游最多同时持有的帧数再加一两个
+    explicit MatBufferPool(int maxBuffers = 8);
+
+    // 取一个当前没有被别人引用的缓冲区；都还在下游用着时放弃最后一个的引用，让它重新分配
+    cv::Mat &acquire();
+
+private:
+    int mMaxBuffers;
+    std::vector<cv::Mat> mBuffers;
+};
+
+// 基于内存映射的图像读取：
+// - 文件用QFile::map映射进来，不再经过readAll和std::vector两次拷贝
+// - 压缩格式（jpg/png/tif...）直接从映射区imdecode到复用的缓冲区
+// - 无压缩的8位灰度/24位BMP不解码：自上而下存储的直接包装映射区（零拷贝），
+//   自下而上存储的只做一次行翻转拷贝到复用缓冲区
+// 一个读取器只能在一个线程中使用
+class MappedImageReader
+{
+public:
+    // maxPooledBuffers：最多缓存多少个复用缓冲区
+    explicit MappedImageReader(int maxPooledBuffers = 8);
+
+    // 读取并解码，失败时返回false
+    // 零拷贝时image直接指向映射区，keepAlive持有映射，image用完之前keepAlive不能释放
+    bool read(const QString &path, cv::Mat &image, std::shared_ptr<void> &keepAlive);
+
+    // 上一次read是否走了零拷贝
+    bool lastReadWasZeroCopy() const { return mLastZeroCopy; }
+
+    // 解析无压缩BMP，返回指向data中像素的cv::Mat（不拷贝）
+    // 不支持的BMP（RLE压缩、32位、调色板不是灰度等）返回空；bottomUp表示行是自下而上存储的
+    static cv::Mat wrapUncompressedBmp(const uchar *data, qint64 size, bool &bottomUp);
+
+private:
+    MatBufferPool mBuffers;
+    bool mLastZeroCopy = false;
+};
+
+#endif // MAPPEDIMAGE_H
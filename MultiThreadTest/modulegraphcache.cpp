@@ -0,0 +1,143 @@
+﻿#include "modulegraphcache.h"
+
+#include <chrono>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <vector>
+
+namespace {
+
+// 按8字节一组混合的64位哈希，只用来判断文件内容有没有变，不要求抗碰撞
+unsigned long long mix(unsigned long long h, unsigned long long v)
+{
+    h ^= v * 0x9e3779b97f4a7c15ULL;
+    h = (h << 27) | (h >> 37);
+    return h * 0xbf58476d1ce4e5b9ULL;
+}
+
+bool hashFile(const std::string &path, unsigned long long &hash, long long &bytesRead)
+{
+    std::ifstream file(path, std::ios::binary);
+    if (!file)
+    {
+        return false;
+    }
+
+    std::vector<char> buffer(1 << 20);
+    unsigned long long h = 0x94d049bb133111ebULL;
+    bytesRead = 0;
+    while (file)
+    {
+        file.read(buffer.data(), (std::streamsize)buffer.size());
+        size_t n = (size_t)file.gcount();
+        size_t i = 0;
+        for (; i + 8 <= n; i += 8)
+        {
+            unsigned long long v;
+            std::memcpy(&v, buffer.data() + i, 8);
+            h = mix(h, v);
+        }
+        for (; i < n; ++i)
+        {
+            h = mix(h, (unsigned char)buffer[i]);
+        }
+        bytesRead += (long long)n;
+    }
+    hash = mix(h, (unsigned long long)bytesRead);
+    return true;
+}
+
+} // namespace
+
+ModuleGraphCache &ModuleGraphCache::instance()
+{
+    static ModuleGraphCache cache;
+    return cache;
+}
+
+bool ModuleGraphCache::fingerprint(const std::string &path, ModelFingerprint &fingerprint)
+{
+    std::error_code ec;
+    // 路径和传给SDK的一样是本地编码
+    std::filesystem::path filePath(path);
+    auto size = std::filesystem::file_size(filePath, ec);
+    if (ec)
+    {
+        return false;
+    }
+    auto mtime = std::filesystem::last_write_time(filePath, ec);
+    if (ec)
+    {
+        return false;
+    }
+
+    ModelFingerprint current;
+    current.size = (long long)size;
+    current.mtimeNs = (long long)std::chrono::duration_cast<std::chrono::nanoseconds>(mtime.time_since_epoch()).count();
+
+    {
+        std::lock_guard<std::mutex> locker(mMutex);
+        auto it = mEntries.find(path);
+        if (it != mEntries.end() && it->second.fingerprint.size == current.size
+            && it->second.fingerprint.mtimeNs == current.mtimeNs)
+        {
+            fingerprint = it->second.fingerprint;
+            return true;
+        }
+    }
+
+    // 读文件在锁外面做，模型文件可能有几百MB
+    long long bytesRead = 0;
+    if (!hashFile(path, current.hash, bytesRead))
+    {
+        return false;
+    }
+
+    std::lock_guard<std::mutex> locker(mMutex);
+    mStats.hashedBytes += bytesRead;
+    Entry &entry = mEntries[path];
+    if (entry.fingerprint.hash != current.hash)
+    {
+        // 内容真的变了，之前解析的模组图作废；只是修改时间变了就保留
+        entry.hasGraph = false;
+    }
+    entry.fingerprint = current;
+    fingerprint = current;
+    return true;
+}
+
+bool ModuleGraphCache::lookup(const std::string &path, const ModelFingerprint &fingerprint, ModuleGraph &graph)
+{
+    std::lock_guard<std::mutex> locker(mMutex);
+    auto it = mEntries.find(path);
+    if (it == mEntries.end() || !it->second.hasGraph || it->second.fingerprint != fingerprint)
+    {
+        ++mStats.misses;
+        return false;
+    }
+    ++mStats.hits;
+    graph = it->second.graph;
+    return true;
+}
+
+void ModuleGraphCache::store(const std::string &path, const ModelFingerprint &fingerprint, const ModuleGraph &graph)
+{
+    std::lock_guard<std::mutex> locker(mMutex);
+    Entry &entry = mEntries[path];
+    entry.fingerprint = fingerprint;
+    entry.hasGraph = true;
+    entry.graph = graph;
+}
+
+void ModuleGraphCache::clear()
+{
+    std::lock_guard<std::mutex> locker(mMutex);
+    mEntries.clear();
+}
+
+ModuleGraphCacheStats ModuleGraphCache::stats() const
+{
+    std::lock_guard<std::mutex> locker(mMutex);
+    return mStats;
+}
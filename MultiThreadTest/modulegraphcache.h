@@ -0,0 +1,71 @@
+﻿#ifndef MODULEGRAPHCACHE_H
+#define MODULEGRAPHCACHE_H
+
+#include <map>
+#include <mutex>
+#include <string>
+#include <utility>
+#include <vector>
+
+// 模型文件的指纹：大小和修改时间用来快速判断，内容哈希用来确认
+struct ModelFingerprint
+{
+    long long size = -1;
+    long long mtimeNs = 0;
+    unsigned long long hash = 0;
+
+    bool isValid() const { return size >= 0; }
+    bool operator==(const ModelFingerprint &other) const
+    {
+        return size == other.size && mtimeNs == other.mtimeNs && hash == other.hash;
+    }
+    bool operator!=(const ModelFingerprint &other) const { return !(*this == other); }
+};
+
+// 解析好的模组图
+struct ModuleGraph
+{
+    std::vector<std::string> moduleIds;
+    std::vector<std::pair<std::string, std::string>> edges;    // (上游, 下游)
+    std::string moduleId;                                       // 推理使用的模组
+};
+
+struct ModuleGraphCacheStats
+{
+    long long hits = 0;
+    long long misses = 0;
+    long long hashedBytes = 0;      // 为了算指纹读过的字节数
+};
+
+// 按模型文件路径缓存模组图，整个进程共用
+// 文件的大小、修改时间或内容哈希任何一个变了，缓存就失效
+// 大小和修改时间都没变时直接用上次的哈希，不再读文件
+class ModuleGraphCache
+{
+public:
+    static ModuleGraphCache &instance();
+
+    // 取文件当前的指纹，文件不存在时返回false
+    bool fingerprint(const std::string &path, ModelFingerprint &fingerprint);
+
+    // 指纹一致时返回缓存的模组图
+    bool lookup(const std::string &path, const ModelFingerprint &fingerprint, ModuleGraph &graph);
+    void store(const std::string &path, const ModelFingerprint &fingerprint, const ModuleGraph &graph);
+
+    void clear();
+    ModuleGraphCacheStats stats() const;
+
+private:
+    struct Entry
+    {
+        ModelFingerprint fingerprint;
+        bool hasGraph = false;
+        ModuleGraph graph;
+    };
+
+    mutable std::mutex mMutex;
+    std::map<std::string, Entry> mEntries;
+    ModuleGraphCacheStats mStats;
+};
+
+#endif // MODULEGRAPHCACHE_H
@@ -0,0 +1,142 @@
+﻿#ifndef MPMCQUEUE_H
+#define MPMCQUEUE_H
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <new>
+#include <type_traits>
+#include <utility>
+
+// 有界、无锁的多生产者多消费者环形队列（Dmitry Vyukov的算法）
+// 每个槽位带一个序号，生产者/消费者各自用CAS抢占位置，不需要任何互斥锁
+// 容量会向上取整为2的幂；队列满时tryPush返回false，队列空时tryPop返回false
+// 需要阻塞等待的场景由使用者自己在外面加条件变量
+template <typename T>
+class MpmcQueue
+{
+public:
+    explicit MpmcQueue(size_t capacity)
+    {
+        size_t size = 2;
+        while (size < capacity)
+        {
+            size <<= 1;
+        }
+        mMask = size - 1;
+        mCells.reset(new Cell[size]);
+        for (size_t i = 0; i < size; ++i)
+        {
+            mCells[i].sequence.store(i, std::memory_order_relaxed);
+        }
+        mEnqueuePos.store(0, std::memory_order_relaxed);
+        mDequeuePos.store(0, std::memory_order_relaxed);
+    }
+
+    ~MpmcQueue()
+    {
+        // 析构时不会再有并发访问，直接销毁剩余的元素
+        size_t dequeue = mDequeuePos.load(std::memory_order_relaxed);
+        size_t enqueue = mEnqueuePos.load(std::memory_order_relaxed);
+        for (size_t pos = dequeue; pos != enqueue; ++pos)
+        {
+            reinterpret_cast<T *>(&mCells[pos & mMask].storage)->~T();
+        }
+    }
+
+    MpmcQueue(const MpmcQueue &) = delete;
+    MpmcQueue &operator=(const MpmcQueue &) = delete;
+
+    template <typename U>
+    bool tryPush(U &&value)
+    {
+        Cell *cell;
+        size_t pos = mEnqueuePos.load(std::memory_order_relaxed);
+        for (;;)
+        {
+            cell = &mCells[pos & mMask];
+            size_t seq = cell->sequence.load(std::memory_order_acquire);
+            intptr_t diff = (intptr_t)seq - (intptr_t)pos;
+            if (diff == 0)
+            {
+                if (mEnqueuePos.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed))
+                {
+                    break;
+                }
+            }
+            else if (diff < 0)
+            {
+                return false;  // 满了
+            }
+            else
+            {
+                pos = mEnqueuePos.load(std::memory_order_relaxed);
+            }
+        }
+
+        new (&cell->storage) T(std::forward<U>(value));
+        cell->sequence.store(pos + 1, std::memory_order_release);
+        return true;
+    }
+
+    bool tryPop(T &out)
+    {
+        Cell *cell;
+        size_t pos = mDequeuePos.load(std::memory_order_relaxed);
+        for (;;)
+        {
+            cell = &mCells[pos & mMask];
+            size_t seq = cell->sequence.load(std::memory_order_acquire);
+            intptr_t diff = (intptr_t)seq - (intptr_t)(pos + 1);
+            if (diff == 0)
+            {
+                if (mDequeuePos.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed))
+                {
+                    break;
+                }
+            }
+            else if (diff < 0)
+            {
+                return false;  // 空了
+            }
+            else
+            {
+                pos = mDequeuePos.load(std::memory_order_relaxed);
+            }
+        }
+
+        T *item = reinterpret_cast<T *>(&cell->storage);
+        out = std::move(*item);
+        item->~T();
+        cell->sequence.store(pos + mMask + 1, std::memory_order_release);
+        return true;
+    }
+
+    // 近似的元素个数，并发修改时只作参考
+    size_t sizeApprox() const
+    {
+        size_t enqueue = mEnqueuePos.load(std::memory_order_relaxed);
+        size_t dequeue = mDequeuePos.load(std::memory_order_relaxed);
+        return enqueue > dequeue ? enqueue - dequeue : 0;
+    }
+
+    size_t capacity() const { return mMask + 1; }
+
+private:
+    struct Cell
+    {
+        std::atomic<size_t> sequence;
+        typename std::aligned_storage<sizeof(T), alignof(T)>::type storage;
+    };
+
+    // 生产者和消费者的游标放在不同的缓存行上，避免伪共享
+    static constexpr size_t kCacheLine = 64;
+
+    std::unique_ptr<Cell[]> mCells;
+    size_t mMask = 0;
+    alignas(kCacheLine) std::atomic<size_t> mEnqueuePos;
+    alignas(kCacheLine) std::atomic<size_t> mDequeuePos;
+};
+
+#endif // MPMCQUEUE_H
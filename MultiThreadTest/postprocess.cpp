@@ -0,0 +1,215 @@
+﻿#include "postprocess.h"
+#include "tracing.h"
+
+#include <algorithm>
+
+using Clock = std::chrono::steady_clock;
+
+// 睡眠等待的上限，防止极端情况下丢失唤醒导致线程一直睡下去
+static const std::chrono::milliseconds kWaitSlice(50);
+
+PostProcessStage::PostProcessStage(const PostProcessConfig &config)
+    : mConfig(config)
+    , mQueue((size_t)std::max(1, config.queueCapacity))
+{
+    mConfig.threadCount = std::max(1, mConfig.threadCount);
+}
+
+PostProcessStage::~PostProcessStage()
+{
+    shutdown(true);
+}
+
+void PostProcessStage::addHandler(std::shared_ptr<IResultHandler> handler)
+{
+    std::lock_guard<std::mutex> locker(mLifecycleMutex);
+    if (mRunning || !handler)
+    {
+        return;
+    }
+    mHandlers.push_back(std::move(handler));
+    mHandlerLatency.emplace_back(new LatencyHistogram);
+    mHandlerFailed.emplace_back(new std::atomic<long long>(0));
+}
+
+void PostProcessStage::start()
+{
+    std::lock_guard<std::mutex> locker(mLifecycleMutex);
+    if (mRunning)
+    {
+        return;
+    }
+
+    mStopping = false;
+    mDraining = false;
+    mAccepting = true;
+    mRunning = true;
+    for (int i = 0; i < mConfig.threadCount; ++i)
+    {
+        mWorkers.emplace_back(&PostProcessStage::workerLoop, this);
+    }
+}
+
+bool PostProcessStage::submit(ItemPtr item)
+{
+    if (!mAccepting)
+    {
+        ++mDropped;
+        return false;
+    }
+
+    item->enqueueTime = Clock::now();
+    if (!mQueue.tryPush(std::move(item)))
+    {
+        ++mDropped;
+        return false;
+    }
+    ++mSubmitted;
+
+    if (mWaitingConsumers.load() > 0)
+    {
+        std::lock_guard<std::mutex> locker(mWaitMutex);
+        mNotEmpty.notify_one();
+    }
+    return true;
+}
+
+void PostProcessStage::shutdown(bool drain)
+{
+    std::lock_guard<std::mutex> locker(mLifecycleMutex);
+    if (!mRunning)
+    {
+        return;
+    }
+
+    mAccepting = false;
+    mDraining = drain;
+    mStopping = true;
+    {
+        std::lock_guard<std::mutex> waitLocker(mWaitMutex);
+        mNotEmpty.notify_all();
+    }
+    for (auto &worker : mWorkers)
+    {
+        worker.join();
+    }
+    mWorkers.clear();
+
+    ItemPtr item;
+    while (mQueue.tryPop(item))
+    {
+        ++mDropped;
+    }
+
+    for (auto &handler : mHandlers)
+    {
+        handler->flush();
+    }
+    mRunning = false;
+}
+
+void PostProcessStage::workerLoop()
+{
+    TraceRecorder::setThreadName("post process");
+
+    ItemPtr item;
+    while (popItem(item))
+    {
+        process(*item);
+        // 在这里释放，图像和推理输出的最后一个引用可能就在这一项上
+        item.reset();
+    }
+}
+
+bool PostProcessStage::popItem(ItemPtr &item)
+{
+    for (;;)
+    {
+        if (mStopping && !mDraining)
+        {
+            return false;
+        }
+
+        if (mQueue.tryPop(item))
+        {
+            return true;
+        }
+
+        if (mStopping)
+        {
+            return false;
+        }
+
+        // 先登记再复查，保证不会错过submit()的唤醒
+        std::unique_lock<std::mutex> locker(mWaitMutex);
+        ++mWaitingConsumers;
+        if (mQueue.sizeApprox() == 0 && !mStopping)
+        {
+            mNotEmpty.wait_for(locker, kWaitSlice);
+        }
+        --mWaitingConsumers;
+    }
+}
+
+void PostProcessStage::process(PostProcessItem &item)
+{
+    auto start = Clock::now();
+    mQueueLatency.record(start - item.enqueueTime);
+    if (TraceRecorder::isEnabled())
+    {
+        TraceRecorder::instance().recordAsync("post queue", "post", item.enqueueTime, start, item.traceId);
+    }
+
+    auto handlerStart = start;
+    for (size_t i = 0; i < mHandlers.size(); ++i)
+    {
+        try
+        {
+            TraceSpan span(mHandlers[i]->name(), "post", item.traceId);
+            mHandlers[i]->handle(item);
+        }
+        catch (const std::exception &)
+        {
+            ++*mHandlerFailed[i];
+        }
+        auto handlerEnd = Clock::now();
+        mHandlerLatency[i]->record(handlerEnd - handlerStart);
+        handlerStart = handlerEnd;
+    }
+
+    mTotalLatency.record(handlerStart - item.enqueueTime);
+    ++mProcessed;
+}
+
+PostProcessStats PostProcessStage::stats() const
+{
+    PostProcessStats stats;
+    stats.submitted = mSubmitted.load();
+    stats.processed = mProcessed.load();
+    stats.dropped = mDropped.load();
+    stats.queue = mQueueLatency.snapshot();
+    stats.total = mTotalLatency.snapshot();
+    for (size_t i = 0; i < mHandlers.size(); ++i)
+    {
+        PostProcessHandlerStats handler;
+        handler.name = mHandlers[i]->name();
+        handler.latency = mHandlerLatency[i]->snapshot();
+        handler.failed = mHandlerFailed[i]->load();
+        stats.handlers.push_back(std::move(handler));
+    }
+    return stats;
+}
+
+void PostProcessStage::resetStats()
+{
+    mSubmitted = 0;
+    mProcessed = 0;
+    mDropped = 0;
+    mQueueLatency.reset();
+    mTotalLatency.reset();
+    for (size_t i = 0; i < mHandlers.size(); ++i)
+    {
+        mHandlerLatency[i]->reset();
+        *mHandlerFailed[i] = 0;
+    }
+}
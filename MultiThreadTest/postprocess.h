@@ -0,0 +1,151 @@
+﻿#ifndef POSTPROCESS_H
+#define POSTPROCESS_H
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <opencv2/opencv.hpp>
+
+#include "inferencebackend.h"
+#include "latencyhistogram.h"
+#include "mpmcqueue.h"
+
+enum class ResultVerdict
+{
+    Unknown,        // 还没有处理器判定
+    Pass,
+    Fail,
+};
+
+// 一张图的推理结果，在推理线程中构造后整个移交给后处理阶段
+// 图像和推理共用同一块数据，输出从InferenceResult中移过来，都不做深拷贝
+struct PostProcessItem
+{
+    int stream = 0;
+    long long sequence = 0;
+    cv::Mat image;                  // 只读，要画图的处理器自己拷一份
+    std::shared_ptr<void> keepAlive;    // 保证图像数据（文件映射、图像库）在后处理结束前有效
+    InferenceOutput output;
+    double queueMs = 0;             // 推理前的排队时间
+    double inferMs = 0;
+    long long traceId = -1;
+
+    // 由处理器填写，排在后面的处理器可以使用
+    ResultVerdict verdict = ResultVerdict::Unknown;
+
+    std::chrono::steady_clock::time_point enqueueTime;  // 进入后处理队列的时间，由submit()填写
+};
+
+// 结果处理器：统计、保存、画图……
+// 同一张图的所有处理器按添加的顺序在同一个后处理线程中依次执行；
+// 有多个后处理线程时，不同的图会在不同的线程中并发处理，实现要自己保证线程安全
+// 失败时抛出std::exception，只影响这一个处理器，后面的处理器照常执行
+class IResultHandler
+{
+public:
+    virtual ~IResultHandler() = default;
+
+    // 字符串常量，用于统计和trace
+    virtual const char *name() const = 0;
+
+    virtual void handle(PostProcessItem &item) = 0;
+
+    // 后处理线程全部退出之后调用一次，用于写出缓冲的数据
+    virtual void flush() {}
+};
+
+struct PostProcessConfig
+{
+    int threadCount = 1;
+    int queueCapacity = 256;        // 向上取整为2的幂
+};
+
+struct PostProcessHandlerStats
+{
+    std::string name;
+    LatencySnapshot latency;        // 每张图在这个处理器中的耗时
+    long long failed = 0;
+};
+
+struct PostProcessStats
+{
+    long long submitted = 0;
+    long long processed = 0;
+    long long dropped = 0;          // 队列满或者停止时没有处理的
+    LatencySnapshot queue;          // 在后处理队列中等待的时间
+    LatencySnapshot total;          // 从进入队列到所有处理器执行完
+    std::vector<PostProcessHandlerStats> handlers;
+};
+
+// 异步后处理阶段：推理线程把结果放进有界无锁队列后立即返回，后处理线程从队列中取出交给各个处理器
+// 队列满时直接丢弃并计数，后处理慢了也不会拖慢推理和节拍
+class PostProcessStage
+{
+public:
+    using ItemPtr = std::unique_ptr<PostProcessItem>;
+
+    explicit PostProcessStage(const PostProcessConfig &config = PostProcessConfig());
+    ~PostProcessStage();
+
+    PostProcessStage(const PostProcessStage &) = delete;
+    PostProcessStage &operator=(const PostProcessStage &) = delete;
+
+    // 只能在start()之前添加
+    void addHandler(std::shared_ptr<IResultHandler> handler);
+    const std::vector<std::shared_ptr<IResultHandler>> &handlers() const { return mHandlers; }
+
+    void start();
+
+    // 不阻塞；队列满或者已经停止时返回false，结果被丢弃
+    bool submit(ItemPtr item);
+
+    // 停止接收新结果并等后处理线程退出；drain为true时先把队列中的结果处理完
+    // 之后依次调用各个处理器的flush()
+    void shutdown(bool drain = true);
+
+    bool isRunning() const { return mRunning.load(); }
+    size_t queueDepth() const { return mQueue.sizeApprox(); }
+
+    PostProcessStats stats() const;
+
+    // 清空计数和耗时，用于跳过预热阶段
+    void resetStats();
+
+private:
+    void workerLoop();
+    bool popItem(ItemPtr &item);
+    void process(PostProcessItem &item);
+
+    PostProcessConfig mConfig;
+    std::vector<std::shared_ptr<IResultHandler>> mHandlers;
+    std::vector<std::unique_ptr<LatencyHistogram>> mHandlerLatency;
+    std::vector<std::unique_ptr<std::atomic<long long>>> mHandlerFailed;
+
+    MpmcQueue<ItemPtr> mQueue;
+
+    // 和线程池一样，锁和条件变量只用于队列空时让线程睡眠
+    std::mutex mWaitMutex;
+    std::condition_variable mNotEmpty;
+    std::atomic<int> mWaitingConsumers{0};
+
+    std::atomic<bool> mRunning{false};
+    std::atomic<bool> mAccepting{false};
+    std::atomic<bool> mStopping{false};
+    std::atomic<bool> mDraining{false};
+    std::mutex mLifecycleMutex;
+    std::vector<std::thread> mWorkers;
+
+    std::atomic<long long> mSubmitted{0};
+    std::atomic<long long> mProcessed{0};
+    std::atomic<long long> mDropped{0};
+    LatencyHistogram mQueueLatency;
+    LatencyHistogram mTotalLatency;
+};
+
+#endif // POSTPROCESS_H
@@ -0,0 +1,588 @@
+﻿#include "preprocess.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <sstream>
+
+#if defined(__x86_64__) || defined(__i386__) || defined(_M_X64) || defined(_M_IX86)
+#include <immintrin.h>
+#define SMORE_PREPROCESS_X86 1
+#if defined(_MSC_VER)
+#include <intrin.h>
+// MSVC不需要/arch:AVX2也能使用AVX2的intrinsics
+#define SMORE_TARGET_AVX2
+#else
+// 只有这几个函数按AVX2编译，其余代码仍能在老CPU上运行
+#define SMORE_TARGET_AVX2 __attribute__((target("avx2")))
+#endif
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__)
+#include <arm_neon.h>
+#define SMORE_PREPROCESS_NEON 1
+#endif
+
+namespace {
+
+const int kWeightBits = 11;                 // 插值权重的定点位数，和cv::resize的INTER_LINEAR相同
+const int kWeightOne = 1 << kWeightBits;
+const int kBlendShift = kWeightBits * 2;
+const int kBlendRound = 1 << (kBlendShift - 1);
+
+bool parseDouble(const std::string &text, double &value)
+{
+    char *end = nullptr;
+    value = std::strtod(text.c_str(), &end);
+    return !text.empty() && end && *end == '\0';
+}
+
+// 一行的转换内核，count都是像素数（narrow16为元素数）
+struct Kernels
+{
+    const char *isa;
+    void (*grayToBgr)(const uchar *src, uchar *dst, int count);
+    void (*bgraToBgr)(const uchar *src, uchar *dst, int count);
+    void (*narrow16)(const ushort *src, uchar *dst, int count, unsigned short scale);
+    void (*blendRows)(const int *row0, const int *row1, uchar *dst, int count, int weight);
+};
+
+void grayToBgrScalar(const uchar *src, uchar *dst, int count)
+{
+    for (int i = 0; i < count; ++i)
+    {
+        dst[i * 3] = dst[i * 3 + 1] = dst[i * 3 + 2] = src[i];
+    }
+}
+
+void bgraToBgrScalar(const uchar *src, uchar *dst, int count)
+{
+    for (int i = 0; i < count; ++i)
+    {
+        dst[i * 3] = src[i * 4];
+        dst[i * 3 + 1] = src[i * 4 + 1];
+        dst[i * 3 + 2] = src[i * 4 + 2];
+    }
+}
+
+// (v * scale) / 65536，四舍五入，超过255（有效位数之外有值）时饱和
+inline uchar narrowValue(ushort value, unsigned short scale)
+{
+    unsigned int scaled = ((unsigned int)value * scale + 0x8000) >> 16;
+    return (uchar)std::min(scaled, 255u);
+}
+
+void narrow16Scalar(const ushort *src, uchar *dst, int count, unsigned short scale)
+{
+    for (int i = 0; i < count; ++i)
+    {
+        dst[i] = narrowValue(src[i], scale);
+    }
+}
+
+// 两个水平插值过的源行按垂直权重混合；两个权重之和为kWeightOne，结果不会超过255
+void blendRowsScalar(const int *row0, const int *row1, uchar *dst, int count, int weight)
+{
+    int weight0 = kWeightOne - weight;
+    for (int i = 0; i < count; ++i)
+    {
+        dst[i] = (uchar)((row0[i] * weight0 + row1[i] * weight + kBlendRound) >> kBlendShift);
+    }
+}
+
+#if defined(SMORE_PREPROCESS_X86)
+
+// 每32个灰度值展开成96字节：pshufb只能在128位的半边内部重排，
+// 两个半边各得到16个像素的48字节，再用vperm2i128拼成连续的3个256位
+SMORE_TARGET_AVX2 void grayToBgrAvx2(const uchar *src, uchar *dst, int count)
+{
+    const __m256i mask0 = _mm256_setr_epi8(0, 0, 0, 1, 1, 1, 2, 2, 2, 3, 3, 3, 4, 4, 4, 5,
+                                           0, 0, 0, 1, 1, 1, 2, 2, 2, 3, 3, 3, 4, 4, 4, 5);
+    const __m256i mask1 = _mm256_setr_epi8(5, 5, 6, 6, 6, 7, 7, 7, 8, 8, 8, 9, 9, 9, 10, 10,
+                                           5, 5, 6, 6, 6, 7, 7, 7, 8, 8, 8, 9, 9, 9, 10, 10);
+    const __m256i mask2 = _mm256_setr_epi8(10, 11, 11, 11, 12, 12, 12, 13, 13, 13, 14, 14, 14, 15, 15, 15,
+                                           10, 11, 11, 11, 12, 12, 12, 13, 13, 13, 14, 14, 14, 15, 15, 15);
+    int i = 0;
+    for (; i + 32 <= count; i += 32)
+    {
+        __m256i gray = _mm256_loadu_si256((const __m256i *)(src + i));
+        __m256i r0 = _mm256_shuffle_epi8(gray, mask0);
+        __m256i r1 = _mm256_shuffle_epi8(gray, mask1);
+        __m256i r2 = _mm256_shuffle_epi8(gray, mask2);
+        uchar *out = dst + i * 3;
+        _mm256_storeu_si256((__m256i *)out, _mm256_permute2x128_si256(r0, r1, 0x20));
+        _mm256_storeu_si256((__m256i *)(out + 32), _mm256_permute2x128_si256(r2, r0, 0x30));
+        _mm256_storeu_si256((__m256i *)(out + 64), _mm256_permute2x128_si256(r1, r2, 0x31));
+    }
+    grayToBgrScalar(src + i, dst + i * 3, count - i);
+}
+
+// 每8个像素：pshufb去掉每个半边的alpha，vpermd把两个半边的12字节拼成连续的24字节
+// 存储时写32字节，多出的8字节被下一次存储覆盖，所以最后要留出至少8字节给标量处理
+SMORE_TARGET_AVX2 void bgraToBgrAvx2(const uchar *src, uchar *dst, int count)
+{
+    const __m256i mask = _mm256_setr_epi8(0, 1, 2, 4, 5, 6, 8, 9, 10, 12, 13, 14, -1, -1, -1, -1,
+                                          0, 1, 2, 4, 5, 6, 8, 9, 10, 12, 13, 14, -1, -1, -1, -1);
+    const __m256i pack = _mm256_setr_epi32(0, 1, 2, 4, 5, 6, 7, 7);
+    int i = 0;
+    for (; i + 35 <= count; i += 32)
+    {
+        for (int k = 0; k < 4; ++k)
+        {
+            __m256i bgra = _mm256_loadu_si256((const __m256i *)(src + (i + k * 8) * 4));
+            __m256i bgr = _mm256_permutevar8x32_epi32(_mm256_shuffle_epi8(bgra, mask), pack);
+            _mm256_storeu_si256((__m256i *)(dst + (i + k * 8) * 3), bgr);
+        }
+    }
+    bgraToBgrScalar(src + i * 4, dst + i * 3, count - i);
+}
+
+// 乘法的高16位加上低16位的最高位，就是四舍五入的(v * scale) >> 16，和标量实现逐位相同
+SMORE_TARGET_AVX2 inline __m256i narrowAvx2(__m256i value, __m256i scale)
+{
+    __m256i high = _mm256_mulhi_epu16(value, scale);
+    __m256i round = _mm256_srli_epi16(_mm256_mullo_epi16(value, scale), 15);
+    return _mm256_add_epi16(high, round);
+}
+
+SMORE_TARGET_AVX2 void narrow16Avx2(const ushort *src, uchar *dst, int count, unsigned short scale)
+{
+    const __m256i factor = _mm256_set1_epi16((short)scale);
+    int i = 0;
+    for (; i + 32 <= count; i += 32)
+    {
+        __m256i a = narrowAvx2(_mm256_loadu_si256((const __m256i *)(src + i)), factor);
+        __m256i b = narrowAvx2(_mm256_loadu_si256((const __m256i *)(src + i + 16)), factor);
+        // packus按128位半边交错，vpermq恢复顺序
+        __m256i packed = _mm256_permute4x64_epi64(_mm256_packus_epi16(a, b), 0xD8);
+        _mm256_storeu_si256((__m256i *)(dst + i), packed);
+    }
+    narrow16Scalar(src + i, dst + i, count - i, scale);
+}
+
+SMORE_TARGET_AVX2 inline __m256i blendAvx2(const int *row0, const int *row1, __m256i weight0, __m256i weight1)
+{
+    __m256i a = _mm256_mullo_epi32(_mm256_loadu_si256((const __m256i *)row0), weight0);
+    __m256i b = _mm256_mullo_epi32(_mm256_loadu_si256((const __m256i *)row1), weight1);
+    __m256i sum = _mm256_add_epi32(_mm256_add_epi32(a, b), _mm256_set1_epi32(kBlendRound));
+    return _mm256_srai_epi32(sum, kBlendShift);
+}
+
+SMORE_TARGET_AVX2 void blendRowsAvx2(const int *row0, const int *row1, uchar *dst, int count, int weight)
+{
+    const __m256i weight0 = _mm256_set1_epi32(kWeightOne - weight);
+    const __m256i weight1 = _mm256_set1_epi32(weight);
+    const __m256i order = _mm256_setr_epi32(0, 4, 1, 5, 2, 6, 3, 7);
+    int i = 0;
+    for (; i + 32 <= count; i += 32)
+    {
+        __m256i a = blendAvx2(row0 + i, row1 + i, weight0, weight1);
+        __m256i b = blendAvx2(row0 + i + 8, row1 + i + 8, weight0, weight1);
+        __m256i c = blendAvx2(row0 + i + 16, row1 + i + 16, weight0, weight1);
+        __m256i d = blendAvx2(row0 + i + 24, row1 + i + 24, weight0, weight1);
+        __m256i packed = _mm256_packus_epi16(_mm256_packs_epi32(a, b), _mm256_packs_epi32(c, d));
+        _mm256_storeu_si256((__m256i *)(dst + i), _mm256_permutevar8x32_epi32(packed, order));
+    }
+    blendRowsScalar(row0 + i, row1 + i, dst + i, count - i, weight);
+}
+
+bool cpuHasAvx2()
+{
+#if defined(_MSC_VER)
+    int info[4];
+    __cpuid(info, 0);
+    if (info[0] < 7)
+    {
+        return false;
+    }
+    __cpuid(info, 1);
+    bool osxsave = (info[2] & (1 << 27)) != 0;
+    bool avx = (info[2] & (1 << 28)) != 0;
+    // 操作系统要保存YMM寄存器
+    if (!osxsave || !avx || (_xgetbv(0) & 6) != 6)
+    {
+        return false;
+    }
+    __cpuidex(info, 7, 0);
+    return (info[1] & (1 << 5)) != 0;
+#else
+    __builtin_cpu_init();
+    return __builtin_cpu_supports("avx2");
+#endif
+}
+
+#elif defined(SMORE_PREPROCESS_NEON)
+
+// NEON的交错读写指令直接完成通道的展开和去除
+void grayToBgrNeon(const uchar *src, uchar *dst, int count)
+{
+    int i = 0;
+    for (; i + 16 <= count; i += 16)
+    {
+        uint8x16_t gray = vld1q_u8(src + i);
+        uint8x16x3_t bgr = {{gray, gray, gray}};
+        vst3q_u8(dst + i * 3, bgr);
+    }
+    grayToBgrScalar(src + i, dst + i * 3, count - i);
+}
+
+void bgraToBgrNeon(const uchar *src, uchar *dst, int count)
+{
+    int i = 0;
+    for (; i + 16 <= count; i += 16)
+    {
+        uint8x16x4_t bgra = vld4q_u8(src + i * 4);
+        uint8x16x3_t bgr = {{bgra.val[0], bgra.val[1], bgra.val[2]}};
+        vst3q_u8(dst + i * 3, bgr);
+    }
+    bgraToBgrScalar(src + i * 4, dst + i * 3, count - i);
+}
+
+void narrow16Neon(const ushort *src, uchar *dst, int count, unsigned short scale)
+{
+    const uint16x4_t factor = vdup_n_u16(scale);
+    int i = 0;
+    for (; i + 16 <= count; i += 16)
+    {
+        uint16x8_t a = vld1q_u16(src + i);
+        uint16x8_t b = vld1q_u16(src + i + 8);
+        // 乘到32位，带舍入右移16位再饱和到8位
+        uint16x8_t na = vcombine_u16(vrshrn_n_u32(vmull_u16(vget_low_u16(a), factor), 16),
+                                     vrshrn_n_u32(vmull_u16(vget_high_u16(a), factor), 16));
+        uint16x8_t nb = vcombine_u16(vrshrn_n_u32(vmull_u16(vget_low_u16(b), factor), 16),
+                                     vrshrn_n_u32(vmull_u16(vget_high_u16(b), factor), 16));
+        vst1q_u8(dst + i, vcombine_u8(vqmovn_u16(na), vqmovn_u16(nb)));
+    }
+    narrow16Scalar(src + i, dst + i, count - i, scale);
+}
+
+inline int16x4_t blendNeon(const int *row0, const int *row1, int weight0, int weight1)
+{
+    int32x4_t sum = vmulq_n_s32(vld1q_s32(row0), weight0);
+    sum = vmlaq_n_s32(sum, vld1q_s32(row1), weight1);
+    return vmovn_s32(vshrq_n_s32(vaddq_s32(sum, vdupq_n_s32(kBlendRound)), kBlendShift));
+}
+
+void blendRowsNeon(const int *row0, const int *row1, uchar *dst, int count, int weight)
+{
+    int weight0 = kWeightOne - weight;
+    int i = 0;
+    for (; i + 8 <= count; i += 8)
+    {
+        int16x8_t value = vcombine_s16(blendNeon(row0 + i, row1 + i, weight0, weight),
+                                       blendNeon(row0 + i + 4, row1 + i + 4, weight0, weight));
+        vst1_u8(dst + i, vqmovun_s16(value));
+    }
+    blendRowsScalar(row0 + i, row1 + i, dst + i, count - i, weight);
+}
+
+#endif
+
+const Kernels &scalarKernels()
+{
+    static const Kernels kernels = {"scalar", grayToBgrScalar, bgraToBgrScalar, narrow16Scalar, blendRowsScalar};
+    return kernels;
+}
+
+const Kernels &simdKernels()
+{
+#if defined(SMORE_PREPROCESS_X86)
+    static const Kernels avx2 = {"avx2", grayToBgrAvx2, bgraToBgrAvx2, narrow16Avx2, blendRowsAvx2};
+    static const bool hasAvx2 = cpuHasAvx2();
+    return hasAvx2 ? avx2 : scalarKernels();
+#elif defined(SMORE_PREPROCESS_NEON)
+    static const Kernels neon = {"neon", grayToBgrNeon, bgraToBgrNeon, narrow16Neon, blendRowsNeon};
+    return neon;
+#else
+    return scalarKernels();
+#endif
+}
+
+const Kernels &kernelsFor(bool simd)
+{
+    return simd ? simdKernels() : scalarKernels();
+}
+
+} // namespace
+
+const char *preprocessSpecHelp()
+{
+    return "off（不做预处理）, w=<模型输入宽>, h=<模型输入高>, bits=<16位图像的有效位数>, simd=<0/1>";
+}
+
+bool parsePreprocessSpec(const std::string &spec, PreprocessConfig &config, std::string *errorMessage)
+{
+    auto fail = [&](const std::string &message) {
+        if (errorMessage)
+        {
+            *errorMessage = message;
+        }
+        return false;
+    };
+
+    std::stringstream stream(spec);
+    std::string item;
+    while (std::getline(stream, item, ','))
+    {
+        if (item.empty())
+        {
+            continue;
+        }
+        if (item == "off")
+        {
+            config.enabled = false;
+            continue;
+        }
+        size_t eq = item.find('=');
+        if (eq == std::string::npos)
+        {
+            return fail("缺少'=': " + item);
+        }
+        std::string key = item.substr(0, eq);
+        double value = 0;
+        if (!parseDouble(item.substr(eq + 1), value))
+        {
+            return fail("无效的数值: " + item);
+        }
+        if (key == "w") config.width = (int)value;
+        else if (key == "h") config.height = (int)value;
+        else if (key == "bits") config.bits = (int)value;
+        else if (key == "simd") config.simd = value != 0;
+        else return fail("未知的参数: " + key);
+    }
+
+    if (config.width < 0 || config.height < 0 || (config.width > 0) != (config.height > 0))
+    {
+        return fail("模型输入的宽和高要同时给出");
+    }
+    if (config.bits < 9 || config.bits > 16)
+    {
+        return fail("有效位数必须在9到16之间");
+    }
+    return true;
+}
+
+const char *preprocessIsa()
+{
+    return simdKernels().isa;
+}
+
+FramePreprocessor::FramePreprocessor(const PreprocessConfig &config)
+    : mConfig(config)
+{
+    mConfig.bits = std::max(9, std::min(16, mConfig.bits));
+    mSimd = mConfig.simd;
+    mScale16 = (unsigned short)std::lround(255.0 * 65536.0 / ((1 << mConfig.bits) - 1));
+    mHorizontalY[0] = mHorizontalY[1] = -1;
+}
+
+bool FramePreprocessor::isPassThrough(const cv::Mat &src) const
+{
+    if (!mConfig.enabled)
+    {
+        return true;
+    }
+    bool sizeMatches = mConfig.width <= 0 || mConfig.height <= 0
+            || (src.cols == mConfig.width && src.rows == mConfig.height);
+    return src.type() == CV_8UC3 && sizeMatches;
+}
+
+bool FramePreprocessor::process(const cv::Mat &src, cv::Mat &dst)
+{
+    if (src.empty())
+    {
+        return false;
+    }
+    // dst可能就是src，先持有输入的数据
+    cv::Mat input = src;
+    if (isPassThrough(input))
+    {
+        dst = input;
+        return true;
+    }
+
+    int depth = input.depth();
+    int channels = input.channels();
+    if ((depth != CV_8U && depth != CV_16U) || (channels != 1 && channels != 3 && channels != 4))
+    {
+        return processGeneric(input, dst);
+    }
+
+    if (mNarrowRow.size() < (size_t)input.cols * 4)
+    {
+        mNarrowRow.resize((size_t)input.cols * 4);
+    }
+
+    bool resize = mConfig.width > 0 && mConfig.height > 0
+            && (input.cols != mConfig.width || input.rows != mConfig.height);
+    if (!resize)
+    {
+        // 直接转换到输出行上
+        dst.create(input.rows, input.cols, CV_8UC3);
+        for (int y = 0; y < input.rows; ++y)
+        {
+            convertRow(input, y, dst.ptr<uchar>(y));
+        }
+        return true;
+    }
+
+    prepareResize(input);
+    dst.create(mConfig.height, mConfig.width, CV_8UC3);
+
+    const Kernels &kernels = kernelsFor(mSimd);
+    mHorizontalY[0] = mHorizontalY[1] = -1;
+    for (int y = 0; y < mConfig.height; ++y)
+    {
+        int y0 = mYOffset[y * 2];
+        int y1 = mYOffset[y * 2 + 1];
+        const int *row0 = horizontalRow(input, y0, y1);
+        const int *row1 = horizontalRow(input, y1, y0);
+        kernels.blendRows(row0, row1, dst.ptr<uchar>(y), mConfig.width * 3, mYWeight[y]);
+    }
+    return true;
+}
+
+const uchar *FramePreprocessor::convertRow(const cv::Mat &src, int y, uchar *buffer)
+{
+    const Kernels &kernels = kernelsFor(mSimd);
+    int width = src.cols;
+    if (src.depth() == CV_8U)
+    {
+        const uchar *row = src.ptr<uchar>(y);
+        switch (src.channels())
+        {
+        case 1:
+            kernels.grayToBgr(row, buffer, width);
+            return buffer;
+        case 4:
+            kernels.bgraToBgr(row, buffer, width);
+            return buffer;
+        default:
+            return row;
+        }
+    }
+
+    // 16位先缩放到8位，单通道和4通道再展开/去掉alpha，一行在L1中完成
+    const ushort *row = src.ptr<ushort>(y);
+    switch (src.channels())
+    {
+    case 1:
+        kernels.narrow16(row, mNarrowRow.data(), width, mScale16);
+        kernels.grayToBgr(mNarrowRow.data(), buffer, width);
+        break;
+    case 4:
+        kernels.narrow16(row, mNarrowRow.data(), width * 4, mScale16);
+        kernels.bgraToBgr(mNarrowRow.data(), buffer, width);
+        break;
+    default:
+        kernels.narrow16(row, buffer, width * 3, mScale16);
+        break;
+    }
+    return buffer;
+}
+
+void FramePreprocessor::prepareResize(const cv::Mat &src)
+{
+    cv::Size target(mConfig.width, mConfig.height);
+    if (mTableSrc == src.size() && mTableDst == target)
+    {
+        return;
+    }
+    mTableSrc = src.size();
+    mTableDst = target;
+
+    // 和INTER_LINEAR相同的像素中心对齐：源坐标 = (输出坐标 + 0.5) * 比例 - 0.5，越界时夹到边缘
+    auto buildTable = [](int srcLength, int dstLength, int step, std::vector<int> &offsets, std::vector<short> &weights) {
+        offsets.resize(dstLength * 2);
+        weights.resize(dstLength);
+        double scale = (double)srcLength / dstLength;
+        for (int i = 0; i < dstLength; ++i)
+        {
+            double position = (i + 0.5) * scale - 0.5;
+            int index = (int)std::floor(position);
+            double fraction = position - index;
+            if (index < 0)
+            {
+                index = 0;
+                fraction = 0;
+            }
+            if (index >= srcLength - 1)
+            {
+                index = srcLength - 1;
+                fraction = 0;
+            }
+            offsets[i * 2] = index * step;
+            offsets[i * 2 + 1] = std::min(index + 1, srcLength - 1) * step;
+            weights[i] = (short)std::lround(fraction * kWeightOne);
+        }
+    };
+    buildTable(src.cols, target.width, 3, mXOffset, mXWeight);
+    buildTable(src.rows, target.height, 1, mYOffset, mYWeight);
+
+    mBgrRow.resize((size_t)src.cols * 3);
+    mHorizontal[0].resize((size_t)target.width * 3);
+    mHorizontal[1].resize((size_t)target.width * 3);
+}
+
+const int *FramePreprocessor::horizontalRow(const cv::Mat &src, int y, int keepY)
+{
+    for (int slot = 0; slot < 2; ++slot)
+    {
+        if (mHorizontalY[slot] == y)
+        {
+            return mHorizontal[slot].data();
+        }
+    }
+
+    // 不覆盖这一输出行还要用的另一行
+    int slot = mHorizontalY[0] == keepY ? 1 : 0;
+    const uchar *bgr = convertRow(src, y, mBgrRow.data());
+    int *out = mHorizontal[slot].data();
+    for (int x = 0; x < mConfig.width; ++x)
+    {
+        const uchar *left = bgr + mXOffset[x * 2];
+        const uchar *right = bgr + mXOffset[x * 2 + 1];
+        int weight = mXWeight[x];
+        int weight0 = kWeightOne - weight;
+        out[x * 3] = left[0] * weight0 + right[0] * weight;
+        out[x * 3 + 1] = left[1] * weight0 + right[1] * weight;
+        out[x * 3 + 2] = left[2] * weight0 + right[2] * weight;
+    }
+    mHorizontalY[slot] = y;
+    return out;
+}
+
+bool FramePreprocessor::processGeneric(const cv::Mat &src, cv::Mat &dst) const
+{
+    cv::Mat image = src;
+    if (image.depth() != CV_8U)
+    {
+        cv::Mat narrowed;
+        image.convertTo(narrowed, CV_8U);
+        image = narrowed;
+    }
+
+    cv::Mat bgr;
+    switch (image.channels())
+    {
+    case 1:
+        cv::cvtColor(image, bgr, cv::COLOR_GRAY2BGR);
+        break;
+    case 3:
+        bgr = image;
+        break;
+    case 4:
+        cv::cvtColor(image, bgr, cv::COLOR_BGRA2BGR);
+        break;
+    default:
+        return false;
+    }
+
+    if (mConfig.width > 0 && mConfig.height > 0 && bgr.size() != cv::Size(mConfig.width, mConfig.height))
+    {
+        cv::resize(bgr, dst, cv::Size(mConfig.width, mConfig.height), 0, 0, cv::INTER_LINEAR);
+    }
+    else
+    {
+        dst = bgr;
+    }
+    return true;
+}
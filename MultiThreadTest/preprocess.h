@@ -0,0 +1,71 @@
+﻿#ifndef PREPROCESS_H
+#define PREPROCESS_H
+
+#include <string>
+#include <vector>
+
+#include <opencv2/opencv.hpp>
+
+// 送进模型之前的预处理：loadMatFromPath和MappedImageReader都按IMREAD_UNCHANGED解码，
+// 16位TIFF、灰度BMP、带透明通道的PNG会原样到达vimo::Request，由SDK在推理线程里再转换一次
+// 预处理在解码线程（或预加载时）就把每帧转成模型的输入格式：8位BGR，可选缩放到模型输入尺寸
+struct PreprocessConfig
+{
+    bool enabled = true;
+    int width = 0;          // 模型输入尺寸，0表示不缩放
+    int height = 0;
+    int bits = 16;          // 16位图像的有效位数（12位相机为12），按(2^bits-1)线性缩放到255
+    bool simd = true;       // false时强制使用标量实现，对比用
+};
+
+// 把"w=1024,h=768,bits=12"这样的描述解析到config中，没有出现的键保持原值；"off"关闭预处理
+bool parsePreprocessSpec(const std::string &spec, PreprocessConfig &config, std::string *errorMessage = nullptr);
+const char *preprocessSpecHelp();
+
+// 当前CPU上实际使用的指令集："avx2"、"neon"或"scalar"
+const char *preprocessIsa();
+
+// 预处理器：16位->8位缩放、灰度->BGR、BGRA->BGR和双线性缩放在一遍中完成，
+// 逐行转换，缩放时只转换用到的源行，不生成整张的中间图
+// 8位/16位的1、3、4通道有专门的内核（x86上运行时检测AVX2，ARM上用NEON），其他类型退回cv::cvtColor/cv::resize
+// 内部有行缓冲区，不是线程安全的，每个解码线程一个
+class FramePreprocessor
+{
+public:
+    explicit FramePreprocessor(const PreprocessConfig &config = PreprocessConfig());
+
+    // 转换src到dst；src已经是目标格式时dst直接引用src，不拷贝
+    // 失败（空图、不支持的类型）时返回false
+    bool process(const cv::Mat &src, cv::Mat &dst);
+
+    // 不做任何转换就能直接送进模型
+    bool isPassThrough(const cv::Mat &src) const;
+
+    const PreprocessConfig &config() const { return mConfig; }
+
+private:
+    // 把src的第y行转成8位BGR，返回行指针（已是8位BGR时直接返回源行）
+    const uchar *convertRow(const cv::Mat &src, int y, uchar *buffer);
+    void prepareResize(const cv::Mat &src);
+    const int *horizontalRow(const cv::Mat &src, int y, int keepY);
+    bool processGeneric(const cv::Mat &src, cv::Mat &dst) const;
+
+    PreprocessConfig mConfig;
+    bool mSimd;
+    unsigned short mScale16 = 0;    // 16位->8位的定点系数（乘后取高16位）
+
+    std::vector<uchar> mNarrowRow;  // 16位缩放后、展开通道前的行
+    std::vector<uchar> mBgrRow;     // 缩放时转换好的一行源图
+    std::vector<int> mHorizontal[2];    // 最近两个源行的水平插值结果，相邻的输出行大多共用
+    int mHorizontalY[2];
+
+    // 缩放的坐标表，源尺寸不变时复用
+    cv::Size mTableSrc;
+    cv::Size mTableDst;
+    std::vector<int> mXOffset;      // 每个输出像素左右两个源像素的字节偏移
+    std::vector<short> mXWeight;    // 右侧源像素的权重，定点11位
+    std::vector<int> mYOffset;      // 每个输出行上下两个源行
+    std::vector<short> mYWeight;
+};
+
+#endif // PREPROCESS_H
@@ -0,0 +1,68 @@
+﻿#include "processmemory.h"
+
+#if defined(_WIN32)
+#define NOMINMAX
+#include <windows.h>
+#include <psapi.h>
+#elif defined(__linux__)
+#include <cstdio>
+#include <cstring>
+#endif
+
+#if defined(__linux__)
+// 从/proc/self/status中读取形如"VmRSS:  1234 kB"的字段
+static long long readStatusKb(const char *key)
+{
+    FILE *fp = std::fopen("/proc/self/status", "r");
+    if (!fp)
+    {
+        return -1;
+    }
+
+    long long value = -1;
+    char line[256];
+    size_t keyLen = std::strlen(key);
+    while (std::fgets(line, sizeof(line), fp))
+    {
+        if (std::strncmp(line, key, keyLen) == 0)
+        {
+            std::sscanf(line + keyLen, "%lld", &value);
+            break;
+        }
+    }
+    std::fclose(fp);
+    return value < 0 ? -1 : value * 1024;
+}
+#endif
+
+long long currentResidentBytes()
+{
+#if defined(_WIN32)
+    PROCESS_MEMORY_COUNTERS pmc;
+    if (K32GetProcessMemoryInfo(GetCurrentProcess(), &pmc, sizeof(pmc)))
+    {
+        return (long long)pmc.WorkingSetSize;
+    }
+    return -1;
+#elif defined(__linux__)
+    return readStatusKb("VmRSS:");
+#else
+    return -1;
+#endif
+}
+
+long long peakResidentBytes()
+{
+#if defined(_WIN32)
+    PROCESS_MEMORY_COUNTERS pmc;
+    if (K32GetProcessMemoryInfo(GetCurrentProcess(), &pmc, sizeof(pmc)))
+    {
+        return (long long)pmc.PeakWorkingSetSize;
+    }
+    return -1;
+#elif defined(__linux__)
+    return readStatusKb("VmHWM:");
+#else
+    return -1;
+#endif
+}
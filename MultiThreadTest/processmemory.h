@@ -0,0 +1,10 @@
+﻿#ifndef PROCESSMEMORY_H
+#define PROCESSMEMORY_H
+
+// 当前进程的常驻内存（字节），获取失败时返回-1
+long long currentResidentBytes();
+
+// 当前进程的常驻内存峰值（字节），获取失败时返回-1
+long long peakResidentBytes();
+
+#endif // PROCESSMEMORY_H
@@ -0,0 +1,371 @@
+﻿#include "resultcache.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstring>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define SMORE_HASH_SSE2 1
+#endif
+
+using Clock = std::chrono::steady_clock;
+
+namespace {
+
+const uint64_t kPrime32 = 0x9E3779B1ULL;
+const uint64_t kPrime64a = 0x9E3779B185EBCA87ULL;
+const uint64_t kPrime64b = 0xC2B2AE3D27D4EB4FULL;
+
+const int kLanes = 8;                   // 一个条带64字节
+const int kStripesPerBlock = 16;        // 每1KB打散一次累加器
+
+uint64_t splitmix(uint64_t &state)
+{
+    uint64_t z = (state += 0x9E3779B97F4A7C15ULL);
+    z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+    z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+    return z ^ (z >> 31);
+}
+
+// 密钥：每个条带错开8字节使用，最后8个用于打散
+struct Secret
+{
+    uint64_t words[kStripesPerBlock + kLanes];
+
+    Secret()
+    {
+        uint64_t state = 0x5A4D6F7265ULL;
+        for (uint64_t &word : words)
+        {
+            word = splitmix(state);
+        }
+    }
+};
+
+const Secret &secret()
+{
+    static const Secret s;
+    return s;
+}
+
+uint64_t read64(const unsigned char *p)
+{
+    uint64_t v;
+    std::memcpy(&v, p, 8);
+    return v;
+}
+
+// 没有依赖链的8路累加，每路只有一次32x32->64位乘法
+inline void accumulateStripe(uint64_t *acc, const unsigned char *p, const uint64_t *key)
+{
+    for (int i = 0; i < kLanes; ++i)
+    {
+        uint64_t data = read64(p + 8 * i);
+        uint64_t mixed = data ^ key[i];
+        acc[i ^ 1] += data;
+        acc[i] += (mixed & 0xFFFFFFFFULL) * (mixed >> 32);
+    }
+}
+
+inline void scramble(uint64_t *acc, const uint64_t *key)
+{
+    for (int i = 0; i < kLanes; ++i)
+    {
+        uint64_t a = acc[i];
+        a ^= a >> 47;
+        a ^= key[i];
+        acc[i] = a * kPrime32;
+    }
+}
+
+// 连续count个条带，stripe为第一个条带在块中的位置，返回处理完之后的位置
+// SSE2时累加器放在4个寄存器中，pmuludq一次做2路乘法；结果和逐个accumulateStripe相同
+int accumulateStripes(uint64_t *acc, const unsigned char *p, size_t count, int stripe)
+{
+    const uint64_t *key = secret().words;
+#ifdef SMORE_HASH_SSE2
+    __m128i a[kLanes / 2];
+    for (int j = 0; j < kLanes / 2; ++j)
+    {
+        a[j] = _mm_loadu_si128(reinterpret_cast<const __m128i *>(acc + 2 * j));
+    }
+    const __m128i prime = _mm_set1_epi32((int)kPrime32);
+    for (size_t n = 0; n < count; ++n, p += 8 * kLanes)
+    {
+        for (int j = 0; j < kLanes / 2; ++j)
+        {
+            __m128i data = _mm_loadu_si128(reinterpret_cast<const __m128i *>(p + 16 * j));
+            __m128i k = _mm_loadu_si128(reinterpret_cast<const __m128i *>(key + stripe + 2 * j));
+            __m128i mixed = _mm_xor_si128(data, k);
+            __m128i product = _mm_mul_epu32(mixed, _mm_shuffle_epi32(mixed, _MM_SHUFFLE(2, 3, 0, 1)));
+            a[j] = _mm_add_epi64(a[j], _mm_shuffle_epi32(data, _MM_SHUFFLE(1, 0, 3, 2)));
+            a[j] = _mm_add_epi64(a[j], product);
+        }
+        if (++stripe == kStripesPerBlock)
+        {
+            for (int j = 0; j < kLanes / 2; ++j)
+            {
+                __m128i v = _mm_xor_si128(a[j], _mm_srli_epi64(a[j], 47));
+                v = _mm_xor_si128(v, _mm_loadu_si128(reinterpret_cast<const __m128i *>(key + kStripesPerBlock + 2 * j)));
+                __m128i low = _mm_mul_epu32(v, prime);
+                __m128i high = _mm_mul_epu32(_mm_srli_epi64(v, 32), prime);
+                a[j] = _mm_add_epi64(low, _mm_slli_epi64(high, 32));
+            }
+            stripe = 0;
+        }
+    }
+    for (int j = 0; j < kLanes / 2; ++j)
+    {
+        _mm_storeu_si128(reinterpret_cast<__m128i *>(acc + 2 * j), a[j]);
+    }
+#else
+    for (size_t n = 0; n < count; ++n, p += 8 * kLanes)
+    {
+        accumulateStripe(acc, p, key + stripe);
+        if (++stripe == kStripesPerBlock)
+        {
+            scramble(acc, key + kStripesPerBlock);
+            stripe = 0;
+        }
+    }
+#endif
+    return stripe;
+}
+
+uint64_t avalanche(uint64_t h)
+{
+    h ^= h >> 33;
+    h *= kPrime64b;
+    h ^= h >> 29;
+    h *= kPrime64a;
+    h ^= h >> 32;
+    return h;
+}
+
+// 按条带累加的哈希状态，数据可以分几次送进来（不连续的ROI逐行送），结果只和内容有关
+class StripeHasher
+{
+public:
+    explicit StripeHasher(uint64_t seed)
+        : mSeed(seed)
+    {
+        const uint64_t *key = secret().words;
+        for (int i = 0; i < kLanes; ++i)
+        {
+            mAcc[i] = key[i] ^ (seed + (uint64_t)i * kPrime64a);
+        }
+    }
+
+    void update(const unsigned char *p, size_t size)
+    {
+        mTotal += size;
+
+        // 先把上次剩下的不足一个条带的部分补满
+        if (mPending > 0)
+        {
+            size_t take = std::min(size, kStripeBytes - mPending);
+            std::memcpy(mBuffer + mPending, p, take);
+            mPending += take;
+            p += take;
+            size -= take;
+            if (mPending < kStripeBytes)
+            {
+                return;
+            }
+            mStripe = accumulateStripes(mAcc, mBuffer, 1, mStripe);
+            mPending = 0;
+        }
+
+        size_t stripes = size / kStripeBytes;
+        mStripe = accumulateStripes(mAcc, p, stripes, mStripe);
+        p += stripes * kStripeBytes;
+        size -= stripes * kStripeBytes;
+        if (size > 0)
+        {
+            std::memcpy(mBuffer, p, size);
+            mPending = size;
+        }
+    }
+
+    uint64_t finish()
+    {
+        const uint64_t *key = secret().words;
+
+        // 不足一个条带的尾部补零
+        if (mPending > 0)
+        {
+            std::memset(mBuffer + mPending, 0, kStripeBytes - mPending);
+            accumulateStripe(mAcc, mBuffer, key + mStripe);
+        }
+
+        uint64_t h = (uint64_t)mTotal * kPrime64a ^ mSeed;
+        for (int i = 0; i < kLanes; ++i)
+        {
+            h ^= avalanche(mAcc[i] + key[kStripesPerBlock + i]);
+            h = ((h << 27) | (h >> 37)) * kPrime64b;
+        }
+        return avalanche(h);
+    }
+
+private:
+    static const size_t kStripeBytes = 8 * kLanes;
+
+    uint64_t mSeed;
+    uint64_t mAcc[kLanes];
+    int mStripe = 0;
+    size_t mTotal = 0;
+    unsigned char mBuffer[kStripeBytes];
+    size_t mPending = 0;
+};
+
+} // namespace
+
+unsigned long long hashBytes(const void *data, size_t size, unsigned long long seed)
+{
+    StripeHasher hasher(seed);
+    hasher.update(static_cast<const unsigned char *>(data), size);
+    return hasher.finish();
+}
+
+unsigned long long hashImage(const cv::Mat &image)
+{
+    unsigned long long seed = ((unsigned long long)image.rows << 32) ^ (unsigned long long)image.cols
+                              ^ ((unsigned long long)image.type() << 56);
+    StripeHasher hasher(seed);
+    if (!image.empty())
+    {
+        size_t rowBytes = (size_t)image.cols * image.elemSize();
+        if (image.isContinuous())
+        {
+            hasher.update(image.data, rowBytes * image.rows);
+        }
+        else
+        {
+            for (int y = 0; y < image.rows; ++y)
+            {
+                hasher.update(image.ptr(y), rowBytes);
+            }
+        }
+    }
+    return hasher.finish();
+}
+
+ResultCache::ResultCache(const ResultCacheConfig &config)
+    : mMaxBytes(config.maxBytes)
+{
+    mBypass = config.bypass;
+}
+
+ResultCacheKey ResultCache::keyOf(const cv::Mat &image)
+{
+    auto start = Clock::now();
+    ResultCacheKey key;
+    key.hash = hashImage(image);
+    key.rows = image.rows;
+    key.cols = image.cols;
+    key.type = image.type();
+    double ms = std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+
+    std::lock_guard<std::mutex> locker(mMutex);
+    mStats.hashedBytes += (long long)(image.total() * image.elemSize());
+    mStats.hashMs += ms;
+    return key;
+}
+
+bool ResultCache::lookup(const ResultCacheKey &key, InferenceOutput &output)
+{
+    std::lock_guard<std::mutex> locker(mMutex);
+    if (isBypassed())
+    {
+        return false;
+    }
+
+    auto found = mIndex.find(key);
+    if (found == mIndex.end())
+    {
+        ++mStats.misses;
+        return false;
+    }
+    mEntries.splice(mEntries.begin(), mEntries, found->second);
+    output = found->second->output;
+    ++mStats.hits;
+    return true;
+}
+
+void ResultCache::store(const ResultCacheKey &key, const InferenceOutput &output, size_t bytes)
+{
+    // 键、链表节点和哈希表节点的开销
+    bytes += sizeof(Entry) + 4 * sizeof(void *);
+
+    std::lock_guard<std::mutex> locker(mMutex);
+    if (isBypassed() || (long long)bytes > mMaxBytes)
+    {
+        return;
+    }
+
+    auto found = mIndex.find(key);
+    if (found != mIndex.end())
+    {
+        // 同一张图同时在两个工作线程上没命中，后完成的覆盖先完成的
+        mStats.bytes -= (long long)found->second->bytes;
+        found->second->output = output;
+        found->second->bytes = bytes;
+        mEntries.splice(mEntries.begin(), mEntries, found->second);
+    }
+    else
+    {
+        mEntries.push_front(Entry{key, output, bytes});
+        mIndex.emplace(key, mEntries.begin());
+        ++mStats.inserts;
+    }
+    mStats.bytes += (long long)bytes;
+    evictTo(mMaxBytes);
+}
+
+void ResultCache::setBypass(bool bypass)
+{
+    mBypass = bypass;
+}
+
+void ResultCache::setMaxBytes(long long maxBytes)
+{
+    std::lock_guard<std::mutex> locker(mMutex);
+    mMaxBytes = maxBytes;
+    evictTo(mMaxBytes);
+}
+
+long long ResultCache::maxBytes() const
+{
+    std::lock_guard<std::mutex> locker(mMutex);
+    return mMaxBytes;
+}
+
+void ResultCache::clear()
+{
+    std::lock_guard<std::mutex> locker(mMutex);
+    mEntries.clear();
+    mIndex.clear();
+    mStats.bytes = 0;
+}
+
+ResultCacheStats ResultCache::stats() const
+{
+    std::lock_guard<std::mutex> locker(mMutex);
+    ResultCacheStats stats = mStats;
+    stats.entries = (long long)mEntries.size();
+    return stats;
+}
+
+void ResultCache::evictTo(long long maxBytes)
+{
+    while (mStats.bytes > maxBytes && !mEntries.empty())
+    {
+        const Entry &oldest = mEntries.back();
+        mStats.bytes -= (long long)oldest.bytes;
+        mIndex.erase(oldest.key);
+        mEntries.pop_back();
+        ++mStats.evictions;
+    }
+}
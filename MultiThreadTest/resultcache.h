@@ -0,0 +1,115 @@
+﻿#ifndef RESULTCACHE_H
+#define RESULTCACHE_H
+
+#include <atomic>
+#include <cstddef>
+#include <list>
+#include <mutex>
+#include <unordered_map>
+
+#include <opencv2/opencv.hpp>
+
+#include "inferencebackend.h"
+
+// 一段内存的64位哈希：XXH3的做法，8个64位累加器各自做32x32->64位乘法，有SSE2时两路一组用pmuludq计算
+// 结果和xxh3并不相同，只用作缓存的键，不要求抗碰撞
+unsigned long long hashBytes(const void *data, size_t size, unsigned long long seed = 0);
+
+// 解码后像素的哈希，尺寸和类型也算在内；不连续的ROI逐行计算
+unsigned long long hashImage(const cv::Mat &image);
+
+// 缓存的键：像素哈希加上尺寸和类型，哈希碰撞时尺寸不同也不会取错
+struct ResultCacheKey
+{
+    unsigned long long hash = 0;
+    int rows = 0;
+    int cols = 0;
+    int type = 0;
+
+    bool operator==(const ResultCacheKey &other) const
+    {
+        return hash == other.hash && rows == other.rows && cols == other.cols && type == other.type;
+    }
+};
+
+struct ResultCacheConfig
+{
+    long long maxBytes = 64LL << 20;    // 所有条目的字节数上限，超出时淘汰最久没用过的
+    bool bypass = false;                // 不查也不存，纯测推理速度时使用
+};
+
+struct ResultCacheStats
+{
+    long long hits = 0;
+    long long misses = 0;
+    long long inserts = 0;
+    long long evictions = 0;
+    long long entries = 0;
+    long long bytes = 0;            // 当前所有条目的估算字节数
+    long long hashedBytes = 0;      // 算过哈希的像素字节数
+    double hashMs = 0;              // 算哈希的总耗时
+
+    double hitRate() const
+    {
+        long long lookups = hits + misses;
+        return lookups > 0 ? (double)hits / lookups : 0;
+    }
+};
+
+// 按图像内容缓存推理结果：同一张图（比如复检时反复送的图、测试时循环使用的图）
+// 第二次起只算一次哈希、查一次表，不再跑模型
+// 按字节数做LRU淘汰，条目的大小由后端的outputBytes()估算；可以被多个工作线程同时使用
+// 结果只和图有关，换了模型要clear()
+class ResultCache
+{
+public:
+    explicit ResultCache(const ResultCacheConfig &config = ResultCacheConfig());
+
+    ResultCache(const ResultCache &) = delete;
+    ResultCache &operator=(const ResultCache &) = delete;
+
+    // 算图的键，计入哈希的耗时
+    ResultCacheKey keyOf(const cv::Mat &image);
+
+    // 命中时拷贝一份结果，并把条目移到最近使用的一端；旁路时总是返回false
+    bool lookup(const ResultCacheKey &key, InferenceOutput &output);
+
+    // bytes为结果的估算字节数，超过上限的结果不缓存
+    void store(const ResultCacheKey &key, const InferenceOutput &output, size_t bytes);
+
+    void setBypass(bool bypass);
+    bool isBypassed() const { return mBypass.load(std::memory_order_relaxed); }
+
+    void setMaxBytes(long long maxBytes);
+    long long maxBytes() const;
+
+    void clear();
+    ResultCacheStats stats() const;
+
+private:
+    struct KeyHash
+    {
+        size_t operator()(const ResultCacheKey &key) const { return (size_t)key.hash; }
+    };
+
+    struct Entry
+    {
+        ResultCacheKey key;
+        InferenceOutput output;
+        size_t bytes = 0;
+    };
+
+    using EntryList = std::list<Entry>;
+
+    void evictTo(long long maxBytes);
+
+    std::atomic<bool> mBypass{false};
+
+    mutable std::mutex mMutex;
+    long long mMaxBytes = 0;
+    EntryList mEntries;                                             // 前端为最近使用的
+    std::unordered_map<ResultCacheKey, EntryList::iterator, KeyHash> mIndex;
+    ResultCacheStats mStats;
+};
+
+#endif // RESULTCACHE_H
@@ -0,0 +1,237 @@
+﻿#include "resulthandlers.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <sstream>
+#include <stdexcept>
+
+static const char *verdictName(ResultVerdict verdict)
+{
+    switch (verdict)
+    {
+    case ResultVerdict::Pass: return "OK";
+    case ResultVerdict::Fail: return "NG";
+    default: return "--";
+    }
+}
+
+ResultStatisticsHandler::ResultStatisticsHandler(ResultVerdictFunction verdict)
+    : mVerdict(std::move(verdict))
+{
+}
+
+void ResultStatisticsHandler::handle(PostProcessItem &item)
+{
+    if (mVerdict)
+    {
+        item.verdict = mVerdict(item);
+    }
+    else
+    {
+        item.verdict = item.output.payload.has_value() ? ResultVerdict::Pass : ResultVerdict::Fail;
+    }
+
+    if (item.verdict == ResultVerdict::Pass)
+    {
+        ++mPass;
+    }
+    else if (item.verdict == ResultVerdict::Fail)
+    {
+        ++mFail;
+    }
+}
+
+ResultWriterHandler::ResultWriterHandler(const std::string &path, ResultFormatter formatter)
+    : mPath(path)
+    , mFormatter(std::move(formatter))
+    , mFile(path, std::ios::out | std::ios::trunc)
+{
+    if (mFile)
+    {
+        mFile << "stream,sequence,queue_ms,infer_ms,verdict,detail\n";
+    }
+}
+
+void ResultWriterHandler::handle(PostProcessItem &item)
+{
+    if (!mFile.is_open())
+    {
+        throw std::runtime_error("无法写入结果文件: " + mPath);
+    }
+
+    char prefix[128];
+    std::snprintf(prefix, sizeof(prefix), "%d,%lld,%.3f,%.3f,%s,", item.stream, item.sequence,
+                  item.queueMs, item.inferMs, verdictName(item.verdict));
+    std::string line = prefix;
+    if (mFormatter)
+    {
+        // 描述中可能有逗号，整个放在引号里
+        std::string detail = mFormatter(item.output);
+        line += '"';
+        for (char c : detail)
+        {
+            line += c;
+            if (c == '"')
+            {
+                line += '"';
+            }
+        }
+        line += '"';
+    }
+    line += '\n';
+
+    std::lock_guard<std::mutex> locker(mMutex);
+    mFile.write(line.data(), (std::streamsize)line.size());
+    ++mWritten;
+}
+
+void ResultWriterHandler::flush()
+{
+    std::lock_guard<std::mutex> locker(mMutex);
+    mFile.flush();
+}
+
+OverlayHandler::OverlayHandler(const OverlayConfig &config)
+    : mConfig(config)
+{
+    mConfig.saveEvery = std::max(1, mConfig.saveEvery);
+}
+
+void OverlayHandler::handle(PostProcessItem &item)
+{
+    if (item.image.empty())
+    {
+        return;
+    }
+
+    // 每个后处理线程一块画布，尺寸不变时不重新分配
+    thread_local cv::Mat converted;
+    thread_local cv::Mat canvas;
+
+    const cv::Mat *source = &item.image;
+    if (item.image.depth() != CV_8U)
+    {
+        // 16位等高位深的图按最高8位显示
+        double scale = item.image.depth() == CV_16U ? 1.0 / 256 : 1.0;
+        item.image.convertTo(converted, CV_8U, scale);
+        source = &converted;
+    }
+    switch (source->channels())
+    {
+    case 1: cv::cvtColor(*source, canvas, cv::COLOR_GRAY2BGR); break;
+    case 4: cv::cvtColor(*source, canvas, cv::COLOR_BGRA2BGR); break;
+    default: source->copyTo(canvas); break;
+    }
+
+    cv::Scalar color = item.verdict == ResultVerdict::Fail ? cv::Scalar(0, 0, 255)
+                       : item.verdict == ResultVerdict::Pass ? cv::Scalar(0, 200, 0)
+                                                             : cv::Scalar(0, 200, 255);
+    int thickness = std::max(2, std::min(canvas.cols, canvas.rows) / 100);
+    cv::rectangle(canvas, cv::Rect(0, 0, canvas.cols, canvas.rows), color, thickness);
+
+    char text[128];
+    std::snprintf(text, sizeof(text), "#%d-%lld %s %.1f ms", item.stream, item.sequence,
+                  verdictName(item.verdict), item.inferMs);
+    double fontScale = std::max(0.5, canvas.cols / 1000.0);
+    cv::putText(canvas, text, cv::Point(thickness * 2, thickness * 2 + (int)(fontScale * 24)),
+                cv::FONT_HERSHEY_SIMPLEX, fontScale, color, std::max(1, thickness / 2));
+    ++mRendered;
+
+    if (!mConfig.outputDir.empty() && item.sequence % mConfig.saveEvery == 0)
+    {
+        std::snprintf(text, sizeof(text), "/stream%d_%06lld.jpg", item.stream, item.sequence);
+        if (!cv::imwrite(mConfig.outputDir + text, canvas))
+        {
+            throw std::runtime_error("叠加图保存失败: " + mConfig.outputDir + text);
+        }
+        ++mSaved;
+    }
+}
+
+const char *resultHandlersSpecHelp()
+{
+    return "stats, write=<文件>, overlay, overlay-dir=<目录>, overlay-every=<张数>";
+}
+
+bool createResultHandlers(const std::string &spec, const ResultFormatter &formatter,
+                          std::vector<std::shared_ptr<IResultHandler>> &handlers,
+                          std::string *errorMessage)
+{
+    auto fail = [&](const std::string &message) {
+        if (errorMessage)
+        {
+            *errorMessage = message;
+        }
+        return false;
+    };
+
+    // 叠加图的参数可能分散在几项中，先占好位置，最后再创建
+    int overlayIndex = -1;
+    OverlayConfig overlay;
+    std::vector<std::shared_ptr<IResultHandler>> created;
+
+    std::stringstream stream(spec);
+    std::string item;
+    while (std::getline(stream, item, ','))
+    {
+        if (item.empty())
+        {
+            continue;
+        }
+        size_t eq = item.find('=');
+        std::string key = item.substr(0, eq);
+        std::string text = eq == std::string::npos ? std::string() : item.substr(eq + 1);
+
+        if (key == "stats")
+        {
+            created.push_back(std::make_shared<ResultStatisticsHandler>());
+        }
+        else if (key == "write")
+        {
+            if (text.empty())
+            {
+                return fail("write缺少文件名");
+            }
+            auto writer = std::make_shared<ResultWriterHandler>(text, formatter);
+            if (!writer->isOpen())
+            {
+                return fail("无法写入结果文件: " + text);
+            }
+            created.push_back(writer);
+        }
+        else if (key == "overlay" || key == "overlay-dir" || key == "overlay-every")
+        {
+            if (key == "overlay-dir")
+            {
+                overlay.outputDir = text;
+            }
+            else if (key == "overlay-every")
+            {
+                char *end = nullptr;
+                long value = std::strtol(text.c_str(), &end, 10);
+                if (text.empty() || *end != '\0' || value <= 0)
+                {
+                    return fail("无效的数值: " + item);
+                }
+                overlay.saveEvery = (int)value;
+            }
+            if (overlayIndex < 0)
+            {
+                overlayIndex = (int)created.size();
+                created.push_back(nullptr);
+            }
+        }
+        else
+        {
+            return fail("未知的后处理: " + key);
+        }
+    }
+
+    if (overlayIndex >= 0)
+    {
+        created[overlayIndex] = std::make_shared<OverlayHandler>(overlay);
+    }
+    handlers.insert(handlers.end(), created.begin(), created.end());
+    return true;
+}
@@ -0,0 +1,97 @@
+﻿#ifndef RESULTHANDLERS_H
+#define RESULTHANDLERS_H
+
+#include <atomic>
+#include <fstream>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include "postprocess.h"
+
+// 判定一张图是OK还是NG
+using ResultVerdictFunction = std::function<ResultVerdict(const PostProcessItem &item)>;
+
+// 推理输出的文字描述，一般用IInferenceBackend::describeOutput()
+using ResultFormatter = std::function<std::string(const InferenceOutput &output)>;
+
+// 判定OK/NG并计数，结果写回item.verdict，排在它后面的处理器可以使用
+// 没有指定判定规则时，只要有推理输出就算OK；实际产线上换成按响应中的缺陷判定的规则
+class ResultStatisticsHandler : public IResultHandler
+{
+public:
+    explicit ResultStatisticsHandler(ResultVerdictFunction verdict = ResultVerdictFunction());
+
+    const char *name() const override { return "statistics"; }
+    void handle(PostProcessItem &item) override;
+
+    long long passCount() const { return mPass.load(); }
+    long long failCount() const { return mFail.load(); }
+
+private:
+    ResultVerdictFunction mVerdict;
+    std::atomic<long long> mPass{0};
+    std::atomic<long long> mFail{0};
+};
+
+// 把每张图的结果逐行写成CSV：stream,sequence,queue_ms,infer_ms,verdict,detail
+// 格式化在锁外做，锁内只写进文件流的缓冲区
+class ResultWriterHandler : public IResultHandler
+{
+public:
+    explicit ResultWriterHandler(const std::string &path, ResultFormatter formatter = ResultFormatter());
+
+    bool isOpen() const { return mFile.is_open(); }
+    const std::string &path() const { return mPath; }
+    long long writtenCount() const { return mWritten.load(); }
+
+    const char *name() const override { return "serialize"; }
+    void handle(PostProcessItem &item) override;
+    void flush() override;
+
+private:
+    std::string mPath;
+    ResultFormatter mFormatter;
+    std::mutex mMutex;
+    std::ofstream mFile;
+    std::atomic<long long> mWritten{0};
+};
+
+struct OverlayConfig
+{
+    std::string outputDir;          // 为空时只画不保存
+    int saveEvery = 100;            // 每一路每隔这么多张保存一张
+};
+
+// 在原图的拷贝上画出判定结果和耗时（每个后处理线程复用自己的画布，不逐张分配）
+class OverlayHandler : public IResultHandler
+{
+public:
+    explicit OverlayHandler(const OverlayConfig &config = OverlayConfig());
+
+    const char *name() const override { return "overlay"; }
+    void handle(PostProcessItem &item) override;
+
+    long long renderedCount() const { return mRendered.load(); }
+    long long savedCount() const { return mSaved.load(); }
+
+private:
+    OverlayConfig mConfig;
+    std::atomic<long long> mRendered{0};
+    std::atomic<long long> mSaved{0};
+};
+
+// 按描述创建处理器，描述是逗号分隔的列表，按顺序执行：
+//   stats                    判定OK/NG并计数
+//   write=<file>             结果写成CSV
+//   overlay                  画叠加图
+//   overlay-dir=<dir>        叠加图保存到目录（隐含overlay）
+//   overlay-every=<n>        每一路每隔n张保存一张，默认100
+bool createResultHandlers(const std::string &spec, const ResultFormatter &formatter,
+                          std::vector<std::shared_ptr<IResultHandler>> &handlers,
+                          std::string *errorMessage = nullptr);
+const char *resultHandlersSpecHelp();
+
+#endif // RESULTHANDLERS_H
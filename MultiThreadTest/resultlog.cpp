@@ -0,0 +1,479 @@
+﻿#include "resultlog.h"
+#include "tracing.h"
+
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <filesystem>
+#include <memory>
+#include <system_error>
+#include <thread>
+
+namespace fs = std::filesystem;
+
+static const char kMagic[8] = {'S', 'M', 'R', 'L', 'O', 'G', 0, 0};
+static const char kExtension[] = ".rlog";
+
+// 写线程一次最多取这么多条写一次文件（160KB）
+static const size_t kBatchRecords = 4096;
+
+// 第index个文件的文件名：<prefix>.0001.rlog
+static std::string logFileName(const std::string &prefix, int index)
+{
+    char suffix[32];
+    std::snprintf(suffix, sizeof(suffix), ".%04d%s", index, kExtension);
+    return prefix + suffix;
+}
+
+// 从文件名中解析出编号，不是prefix的日志文件时返回-1
+static int logFileIndex(const std::string &prefixName, const std::string &fileName)
+{
+    const size_t extLength = sizeof(kExtension) - 1;
+    if (fileName.size() <= prefixName.size() + 1 + extLength
+        || fileName.compare(0, prefixName.size(), prefixName) != 0
+        || fileName[prefixName.size()] != '.'
+        || fileName.compare(fileName.size() - extLength, extLength, kExtension) != 0)
+    {
+        return -1;
+    }
+    std::string digits = fileName.substr(prefixName.size() + 1, fileName.size() - prefixName.size() - 1 - extLength);
+    if (digits.empty() || digits.size() > 9
+        || !std::all_of(digits.begin(), digits.end(), [](char c) { return c >= '0' && c <= '9'; }))
+    {
+        return -1;
+    }
+    return std::atoi(digits.c_str());
+}
+
+// prefix已有的日志文件，按编号排序
+static std::vector<std::pair<int, std::string>> listLogFiles(const std::string &prefix)
+{
+    std::vector<std::pair<int, std::string>> files;
+    fs::path prefixPath(prefix);
+    fs::path dir = prefixPath.has_parent_path() ? prefixPath.parent_path() : fs::path(".");
+    std::string prefixName = prefixPath.filename().string();
+
+    std::error_code ec;
+    for (fs::directory_iterator it(dir, ec), end; !ec && it != end; it.increment(ec))
+    {
+        int index = logFileIndex(prefixName, it->path().filename().string());
+        if (index >= 0)
+        {
+            files.emplace_back(index, logFileName(prefix, index));
+        }
+    }
+    std::sort(files.begin(), files.end());
+    return files;
+}
+
+// 写线程自己攒批，stdio的缓冲只要能装下一批；要在第一次读写之前设置
+static void setBuffer(std::FILE *fp)
+{
+    std::setvbuf(fp, nullptr, _IOFBF, kBatchRecords * sizeof(ResultLogRecord));
+}
+
+static bool readHeader(std::FILE *fp, ResultLogFileHeader &header, std::string *error)
+{
+    if (std::fread(&header, sizeof(header), 1, fp) != 1)
+    {
+        if (error)
+        {
+            *error = "文件头不完整";
+        }
+        return false;
+    }
+    if (std::memcmp(header.magic, kMagic, sizeof(kMagic)) != 0)
+    {
+        if (error)
+        {
+            *error = "不是结果日志文件";
+        }
+        return false;
+    }
+    if (header.recordSize != sizeof(ResultLogRecord))
+    {
+        if (error)
+        {
+            *error = "记录大小不一致（版本" + std::to_string(header.version) + "）";
+        }
+        return false;
+    }
+    return true;
+}
+
+ResultLogWriter::ResultLogWriter(const ResultLogConfig &config)
+    : mConfig(config)
+    , mQueue((size_t)std::max(1, config.queueCapacity))
+{
+    mConfig.flushIntervalMs = std::max(1, mConfig.flushIntervalMs);
+    mConfig.maxFileBytes = std::max<long long>(mConfig.maxFileBytes, sizeof(ResultLogFileHeader) + sizeof(ResultLogRecord));
+}
+
+ResultLogWriter::~ResultLogWriter()
+{
+    close();
+}
+
+int64_t ResultLogWriter::nowUs()
+{
+    return std::chrono::duration_cast<std::chrono::microseconds>(
+               std::chrono::system_clock::now().time_since_epoch()).count();
+}
+
+bool ResultLogWriter::open(std::string *error)
+{
+    std::lock_guard<std::mutex> locker(mLifecycleMutex);
+    if (mOpen)
+    {
+        return true;
+    }
+
+    if (mConfig.path.empty())
+    {
+        if (error)
+        {
+            *error = "没有指定结果日志的文件名";
+        }
+        return false;
+    }
+    fs::path dir = fs::path(mConfig.path).parent_path();
+    if (!dir.empty())
+    {
+        std::error_code ec;
+        fs::create_directories(dir, ec);
+    }
+
+    mFiles = 0;
+    mBytes = 0;
+    if (!openNextFile(true))
+    {
+        if (error)
+        {
+            std::lock_guard<std::mutex> infoLocker(mInfoMutex);
+            *error = mError;
+        }
+        return false;
+    }
+
+    mStopping = false;
+    mOpen = true;
+    mWriter = std::thread(&ResultLogWriter::writerLoop, this);
+    return true;
+}
+
+void ResultLogWriter::close()
+{
+    std::lock_guard<std::mutex> locker(mLifecycleMutex);
+    if (!mOpen)
+    {
+        return;
+    }
+
+    mOpen = false;
+    // 等已经通过检查的append()返回，它们放进队列的记录由写线程停止前的最后一次排空写出
+    while (mAppending > 0)
+    {
+        std::this_thread::yield();
+    }
+    {
+        std::lock_guard<std::mutex> wakeLocker(mWakeMutex);
+        mStopping = true;
+        mWake.notify_all();
+    }
+    mWriter.join();
+    closeFile();
+
+    // 写线程已经取完；万一还有剩下的也记为丢弃，不会写进下一次open()的文件
+    ResultLogRecord record;
+    while (mQueue.tryPop(record))
+    {
+        mDropped.fetch_add(1, std::memory_order_relaxed);
+    }
+}
+
+bool ResultLogWriter::append(const ResultLogRecord &record)
+{
+    // 先登记再检查mOpen，和close()中先清mOpen再等mAppending归零配对（都是顺序一致的原子操作）：
+    // 要么这里看到已经关闭、记为丢弃，要么close()等到这次入队结束，记录照常写出
+    ++mAppending;
+    bool pushed = mOpen.load() && mQueue.tryPush(record);
+    --mAppending;
+    if (!pushed)
+    {
+        mDropped.fetch_add(1, std::memory_order_relaxed);
+        return false;
+    }
+    long long appended = mAppended.fetch_add(1, std::memory_order_relaxed) + 1;
+
+    // 平时由写线程定时来取；每攒够一批叫醒一次，避免高吞吐时队列满
+    if ((appended & (long long)(kBatchRecords - 1)) == 0)
+    {
+        std::lock_guard<std::mutex> locker(mWakeMutex);
+        mWake.notify_one();
+    }
+    return true;
+}
+
+ResultLogStats ResultLogWriter::stats() const
+{
+    ResultLogStats stats;
+    stats.appended = mAppended.load();
+    stats.written = mWritten.load();
+    stats.dropped = mDropped.load();
+    stats.batches = mBatches.load();
+    stats.bytes = mBytes.load();
+    stats.files = mFiles.load();
+    std::lock_guard<std::mutex> locker(mInfoMutex);
+    stats.currentFile = mCurrentFile;
+    stats.error = mError;
+    return stats;
+}
+
+void ResultLogWriter::writerLoop()
+{
+    TraceRecorder::setThreadName("result log");
+
+    std::vector<ResultLogRecord> batch;
+    batch.reserve(kBatchRecords);
+    const auto interval = std::chrono::milliseconds(mConfig.flushIntervalMs);
+    for (;;)
+    {
+        {
+            std::unique_lock<std::mutex> locker(mWakeMutex);
+            mWake.wait_for(locker, interval, [this]() {
+                return mStopping.load() || mQueue.sizeApprox() >= kBatchRecords;
+            });
+        }
+        // 先读停止标志再取记录，停止之前放进队列的记录都会写出去
+        bool stopping = mStopping.load();
+
+        ResultLogRecord record;
+        while (mQueue.tryPop(record))
+        {
+            batch.push_back(record);
+            if (batch.size() == kBatchRecords)
+            {
+                writeBatch(batch);
+                batch.clear();
+            }
+        }
+        if (!batch.empty())
+        {
+            writeBatch(batch);
+            batch.clear();
+        }
+        if (mFile)
+        {
+            std::fflush(mFile);
+        }
+
+        if (stopping)
+        {
+            break;
+        }
+    }
+}
+
+bool ResultLogWriter::writeBatch(const std::vector<ResultLogRecord> &batch)
+{
+    TraceSpan span("write log", "log");
+    size_t offset = 0;
+    while (offset < batch.size())
+    {
+        if (mFile && mFileBytes + (long long)sizeof(ResultLogRecord) > mConfig.maxFileBytes)
+        {
+            closeFile();
+        }
+        if (!mFile && !openNextFile(false))
+        {
+            mDropped.fetch_add((long long)(batch.size() - offset), std::memory_order_relaxed);
+            return false;
+        }
+
+        // 一次写到文件写满为止
+        long long room = (mConfig.maxFileBytes - mFileBytes) / (long long)sizeof(ResultLogRecord);
+        size_t count = std::min(batch.size() - offset, (size_t)std::max<long long>(1, room));
+        size_t written = std::fwrite(batch.data() + offset, sizeof(ResultLogRecord), count, mFile);
+        mFileBytes += (long long)(written * sizeof(ResultLogRecord));
+        mBytes.fetch_add((long long)(written * sizeof(ResultLogRecord)), std::memory_order_relaxed);
+        mWritten.fetch_add((long long)written, std::memory_order_relaxed);
+        mBatches.fetch_add(1, std::memory_order_relaxed);
+        if (written != count)
+        {
+            setError("写结果日志失败: " + std::string(std::strerror(errno)));
+            mDropped.fetch_add((long long)(batch.size() - offset - written), std::memory_order_relaxed);
+            closeFile();
+            return false;
+        }
+        offset += count;
+    }
+    return true;
+}
+
+bool ResultLogWriter::openNextFile(bool resume)
+{
+    std::vector<std::pair<int, std::string>> existing = listLogFiles(mConfig.path);
+    int index = existing.empty() ? 1 : existing.back().first + 1;
+
+    // 接着最后一个文件写：文件头要对得上、没写满，末尾不完整的记录先截掉
+    if (resume && !existing.empty())
+    {
+        const std::string &last = existing.back().second;
+        std::error_code ec;
+        long long size = (long long)fs::file_size(last, ec);
+        ResultLogFileHeader header;
+        bool valid = false;
+        if (!ec && size < mConfig.maxFileBytes)
+        {
+            if (std::FILE *fp = std::fopen(last.c_str(), "rb"))
+            {
+                valid = readHeader(fp, header, nullptr);
+                std::fclose(fp);
+            }
+        }
+        if (valid)
+        {
+            long long records = (size - (long long)sizeof(header)) / (long long)sizeof(ResultLogRecord);
+            long long aligned = (long long)sizeof(header) + records * (long long)sizeof(ResultLogRecord);
+            if (aligned != size)
+            {
+                fs::resize_file(last, (uintmax_t)aligned, ec);
+            }
+            mFile = ec ? nullptr : std::fopen(last.c_str(), "ab");
+            if (mFile)
+            {
+                setBuffer(mFile);
+                index = existing.back().first;
+                mFileBytes = aligned;
+            }
+        }
+    }
+
+    std::string path = logFileName(mConfig.path, index);
+    if (!mFile)
+    {
+        mFile = std::fopen(path.c_str(), "wb");
+        if (!mFile)
+        {
+            setError("无法创建结果日志 " + path + ": " + std::strerror(errno));
+            return false;
+        }
+        setBuffer(mFile);
+
+        ResultLogFileHeader header;
+        std::memset(&header, 0, sizeof(header));
+        std::memcpy(header.magic, kMagic, sizeof(kMagic));
+        header.version = kResultLogVersion;
+        header.recordSize = sizeof(ResultLogRecord);
+        header.createdUs = nowUs();
+        if (std::fwrite(&header, sizeof(header), 1, mFile) != 1)
+        {
+            setError("写结果日志失败 " + path + ": " + std::strerror(errno));
+            std::fclose(mFile);
+            mFile = nullptr;
+            return false;
+        }
+        mFileBytes = sizeof(header);
+        mBytes.fetch_add((long long)sizeof(header), std::memory_order_relaxed);
+    }
+
+    mFileIndex = index;
+    ++mFiles;
+    {
+        std::lock_guard<std::mutex> locker(mInfoMutex);
+        mCurrentFile = path;
+    }
+    removeOldFiles();
+    return true;
+}
+
+void ResultLogWriter::closeFile()
+{
+    if (mFile)
+    {
+        std::fclose(mFile);
+        mFile = nullptr;
+    }
+}
+
+void ResultLogWriter::removeOldFiles()
+{
+    if (mConfig.maxFiles <= 0)
+    {
+        return;
+    }
+    std::vector<std::pair<int, std::string>> existing = listLogFiles(mConfig.path);
+    for (size_t i = 0; i + (size_t)mConfig.maxFiles < existing.size(); ++i)
+    {
+        if (existing[i].first != mFileIndex)
+        {
+            std::error_code ec;
+            fs::remove(existing[i].second, ec);
+        }
+    }
+}
+
+void ResultLogWriter::setError(const std::string &error)
+{
+    std::lock_guard<std::mutex> locker(mInfoMutex);
+    mError = error;
+}
+
+std::vector<std::string> resultLogFiles(const std::string &path)
+{
+    std::vector<std::string> files;
+    std::error_code ec;
+    if (fs::is_regular_file(path, ec))
+    {
+        files.push_back(path);
+        return files;
+    }
+    for (const auto &file : listLogFiles(path))
+    {
+        files.push_back(file.second);
+    }
+    return files;
+}
+
+bool readResultLog(const std::string &file,
+                   const std::function<bool(const ResultLogRecord &record)> &visit,
+                   std::string *error)
+{
+    std::unique_ptr<std::FILE, int (*)(std::FILE *)> fp(std::fopen(file.c_str(), "rb"), &std::fclose);
+    if (!fp)
+    {
+        if (error)
+        {
+            *error = "无法打开 " + file + ": " + std::strerror(errno);
+        }
+        return false;
+    }
+
+    ResultLogFileHeader header;
+    std::string headerError;
+    if (!readHeader(fp.get(), header, &headerError))
+    {
+        if (error)
+        {
+            *error = file + ": " + headerError;
+        }
+        return false;
+    }
+
+    std::vector<ResultLogRecord> chunk(kBatchRecords);
+    for (;;)
+    {
+        size_t count = std::fread(chunk.data(), sizeof(ResultLogRecord), chunk.size(), fp.get());
+        for (size_t i = 0; i < count; ++i)
+        {
+            if (!visit(chunk[i]))
+            {
+                return true;
+            }
+        }
+        if (count < chunk.size())
+        {
+            return true;
+        }
+    }
+}
@@ -0,0 +1,153 @@
+﻿#ifndef RESULTLOG_H
+#define RESULTLOG_H
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <cstdio>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "mpmcqueue.h"
+
+// 结果日志：每张图一条定长的二进制记录，只追加，长时间（24小时以上）运行后可以离线统计任意时间段
+// 文件格式（小端，和x86/ARM的内存布局一致，直接读写结构体）：
+//   文件头 ResultLogFileHeader，之后是连续的ResultLogRecord
+//   写到一半断电时最后一条记录可能不完整，读取时忽略
+const uint32_t kResultLogVersion = 1;
+
+struct ResultLogFileHeader
+{
+    char magic[8];                  // "SMRLOG\0\0"
+    uint32_t version;
+    uint32_t recordSize;            // sizeof(ResultLogRecord)，读取时据此判断格式是否一致
+    int64_t createdUs;              // 文件创建时刻，Unix纪元以来的微秒
+    int64_t reserved;
+};
+
+// 记录的标志位
+enum ResultLogFlag : uint16_t
+{
+    kResultLogWarmup = 1,           // 预热阶段的结果，统计时默认跳过
+};
+
+struct ResultLogRecord
+{
+    int64_t timestampUs = 0;        // 推理完成的时刻，Unix纪元以来的微秒（system_clock），离线工具按它划分时间段
+    int64_t sequence = 0;           // 这一路的第几张图
+    int32_t stream = 0;
+    uint8_t status = 0;             // InferenceStatus
+    uint8_t batchSize = 1;
+    uint16_t flags = 0;             // ResultLogFlag
+    float fetchMs = 0;              // 取帧（等解码或者读图像库）
+    float queueMs = 0;              // 在推理队列中等待（含凑批）
+    float inferMs = 0;              // 会话推理
+    float totalMs = 0;              // 从送图（开环送图时为预定到达时刻）到推理回调
+};
+
+static_assert(sizeof(ResultLogFileHeader) == 32, "结果日志的文件头必须是32字节");
+static_assert(sizeof(ResultLogRecord) == 40, "结果日志的记录必须是40字节");
+
+struct ResultLogConfig
+{
+    // 文件名前缀，实际的文件为 <path>.0001.rlog、<path>.0002.rlog……
+    // 已经有同名的文件时接着最后一个写（没写满的话），不覆盖
+    std::string path;
+    long long maxFileBytes = 256LL << 20;   // 单个文件写满后换下一个
+    int maxFiles = 0;                       // 最多保留的文件数，超出时删除最旧的；0为不限
+    int queueCapacity = 1 << 16;            // 向上取整为2的幂；写线程跟不上时丢弃并计数
+    int flushIntervalMs = 200;              // 写线程最长隔这么久写一次盘，异常退出时最多丢这么久的记录
+};
+
+struct ResultLogStats
+{
+    long long appended = 0;         // 放进队列的记录数
+    long long written = 0;          // 已经写进文件的记录数
+    long long dropped = 0;          // 队列满、没有打开或者写文件失败而丢弃的记录数
+    long long batches = 0;          // 写文件的次数
+    long long bytes = 0;            // 本次打开以来写入的字节数
+    int files = 0;                  // 本次打开以来写过的文件数
+    std::string currentFile;
+    std::string error;              // 最后一次写文件的错误
+};
+
+// 写端：append()只把记录放进有界无锁队列，不加锁、不做IO；
+// 后台写线程按批取出，一次fwrite写一批，按大小换文件
+class ResultLogWriter
+{
+public:
+    explicit ResultLogWriter(const ResultLogConfig &config);
+    ~ResultLogWriter();
+
+    ResultLogWriter(const ResultLogWriter &) = delete;
+    ResultLogWriter &operator=(const ResultLogWriter &) = delete;
+
+    // 打开（或者接着写）日志文件并启动写线程
+    bool open(std::string *error = nullptr);
+
+    // 写完队列中的记录，关闭文件，停止写线程；和append()并发调用时，已经放进队列的记录也会写出去
+    void close();
+
+    bool isOpen() const { return mOpen.load(); }
+
+    // 不阻塞，可以在任意线程中调用；没有打开或者队列满时返回false
+    bool append(const ResultLogRecord &record);
+
+    ResultLogStats stats() const;
+
+    const ResultLogConfig &config() const { return mConfig; }
+
+    // 当前时刻，用于填写ResultLogRecord::timestampUs
+    static int64_t nowUs();
+
+private:
+    void writerLoop();
+    bool writeBatch(const std::vector<ResultLogRecord> &batch);
+    bool openNextFile(bool resume);
+    void closeFile();
+    void removeOldFiles();
+    void setError(const std::string &error);
+
+    ResultLogConfig mConfig;
+    MpmcQueue<ResultLogRecord> mQueue;
+
+    std::mutex mWakeMutex;
+    std::condition_variable mWake;
+    std::atomic<bool> mOpen{false};
+    std::atomic<int> mAppending{0};     // 正在append()中的调用者数，close()等它们返回后才最后排空队列
+    std::atomic<bool> mStopping{false};
+    std::mutex mLifecycleMutex;
+    std::thread mWriter;
+
+    // 只在写线程（以及open/close）中访问
+    std::FILE *mFile = nullptr;
+    int mFileIndex = 0;
+    long long mFileBytes = 0;
+
+    std::atomic<long long> mAppended{0};
+    std::atomic<long long> mWritten{0};
+    std::atomic<long long> mDropped{0};
+    std::atomic<long long> mBatches{0};
+    std::atomic<long long> mBytes{0};
+    std::atomic<int> mFiles{0};
+    mutable std::mutex mInfoMutex;
+    std::string mCurrentFile;
+    std::string mError;
+};
+
+// 读端
+
+// path可以是一个.rlog文件，也可以是写端的文件名前缀；返回按编号排好序的文件列表
+std::vector<std::string> resultLogFiles(const std::string &path);
+
+// 依次读出一个文件中的所有记录，visit返回false时提前结束
+// 文件头不对时返回false；末尾不完整的记录忽略
+bool readResultLog(const std::string &file,
+                   const std::function<bool(const ResultLogRecord &record)> &visit,
+                   std::string *error = nullptr);
+
+#endif // RESULTLOG_H
@@ -0,0 +1,185 @@
+﻿#include "shardedinferencepool.h"
+
+#include <algorithm>
+#include <thread>
+
+ShardedInferencePool::ShardedInferencePool(std::shared_ptr<InferenceEngine> engine,
+                                           const InferencePoolConfig &config,
+                                           const std::vector<DevicePlacement> &placements)
+    : mEngine(std::move(engine))
+    , mPlacements(placements)
+{
+    // pipelines按设备轮流创建，pipelines比设备少时后面的设备上没有pipelines，不建分片
+    int shardCount = std::max(1, std::min(mEngine->deviceCount(), mEngine->config().pipelineCount));
+    int workerCount = std::max(shardCount, config.workerCount);
+
+    for (int i = 0; i < shardCount; ++i)
+    {
+        InferencePoolConfig shardConfig = config;
+        shardConfig.workerCount = workerCount / shardCount + (i < workerCount % shardCount ? 1 : 0);
+        shardConfig.deviceIndex = shardCount > 1 ? i : -1;
+        if (i < (int)mPlacements.size())
+        {
+            shardConfig.workerCpus = mPlacements[i].cpus;
+        }
+        mShardCpus.push_back(shardConfig.workerCpus);
+        mShards.emplace_back(new InferencePool(mEngine, shardConfig));
+    }
+}
+
+ShardedInferencePool::~ShardedInferencePool()
+{
+    shutdown(true);
+}
+
+bool ShardedInferencePool::start(std::string *errorMessage)
+{
+    for (auto &shard : mShards)
+    {
+        if (!shard->start(errorMessage))
+        {
+            shutdown(false);
+            return false;
+        }
+    }
+    return true;
+}
+
+void ShardedInferencePool::stopAccepting()
+{
+    for (auto &shard : mShards)
+    {
+        shard->stopAccepting();
+    }
+}
+
+InferencePoolShutdownStats ShardedInferencePool::shutdown(bool drain, std::chrono::milliseconds drainBudget)
+{
+    if (mShards.size() == 1)
+    {
+        return mShards.front()->shutdown(drain, drainBudget);
+    }
+
+    // 各分片同时停止，总耗时取最慢的那个分片，而不是各分片相加
+    std::vector<InferencePoolShutdownStats> shardStats(mShards.size());
+    std::vector<std::thread> threads;
+    for (size_t i = 0; i < mShards.size(); ++i)
+    {
+        threads.emplace_back([&, i]() { shardStats[i] = mShards[i]->shutdown(drain, drainBudget); });
+    }
+    for (auto &thread : threads)
+    {
+        thread.join();
+    }
+
+    InferencePoolShutdownStats stats;
+    for (const InferencePoolShutdownStats &shard : shardStats)
+    {
+        stats.totalMs = std::max(stats.totalMs, shard.totalMs);
+        stats.drainMs = std::max(stats.drainMs, shard.drainMs);
+        stats.joinMs = std::max(stats.joinMs, shard.joinMs);
+        stats.abandoned += shard.abandoned;
+        stats.overBudget = stats.overBudget || shard.overBudget;
+    }
+    return stats;
+}
+
+bool ShardedInferencePool::pinStreamThread(int stream) const
+{
+    return pinCurrentThread(mShardCpus[stream % mShardCpus.size()]);
+}
+
+long long ShardedInferencePool::submittedCount() const
+{
+    long long count = 0;
+    for (const auto &shard : mShards)
+    {
+        count += shard->submittedCount();
+    }
+    return count;
+}
+
+long long ShardedInferencePool::completedCount() const
+{
+    long long count = 0;
+    for (const auto &shard : mShards)
+    {
+        count += shard->completedCount();
+    }
+    return count;
+}
+
+long long ShardedInferencePool::droppedCount() const
+{
+    long long count = 0;
+    for (const auto &shard : mShards)
+    {
+        count += shard->droppedCount();
+    }
+    return count;
+}
+
+long long ShardedInferencePool::rejectedCount() const
+{
+    long long count = 0;
+    for (const auto &shard : mShards)
+    {
+        count += shard->rejectedCount();
+    }
+    return count;
+}
+
+long long ShardedInferencePool::batchCount() const
+{
+    long long count = 0;
+    for (const auto &shard : mShards)
+    {
+        count += shard->batchCount();
+    }
+    return count;
+}
+
+long long ShardedInferencePool::cachedCount() const
+{
+    long long count = 0;
+    for (const auto &shard : mShards)
+    {
+        count += shard->cachedCount();
+    }
+    return count;
+}
+
+std::vector<DeviceUsage> ShardedInferencePool::deviceUsage(double elapsedSec,
+                                                          const std::vector<DeviceUsage> *since) const
+{
+    std::vector<DeviceUsage> usage;
+    const std::vector<int> &deviceIds = mEngine->deviceIds();
+    for (int i = 0; i < (int)mShards.size(); ++i)
+    {
+        const InferencePool &shard = *mShards[i];
+        DeviceUsage device;
+        device.useGpu = mEngine->config().useGpu;
+        device.deviceId = i < (int)mPlacements.size() ? mPlacements[i].deviceId : deviceIds[i];
+        device.numaNode = i < (int)mPlacements.size() ? mPlacements[i].numaNode : -1;
+        device.cpus = formatCpuList(mShardCpus[i]);
+        // 只有一个分片时它可以借所有设备上的pipelines
+        device.sessions = mShards.size() > 1 ? mEngine->deviceSessionCount(i) : mEngine->pipelineCount();
+        device.completed = shard.completedCount();
+        device.busyMs = shard.busyMs();
+        if (since && i < (int)since->size())
+        {
+            device.completed -= (*since)[i].completed;
+            device.busyMs -= (*since)[i].busyMs;
+        }
+        if (elapsedSec > 0)
+        {
+            device.throughput = device.completed / elapsedSec;
+            if (device.sessions > 0)
+            {
+                device.utilization = device.busyMs / (elapsedSec * 1000.0 * device.sessions);
+            }
+        }
+        usage.push_back(device);
+    }
+    return usage;
+}
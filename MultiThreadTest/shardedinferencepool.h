@@ -0,0 +1,79 @@
+﻿#ifndef SHARDEDINFERENCEPOOL_H
+#define SHARDEDINFERENCEPOOL_H
+
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "deviceplacement.h"
+#include "inferencepool.h"
+
+// 一个设备在一段时间内的使用情况
+struct DeviceUsage
+{
+    bool useGpu = true;
+    int deviceId = 0;
+    int numaNode = -1;
+    std::string cpus;           // 绑定的核，空表示没有绑核
+    int sessions = 0;           // 该设备上的pipelines数
+    long long completed = 0;    // 推理完成的张数
+    double busyMs = 0;          // 推理耗时的总和
+    double utilization = 0;     // busyMs / (时长 * sessions)
+    double throughput = 0;      // 张/秒
+};
+
+// 按设备分片的推理线程池：每个设备一个InferencePool，
+// 分片的工作线程只借本设备上的pipelines，并绑在离设备最近的NUMA节点的核上
+// 送图的第stream路固定交给第shardForStream(stream)个分片，送图线程也可以绑到同一组核上，
+// 这样从读图、推理到回调都在同一个节点上，不会跨节点访问内存
+// 只有一个设备、也不绑核时，和直接使用InferencePool完全一样
+class ShardedInferencePool
+{
+public:
+    // placements与引擎的deviceIds一一对应；为空时不绑核
+    // config中的workerCount按设备轮流分给各个分片
+    ShardedInferencePool(std::shared_ptr<InferenceEngine> engine, const InferencePoolConfig &config,
+                         const std::vector<DevicePlacement> &placements = std::vector<DevicePlacement>());
+    ~ShardedInferencePool();
+
+    ShardedInferencePool(const ShardedInferencePool &) = delete;
+    ShardedInferencePool &operator=(const ShardedInferencePool &) = delete;
+
+    bool start(std::string *errorMessage = nullptr);
+    void stopAccepting();
+
+    // 参数和返回值同InferencePool::shutdown()，多个分片并行停止
+    InferencePoolShutdownStats shutdown(bool drain = true,
+                                        std::chrono::milliseconds drainBudget = std::chrono::milliseconds(-1));
+
+    int shardCount() const { return (int)mShards.size(); }
+    int shardForStream(int stream) const { return stream % shardCount(); }
+    InferencePool &shard(int index) { return *mShards[index]; }
+    InferencePool &poolForStream(int stream) { return *mShards[shardForStream(stream)]; }
+
+    // 分片绑定的核，以及把送图线程绑到对应分片的核上
+    const std::vector<int> &shardCpus(int index) const { return mShardCpus[index]; }
+    bool pinStreamThread(int stream) const;
+
+    const std::shared_ptr<InferenceEngine> &engine() const { return mEngine; }
+
+    long long submittedCount() const;
+    long long completedCount() const;
+    long long droppedCount() const;
+    long long rejectedCount() const;
+    long long batchCount() const;
+    long long cachedCount() const;
+
+    // 每个设备从start()以来的使用情况，elapsedSec为统计的时长
+    // 给出since时只统计从那次快照（同一个线程池之前的返回值）以来的部分
+    std::vector<DeviceUsage> deviceUsage(double elapsedSec,
+                                         const std::vector<DeviceUsage> *since = nullptr) const;
+
+private:
+    std::shared_ptr<InferenceEngine> mEngine;
+    std::vector<DevicePlacement> mPlacements;
+    std::vector<std::unique_ptr<InferencePool>> mShards;
+    std::vector<std::vector<int>> mShardCpus;
+};
+
+#endif // SHARDEDINFERENCEPOOL_H
@@ -3,14 +3,198 @@
 
 #include <QStyledItemDelegate>
 #include <QPainter>
+#include <QPointF>
 #include <QVector>
 
+#include <algorithm>
+#include <deque>
+#include <memory>
+#include <utility>
+
 #pragma execution_character_set("utf-8")
 
 // 可配置的历史数据点数量
 const int MAX_HISTORY_POINTS = 30;
 
+// 单元格中的曲线最多画这么多列，历史点数更多时每列合并成一段的最小值和最大值
+const int SPARKLINE_COLUMNS = 256;
+
+// 点数不超过这个值时画出每个数据点
+const int SPARKLINE_DOT_POINTS = 60;
+
+// 单元格数据变化的序号，存历史的共享指针不变时靠它触发这一格重绘
+const int SparklineRevisionRole = Qt::UserRole + 1;
+
+// 一路的历史耗时：固定容量的环形缓冲，追加时维护窗口内的最小最大值和曲线折线
+// 折线在样本坐标中（x为样本序号，y为耗时），追加新点只改末尾，窗口滑动只移动起点，
+// 绘制时由坐标变换映射到单元格，历史再长每次追加和绘制的开销都不变
+class SparklineHistory
+{
+public:
+    explicit SparklineHistory(int capacity = MAX_HISTORY_POINTS, int columns = SPARKLINE_COLUMNS)
+        : mCapacity(std::max(1, capacity))
+        , mBucket(std::max(1, (mCapacity + std::max(1, columns) - 1) / std::max(1, columns)))
+    {
+        mValues.resize(mCapacity);
+        // 每列最多两个点，再加上窗口左边界外的一列和尚未填满的一列，留一倍的空间给整体前移
+        mPoints.resize(4 * (mCapacity / mBucket + 2));
+    }
+
+    void append(double value)
+    {
+        long long seq = mNext++;
+
+        // 原始值的环形缓冲，只用来知道滑出窗口的是哪个值
+        mValues[(int)(seq % mCapacity)] = value;
+
+        // 单调队列：队首即窗口内的最小/最大值，每个值最多进出一次
+        while (!mMinQueue.empty() && mMinQueue.back().second >= value)
+        {
+            mMinQueue.pop_back();
+        }
+        mMinQueue.emplace_back(seq, value);
+        while (!mMaxQueue.empty() && mMaxQueue.back().second <= value)
+        {
+            mMaxQueue.pop_back();
+        }
+        mMaxQueue.emplace_back(seq, value);
+        long long first = firstSeq();
+        while (mMinQueue.front().first < first)
+        {
+            mMinQueue.pop_front();
+        }
+        while (mMaxQueue.front().first < first)
+        {
+            mMaxQueue.pop_front();
+        }
+
+        appendPoint(seq, value);
+    }
+
+    void clear()
+    {
+        mNext = 0;
+        mMinQueue.clear();
+        mMaxQueue.clear();
+        mBegin = 0;
+        mEnd = 0;
+        mTail = 0;
+        mOrigin = 0;
+        mBucketCount = 0;
+    }
+
+    int capacity() const { return mCapacity; }
+    int size() const { return (int)std::min<long long>(mNext, mCapacity); }
+    bool isEmpty() const { return mNext == 0; }
+
+    // 追加过的总点数，也用作单元格的版本号
+    long long sequence() const { return mNext; }
+
+    double last() const { return mValues[(int)((mNext - 1) % mCapacity)]; }
+    double minimum() const { return mMinQueue.front().second; }
+    double maximum() const { return mMaxQueue.front().second; }
+
+    // 折线，连续存放，可以直接交给QPainter::drawPolyline
+    const QPointF *points() const { return mPoints.constData() + mBegin; }
+    int pointCount() const { return mEnd + mTail - mBegin; }
+
+    // 窗口内第一个和最后一个样本在折线坐标中的x
+    double firstX() const { return (double)(firstSeq() - mOrigin); }
+    double lastX() const { return (double)(mNext - 1 - mOrigin); }
+
+    // 每个点都在折线上时才画出数据点
+    bool showDots() const { return mBucket == 1 && mCapacity <= SPARKLINE_DOT_POINTS; }
+
+private:
+    long long firstSeq() const { return std::max<long long>(0, mNext - mCapacity); }
+
+    void appendPoint(long long seq, double value)
+    {
+        // 未填满的一列：记下这一列的最小最大值，末尾的点随每次追加改写
+        if (mBucketCount == 0 || value < mBucketMin.second)
+        {
+            mBucketMin = std::make_pair(seq, value);
+        }
+        if (mBucketCount == 0 || value > mBucketMax.second)
+        {
+            mBucketMax = std::make_pair(seq, value);
+        }
+        mBucketCount++;
+
+        if (mEnd + 2 > mPoints.size())
+        {
+            compact();
+        }
+        if (mBucket == 1 || mBucketMin.first == mBucketMax.first)
+        {
+            mPoints[mEnd] = QPointF((double)(seq - mOrigin), value);
+            mTail = 1;
+        }
+        else
+        {
+            // 按出现的先后连成折线，保留这一列的起伏
+            std::pair<long long, double> a = mBucketMin.first < mBucketMax.first ? mBucketMin : mBucketMax;
+            std::pair<long long, double> b = mBucketMin.first < mBucketMax.first ? mBucketMax : mBucketMin;
+            mPoints[mEnd] = QPointF((double)(a.first - mOrigin), a.second);
+            mPoints[mEnd + 1] = QPointF((double)(b.first - mOrigin), b.second);
+            mTail = 2;
+        }
+        if (mBucketCount == mBucket)
+        {
+            mEnd += mTail;
+            mTail = 0;
+            mBucketCount = 0;
+        }
+
+        // 滑出窗口的点从起点去掉，留一个在窗口左边，折线从单元格左边缘画起
+        double first = firstX();
+        while (mBegin + 1 < mEnd && mPoints[mBegin + 1].x() <= first)
+        {
+            mBegin++;
+        }
+    }
+
+    // 缓冲写到末尾时把窗口内的点整体移到开头，x一并改成相对新起点的序号，
+    // 每次移动的点数不超过缓冲的一半，摊到每次追加上是常数
+    void compact()
+    {
+        long long shift = (long long)mPoints[mBegin].x();
+        int count = mEnd + mTail - mBegin;
+        for (int i = 0; i < count; ++i)
+        {
+            QPointF pt = mPoints[mBegin + i];
+            mPoints[i] = QPointF(pt.x() - shift, pt.y());
+        }
+        mOrigin += shift;
+        mEnd -= mBegin;
+        mBegin = 0;
+    }
+
+    int mCapacity;
+    int mBucket;
+    long long mNext = 0;
+
+    QVector<double> mValues;
+    std::deque<std::pair<long long, double>> mMinQueue;
+    std::deque<std::pair<long long, double>> mMaxQueue;
+
+    // 折线缓冲：[mBegin, mEnd)为已经填满的列，其后mTail个点为正在填的一列
+    QVector<QPointF> mPoints;
+    int mBegin = 0;
+    int mEnd = 0;
+    int mTail = 0;
+    long long mOrigin = 0;
+
+    int mBucketCount = 0;
+    std::pair<long long, double> mBucketMin;
+    std::pair<long long, double> mBucketMax;
+};
+
+typedef std::shared_ptr<const SparklineHistory> SparklineHistoryPtr;
+Q_DECLARE_METATYPE(SparklineHistoryPtr)
+
 // 自定义委托：在单元格中绘制迷你曲线图（Sparkline）
+// 单元格的Qt::UserRole存一路的SparklineHistory，绘制时不复制数据
 class SparklineDelegate : public QStyledItemDelegate
 {
     Q_OBJECT
@@ -23,14 +207,9 @@ public:
     {
         // 获取存储在单元格中的历史数据
         QVariant data = index.data(Qt::UserRole);
-        if (!data.isValid() || !data.canConvert<QVector<double>>())
-        {
-            QStyledItemDelegate::paint(painter, option, index);
-            return;
-        }
-
-        QVector<double> values = data.value<QVector<double>>();
-        if (values.isEmpty())
+        const SparklineHistory *history = data.canConvert<SparklineHistoryPtr>()
+                ? data.value<SparklineHistoryPtr>().get() : nullptr;
+        if (!history || history->isEmpty())
         {
             QStyledItemDelegate::paint(painter, option, index);
             return;
@@ -56,16 +235,13 @@ public:
             return;
         }
 
-        // 找到数据的最大最小值
-        double minVal = values.first();
-        double maxVal = values.first();
-        for (double v : values)
-        {
-            if (v < minVal) minVal = v;
-            if (v > maxVal) maxVal = v;
-        }
+        // 窗口内的最大最小值随追加维护，不用再扫描
+        double origMin = history->minimum();
+        double origMax = history->maximum();
 
         // 添加一些边距，避免曲线贴边
+        double minVal = origMin;
+        double maxVal = origMax;
         double range = maxVal - minVal;
         if (range < 0.01) range = 1.0;  // 防止除以零
         minVal -= range * 0.1;
@@ -77,76 +253,62 @@ public:
         int midY = plotRect.top() + plotRect.height() / 2;
         painter->drawLine(plotRect.left(), midY, plotRect.right(), midY);
 
-        // 绘制曲线
+        // 折线坐标（样本序号，耗时）到单元格像素的变换，窗口左边界外的一段裁掉
+        double firstX = history->firstX();
+        double scaleX = plotRect.width() / qMax(1.0, history->lastX() - firstX);
+        double scaleY = -plotRect.height() / range;
+        QTransform transform(scaleX, 0, 0, scaleY,
+                             plotRect.left() - firstX * scaleX, plotRect.bottom() - minVal * scaleY);
+        QPointF lastPoint = transform.map(QPointF(history->lastX(), history->last()));
+
+        // 绘制曲线，整条折线一次画完；线宽不随变换缩放
         painter->setRenderHint(QPainter::Antialiasing, true);
+        painter->save();
+        painter->setClipRect(option.rect.adjusted(1, 0, 0, 0), Qt::IntersectClip);
+        painter->setTransform(transform, true);
         QPen linePen(QColor(30, 144, 255), 2);  // 道奇蓝色
+        linePen.setCosmetic(true);
         painter->setPen(linePen);
+        painter->drawPolyline(history->points(), history->pointCount());
 
-        QVector<QPointF> points;
-        int n = values.size();
-        for (int i = 0; i < n; ++i)
+        // 绘制数据点，点多时只剩一片色块，不画
+        if (history->showDots())
         {
-            double x = plotRect.left() + (double)i / qMax(1, n - 1) * plotRect.width();
-            double y = plotRect.bottom() - (values[i] - minVal) / range * plotRect.height();
-            points.append(QPointF(x, y));
-        }
-
-        // 绘制折线
-        for (int i = 0; i < points.size() - 1; ++i)
-        {
-            painter->drawLine(points[i], points[i + 1]);
-        }
-
-        // 绘制数据点
-        painter->setBrush(QColor(30, 144, 255));
-        painter->setPen(Qt::NoPen);
-        for (const QPointF &pt : points)
-        {
-            painter->drawEllipse(pt, 3, 3);
+            QPen dotPen(QColor(30, 144, 255), 6, Qt::SolidLine, Qt::RoundCap);
+            dotPen.setCosmetic(true);
+            painter->setPen(dotPen);
+            painter->drawPoints(history->points(), history->pointCount());
         }
+        painter->restore();
 
         // 高亮最后一个点（当前值）
-        if (!points.isEmpty())
-        {
-            painter->setBrush(QColor(255, 69, 0));  // 橙红色
-            painter->drawEllipse(points.last(), 4, 4);
-        }
+        painter->setPen(Qt::NoPen);
+        painter->setBrush(QColor(255, 69, 0));  // 橙红色
+        painter->drawEllipse(lastPoint, 4, 4);
 
         // 在曲线图中显示最大最小值
-        if (!values.isEmpty())
-        {
-            // 重新计算原始的最大最小值（不含边距）
-            double origMin = values.first();
-            double origMax = values.first();
-            for (double v : values)
-            {
-                if (v < origMin) origMin = v;
-                if (v > origMax) origMax = v;
-            }
-            
-            QFont font = painter->font();
-            font.setPointSize(8);
-            painter->setFont(font);
-            QFontMetrics fm(font);
-            
-            // 左上角显示最大值（带背景）
-            QString maxText = QString("max:%1").arg(origMax, 0, 'f', 1);
-            QRect maxTextRect = fm.boundingRect(maxText);
-            maxTextRect.moveTo(plotRect.left() + 2, plotRect.top() + 1);
-            maxTextRect.adjust(-2, -1, 4, 2);  // 扩展一点边距
-            painter->fillRect(maxTextRect, QColor(255, 255, 255, 200));  // 半透明白色背景
-            painter->setPen(QColor(220, 20, 60));  // 深红色文字（最大值）
-            painter->drawText(maxTextRect, Qt::AlignCenter, maxText);
-            
-            // 左下角显示最小值（带背景）
-            QString minText = QString("min:%1").arg(origMin, 0, 'f', 1);
-            QRect minTextRect = fm.boundingRect(minText);
-            minTextRect.moveTo(plotRect.left() + 2, plotRect.bottom() - minTextRect.height() - 1);
-            minTextRect.adjust(-2, -1, 4, 2);  // 扩展一点边距
-            painter->fillRect(minTextRect, QColor(255, 255, 255, 200));  // 半透明白色背景
-            painter->setPen(QColor(0, 100, 0));  // 深绿色文字（最小值）
-            painter->drawText(minTextRect, Qt::AlignCenter, minText);
-        }
+        QFont font = painter->font();
+        font.setPointSize(8);
+        painter->setFont(font);
+        QFontMetrics fm(font);
+
+        // 左上角显示最大值（带背景）
+        QString maxText = QString("max:%1").arg(origMax, 0, 'f', 1);
+        QRect maxTextRect = fm.boundingRect(maxText);
+        maxTextRect.moveTo(plotRect.left() + 2, plotRect.top() + 1);
+        maxTextRect.adjust(-2, -1, 4, 2);  // 扩展一点边距
+        painter->fillRect(maxTextRect, QColor(255, 255, 255, 200));  // 半透明白色背景
+        painter->setPen(QColor(220, 20, 60));  // 深红色文字（最大值）
+        painter->drawText(maxTextRect, Qt::AlignCenter, maxText);
+
+        // 左下角显示最小值（带背景）
+        QString minText = QString("min:%1").arg(origMin, 0, 'f', 1);
+        QRect minTextRect = fm.boundingRect(minText);
+        minTextRect.moveTo(plotRect.left() + 2, plotRect.bottom() - minTextRect.height() - 1);
+        minTextRect.adjust(-2, -1, 4, 2);  // 扩展一点边距
+        painter->fillRect(minTextRect, QColor(255, 255, 255, 200));  // 半透明白色背景
+        painter->setPen(QColor(0, 100, 0));  // 深绿色文字（最小值）
+        painter->drawText(minTextRect, Qt::AlignCenter, minText);
 
         painter->restore();
     }
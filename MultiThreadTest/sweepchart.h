@@ -0,0 +1,153 @@
+﻿#ifndef SWEEPCHART_H
+#define SWEEPCHART_H
+
+#include <QPainter>
+#include <QPointF>
+#include <QVector>
+#include <QWidget>
+
+#pragma execution_character_set("utf-8")
+
+// 自动扫描的结果图：横轴为线程数，蓝线为吞吐量（左轴），橙线为端到端p99（右轴）
+// 灰色虚线为延迟预算，绿色竖线为推荐的线程数
+class SweepChart : public QWidget
+{
+    Q_OBJECT
+
+public:
+    explicit SweepChart(QWidget *parent = nullptr) : QWidget(parent)
+    {
+        setMinimumSize(360, 220);
+    }
+
+    void setBudget(double budgetMs)
+    {
+        mBudgetMs = budgetMs;
+        update();
+    }
+
+    void addPoint(int threads, double throughput, double p99Ms)
+    {
+        mThroughput.append(QPointF(threads, throughput));
+        mP99.append(QPointF(threads, p99Ms));
+        update();
+    }
+
+    void setRecommended(int threads)
+    {
+        mRecommended = threads;
+        update();
+    }
+
+    void clear()
+    {
+        mThroughput.clear();
+        mP99.clear();
+        mRecommended = 0;
+        update();
+    }
+
+protected:
+    void paintEvent(QPaintEvent *) override
+    {
+        QPainter painter(this);
+        painter.fillRect(rect(), palette().base());
+
+        // 留出坐标轴文字的位置
+        QRect plotRect = rect().adjusted(48, 12, -48, -28);
+        if (mThroughput.isEmpty() || plotRect.width() < 10 || plotRect.height() < 10)
+        {
+            painter.drawText(rect(), Qt::AlignCenter, "暂无数据");
+            return;
+        }
+
+        double minX = mThroughput.first().x();
+        double maxX = qMax(minX + 1, mThroughput.last().x());
+        double maxThroughput = 1;
+        double maxLatency = mBudgetMs;
+        for (int i = 0; i < mThroughput.size(); ++i)
+        {
+            maxThroughput = qMax(maxThroughput, mThroughput[i].y());
+            maxLatency = qMax(maxLatency, mP99[i].y());
+        }
+        maxThroughput *= 1.1;
+        maxLatency = qMax(1.0, maxLatency * 1.1);
+
+        auto mapX = [&](double x) { return plotRect.left() + (x - minX) / (maxX - minX) * plotRect.width(); };
+        auto mapThroughput = [&](double y) { return plotRect.bottom() - y / maxThroughput * plotRect.height(); };
+        auto mapLatency = [&](double y) { return plotRect.bottom() - y / maxLatency * plotRect.height(); };
+
+        // 坐标轴
+        painter.setPen(QColor(160, 160, 160));
+        painter.drawRect(plotRect);
+        QFont font = painter.font();
+        font.setPointSize(8);
+        painter.setFont(font);
+        painter.setPen(QColor(30, 144, 255));
+        painter.drawText(QRect(0, plotRect.top(), plotRect.left() - 4, 16), Qt::AlignRight,
+                         QString::number(maxThroughput, 'f', 0));
+        painter.drawText(QRect(0, plotRect.bottom() - 16, plotRect.left() - 4, 16), Qt::AlignRight, "pcs/s");
+        painter.setPen(QColor(255, 140, 0));
+        painter.drawText(QRect(plotRect.right() + 4, plotRect.top(), 44, 16), Qt::AlignLeft,
+                         QString::number(maxLatency, 'f', 0));
+        painter.drawText(QRect(plotRect.right() + 4, plotRect.bottom() - 16, 44, 16), Qt::AlignLeft, "p99 ms");
+        painter.setPen(palette().text().color());
+        for (const QPointF &pt : mThroughput)
+        {
+            painter.drawText(QRectF(mapX(pt.x()) - 12, plotRect.bottom() + 4, 24, 16), Qt::AlignCenter,
+                             QString::number((int)pt.x()));
+        }
+
+        // 延迟预算
+        if (mBudgetMs > 0)
+        {
+            painter.setPen(QPen(QColor(150, 150, 150), 1, Qt::DashLine));
+            double y = mapLatency(mBudgetMs);
+            painter.drawLine(QPointF(plotRect.left(), y), QPointF(plotRect.right(), y));
+        }
+
+        // 推荐的线程数
+        if (mRecommended > 0)
+        {
+            painter.setPen(QPen(QColor(46, 139, 87), 2));
+            double x = mapX(mRecommended);
+            painter.drawLine(QPointF(x, plotRect.top()), QPointF(x, plotRect.bottom()));
+        }
+
+        painter.setRenderHint(QPainter::Antialiasing, true);
+        drawSeries(painter, mThroughput, QColor(30, 144, 255), mapX, mapThroughput);
+        drawSeries(painter, mP99, QColor(255, 140, 0), mapX, mapLatency);
+    }
+
+private:
+    template<typename MapX, typename MapY>
+    static void drawSeries(QPainter &painter, const QVector<QPointF> &series, const QColor &color,
+                           MapX mapX, MapY mapY)
+    {
+        QVector<QPointF> points;
+        for (const QPointF &pt : series)
+        {
+            points.append(QPointF(mapX(pt.x()), mapY(pt.y())));
+        }
+
+        painter.setPen(QPen(color, 2));
+        for (int i = 0; i < points.size() - 1; ++i)
+        {
+            painter.drawLine(points[i], points[i + 1]);
+        }
+        painter.setPen(Qt::NoPen);
+        painter.setBrush(color);
+        for (const QPointF &pt : points)
+        {
+            painter.drawEllipse(pt, 3, 3);
+        }
+        painter.setBrush(Qt::NoBrush);
+    }
+
+    QVector<QPointF> mThroughput;
+    QVector<QPointF> mP99;
+    double mBudgetMs = 0;
+    int mRecommended = 0;
+};
+
+#endif // SWEEPCHART_H
@@ -0,0 +1,230 @@
+﻿#include "sweepdialog.h"
+#include "sweepchart.h"
+#include "framecorpus.h"
+
+#include <QFormLayout>
+#include <QHBoxLayout>
+#include <QHeaderView>
+#include <QVBoxLayout>
+
+SweepDialog::SweepDialog(const SweepSettings &settings, QWidget *parent)
+    : QDialog(parent)
+    , mSettings(settings)
+{
+    setWindowTitle("自动扫描线程数");
+    resize(760, 560);
+
+    mMaxThreads = new QSpinBox(this);
+    mMaxThreads->setRange(1, 64);
+    mMaxThreads->setValue(settings.maxThreads);
+    mMaxThreads->setToolTip("从1开始逐个增加，最多扫描到这么多线程");
+
+    mDuration = new QDoubleSpinBox(this);
+    mDuration->setRange(1, 600);
+    mDuration->setValue(10);
+    mDuration->setSuffix(" s");
+    mDuration->setToolTip("每个线程数预热之后测量的时间");
+
+    mScalePipelines = new QCheckBox("pipelines数随线程数增加", this);
+    mScalePipelines->setToolTip(QString("不勾选时固定使用%1个pipelines；勾选时每一步重新创建引擎").arg(settings.pipelines));
+
+    mStart = new QPushButton("开始扫描", this);
+    mStop = new QPushButton("停止", this);
+    mStatus = new QLabel(QString("节拍 %1 ms，p99超过节拍或吞吐量不再增长时停止").arg(settings.taktMs), this);
+
+    QFormLayout *form = new QFormLayout;
+    form->addRow("最大线程数", mMaxThreads);
+    form->addRow("每步测量时间", mDuration);
+    form->addRow("", mScalePipelines);
+
+    QHBoxLayout *buttons = new QHBoxLayout;
+    buttons->addWidget(mStatus, 1);
+    buttons->addWidget(mStart);
+    buttons->addWidget(mStop);
+
+    mTable = new QTableWidget(0, 8, this);
+    mTable->setHorizontalHeaderLabels(QStringList() << "线程数" << "pipelines" << "吞吐量(pcs/s)"
+                                      << "P50(ms)" << "P99(ms)" << "端到端P99(ms)" << "超拍" << "预算内");
+    mTable->setEditTriggers(QAbstractItemView::NoEditTriggers);
+    mTable->verticalHeader()->setVisible(false);
+    mTable->horizontalHeader()->setSectionResizeMode(QHeaderView::Stretch);
+
+    mChart = new SweepChart(this);
+    mChart->setBudget(settings.taktMs);
+
+    QVBoxLayout *layout = new QVBoxLayout(this);
+    layout->addLayout(form);
+    layout->addLayout(buttons);
+    layout->addWidget(mTable, 1);
+    layout->addWidget(mChart, 1);
+
+    connect(mStart, &QPushButton::clicked, this, &SweepDialog::onStartClicked);
+    connect(mStop, &QPushButton::clicked, this, &SweepDialog::onStopClicked);
+    connect(this, &SweepDialog::stepFinished, this, &SweepDialog::onStepFinished, Qt::QueuedConnection);
+    connect(this, &SweepDialog::sweepFinished, this, &SweepDialog::onSweepFinished, Qt::QueuedConnection);
+    connect(this, &SweepDialog::statusChanged, mStatus, &QLabel::setText, Qt::QueuedConnection);
+
+    setRunning(false);
+}
+
+SweepDialog::~SweepDialog()
+{
+    mCancel.cancel();
+    joinWorker();
+}
+
+void SweepDialog::reject()
+{
+    // 关闭窗口时先停止扫描，取消会立即唤醒扫描线程，这里最多等正在推理的那一张做完
+    mCancel.cancel();
+    joinWorker();
+    QDialog::reject();
+}
+
+void SweepDialog::onStartClicked()
+{
+    joinWorker();
+
+    ThreadSweepConfig config;
+    config.maxThreads = mMaxThreads->value();
+    config.scalePipelines = mScalePipelines->isChecked();
+    config.fixedPipelines = mSettings.pipelines;
+    config.run.pacing = PacingMode::Takt;
+    config.run.taktMs = mSettings.taktMs;
+    config.run.durationSec = mDuration->value();
+    config.run.maxBatchSize = mSettings.maxBatchSize;
+    config.run.maxBatchWaitUs = mSettings.maxBatchWaitUs;
+    config.run.placement = planDevicePlacement(mSettings.devices, mSettings.pinThreads);
+
+    mTable->setRowCount(0);
+    mChart->clear();
+    mCancel = CancellationSource();
+    setRunning(true);
+
+    mWorker = std::thread(&SweepDialog::runSweep, this, config, mCancel.token());
+}
+
+void SweepDialog::onStopClicked()
+{
+    mCancel.cancel();
+    mStatus->setText("正在停止...");
+}
+
+void SweepDialog::runSweep(ThreadSweepConfig config, CancellationToken cancel)
+{
+    emit statusChanged("正在预加载图像...");
+    FrameCorpusConfig corpusConfig;
+    corpusConfig.imageFolderPath = mSettings.imageDir;
+    corpusConfig.preprocess = mSettings.preprocess;
+    auto corpus = std::make_shared<FrameCorpus>(corpusConfig);
+    std::string error;
+    if (!corpus->load(&error))
+    {
+        emit sweepFinished(QString("图像加载失败: %1").arg(QString::fromStdString(error)), 0);
+        return;
+    }
+
+    // 绑核时每个分片在自己的节点上有一份图像库的副本
+    std::vector<int> replicaForShard;
+    for (const DevicePlacement &placement : config.run.placement)
+    {
+        replicaForShard.push_back(mSettings.pinThreads ? corpus->addReplica(placement.cpus) : 0);
+    }
+
+    BenchmarkFrameSource frames = [corpus, replicaForShard](int stream, long long sequence, int shard) {
+        int replica = shard < (int)replicaForShard.size() ? replicaForShard[shard] : 0;
+        return corpus->frame((int)((stream + sequence) % corpus->size()), replica);
+    };
+
+    std::string modelDir = mSettings.modelDir.toLocal8Bit().toStdString();
+    bool synthetic = mSettings.synthetic;
+    SyntheticBackendConfig syntheticConfig = mSettings.syntheticConfig;
+    bool useGpu = mSettings.devices.useGpu;
+    std::vector<int> deviceIds;
+    for (const DevicePlacement &placement : config.run.placement)
+    {
+        deviceIds.push_back(placement.deviceId);
+    }
+    EngineFactory engineFactory = [modelDir, synthetic, syntheticConfig, useGpu, deviceIds](int pipelineCount) {
+        InferenceEngineConfig engineConfig;
+        engineConfig.modelDir = modelDir;
+        engineConfig.pipelineCount = pipelineCount;
+        engineConfig.useGpu = useGpu;
+        engineConfig.deviceIds = deviceIds;
+        if (synthetic)
+        {
+            engineConfig.backend = std::make_shared<SyntheticBackend>(syntheticConfig);
+        }
+        return std::make_shared<InferenceEngine>(engineConfig);
+    };
+
+    emit statusChanged("正在扫描...");
+    ThreadSweepResult sweep = runThreadSweep(config, engineFactory, frames, [this](const ThreadSweepStep &step) {
+        const BenchmarkStreamResult &total = step.result.total;
+        emit stepFinished(step.threads, step.pipelines, step.result.throughput(),
+                          total.latency.percentileMs(50), total.latency.percentileMs(99),
+                          total.endToEnd.percentileMs(99), total.overruns, step.withinBudget);
+    }, cancel);
+
+    emit sweepFinished(QString::fromStdString(sweep.stopReason), sweep.recommendedThreads);
+}
+
+void SweepDialog::onStepFinished(int threads, int pipelines, double throughput, double p50Ms,
+                                 double p99Ms, double endToEndP99Ms, long long overruns, bool withinBudget)
+{
+    int row = mTable->rowCount();
+    mTable->insertRow(row);
+    QStringList texts;
+    texts << QString::number(threads) << QString::number(pipelines)
+          << QString::number(throughput, 'f', 1) << QString::number(p50Ms, 'f', 2)
+          << QString::number(p99Ms, 'f', 2) << QString::number(endToEndP99Ms, 'f', 2)
+          << QString::number(overruns) << (withinBudget ? "是" : "否");
+    for (int column = 0; column < texts.size(); ++column)
+    {
+        mTable->setItem(row, column, new QTableWidgetItem(texts[column]));
+    }
+    mTable->scrollToBottom();
+
+    mChart->addPoint(threads, throughput, endToEndP99Ms);
+}
+
+void SweepDialog::onSweepFinished(QString reason, int recommendedThreads)
+{
+    joinWorker();
+    setRunning(false);
+
+    mChart->setRecommended(recommendedThreads);
+    if (recommendedThreads > 0)
+    {
+        mStatus->setText(QString("推荐线程数：%1（%2 ms节拍，扫描结束原因：%3）")
+                             .arg(recommendedThreads).arg(mSettings.taktMs).arg(reason));
+        for (int row = 0; row < mTable->rowCount(); ++row)
+        {
+            if (mTable->item(row, 0)->text().toInt() == recommendedThreads)
+            {
+                mTable->selectRow(row);
+            }
+        }
+    }
+    else
+    {
+        mStatus->setText(QString("没有满足节拍预算的线程数（%1）").arg(reason));
+    }
+}
+
+void SweepDialog::joinWorker()
+{
+    if (mWorker.joinable())
+    {
+        mWorker.join();
+    }
+}
+
+void SweepDialog::setRunning(bool running)
+{
+    mMaxThreads->setEnabled(!running);
+    mDuration->setEnabled(!running);
+    mScalePipelines->setEnabled(!running);
+    mStart->setEnabled(!running);
+    mStop->setEnabled(running);
+}
@@ -0,0 +1,88 @@
+﻿#ifndef SWEEPDIALOG_H
+#define SWEEPDIALOG_H
+
+#include <QCheckBox>
+#include <QDialog>
+#include <QDoubleSpinBox>
+#include <QLabel>
+#include <QPushButton>
+#include <QSpinBox>
+#include <QTableWidget>
+
+#include <atomic>
+#include <thread>
+
+#include "deviceplacement.h"
+#include "preprocess.h"
+#include "syntheticbackend.h"
+#include "threadsweep.h"
+
+#pragma execution_character_set("utf-8")
+
+class SweepChart;
+
+// 从主界面带过来的参数
+struct SweepSettings
+{
+    QString modelDir;
+    QString imageDir;
+    int maxThreads = 16;
+    int pipelines = 6;
+    int taktMs = 100;
+    int maxBatchSize = 1;
+    int maxBatchWaitUs = 0;
+    bool synthetic = false;                 // 使用模拟后端，每一步都新建一个后端
+    SyntheticBackendConfig syntheticConfig;
+    DeviceSpec devices;                     // 推理设备，多个设备时按设备分片
+    bool pinThreads = false;                // 工作线程和送图线程绑到设备所在NUMA节点的核上
+    PreprocessConfig preprocess;            // 预加载时的预处理，和正常运行时相同
+};
+
+// 自动扫描线程数：逐个线程数预热、测量稳态吞吐量和p99，
+// 吞吐量饱和或者p99超出节拍预算时停止，给出推荐的线程数
+class SweepDialog : public QDialog
+{
+    Q_OBJECT
+
+public:
+    explicit SweepDialog(const SweepSettings &settings, QWidget *parent = nullptr);
+    ~SweepDialog();
+
+signals:
+    // 以下信号在扫描线程中发出
+    void stepFinished(int threads, int pipelines, double throughput, double p50Ms,
+                      double p99Ms, double endToEndP99Ms, long long overruns, bool withinBudget);
+    void sweepFinished(QString reason, int recommendedThreads);
+    void statusChanged(QString text);
+
+private slots:
+    void onStartClicked();
+    void onStopClicked();
+    void onStepFinished(int threads, int pipelines, double throughput, double p50Ms,
+                        double p99Ms, double endToEndP99Ms, long long overruns, bool withinBudget);
+    void onSweepFinished(QString reason, int recommendedThreads);
+
+protected:
+    void reject() override;
+
+private:
+    void runSweep(ThreadSweepConfig config, CancellationToken cancel);
+    void joinWorker();
+    void setRunning(bool running);
+
+    SweepSettings mSettings;
+
+    QSpinBox *mMaxThreads;
+    QDoubleSpinBox *mDuration;
+    QCheckBox *mScalePipelines;
+    QPushButton *mStart;
+    QPushButton *mStop;
+    QLabel *mStatus;
+    QTableWidget *mTable;
+    SweepChart *mChart;
+
+    std::thread mWorker;
+    CancellationSource mCancel;             // 每次开始扫描时换一个新的
+};
+
+#endif // SWEEPDIALOG_H
@@ -0,0 +1,377 @@
+﻿#include "syntheticbackend.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <sstream>
+#include <stdexcept>
+#include <thread>
+
+using Clock = std::chrono::steady_clock;
+
+namespace {
+
+// splitmix64：实现简单，而且在所有平台上产生同样的序列（std的分布在不同标准库之间并不一致）
+class SyntheticRandom
+{
+public:
+    explicit SyntheticRandom(unsigned long long seed) : mState(seed) {}
+
+    unsigned long long next()
+    {
+        unsigned long long z = (mState += 0x9E3779B97F4A7C15ULL);
+        z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+        z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+        return z ^ (z >> 31);
+    }
+
+    // (0, 1)
+    double uniform()
+    {
+        return ((next() >> 11) + 0.5) * (1.0 / 9007199254740992.0);
+    }
+
+    // 标准正态分布（Box-Muller）
+    double normal()
+    {
+        const double kTwoPi = 6.283185307179586;
+        return std::sqrt(-2.0 * std::log(uniform())) * std::cos(kTwoPi * uniform());
+    }
+
+private:
+    unsigned long long mState;
+};
+
+void waitMs(double ms)
+{
+    if (ms > 0)
+    {
+        std::this_thread::sleep_for(std::chrono::duration<double, std::milli>(ms));
+    }
+}
+
+class SyntheticSession : public IInferenceSession
+{
+public:
+    SyntheticSession(const SyntheticBackendConfig &config, std::string moduleId, unsigned long long seed)
+        : mConfig(config)
+        , mModuleId(std::move(moduleId))
+        , mRandom(seed)
+    {
+        // 逐页写入，保证内存真的被占用
+        if (mConfig.sessionMemoryBytes > 0)
+        {
+            mMemory.resize((size_t)mConfig.sessionMemoryBytes);
+            for (size_t i = 0; i < mMemory.size(); i += 4096)
+            {
+                mMemory[i] = (unsigned char)i;
+            }
+        }
+    }
+
+    void run(const cv::Mat &image, InferenceOutput &output) override
+    {
+        if (image.empty())
+        {
+            throw std::runtime_error("synthetic session got empty image");
+        }
+        double ms = sampleMs() + areaMs(image);
+        output.payload = SyntheticResponse{mModuleId, simulate(ms), 1, makeDetections(image)};
+    }
+
+    void runBatch(const std::vector<cv::Mat> &images, std::vector<InferenceOutput> &outputs) override
+    {
+        for (const cv::Mat &image : images)
+        {
+            if (image.empty())
+            {
+                throw std::runtime_error("synthetic session got empty image");
+            }
+        }
+
+        // 整批的耗时 = 单张 * (1 + (n - 1) * batchCostFraction)
+        double single = sampleMs();
+        double cost = images.empty() ? 0 : single * (1.0 + (images.size() - 1) * mConfig.batchCostFraction);
+        for (const cv::Mat &image : images)
+        {
+            cost += areaMs(image);
+        }
+        double simulated = simulate(cost);
+
+        outputs.resize(images.size());
+        for (size_t i = 0; i < images.size(); ++i)
+        {
+            outputs[i].payload = SyntheticResponse{mModuleId, simulated, (int)images.size(), makeDetections(images[i])};
+        }
+    }
+
+private:
+    double areaMs(const cv::Mat &image) const
+    {
+        return mConfig.msPerMegapixel * image.total() / 1e6;
+    }
+
+    // 原图上固定网格的目标，和这张图（可能是ROI）相交的部分，坐标换算到这张图上
+    std::vector<InferenceDetection> makeDetections(const cv::Mat &image) const
+    {
+        std::vector<InferenceDetection> boxes;
+        if (mConfig.objectSpacing <= 0 || mConfig.objectSize <= 0)
+        {
+            return boxes;
+        }
+        cv::Size whole;
+        cv::Point offset;
+        image.locateROI(whole, offset);
+        cv::Rect view(offset, image.size());
+        const int spacing = mConfig.objectSpacing;
+        const int size = mConfig.objectSize;
+        // 目标的左上角在 (spacing/2 + i*spacing, spacing/2 + j*spacing)
+        int firstX = std::max(0, (view.x - spacing / 2 - size) / spacing);
+        int firstY = std::max(0, (view.y - spacing / 2 - size) / spacing);
+        for (int y = spacing / 2 + firstY * spacing; y < view.y + view.height && y < whole.height; y += spacing)
+        {
+            for (int x = spacing / 2 + firstX * spacing; x < view.x + view.width && x < whole.width; x += spacing)
+            {
+                cv::Rect object(x, y, size, size);
+                cv::Rect visible = object & view;
+                if (visible.area() <= 0)
+                {
+                    continue;
+                }
+                InferenceDetection detection;
+                detection.box = cv::Rect2f((float)(visible.x - view.x), (float)(visible.y - view.y),
+                                           (float)visible.width, (float)visible.height);
+                detection.score = (float)visible.area() / object.area();
+                boxes.push_back(detection);
+            }
+        }
+        return boxes;
+    }
+
+    double sampleMs()
+    {
+        double mean = mConfig.meanMs;
+        double stddev = mConfig.stddevMs;
+        double ms = mean;
+        switch (mConfig.distribution) {
+        case SyntheticLatency::Fixed:
+            break;
+        case SyntheticLatency::Uniform:
+            ms = mean + stddev * std::sqrt(3.0) * (2 * mRandom.uniform() - 1);
+            break;
+        case SyntheticLatency::Normal:
+            ms = mean + stddev * mRandom.normal();
+            break;
+        case SyntheticLatency::LogNormal:{
+            // 由目标均值和标准差反推对数空间的参数
+            if (mean > 0)
+            {
+                double sigma2 = std::log(1 + (stddev * stddev) / (mean * mean));
+                double mu = std::log(mean) - sigma2 / 2;
+                ms = std::exp(mu + std::sqrt(sigma2) * mRandom.normal());
+            }
+        }break;
+        }
+
+        if (mConfig.tailProbability > 0 && mRandom.uniform() < mConfig.tailProbability)
+        {
+            ms *= mConfig.tailMultiplier;
+        }
+        return std::max(0.0, ms);
+    }
+
+    // 按配置的CPU比例先忙算、再睡眠，返回实际耗时
+    double simulate(double ms)
+    {
+        auto start = Clock::now();
+        if (mConfig.failureRate > 0 && mRandom.uniform() < mConfig.failureRate)
+        {
+            throw std::runtime_error("synthetic inference failure");
+        }
+
+        double cpuMs = ms * std::min(1.0, std::max(0.0, mConfig.cpuFraction));
+        auto cpuEnd = start + std::chrono::duration_cast<Clock::duration>(std::chrono::duration<double, std::milli>(cpuMs));
+        unsigned long long sink = 0;
+        while (Clock::now() < cpuEnd)
+        {
+            // 读一遍常驻内存中的一小段，占用CPU的同时也产生一些内存访问
+            for (size_t i = 0; i < std::min<size_t>(mMemory.size(), 64 * 1024); i += 64)
+            {
+                sink += mMemory[i];
+            }
+            sink = sink * 6364136223846793005ULL + 1;
+        }
+        mSink += sink;
+
+        // 睡到绝对时间点，睡眠误差不会累加到下一次
+        auto end = start + std::chrono::duration_cast<Clock::duration>(std::chrono::duration<double, std::milli>(ms));
+        std::this_thread::sleep_until(end);
+        return std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+    }
+
+    SyntheticBackendConfig mConfig;
+    std::string mModuleId;
+    SyntheticRandom mRandom;
+    std::vector<unsigned char> mMemory;
+    unsigned long long mSink = 0;
+};
+
+bool parseDouble(const std::string &text, double &value)
+{
+    char *end = nullptr;
+    value = std::strtod(text.c_str(), &end);
+    return !text.empty() && end && *end == '\0';
+}
+
+} // namespace
+
+const char *syntheticBackendSpecHelp()
+{
+    return "dist=fixed|uniform|normal|lognormal, mean=<ms>, stddev=<ms>, "
+           "tail=<概率>, tail_x=<倍数>, cpu=<0~1>, mem_mb=<每个会话的MB>, "
+           "load_ms=<ms>, create_ms=<ms>, batch=<每多一张的耗时比例>, mp_ms=<每百万像素的耗时>, "
+           "obj_spacing=<模拟目标的间距px>, obj_size=<模拟目标的边长px>, "
+           "fail=<失败概率>, modules=<模组数>, seed=<种子>";
+}
+
+bool parseSyntheticBackendSpec(const std::string &spec, SyntheticBackendConfig &config, std::string *errorMessage)
+{
+    auto fail = [&](const std::string &message) {
+        if (errorMessage)
+        {
+            *errorMessage = message;
+        }
+        return false;
+    };
+
+    std::stringstream stream(spec);
+    std::string item;
+    while (std::getline(stream, item, ','))
+    {
+        if (item.empty())
+        {
+            continue;
+        }
+        size_t eq = item.find('=');
+        if (eq == std::string::npos)
+        {
+            return fail("缺少'=': " + item);
+        }
+        std::string key = item.substr(0, eq);
+        std::string text = item.substr(eq + 1);
+
+        if (key == "dist")
+        {
+            if (text == "fixed") config.distribution = SyntheticLatency::Fixed;
+            else if (text == "uniform") config.distribution = SyntheticLatency::Uniform;
+            else if (text == "normal") config.distribution = SyntheticLatency::Normal;
+            else if (text == "lognormal") config.distribution = SyntheticLatency::LogNormal;
+            else return fail("未知的分布: " + text);
+            continue;
+        }
+
+        double value = 0;
+        if (!parseDouble(text, value))
+        {
+            return fail("无效的数值: " + item);
+        }
+        if (key == "mean") config.meanMs = value;
+        else if (key == "stddev") config.stddevMs = value;
+        else if (key == "tail") config.tailProbability = value;
+        else if (key == "tail_x") config.tailMultiplier = value;
+        else if (key == "cpu") config.cpuFraction = value;
+        else if (key == "mem_mb") config.sessionMemoryBytes = (long long)(value * 1048576);
+        else if (key == "load_ms") config.loadMs = value;
+        else if (key == "create_ms") config.createSessionMs = value;
+        else if (key == "batch") config.batchCostFraction = value;
+        else if (key == "mp_ms") config.msPerMegapixel = value;
+        else if (key == "obj_spacing") config.objectSpacing = (int)value;
+        else if (key == "obj_size") config.objectSize = (int)value;
+        else if (key == "fail") config.failureRate = value;
+        else if (key == "modules") config.moduleCount = std::max(1, (int)value);
+        else if (key == "seed") config.seed = (unsigned long long)value;
+        else return fail("未知的参数: " + key);
+    }
+    return true;
+}
+
+SyntheticBackend::SyntheticBackend(const SyntheticBackendConfig &config)
+    : mConfig(config)
+{
+}
+
+void SyntheticBackend::load(const std::string &modelDir)
+{
+    (void)modelDir;
+    waitMs(mConfig.loadMs);
+    mLoaded = true;
+}
+
+std::vector<std::string> SyntheticBackend::moduleIds()
+{
+    std::vector<std::string> ids;
+    if (mLoaded)
+    {
+        for (int i = 1; i <= mConfig.moduleCount; ++i)
+        {
+            ids.push_back(std::to_string(i));
+        }
+    }
+    return ids;
+}
+
+std::unique_ptr<IInferenceSession> SyntheticBackend::createSession(const std::string &moduleId, bool useGpu, int deviceId)
+{
+    (void)useGpu;
+    (void)deviceId;
+    if (!mLoaded)
+    {
+        throw std::runtime_error("synthetic backend not loaded");
+    }
+
+    waitMs(mConfig.createSessionMs);
+    // 每个会话用不同但确定的种子
+    unsigned long long seed = mConfig.seed * 0x100000001B3ULL + (unsigned long long)mSessionCount++;
+    return std::unique_ptr<IInferenceSession>(new SyntheticSession(mConfig, moduleId, seed));
+}
+
+std::string SyntheticBackend::describeOutput(const InferenceOutput &output) const
+{
+    const SyntheticResponse *response = std::any_cast<SyntheticResponse>(&output.payload);
+    if (!response)
+    {
+        return std::string();
+    }
+    std::ostringstream text;
+    text << "module=" << response->moduleId << " simulated_ms=" << response->simulatedMs
+         << " batch=" << response->batchSize;
+    if (mConfig.objectSpacing > 0)
+    {
+        text << " objects=" << response->detections.size();
+    }
+    return text.str();
+}
+
+size_t SyntheticBackend::outputBytes(const InferenceOutput &output) const
+{
+    const SyntheticResponse *response = std::any_cast<SyntheticResponse>(&output.payload);
+    if (!response)
+    {
+        return sizeof(InferenceOutput);
+    }
+    return sizeof(InferenceOutput) + sizeof(SyntheticResponse) + response->moduleId.capacity()
+           + response->detections.capacity() * sizeof(InferenceDetection);
+}
+
+bool SyntheticBackend::detections(const InferenceOutput &output, std::vector<InferenceDetection> &boxes) const
+{
+    const SyntheticResponse *response = std::any_cast<SyntheticResponse>(&output.payload);
+    if (!response || mConfig.objectSpacing <= 0)
+    {
+        return false;
+    }
+    boxes = response->detections;
+    return true;
+}
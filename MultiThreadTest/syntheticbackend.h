@@ -0,0 +1,89 @@
+﻿#ifndef SYNTHETICBACKEND_H
+#define SYNTHETICBACKEND_H
+
+#include <string>
+#include <vector>
+
+#include "inferencebackend.h"
+
+// 模拟推理耗时的分布
+enum class SyntheticLatency
+{
+    Fixed,          // 固定为meanMs
+    Uniform,        // [meanMs - stddevMs * sqrt(3), meanMs + stddevMs * sqrt(3)]
+    Normal,         // 正态分布，截断到0以上
+    LogNormal,      // 对数正态分布，均值和标准差为meanMs、stddevMs，右侧有自然的长尾
+};
+
+struct SyntheticBackendConfig
+{
+    SyntheticLatency distribution = SyntheticLatency::LogNormal;
+    double meanMs = 30;
+    double stddevMs = 3;
+
+    // 偶发的长尾：以tailProbability的概率，本次耗时乘以tailMultiplier
+    double tailProbability = 0;
+    double tailMultiplier = 5;
+
+    // 耗时中真正占用CPU的比例：0为纯睡眠（模拟GPU推理），1为整段忙算
+    double cpuFraction = 0;
+
+    // 每个会话常驻的内存（模拟模型权重和显存之外的主机内存），创建时分配并逐页写入
+    long long sessionMemoryBytes = 0;
+
+    double loadMs = 0;              // 加载模型的耗时
+    double createSessionMs = 0;     // 创建每个会话的耗时
+    double batchCostFraction = 0.3; // 批量推理时每多一张增加的耗时（相对单张的比例）
+    double msPerMegapixel = 0;      // 每百万像素额外的耗时，模拟大图比小图慢（切图推理时每块的耗时随面积变小）
+
+    // 模拟检测框：在原图上每隔objectSpacing像素放一个objectSize见方的目标（0为不输出检测框）
+    // 送进来的是切图的ROI时，按它在原图中的位置输出落在这一块里的部分，分数为露出的比例
+    int objectSpacing = 0;
+    int objectSize = 64;
+    double failureRate = 0;         // 推理失败（抛异常）的概率
+    int moduleCount = 2;            // 模组数，编号为"1".."n"
+    unsigned long long seed = 1;    // 随机种子，相同种子的每个会话产生相同的耗时序列
+};
+
+// 把"dist=lognormal,mean=30,stddev=3,cpu=0.2"这样的描述解析到config中，
+// 没有出现的键保持原值；键名见syntheticBackendSpecHelp()
+bool parseSyntheticBackendSpec(const std::string &spec, SyntheticBackendConfig &config,
+                               std::string *errorMessage = nullptr);
+const char *syntheticBackendSpecHelp();
+
+// 模拟后端的输出payload
+struct SyntheticResponse
+{
+    std::string moduleId;
+    double simulatedMs = 0;     // 本次模拟的耗时
+    int batchSize = 1;
+    std::vector<InferenceDetection> detections;
+};
+
+// 不依赖SDK和GPU的模拟后端：
+// 按配置的分布产生确定性的推理耗时，可以模拟CPU占用和内存占用，
+// 用来在Linux CI上复现、比较线程池、凑批、调度和统计的行为
+class SyntheticBackend : public IInferenceBackend
+{
+public:
+    explicit SyntheticBackend(const SyntheticBackendConfig &config = SyntheticBackendConfig());
+
+    const char *name() const override { return "synthetic"; }
+
+    void load(const std::string &modelDir) override;
+    std::vector<std::string> moduleIds() override;
+    std::unique_ptr<IInferenceSession> createSession(const std::string &moduleId,
+                                                     bool useGpu, int deviceId) override;
+    std::string describeOutput(const InferenceOutput &output) const override;
+    size_t outputBytes(const InferenceOutput &output) const override;
+    bool detections(const InferenceOutput &output, std::vector<InferenceDetection> &boxes) const override;
+
+    const SyntheticBackendConfig &config() const { return mConfig; }
+
+private:
+    SyntheticBackendConfig mConfig;
+    bool mLoaded = false;
+    int mSessionCount = 0;
+};
+
+#endif // SYNTHETICBACKEND_H
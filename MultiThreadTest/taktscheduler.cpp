@@ -0,0 +1,225 @@
+﻿#include "taktscheduler.h"
+
+#include <algorithm>
+
+#if defined(_WIN32)
+#define NOMINMAX
+#include <windows.h>
+#include <timeapi.h>
+#endif
+
+static double msBetween(TaktScheduler::Clock::time_point start, TaktScheduler::Clock::time_point end)
+{
+    return std::chrono::duration<double, std::milli>(end - start).count();
+}
+
+TaktScheduler::TaktScheduler(const TaktSchedulerConfig &config)
+    : mConfig(config)
+{
+    mConfig.spinMarginUs = std::max(0, mConfig.spinMarginUs);
+}
+
+TaktScheduler::~TaktScheduler()
+{
+    stop();
+}
+
+void TaktScheduler::start()
+{
+    std::lock_guard<std::mutex> locker(mMutex);
+    if (mStarted || mStopped)
+    {
+        return;
+    }
+
+    mStarted = true;
+    mEpoch = Clock::now();
+    for (int i = 0; i < (int)mStreams.size(); ++i)
+    {
+        armLocked(i);
+    }
+    mThread = std::thread(&TaktScheduler::schedulerLoop, this);
+}
+
+void TaktScheduler::stop()
+{
+    {
+        std::lock_guard<std::mutex> locker(mMutex);
+        mStopped = true;
+        mScheduleCond.notify_all();
+        for (auto &stream : mStreams)
+        {
+            stream->released.notify_all();
+        }
+    }
+
+    std::lock_guard<std::mutex> joinLocker(mJoinMutex);
+    if (mThread.joinable())
+    {
+        mThread.join();
+    }
+}
+
+int TaktScheduler::addStream(std::chrono::microseconds period, std::chrono::microseconds phase)
+{
+    std::lock_guard<std::mutex> locker(mMutex);
+    std::unique_ptr<Stream> stream(new Stream);
+    stream->period = std::max(period, std::chrono::microseconds(1));
+    stream->phase = std::max(phase, std::chrono::microseconds(0));
+    mStreams.push_back(std::move(stream));
+
+    int id = (int)mStreams.size() - 1;
+    if (mStarted)
+    {
+        armLocked(id);
+        mScheduleCond.notify_all();
+    }
+    return id;
+}
+
+bool TaktScheduler::waitNext(int stream, TaktTick *tick)
+{
+    std::unique_lock<std::mutex> locker(mMutex);
+    if (stream < 0 || stream >= (int)mStreams.size())
+    {
+        return false;
+    }
+
+    Stream &s = *mStreams[stream];
+    s.released.wait(locker, [&]() { return s.pending || mStopped; });
+    if (mStopped)
+    {
+        return false;
+    }
+
+    s.pending = false;
+    if (tick)
+    {
+        *tick = s.pendingTick;
+    }
+    return true;
+}
+
+int TaktScheduler::streamCount() const
+{
+    std::lock_guard<std::mutex> locker(mMutex);
+    return (int)mStreams.size();
+}
+
+TaktStreamStats TaktScheduler::stats(int stream) const
+{
+    std::lock_guard<std::mutex> locker(mMutex);
+    if (stream < 0 || stream >= (int)mStreams.size())
+    {
+        return TaktStreamStats();
+    }
+    return mStreams[stream]->stats;
+}
+
+TaktScheduler::Clock::time_point TaktScheduler::deadlineOf(const Stream &stream, long long cycle) const
+{
+    return mEpoch + stream.phase + stream.period * cycle;
+}
+
+void TaktScheduler::armLocked(int stream)
+{
+    // 从还没到的第一个节拍开始，保证各路都对齐在同一个时间原点上
+    Stream &s = *mStreams[stream];
+    auto elapsed = Clock::now() - mEpoch - s.phase;
+    if (elapsed > Clock::duration::zero())
+    {
+        long long passed = std::chrono::duration_cast<std::chrono::microseconds>(elapsed).count() / s.period.count();
+        s.nextCycle = std::max(s.nextCycle, passed + 1);
+    }
+    mDeadlines.push(Deadline{deadlineOf(s, s.nextCycle), stream});
+}
+
+void TaktScheduler::releaseLocked(int stream, Clock::time_point now)
+{
+    Stream &s = *mStreams[stream];
+
+    // 调度线程自己被耽误了（系统卡顿等），整拍跳过的节拍也算超拍
+    long long cycle = s.nextCycle;
+    while (deadlineOf(s, cycle + 1) <= now)
+    {
+        ++cycle;
+        ++s.stats.overrunCount;
+    }
+
+    // 上一拍还没被取走，说明这一路的工作超过了一个节拍
+    if (s.pending)
+    {
+        ++s.stats.overrunCount;
+    }
+
+    s.pendingTick.cycle = cycle;
+    s.pendingTick.deadline = deadlineOf(s, cycle);
+    s.pendingTick.latenessMs = msBetween(s.pendingTick.deadline, now);
+    s.pending = true;
+
+    ++s.stats.releasedCount;
+    s.latenessMsSum += s.pendingTick.latenessMs;
+    s.stats.avgLatenessMs = s.latenessMsSum / s.stats.releasedCount;
+    s.stats.maxLatenessMs = std::max(s.stats.maxLatenessMs, s.pendingTick.latenessMs);
+
+    s.nextCycle = cycle + 1;
+    mDeadlines.push(Deadline{deadlineOf(s, s.nextCycle), stream});
+    s.released.notify_one();
+}
+
+void TaktScheduler::schedulerLoop()
+{
+#if defined(_WIN32)
+    // 把系统定时器精度提到1ms，否则睡眠的粒度是15.6ms
+    timeBeginPeriod(1);
+#endif
+
+    const std::chrono::microseconds spinMargin(mConfig.spinMarginUs);
+
+    std::unique_lock<std::mutex> locker(mMutex);
+    while (!mStopped)
+    {
+        if (mDeadlines.empty())
+        {
+            mScheduleCond.wait(locker);
+            continue;
+        }
+
+        // 先睡到截止时间前一点，新加入的流可能带来更早的截止时间，所以醒来后重新看堆顶
+        Clock::time_point deadline = mDeadlines.top().time;
+        if (Clock::now() < deadline - spinMargin)
+        {
+            mScheduleCond.wait_until(locker, deadline - spinMargin);
+            continue;
+        }
+
+        // 最后一小段不持锁忙等
+        while (Clock::now() < deadline)
+        {
+            locker.unlock();
+            std::this_thread::yield();
+            locker.lock();
+            if (mStopped)
+            {
+                break;
+            }
+        }
+        if (mStopped)
+        {
+            break;
+        }
+
+        // 放行所有已经到期的流
+        Clock::time_point now = Clock::now();
+        while (!mDeadlines.empty() && mDeadlines.top().time <= now)
+        {
+            int stream = mDeadlines.top().stream;
+            mDeadlines.pop();
+            releaseLocked(stream, now);
+        }
+    }
+
+#if defined(_WIN32)
+    timeEndPeriod(1);
+#endif
+}
@@ -0,0 +1,108 @@
+﻿#ifndef TAKTSCHEDULER_H
+#define TAKTSCHEDULER_H
+
+#include <chrono>
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <queue>
+#include <thread>
+#include <vector>
+
+struct TaktSchedulerConfig
+{
+    // 操作系统的定时精度有限（Windows默认约15.6ms），
+    // 调度线程先睡到截止时间前spinMarginUs，剩下的时间让出CPU忙等，换取更准的放行时刻
+    int spinMarginUs = 500;
+};
+
+// 一次放行
+struct TaktTick
+{
+    long long cycle = 0;        // 第几个节拍（从调度器启动时算起）
+    std::chrono::steady_clock::time_point deadline;
+    double latenessMs = 0;      // 实际放行时刻比截止时间晚了多少
+};
+
+// 每一路的节拍统计；超拍和推理耗时分开统计
+struct TaktStreamStats
+{
+    long long releasedCount = 0;    // 已放行的节拍数
+    long long overrunCount = 0;     // 错过的节拍数：上一拍的工作还没做完，这一拍就到了
+    double avgLatenessMs = 0;       // 放行时刻相对截止时间的平均延迟
+    double maxLatenessMs = 0;
+};
+
+// 节拍调度器：
+// 一个调度线程按绝对截止时间 epoch + phase + k * period 放行各路的任务，
+// 截止时间只由k算出，不会因为某一拍晚了而累积漂移；
+// 各路线程在waitNext()中睡眠等待，不再每毫秒醒来检查一次
+class TaktScheduler
+{
+public:
+    using Clock = std::chrono::steady_clock;
+
+    explicit TaktScheduler(const TaktSchedulerConfig &config = TaktSchedulerConfig());
+    ~TaktScheduler();
+
+    TaktScheduler(const TaktScheduler &) = delete;
+    TaktScheduler &operator=(const TaktScheduler &) = delete;
+
+    // 启动调度线程，确定所有节拍的时间原点
+    void start();
+
+    // 停止调度，正在等待的waitNext()会立即返回false；可以从多个线程同时调用
+    void stop();
+
+    // 添加一路，返回流编号；phase是这一路相对时间原点的偏移，用来把各路的送图时刻错开
+    // 启动之后添加的流也对齐到同一套节拍上，从下一个还没到的节拍开始放行
+    int addStream(std::chrono::microseconds period,
+                  std::chrono::microseconds phase = std::chrono::microseconds(0));
+
+    // 等待该路的下一次放行；已停止时返回false
+    // 如果调用时已经错过了若干拍，只放行最近的一拍，错过的计入overrunCount
+    bool waitNext(int stream, TaktTick *tick = nullptr);
+
+    int streamCount() const;
+    TaktStreamStats stats(int stream) const;
+
+private:
+    struct Stream
+    {
+        std::chrono::microseconds period;
+        std::chrono::microseconds phase;
+        long long nextCycle = 0;            // 下一个要放行的节拍
+        bool pending = false;               // 已放行但还没被waitNext()取走
+        TaktTick pendingTick;
+        std::condition_variable released;
+        TaktStreamStats stats;
+        double latenessMsSum = 0;
+    };
+
+    // 堆中的一项：某一路的下一个截止时间
+    struct Deadline
+    {
+        Clock::time_point time;
+        int stream;
+        bool operator>(const Deadline &other) const { return time > other.time; }
+    };
+
+    Clock::time_point deadlineOf(const Stream &stream, long long cycle) const;
+    void armLocked(int stream);
+    void releaseLocked(int stream, Clock::time_point now);
+    void schedulerLoop();
+
+    TaktSchedulerConfig mConfig;
+
+    mutable std::mutex mMutex;
+    std::condition_variable mScheduleCond;
+    std::vector<std::unique_ptr<Stream>> mStreams;
+    std::priority_queue<Deadline, std::vector<Deadline>, std::greater<Deadline>> mDeadlines;
+    Clock::time_point mEpoch;
+    bool mStarted = false;
+    bool mStopped = false;
+    std::mutex mJoinMutex;          // 取消回调和停止流程可能同时调用stop()
+    std::thread mThread;
+};
+
+#endif // TAKTSCHEDULER_H
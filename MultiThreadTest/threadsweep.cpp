@@ -0,0 +1,117 @@
+﻿#include "threadsweep.h"
+
+#include <algorithm>
+
+ThreadSweepResult runThreadSweep(const ThreadSweepConfig &config,
+                                 const EngineFactory &engineFactory,
+                                 const BenchmarkFrameSource &frames,
+                                 const ThreadSweepProgress &progress,
+                                 const CancellationToken &cancel)
+{
+    ThreadSweepResult sweep;
+    sweep.budgetMs = config.latencyBudgetMs > 0 ? config.latencyBudgetMs : config.run.taktMs;
+
+    int minThreads = std::max(1, config.minThreads);
+    int maxThreads = std::max(minThreads, config.maxThreads);
+
+    std::shared_ptr<InferenceEngine> sharedEngine;
+    if (!config.scalePipelines)
+    {
+        sharedEngine = engineFactory(config.fixedPipelines > 0 ? config.fixedPipelines : maxThreads);
+    }
+
+    double bestThroughput = 0;
+    int flatSteps = 0;
+    for (int threads = minThreads; threads <= maxThreads; ++threads)
+    {
+        if (cancel.isCancelled())
+        {
+            sweep.stopReason = "cancelled";
+            break;
+        }
+
+        // 换pipelines数时先释放上一步的引擎，避免两份模型同时占用显存
+        std::shared_ptr<InferenceEngine> engine = sharedEngine;
+        if (config.scalePipelines)
+        {
+            engine.reset();
+            engine = engineFactory(threads);
+        }
+
+        ThreadSweepStep step;
+        step.threads = threads;
+        BenchmarkRunConfig runConfig = config.run;
+        runConfig.threadCount = threads;
+        step.result = runBenchmark(runConfig, engine, frames, cancel);
+        step.pipelines = engine->pipelineCount();
+
+        // 中途取消的这一步只测了一部分，不参与推荐
+        if (step.result.cancelled)
+        {
+            sweep.stopReason = "cancelled";
+            break;
+        }
+
+        if (!step.result.ok)
+        {
+            sweep.stopReason = "error: " + step.result.error;
+            sweep.steps.push_back(std::move(step));
+            if (progress)
+            {
+                progress(sweep.steps.back());
+            }
+            break;
+        }
+
+        double p99 = step.result.total.endToEnd.percentileMs(99);
+        double throughput = step.result.throughput();
+        step.withinBudget = p99 <= sweep.budgetMs && step.result.total.failed == 0 && step.result.total.dropped == 0;
+        sweep.steps.push_back(std::move(step));
+        if (progress)
+        {
+            progress(sweep.steps.back());
+        }
+
+        if (!sweep.steps.back().withinBudget)
+        {
+            sweep.stopReason = "latency budget exceeded";
+            break;
+        }
+
+        // 吞吐量饱和判断
+        if (throughput > bestThroughput * (1 + config.plateauGain))
+        {
+            flatSteps = 0;
+        }
+        else if (++flatSteps >= config.plateauSteps)
+        {
+            sweep.stopReason = "throughput plateau";
+            bestThroughput = std::max(bestThroughput, throughput);
+            break;
+        }
+        bestThroughput = std::max(bestThroughput, throughput);
+    }
+    if (sweep.stopReason.empty())
+    {
+        sweep.stopReason = "max threads reached";
+    }
+
+    // 预算之内吞吐量最大的那一步，再往前找吞吐量差不多、线程更少的
+    double bestWithinBudget = 0;
+    for (const auto &step : sweep.steps)
+    {
+        if (step.withinBudget)
+        {
+            bestWithinBudget = std::max(bestWithinBudget, step.result.throughput());
+        }
+    }
+    for (const auto &step : sweep.steps)
+    {
+        if (step.withinBudget && step.result.throughput() >= bestWithinBudget * (1 - config.plateauGain))
+        {
+            sweep.recommendedThreads = step.threads;
+            break;
+        }
+    }
+    return sweep;
+}
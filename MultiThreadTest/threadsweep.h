@@ -0,0 +1,61 @@
+﻿#ifndef THREADSWEEP_H
+#define THREADSWEEP_H
+
+#include <atomic>
+#include <functional>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "benchmarkrun.h"
+
+struct ThreadSweepConfig
+{
+    BenchmarkRunConfig run;         // 每一步的测量参数，threadCount由扫描决定
+    int minThreads = 1;
+    int maxThreads = 16;
+
+    // true：每一步重新创建引擎，pipelines数等于线程数（每张卡上的pipelines数一起扫描）
+    // false：所有步共用一个引擎，pipelines数固定为fixedPipelines（0表示取maxThreads）
+    bool scalePipelines = false;
+    int fixedPipelines = 0;
+
+    // 吞吐量连续plateauSteps步增长都不到plateauGain（比例）时认为已经饱和，停止扫描
+    double plateauGain = 0.05;
+    int plateauSteps = 2;
+
+    // 端到端p99超过节拍预算时停止；0表示取run.taktMs
+    double latencyBudgetMs = 0;
+};
+
+struct ThreadSweepStep
+{
+    int threads = 0;
+    int pipelines = 0;
+    BenchmarkRunResult result;
+    bool withinBudget = false;      // 端到端p99在预算之内，并且没有失败和丢帧
+};
+
+struct ThreadSweepResult
+{
+    std::vector<ThreadSweepStep> steps;
+    std::string stopReason;         // 扫描结束的原因
+    int recommendedThreads = 0;     // 0表示没有满足预算的线程数
+    double budgetMs = 0;
+};
+
+// 按需创建引擎，参数为pipelines数
+using EngineFactory = std::function<std::shared_ptr<InferenceEngine>(int pipelineCount)>;
+
+// 每完成一步调用一次，在扫描线程中调用
+using ThreadSweepProgress = std::function<void(const ThreadSweepStep &step)>;
+
+// 从minThreads开始逐个增加线程数测量，直到吞吐量饱和、延迟超出预算或者到达maxThreads
+// 推荐值：在延迟预算之内、吞吐量达到最大值(1 - plateauGain)的最少线程数
+ThreadSweepResult runThreadSweep(const ThreadSweepConfig &config,
+                                 const EngineFactory &engineFactory,
+                                 const BenchmarkFrameSource &frames,
+                                 const ThreadSweepProgress &progress = ThreadSweepProgress(),
+                                 const CancellationToken &cancel = CancellationToken());
+
+#endif // THREADSWEEP_H
@@ -0,0 +1,297 @@
+﻿#include "tiledinference.h"
+#include "tracing.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <cstdlib>
+#include <sstream>
+
+using Clock = std::chrono::steady_clock;
+
+namespace {
+
+bool parseDouble(const std::string &text, double &value)
+{
+    char *end = nullptr;
+    value = std::strtod(text.c_str(), &end);
+    return !text.empty() && end && *end == '\0';
+}
+
+// 一条边上各块的起点
+std::vector<int> tileOffsets(int length, int tile, int overlap)
+{
+    if (length <= tile)
+    {
+        return {0};
+    }
+    int stride = std::max(1, tile - overlap);
+    int count = (length - overlap + stride - 1) / stride;
+    count = std::max(2, count);
+    std::vector<int> offsets;
+    for (int i = 0; i < count; ++i)
+    {
+        offsets.push_back((int)std::lround((double)i * (length - tile) / (count - 1)));
+    }
+    return offsets;
+}
+
+float area(const cv::Rect2f &box)
+{
+    return std::max(0.f, box.width) * std::max(0.f, box.height);
+}
+
+// 所有块共享的汇总状态，最后一块完成时拼接
+struct TileGather
+{
+    TiledInferenceResult result;
+    std::vector<InferenceResult> tileResults;
+    std::vector<std::vector<InferenceDetection>> tileBoxes;
+    std::vector<unsigned char> tileHasBoxes;        // 每块各写各的，不用加锁
+    std::atomic<int> remaining{0};
+    Clock::time_point submitTime;
+    TiledInferenceCallback callback;
+    std::shared_ptr<IInferenceBackend> backend;
+    TileConfig config;
+};
+
+void finishTiles(TileGather &gather)
+{
+    TraceSpan span("merge tiles", "tile", gather.result.traceId, TraceFlow::In);
+    auto mergeStart = Clock::now();
+    TiledInferenceResult &result = gather.result;
+
+    double firstQueueMs = -1;
+    for (size_t i = 0; i < gather.tileResults.size(); ++i)
+    {
+        InferenceResult &tile = gather.tileResults[i];
+        // 失败优先于丢弃、拒绝、取消
+        if (tile.status != InferenceStatus::Ok
+            && (result.status == InferenceStatus::Ok || tile.status == InferenceStatus::Failed))
+        {
+            if (result.status != InferenceStatus::Failed)
+            {
+                result.status = tile.status;
+                result.error = tile.error;
+            }
+        }
+        if (tile.status == InferenceStatus::Ok)
+        {
+            result.hasDetections = result.hasDetections && gather.tileHasBoxes[i];
+            firstQueueMs = firstQueueMs < 0 ? tile.queueMs : std::min(firstQueueMs, tile.queueMs);
+            result.tileInferMsSum += tile.inferMs;
+        }
+        result.tileOutputs.push_back(std::move(tile.output));
+    }
+
+    if (result.status == InferenceStatus::Ok && result.hasDetections)
+    {
+        std::vector<InferenceDetection> boxes;
+        for (auto &tileBoxes : gather.tileBoxes)
+        {
+            boxes.insert(boxes.end(), tileBoxes.begin(), tileBoxes.end());
+        }
+        result.detections = mergeDetections(std::move(boxes), gather.config.nmsIou, gather.config.mergeCover);
+    }
+
+    auto end = Clock::now();
+    result.mergeMs = std::chrono::duration<double, std::milli>(end - mergeStart).count();
+    result.queueMs = std::max(0.0, firstQueueMs);
+    result.inferMs = std::max(0.0, std::chrono::duration<double, std::milli>(end - gather.submitTime).count() - result.queueMs);
+    span.finish();
+    gather.callback(result);
+}
+
+} // namespace
+
+const char *tileSpecHelp()
+{
+    return "w=<块宽>, h=<块高>, overlap=<重叠像素>, iou=<NMS的IoU阈值>, cover=<残框合并比例>, score=<最低分数>";
+}
+
+bool parseTileSpec(const std::string &spec, TileConfig &config, std::string *errorMessage)
+{
+    auto fail = [&](const std::string &message) {
+        if (errorMessage)
+        {
+            *errorMessage = message;
+        }
+        return false;
+    };
+
+    std::stringstream stream(spec);
+    std::string item;
+    while (std::getline(stream, item, ','))
+    {
+        if (item.empty())
+        {
+            continue;
+        }
+        size_t eq = item.find('=');
+        if (eq == std::string::npos)
+        {
+            return fail("缺少'=': " + item);
+        }
+        std::string key = item.substr(0, eq);
+        double value = 0;
+        if (!parseDouble(item.substr(eq + 1), value))
+        {
+            return fail("无效的数值: " + item);
+        }
+        if (key == "w") config.tileWidth = (int)value;
+        else if (key == "h") config.tileHeight = (int)value;
+        else if (key == "overlap") config.overlap = (int)value;
+        else if (key == "iou") config.nmsIou = (float)value;
+        else if (key == "cover") config.mergeCover = (float)value;
+        else if (key == "score") config.minScore = (float)value;
+        else return fail("未知的参数: " + key);
+    }
+
+    if (config.tileWidth <= 0 || config.tileHeight <= 0)
+    {
+        return fail("块的尺寸必须大于0");
+    }
+    if (config.overlap < 0 || config.overlap >= std::min(config.tileWidth, config.tileHeight))
+    {
+        return fail("重叠必须小于块的尺寸");
+    }
+    return true;
+}
+
+std::vector<cv::Rect> planTiles(cv::Size imageSize, const TileConfig &config)
+{
+    std::vector<cv::Rect> tiles;
+    if (imageSize.width <= 0 || imageSize.height <= 0)
+    {
+        return tiles;
+    }
+    int tileWidth = std::min(std::max(1, config.tileWidth), imageSize.width);
+    int tileHeight = std::min(std::max(1, config.tileHeight), imageSize.height);
+    for (int y : tileOffsets(imageSize.height, tileHeight, config.overlap))
+    {
+        for (int x : tileOffsets(imageSize.width, tileWidth, config.overlap))
+        {
+            tiles.emplace_back(x, y, tileWidth, tileHeight);
+        }
+    }
+    return tiles;
+}
+
+std::vector<InferenceDetection> mergeDetections(std::vector<InferenceDetection> boxes, float nmsIou, float mergeCover)
+{
+    std::sort(boxes.begin(), boxes.end(), [](const InferenceDetection &a, const InferenceDetection &b) {
+        return a.score > b.score;
+    });
+
+    std::vector<InferenceDetection> kept;
+    for (const InferenceDetection &box : boxes)
+    {
+        float boxArea = area(box.box);
+        bool suppressed = false;
+        for (InferenceDetection &keep : kept)
+        {
+            if (keep.label != box.label)
+            {
+                continue;
+            }
+            float overlap = area(keep.box & box.box);
+            if (overlap <= 0)
+            {
+                continue;
+            }
+            float iou = overlap / (area(keep.box) + boxArea - overlap);
+            if (iou > nmsIou)
+            {
+                suppressed = true;
+                break;
+            }
+            // 被块边界切开的残框：大部分落在已保留的框里，并进去
+            if (mergeCover > 0 && overlap >= mergeCover * std::min(boxArea, area(keep.box)))
+            {
+                keep.box = keep.box | box.box;
+                suppressed = true;
+                break;
+            }
+        }
+        if (!suppressed)
+        {
+            kept.push_back(box);
+        }
+    }
+    return kept;
+}
+
+TiledInference::TiledInference(InferencePool &pool, const TileConfig &config)
+    : mPool(pool)
+    , mConfig(config)
+    , mBackend(pool.engine()->backend())
+{
+}
+
+void TiledInference::submit(const cv::Mat &image, TiledInferenceCallback callback)
+{
+    std::shared_ptr<TileGather> gather = std::make_shared<TileGather>();
+    gather->submitTime = Clock::now();
+    gather->callback = std::move(callback);
+    gather->backend = mBackend;
+    gather->config = mConfig;
+    gather->result.tiles = planTiles(image.size(), mConfig);
+    gather->result.hasDetections = true;
+    gather->result.traceId = TraceRecorder::isEnabled() ? TraceRecorder::instance().nextFrameId() : -1;
+
+    const size_t count = gather->result.tiles.size();
+    if (count == 0)
+    {
+        gather->result.status = InferenceStatus::Failed;
+        gather->result.error = "empty image";
+        gather->callback(gather->result);
+        return;
+    }
+    gather->tileResults.resize(count);
+    gather->tileBoxes.resize(count);
+    gather->tileHasBoxes.resize(count, 0);
+    gather->remaining = (int)count;
+
+    TraceSpan span("split tiles", "tile", gather->result.traceId, TraceFlow::Out);
+    for (size_t i = 0; i < count; ++i)
+    {
+        cv::Rect tile = gather->result.tiles[i];
+        // 每块只是原图上的一个ROI头，和原图共用数据
+        mPool.submit(image(tile), [gather, i, tile](InferenceResult &r) {
+            TileGather &state = *gather;
+            if (r.status == InferenceStatus::Ok)
+            {
+                // 在各自的工作线程中把检测框换算到整图坐标，最后只剩合并
+                std::vector<InferenceDetection> &boxes = state.tileBoxes[i];
+                state.tileHasBoxes[i] = state.backend->detections(r.output, boxes);
+                if (state.tileHasBoxes[i])
+                {
+                    float minScore = state.config.minScore;
+                    boxes.erase(std::remove_if(boxes.begin(), boxes.end(), [minScore](const InferenceDetection &box) {
+                                    return box.score < minScore;
+                                }), boxes.end());
+                    for (InferenceDetection &box : boxes)
+                    {
+                        box.box.x += tile.x;
+                        box.box.y += tile.y;
+                    }
+                }
+            }
+            state.tileResults[i] = std::move(r);
+            if (state.remaining.fetch_sub(1, std::memory_order_acq_rel) == 1)
+            {
+                finishTiles(state);
+            }
+        });
+    }
+}
+
+std::future<TiledInferenceResult> TiledInference::submit(const cv::Mat &image)
+{
+    std::shared_ptr<std::promise<TiledInferenceResult>> promise = std::make_shared<std::promise<TiledInferenceResult>>();
+    std::future<TiledInferenceResult> future = promise->get_future();
+    submit(image, [promise](TiledInferenceResult &result) {
+        promise->set_value(std::move(result));
+    });
+    return future;
+}
@@ -0,0 +1,78 @@
+﻿#ifndef TILEDINFERENCE_H
+#define TILEDINFERENCE_H
+
+#include <functional>
+#include <future>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include <opencv2/opencv.hpp>
+
+#include "inferencepool.h"
+
+// 切图推理：检测的图比模型输入大得多时，把整图切成互相重叠的块，
+// 各块作为独立的任务同时交给线程池，由多个pipelines并行推理，再把检测框拼回整图
+// 每一块都是原图上的ROI（只是一个Mat头），不拷贝像素
+struct TileConfig
+{
+    int tileWidth = 1024;
+    int tileHeight = 1024;
+    int overlap = 128;              // 相邻两块重叠的像素，要不小于最大目标的尺寸，跨块的目标才至少在一块中完整
+    float nmsIou = 0.5f;            // 同一类别IoU超过它的框只留分数最高的
+    float mergeCover = 0.8f;        // 小框有这么大比例落在留下的框里时也去掉（被块边界切开的残框），并把留下的框扩到两者的并集
+    float minScore = 0;             // 分数低于它的框丢弃
+};
+
+// 把"w=1024,h=1024,overlap=128,iou=0.5"这样的描述解析到config中，没有出现的键保持原值
+bool parseTileSpec(const std::string &spec, TileConfig &config, std::string *errorMessage = nullptr);
+const char *tileSpecHelp();
+
+// 切块的位置：块数按重叠后的步长向上取整，余下的长度均匀分到各块之间的重叠上，最后一块对齐到图像边缘
+// 图像不比一块大时只有一块（就是整张图）
+std::vector<cv::Rect> planTiles(cv::Size imageSize, const TileConfig &config);
+
+// 按分数从高到低保留检测框，去掉同一类别中和已保留框重叠的
+// mergeCover大于0时，大部分落在已保留框里的小框也去掉，已保留的框扩到并集
+std::vector<InferenceDetection> mergeDetections(std::vector<InferenceDetection> boxes, float nmsIou, float mergeCover);
+
+// 一张图的切图推理结果
+struct TiledInferenceResult
+{
+    InferenceStatus status = InferenceStatus::Ok;   // 任一块失败则为失败（或者被丢弃、拒绝、取消）
+    std::string error;
+
+    std::vector<cv::Rect> tiles;
+    std::vector<InferenceDetection> detections;     // 整图坐标，已经合并过重叠区域
+    bool hasDetections = false;                     // 后端输出中有检测框；没有时只能用tileOutputs
+    std::vector<InferenceOutput> tileOutputs;       // 每块的原始输出，和tiles一一对应
+
+    double queueMs = 0;             // 最先开始推理的那一块等待的时间
+    double inferMs = 0;             // 从最先开始推理到最后一块推理完、拼接完；queueMs + inferMs即整张图的耗时
+    double tileInferMsSum = 0;      // 各块推理耗时的总和，除以inferMs大致是并行度
+    double mergeMs = 0;             // 拼接和合并检测框的耗时
+    long long traceId = -1;
+};
+
+using TiledInferenceCallback = std::function<void(TiledInferenceResult &result)>;
+
+class TiledInference
+{
+public:
+    TiledInference(InferencePool &pool, const TileConfig &config);
+
+    // 切块并把所有块提交给线程池，最后一块完成的工作线程负责拼接并调用回调
+    // 线程池队列满时按线程池的策略阻塞或拒绝；有块被拒绝时整张图的结果为Rejected
+    void submit(const cv::Mat &image, TiledInferenceCallback callback);
+
+    std::future<TiledInferenceResult> submit(const cv::Mat &image);
+
+    const TileConfig &config() const { return mConfig; }
+
+private:
+    InferencePool &mPool;
+    TileConfig mConfig;
+    std::shared_ptr<IInferenceBackend> mBackend;
+};
+
+#endif // TILEDINFERENCE_H
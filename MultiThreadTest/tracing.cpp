@@ -0,0 +1,309 @@
+﻿#include "tracing.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <fstream>
+
+std::atomic<bool> TraceRecorder::sEnabled(false);
+
+// 每个线程自己的缓冲区；count由本线程用release发布，导出时只读count以内的部分
+struct TraceRecorder::ThreadBuffer
+{
+    explicit ThreadBuffer(int capacity) : events((size_t)capacity) {}
+
+    std::vector<TraceEvent> events;
+    std::atomic<long long> count{0};
+    std::atomic<long long> dropped{0};
+    std::atomic<unsigned> generation{0};
+    std::atomic<bool> exited{false};
+    int tid = 0;
+    std::string threadName;         // 受mMutex保护
+};
+
+// 线程退出时标记缓冲区，下次clear()时释放；退出之前记下的span仍然可以导出
+struct TraceRecorder::ThreadSlot
+{
+    std::shared_ptr<ThreadBuffer> buffer;
+    std::string name;
+
+    ~ThreadSlot()
+    {
+        if (buffer)
+        {
+            buffer->exited = true;
+        }
+    }
+};
+
+namespace {
+
+void writeJsonString(std::ostream &out, const std::string &text)
+{
+    out << '"';
+    for (char c : text)
+    {
+        switch (c)
+        {
+        case '"': out << "\\\""; break;
+        case '\\': out << "\\\\"; break;
+        case '\n': out << "\\n"; break;
+        case '\r': out << "\\r"; break;
+        case '\t': out << "\\t"; break;
+        default:
+            if ((unsigned char)c < 0x20)
+            {
+                char escaped[8];
+                std::snprintf(escaped, sizeof(escaped), "\\u%04x", (unsigned char)c);
+                out << escaped;
+            }
+            else
+            {
+                out << c;
+            }
+        }
+    }
+    out << '"';
+}
+
+} // namespace
+
+TraceRecorder::ThreadSlot &TraceRecorder::localSlot()
+{
+    thread_local ThreadSlot slot;
+    return slot;
+}
+
+TraceRecorder &TraceRecorder::instance()
+{
+    static TraceRecorder recorder;
+    return recorder;
+}
+
+TraceRecorder::TraceRecorder()
+    : mEpoch(Clock::now()), mGeneration(0), mNextFrameId(1), mBufferCapacity(1 << 15)
+{
+}
+
+void TraceRecorder::setEnabled(bool enabled)
+{
+    sEnabled.store(enabled, std::memory_order_relaxed);
+}
+
+void TraceRecorder::setBufferCapacity(int events)
+{
+    mBufferCapacity = std::max(events, 1);
+}
+
+void TraceRecorder::setThreadName(const std::string &name)
+{
+    ThreadSlot &slot = localSlot();
+    slot.name = name;
+    if (slot.buffer)
+    {
+        std::lock_guard<std::mutex> locker(instance().mMutex);
+        slot.buffer->threadName = name;
+    }
+}
+
+TraceRecorder::ThreadBuffer *TraceRecorder::localBuffer()
+{
+    ThreadSlot &slot = localSlot();
+    if (!slot.buffer)
+    {
+        // 第一次记录时才分配，从来不记录的线程不占内存
+        auto buffer = std::make_shared<ThreadBuffer>(mBufferCapacity.load());
+        buffer->generation = mGeneration.load(std::memory_order_acquire);
+
+        std::lock_guard<std::mutex> locker(mMutex);
+        buffer->tid = mNextTid++;
+        buffer->threadName = slot.name;
+        mBuffers.push_back(buffer);
+        slot.buffer = std::move(buffer);
+    }
+    return slot.buffer.get();
+}
+
+void TraceRecorder::record(const char *name, const char *category, Clock::time_point begin, Clock::time_point end,
+                           long long frameId, TraceFlow flow)
+{
+    append(name, category, begin, end, frameId, flow, false);
+}
+
+void TraceRecorder::recordAsync(const char *name, const char *category, Clock::time_point begin,
+                                Clock::time_point end, long long frameId)
+{
+    if (frameId >= 0)
+    {
+        append(name, category, begin, end, frameId, TraceFlow::None, true);
+    }
+}
+
+void TraceRecorder::append(const char *name, const char *category, Clock::time_point begin, Clock::time_point end,
+                           long long frameId, TraceFlow flow, bool async)
+{
+    ThreadBuffer *buffer = localBuffer();
+
+    // clear()之后由本线程自己清空，导出的线程看到新的generation之前不会读这个缓冲区
+    unsigned generation = mGeneration.load(std::memory_order_acquire);
+    if (buffer->generation.load(std::memory_order_relaxed) != generation)
+    {
+        buffer->count.store(0, std::memory_order_relaxed);
+        buffer->dropped.store(0, std::memory_order_relaxed);
+        buffer->generation.store(generation, std::memory_order_release);
+    }
+
+    long long count = buffer->count.load(std::memory_order_relaxed);
+    if (count >= (long long)buffer->events.size())
+    {
+        buffer->dropped.store(buffer->dropped.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+        return;
+    }
+
+    TraceEvent &event = buffer->events[(size_t)count];
+    event.name = name;
+    event.category = category;
+    event.beginNs = std::chrono::duration_cast<std::chrono::nanoseconds>(begin - mEpoch).count();
+    event.durationNs = std::chrono::duration_cast<std::chrono::nanoseconds>(end - begin).count();
+    event.frameId = frameId;
+    event.flow = flow;
+    event.async = async;
+    buffer->count.store(count + 1, std::memory_order_release);
+}
+
+std::vector<TraceEvent> TraceRecorder::collect(const ThreadBuffer &buffer) const
+{
+    if (buffer.generation.load(std::memory_order_acquire) != mGeneration.load(std::memory_order_relaxed))
+    {
+        return {};
+    }
+    long long count = buffer.count.load(std::memory_order_acquire);
+    return std::vector<TraceEvent>(buffer.events.begin(), buffer.events.begin() + (size_t)count);
+}
+
+void TraceRecorder::clear()
+{
+    std::lock_guard<std::mutex> locker(mMutex);
+    mGeneration.fetch_add(1, std::memory_order_release);
+
+    std::vector<std::shared_ptr<ThreadBuffer>> alive;
+    for (auto &buffer : mBuffers)
+    {
+        if (!buffer->exited)
+        {
+            alive.push_back(std::move(buffer));
+        }
+    }
+    mBuffers.swap(alive);
+}
+
+TraceStats TraceRecorder::stats() const
+{
+    TraceStats stats;
+    std::lock_guard<std::mutex> locker(mMutex);
+    unsigned generation = mGeneration.load(std::memory_order_relaxed);
+    for (const auto &buffer : mBuffers)
+    {
+        if (buffer->generation.load(std::memory_order_acquire) != generation)
+        {
+            continue;
+        }
+        stats.events += buffer->count.load(std::memory_order_acquire);
+        stats.dropped += buffer->dropped.load(std::memory_order_relaxed);
+        stats.threads++;
+    }
+    return stats;
+}
+
+void TraceRecorder::writeChromeTrace(std::ostream &out) const
+{
+    std::lock_guard<std::mutex> locker(mMutex);
+
+    out << "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[";
+    bool first = true;
+    auto separator = [&]() {
+        out << (first ? "\n" : ",\n");
+        first = false;
+    };
+
+    for (const auto &buffer : mBuffers)
+    {
+        std::vector<TraceEvent> events = collect(*buffer);
+        if (events.empty())
+        {
+            continue;
+        }
+
+        std::string tid = std::to_string(buffer->tid);
+        separator();
+        out << "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":" << tid << ",\"args\":{\"name\":";
+        writeJsonString(out, buffer->threadName.empty() ? "thread " + tid : buffer->threadName);
+        out << "}}";
+
+        // 每个事件先格式化到栈上的缓冲区，再整段写出
+        char line[512];
+        for (const TraceEvent &event : events)
+        {
+            int length = 0;
+            if (event.async)
+            {
+                separator();
+                length = std::snprintf(line, sizeof(line),
+                                       "{\"name\":\"%s\",\"cat\":\"%s\",\"ph\":\"b\",\"id\":%lld,\"pid\":1,\"tid\":%d,"
+                                       "\"ts\":%.3f},\n"
+                                       "{\"name\":\"%s\",\"cat\":\"%s\",\"ph\":\"e\",\"id\":%lld,\"pid\":1,\"tid\":%d,"
+                                       "\"ts\":%.3f}",
+                                       event.name, event.category, event.frameId, buffer->tid, event.beginNs / 1000.0,
+                                       event.name, event.category, event.frameId, buffer->tid,
+                                       (event.beginNs + event.durationNs) / 1000.0);
+                out.write(line, std::min(length, (int)sizeof(line) - 1));
+                continue;
+            }
+
+            separator();
+            length = std::snprintf(line, sizeof(line),
+                                       "{\"name\":\"%s\",\"cat\":\"%s\",\"ph\":\"X\",\"pid\":1,\"tid\":%d,"
+                                       "\"ts\":%.3f,\"dur\":%.3f",
+                                       event.name, event.category, buffer->tid,
+                                       event.beginNs / 1000.0, event.durationNs / 1000.0);
+            out.write(line, std::min(length, (int)sizeof(line) - 1));
+            if (event.frameId >= 0)
+            {
+                length = std::snprintf(line, sizeof(line), ",\"args\":{\"frame\":%lld}", event.frameId);
+                out.write(line, length);
+            }
+            out << '}';
+
+            // 流事件绑定到同一时刻所在的span上
+            if (event.flow != TraceFlow::None && event.frameId >= 0)
+            {
+                separator();
+                length = std::snprintf(line, sizeof(line),
+                                       "{\"name\":\"frame\",\"cat\":\"flow\",\"ph\":\"%s\",\"id\":%lld,"
+                                       "\"pid\":1,\"tid\":%d,\"ts\":%.3f%s}",
+                                       event.flow == TraceFlow::Out ? "s" : "f", event.frameId, buffer->tid,
+                                       event.beginNs / 1000.0, event.flow == TraceFlow::In ? ",\"bp\":\"e\"" : "");
+                out.write(line, length);
+            }
+        }
+    }
+    out << "\n]}\n";
+}
+
+bool TraceRecorder::exportChromeTrace(const std::string &path, std::string *error) const
+{
+    std::ofstream file(path, std::ios::binary | std::ios::trunc);
+    if (file)
+    {
+        writeChromeTrace(file);
+        file.close();
+    }
+    if (!file)
+    {
+        if (error)
+        {
+            *error = "无法写入文件: " + path;
+        }
+        return false;
+    }
+    return true;
+}
@@ -0,0 +1,151 @@
+﻿#ifndef TRACING_H
+#define TRACING_H
+
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <mutex>
+#include <ostream>
+#include <string>
+#include <vector>
+
+// 跨线程关联：同一张图在送图线程上的span用Out，在工作线程上的span用In，
+// Perfetto中会画一条箭头把两段连起来
+enum class TraceFlow : unsigned char
+{
+    None,
+    Out,
+    In,
+};
+
+// 一段已经结束的span；名字和分类必须是字符串常量，记录时只保存指针
+struct TraceEvent
+{
+    const char *name = nullptr;
+    const char *category = nullptr;
+    long long beginNs = 0;          // 相对记录器的时间原点
+    long long durationNs = 0;
+    long long frameId = -1;         // 同一张图的各阶段用同一个编号，-1表示没有
+    TraceFlow flow = TraceFlow::None;
+    bool async = false;             // 异步span画在单独的轨道上，可以和线程上的span重叠
+};
+
+struct TraceStats
+{
+    long long events = 0;           // 缓冲区中的span数
+    long long dropped = 0;          // 缓冲区满了没记下来的span数
+    int threads = 0;
+};
+
+// 各阶段耗时的跟踪记录，导出为Chrome trace JSON，用Perfetto（ui.perfetto.dev）或chrome://tracing打开
+// 每个线程第一次记录时分配一个自己的缓冲区，记录时只有本线程写，不加锁也没有原子读改写
+// 缓冲区满了之后新的span丢弃并计数，clear()之后重新开始
+// 关闭时TraceSpan只读一次原子标志，几乎没有开销
+class TraceRecorder
+{
+public:
+    using Clock = std::chrono::steady_clock;
+
+    static TraceRecorder &instance();
+
+    static bool isEnabled() { return sEnabled.load(std::memory_order_relaxed); }
+    void setEnabled(bool enabled);
+
+    // 每个线程最多缓存的span数，只影响之后新建的缓冲区
+    void setBufferCapacity(int events);
+
+    // 给当前线程起个名字，显示在Perfetto的线程轨道上；关闭时也可以调用
+    static void setThreadName(const std::string &name);
+
+    // 同一张图的关联编号，从1开始递增
+    long long nextFrameId() { return mNextFrameId.fetch_add(1, std::memory_order_relaxed); }
+
+    // 在当前线程的缓冲区中记录一段span，开始时间可以在别的线程上取（例如入队时间）
+    void record(const char *name, const char *category, Clock::time_point begin, Clock::time_point end,
+                long long frameId = -1, TraceFlow flow = TraceFlow::None);
+
+    // 异步span，用于和本线程其他span时间重叠的阶段（例如排队：任务在队列中等待时工作线程正在做上一批）
+    // frameId必须有效，Perfetto按名字和编号把开始和结束配成一对
+    void recordAsync(const char *name, const char *category, Clock::time_point begin, Clock::time_point end,
+                     long long frameId);
+
+    // 丢弃所有已经记录的span，已经退出的线程的缓冲区一并释放
+    void clear();
+
+    TraceStats stats() const;
+
+    // Chrome trace的JSON格式，时间单位为微秒
+    void writeChromeTrace(std::ostream &out) const;
+    bool exportChromeTrace(const std::string &path, std::string *error = nullptr) const;
+
+private:
+    struct ThreadBuffer;
+    struct ThreadSlot;
+
+    TraceRecorder();
+
+    static ThreadSlot &localSlot();
+    ThreadBuffer *localBuffer();
+    void append(const char *name, const char *category, Clock::time_point begin, Clock::time_point end,
+                long long frameId, TraceFlow flow, bool async);
+    std::vector<TraceEvent> collect(const ThreadBuffer &buffer) const;
+
+    static std::atomic<bool> sEnabled;
+
+    Clock::time_point mEpoch;
+    std::atomic<unsigned> mGeneration;      // clear()一次加一，各线程下次记录时自己清空缓冲区
+    std::atomic<long long> mNextFrameId;
+    std::atomic<int> mBufferCapacity;
+
+    mutable std::mutex mMutex;              // 只保护缓冲区列表，记录时不用
+    std::vector<std::shared_ptr<ThreadBuffer>> mBuffers;
+    int mNextTid = 1;
+};
+
+// 作用域span：构造时开始，析构时结束；关闭跟踪时什么也不做
+class TraceSpan
+{
+public:
+    TraceSpan(const char *name, const char *category, long long frameId = -1, TraceFlow flow = TraceFlow::None)
+        : mName(name), mCategory(category), mFrameId(frameId), mFlow(flow), mActive(TraceRecorder::isEnabled())
+    {
+        if (mActive)
+        {
+            mBegin = TraceRecorder::Clock::now();
+        }
+    }
+
+    ~TraceSpan() { finish(); }
+
+    TraceSpan(const TraceSpan &) = delete;
+    TraceSpan &operator=(const TraceSpan &) = delete;
+
+    bool isActive() const { return mActive; }
+
+    // 提前结束，用于span结束之后还要用到其中创建的对象的地方
+    void finish()
+    {
+        if (mActive)
+        {
+            mActive = false;
+            TraceRecorder::instance().record(mName, mCategory, mBegin, TraceRecorder::Clock::now(), mFrameId, mFlow);
+        }
+    }
+
+    // 编号在span开始之后才知道时（例如入队时才分配）
+    void setFrameId(long long frameId, TraceFlow flow)
+    {
+        mFrameId = frameId;
+        mFlow = flow;
+    }
+
+private:
+    const char *mName;
+    const char *mCategory;
+    long long mFrameId;
+    TraceFlow mFlow;
+    bool mActive;
+    TraceRecorder::Clock::time_point mBegin;
+};
+
+#endif // TRACING_H
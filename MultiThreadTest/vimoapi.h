@@ -0,0 +1,33 @@
+﻿#ifndef VIMOAPI_H
+#define VIMOAPI_H
+
+// 统一的SDK入口：
+// 正常编译时使用思谋SDK；定义了SMORE_STUB_BACKEND时使用桩实现，
+// 方便在没有SDK/GPU的机器上调试线程池、调度等逻辑
+#ifdef SMORE_STUB_BACKEND
+#include "vimostub.h"
+#else
+#include "vimo_inference/vimo_inference.h"
+#endif
+
+#include <vector>
+
+// 在同一个pipelines上批量推理，responses与requests一一对应
+// SDK目前只提供单张的Run，这里逐张执行，批量带来的收益只有少借还一次pipelines；
+// 以后SDK提供批量接口时只需要改这一处。桩实现会模拟批量推理的摊销效果
+inline void runPipelinesBatch(smartmore::vimo::Pipelines &pipelines,
+                              const std::vector<smartmore::vimo::Request> &requests,
+                              std::vector<smartmore::vimo::Pipelines::UADResponseList> &responses)
+{
+#ifdef SMORE_STUB_BACKEND
+    pipelines.RunBatch(requests, responses);
+#else
+    responses.resize(requests.size());
+    for (size_t i = 0; i < requests.size(); ++i)
+    {
+        pipelines.Run(requests[i], responses[i]);
+    }
+#endif
+}
+
+#endif // VIMOAPI_H
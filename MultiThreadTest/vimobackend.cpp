@@ -0,0 +1,130 @@
+﻿#include "vimobackend.h"
+#include "tracing.h"
+
+using namespace smartmore;
+
+namespace {
+
+// SDK的异常不一定派生自std::exception，统一转换
+template<typename Fn>
+auto translateVimoException(Fn fn) -> decltype(fn())
+{
+    try
+    {
+        return fn();
+    }
+    catch (const vimo::VimoException &e)
+    {
+        throw std::runtime_error(e.what());
+    }
+}
+
+class VimoSession : public IInferenceSession
+{
+public:
+    explicit VimoSession(vimo::Pipelines pipelines) : mPipelines(std::move(pipelines)) {}
+
+    void run(const cv::Mat &image, InferenceOutput &output) override
+    {
+        TraceSpan requestSpan("request", "sdk");
+        vimo::Request request(image);
+        requestSpan.finish();
+
+        vimo::Pipelines::UADResponseList rsp;
+        {
+            TraceSpan span("run", "sdk");
+            translateVimoException([&]() { mPipelines.Run(request, rsp); });
+        }
+        TraceSpan span("response", "sdk");
+        output.payload = std::move(rsp);
+    }
+
+    void runBatch(const std::vector<cv::Mat> &images, std::vector<InferenceOutput> &outputs) override
+    {
+        std::vector<vimo::Request> requests;
+        requests.reserve(images.size());
+        {
+            TraceSpan span("request", "sdk");
+            for (const cv::Mat &image : images)
+            {
+                requests.emplace_back(image);
+            }
+        }
+
+        std::vector<vimo::Pipelines::UADResponseList> responses;
+        {
+            TraceSpan span("run batch", "sdk");
+            translateVimoException([&]() { runPipelinesBatch(mPipelines, requests, responses); });
+        }
+
+        TraceSpan span("response", "sdk");
+        outputs.resize(images.size());
+        for (size_t i = 0; i < outputs.size() && i < responses.size(); ++i)
+        {
+            outputs[i].payload = std::move(responses[i]);
+        }
+    }
+
+private:
+    vimo::Pipelines mPipelines;
+};
+
+} // namespace
+
+void VimoBackend::load(const std::string &modelDir)
+{
+    std::string model_path = modelPath(modelDir);
+    translateVimoException([&]() { mSolution.LoadFromFile(model_path); });  // load solution from model.vimosln
+}
+
+std::vector<std::string> VimoBackend::moduleIds()
+{
+    std::vector<std::string> ids;
+    for (const auto &info : mSolution.GetModuleInfoList())
+    {
+        ids.push_back(info.id);
+    }
+    return ids;
+}
+
+std::vector<std::pair<std::string, std::string>> VimoBackend::moduleEdges()
+{
+    std::vector<std::pair<std::string, std::string>> edges;
+    for (const auto &edge : mSolution.GetEdgeList())
+    {
+        edges.emplace_back(edge.first, edge.second);
+    }
+    return edges;
+}
+
+std::string VimoBackend::modelPath(const std::string &modelDir) const
+{
+    return modelDir + "/model.vimosln";
+}
+
+std::unique_ptr<IInferenceSession> VimoBackend::createSession(const std::string &moduleId, bool useGpu, int deviceId)
+{
+    return translateVimoException([&]() {
+        return std::unique_ptr<IInferenceSession>(
+            new VimoSession(mSolution.CreatePipelines(moduleId, useGpu, deviceId)));
+    });
+}
+
+size_t VimoBackend::outputBytes(const InferenceOutput &output) const
+{
+    // 响应内部的动态分配（掩码、字符串）看不到，按每个响应一个结构体估算，偏小
+    const auto *responses = std::any_cast<vimo::Pipelines::UADResponseList>(&output.payload);
+    size_t bytes = sizeof(InferenceOutput);
+    if (responses)
+    {
+        bytes += sizeof(*responses) + responses->capacity() * sizeof(vimo::Pipelines::UADResponse);
+    }
+    return bytes;
+}
+
+std::string VimoBackend::describeOutput(const InferenceOutput &output) const
+{
+    // 响应的具体字段随SDK版本变化，这里只给出数量
+    const auto *responses = std::any_cast<vimo::Pipelines::UADResponseList>(&output.payload);
+    return responses ? "responses=" + std::to_string(responses->size()) : std::string();
+}
@@ -0,0 +1,27 @@
+﻿#ifndef VIMOBACKEND_H
+#define VIMOBACKEND_H
+
+#include "inferencebackend.h"
+#include "vimoapi.h"
+
+// 思谋SDK后端：Solution对应后端，Pipelines对应会话
+// 输出的payload为smartmore::vimo::Pipelines::UADResponseList
+class VimoBackend : public IInferenceBackend
+{
+public:
+    const char *name() const override { return "vimo"; }
+
+    void load(const std::string &modelDir) override;
+    std::vector<std::string> moduleIds() override;
+    std::vector<std::pair<std::string, std::string>> moduleEdges() override;
+    std::string modelPath(const std::string &modelDir) const override;
+    std::unique_ptr<IInferenceSession> createSession(const std::string &moduleId,
+                                                     bool useGpu, int deviceId) override;
+    std::string describeOutput(const InferenceOutput &output) const override;
+    size_t outputBytes(const InferenceOutput &output) const override;
+
+private:
+    smartmore::vimo::Solution mSolution;
+};
+
+#endif // VIMOBACKEND_H
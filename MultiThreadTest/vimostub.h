@@ -0,0 +1,143 @@
+﻿#ifndef VIMOSTUB_H
+#define VIMOSTUB_H
+
+// 思谋SDK的桩实现，只模拟本工程用到的那部分接口
+// 推理耗时通过环境变量调节：
+//   SMORE_STUB_LOAD_MS   加载solution的耗时，默认500
+//   SMORE_STUB_INFER_MS  单次推理的耗时，默认30
+//   SMORE_STUB_BATCH_PCT 批量推理时每多一张增加的耗时（相对单张的百分比），默认30
+
+#include <chrono>
+#include <cstdlib>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include <opencv2/core.hpp>
+
+namespace smartmore {
+namespace vimo {
+
+namespace stub {
+inline int envMs(const char *name, int defaultValue)
+{
+    const char *value = std::getenv(name);
+    return value ? std::atoi(value) : defaultValue;
+}
+} // namespace stub
+
+class VimoException : public std::runtime_error
+{
+public:
+    explicit VimoException(const std::string &what) : std::runtime_error(what) {}
+};
+
+class Module
+{
+public:
+    struct Info
+    {
+        std::string id;
+        std::string name;
+    };
+};
+
+class Request
+{
+public:
+    Request() = default;
+    explicit Request(const cv::Mat &image) : mImage(image) {}
+
+    const cv::Mat &image() const { return mImage; }
+
+private:
+    cv::Mat mImage;
+};
+
+class Pipelines
+{
+public:
+    struct UADResponse
+    {
+        std::string moduleId;
+    };
+    using UADResponseList = std::vector<UADResponse>;
+
+    Pipelines() = default;
+    explicit Pipelines(std::string moduleId) : mModuleId(std::move(moduleId)) {}
+
+    void Run(const Request &req, UADResponseList &rsp)
+    {
+        if (mModuleId.empty())
+        {
+            throw VimoException("stub pipelines not created");
+        }
+        if (req.image().empty())
+        {
+            throw VimoException("stub pipelines got empty image");
+        }
+        std::this_thread::sleep_for(std::chrono::milliseconds(stub::envMs("SMORE_STUB_INFER_MS", 30)));
+        rsp.assign(1, UADResponse{mModuleId});
+    }
+
+    // SDK没有这个接口，只用来模拟批量推理：耗时 = 单张 * (1 + (n-1) * 百分比)
+    void RunBatch(const std::vector<Request> &reqs, std::vector<UADResponseList> &rsps)
+    {
+        for (const Request &req : reqs)
+        {
+            if (mModuleId.empty() || req.image().empty())
+            {
+                throw VimoException("stub pipelines got empty image");
+            }
+        }
+        double single = stub::envMs("SMORE_STUB_INFER_MS", 30);
+        double extra = stub::envMs("SMORE_STUB_BATCH_PCT", 30) / 100.0;
+        double cost = reqs.empty() ? 0 : single * (1.0 + (reqs.size() - 1) * extra);
+        std::this_thread::sleep_for(std::chrono::duration<double, std::milli>(cost));
+        rsps.assign(reqs.size(), UADResponseList(1, UADResponse{mModuleId}));
+    }
+
+private:
+    std::string mModuleId;
+};
+
+class Solution
+{
+public:
+    void LoadFromFile(const std::string &path)
+    {
+        std::this_thread::sleep_for(std::chrono::milliseconds(stub::envMs("SMORE_STUB_LOAD_MS", 500)));
+        mPath = path;
+    }
+
+    std::vector<std::pair<std::string, std::string>> GetEdgeList() const
+    {
+        return {{"1", "2"}};
+    }
+
+    std::vector<Module::Info> GetModuleInfoList() const
+    {
+        if (mPath.empty())
+        {
+            return {};
+        }
+        return {{"1", "stub-1"}, {"2", "stub-2"}};
+    }
+
+    Pipelines CreatePipelines(const std::string &moduleId, bool useGpu, int deviceId)
+    {
+        (void)useGpu;
+        (void)deviceId;
+        return Pipelines(moduleId);
+    }
+
+private:
+    std::string mPath;
+};
+
+} // namespace vimo
+} // namespace smartmore
+
+#endif // VIMOSTUB_H
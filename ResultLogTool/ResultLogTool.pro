@@ -0,0 +1,15 @@
+QT += core
+QT -= gui
+
+CONFIG += c++17
+CONFIG += console
+CONFIG -= app_bundle
+
+# 结果日志（BenchRunner --log、界面上的“结果日志”）的离线统计工具
+# 例：ResultLogTool logs/results --from 2024-05-01T08:00:00 --window 3600 --csv hourly.csv
+
+SOURCES += \
+    main.cpp
+
+# 推理公共代码（结果日志的读取和延迟直方图）
+include(../MultiThreadTest/core.pri)
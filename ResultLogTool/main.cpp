@@ -0,0 +1,242 @@
+﻿#include <QCommandLineParser>
+#include <QCoreApplication>
+#include <QDateTime>
+#include <QSaveFile>
+#include <QStringList>
+
+#include <cstdio>
+#include <map>
+#include <memory>
+
+#include "inferencepool.h"
+#include "latencyhistogram.h"
+#include "resultlog.h"
+
+// 一个时间段内的统计；每个直方图几十KB，只保留还可能有记录进来的几个时间段
+struct WindowStats
+{
+    long long count = 0;
+    long long failed = 0;
+    long long dropped = 0;          // 被挤掉、拒绝、停止时放弃的
+    int64_t firstUs = 0;
+    int64_t lastUs = 0;
+    LatencyHistogram fetch;
+    LatencyHistogram queue;
+    LatencyHistogram infer;
+    LatencyHistogram total;
+
+    void add(const ResultLogRecord &record)
+    {
+        if (count + failed + dropped == 0 || record.timestampUs < firstUs)
+        {
+            firstUs = record.timestampUs;
+        }
+        lastUs = std::max(lastUs, record.timestampUs);
+        if (record.status == (uint8_t)InferenceStatus::Ok)
+        {
+            ++count;
+            fetch.recordMs(record.fetchMs);
+            queue.recordMs(record.queueMs);
+            infer.recordMs(record.inferMs);
+            total.recordMs(record.totalMs);
+        }
+        else if (record.status == (uint8_t)InferenceStatus::Failed)
+        {
+            ++failed;
+        }
+        else
+        {
+            ++dropped;
+        }
+    }
+};
+
+static QString formatTime(int64_t us)
+{
+    return QDateTime::fromMSecsSinceEpoch(us / 1000).toString("yyyy-MM-dd hh:mm:ss");
+}
+
+// 时间参数：ISO格式的本地时间（2024-05-01T08:00:00），或者Unix纪元以来的秒数
+static bool parseTime(const QString &text, int64_t &us)
+{
+    bool ok = false;
+    double seconds = text.toDouble(&ok);
+    if (ok)
+    {
+        us = (int64_t)(seconds * 1e6);
+        return true;
+    }
+    QDateTime time = QDateTime::fromString(text, Qt::ISODate);
+    if (!time.isValid())
+    {
+        return false;
+    }
+    us = time.toMSecsSinceEpoch() * 1000;
+    return true;
+}
+
+int main(int argc, char *argv[])
+{
+    QCoreApplication a(argc, argv);
+    QCoreApplication::setApplicationName("ResultLogTool");
+
+    QCommandLineParser parser;
+    parser.setApplicationDescription("结果日志（.rlog）的离线统计：按时间段给出吞吐量和各阶段耗时的分位数");
+    parser.addHelpOption();
+    parser.addPositionalArgument("logs", "结果日志文件，或者写日志时的文件名前缀（读取所有编号的文件）", "<log>...");
+
+    QCommandLineOption fromOption("from", "只统计这个时刻之后的记录：本地时间如 2024-05-01T08:00:00，或Unix秒数", "time");
+    QCommandLineOption toOption("to", "只统计这个时刻之前的记录", "time");
+    QCommandLineOption windowOption("window", "按这么多秒分段统计；0表示整个时间范围只给一行", "sec", "0");
+    QCommandLineOption streamOption("stream", "只统计这一路，-1为所有路", "n", "-1");
+    QCommandLineOption warmupOption("include-warmup", "预热阶段的记录也计入统计");
+    QCommandLineOption csvOption("csv", "把每个时间段的统计写成CSV", "file");
+    parser.addOptions({fromOption, toOption, windowOption, streamOption, warmupOption, csvOption});
+    parser.process(a);
+
+    if (parser.positionalArguments().isEmpty())
+    {
+        parser.showHelp(1);
+    }
+
+    int64_t fromUs = INT64_MIN;
+    int64_t toUs = INT64_MAX;
+    if ((parser.isSet(fromOption) && !parseTime(parser.value(fromOption), fromUs))
+        || (parser.isSet(toOption) && !parseTime(parser.value(toOption), toUs)))
+    {
+        std::fprintf(stderr, "无效的时间，应为 2024-05-01T08:00:00 或Unix秒数\n");
+        return 1;
+    }
+    const int64_t windowUs = (int64_t)(parser.value(windowOption).toDouble() * 1e6);
+    const int stream = parser.value(streamOption).toInt();
+    const bool includeWarmup = parser.isSet(warmupOption);
+
+    std::vector<std::string> files;
+    for (const QString &arg : parser.positionalArguments())
+    {
+        std::vector<std::string> found = resultLogFiles(arg.toLocal8Bit().toStdString());
+        if (found.empty())
+        {
+            std::fprintf(stderr, "找不到结果日志: %s\n", qPrintable(arg));
+            return 1;
+        }
+        files.insert(files.end(), found.begin(), found.end());
+    }
+
+    QStringList csv;
+    csv << "start,end,completed,failed,dropped,throughput,"
+           "infer_p50_ms,infer_p90_ms,infer_p99_ms,infer_p999_ms,infer_max_ms,"
+           "total_p50_ms,total_p99_ms,queue_p99_ms,fetch_p99_ms";
+
+    std::printf("%-19s %9s %7s %7s %10s %9s %9s %9s %9s %9s %9s %9s\n", "start", "completed", "failed", "dropped",
+                "throughput", "p50(ms)", "p99(ms)", "p99.9(ms)", "max(ms)", "e2e p99", "queue p99", "fetch p99");
+
+    // 输出一行，吞吐量按startUs到endUs的时长计算
+    auto report = [&](const WindowStats &stats, const QString &label, int64_t startUs, int64_t endUs) {
+        LatencySnapshot infer = stats.infer.snapshot();
+        LatencySnapshot total = stats.total.snapshot();
+        LatencySnapshot queue = stats.queue.snapshot();
+        LatencySnapshot fetch = stats.fetch.snapshot();
+        double seconds = (endUs - startUs) / 1e6;
+        double throughput = seconds > 0 ? stats.count / seconds : 0;
+        std::printf("%-19s %9lld %7lld %7lld %10.1f %9.2f %9.2f %9.2f %9.2f %9.2f %9.2f %9.2f\n",
+                    qPrintable(label), stats.count, stats.failed, stats.dropped, throughput,
+                    infer.percentileMs(50), infer.percentileMs(99), infer.percentileMs(99.9), infer.maxMs(),
+                    total.percentileMs(99), queue.percentileMs(99), fetch.percentileMs(99));
+        csv << QString("%1,%2,%3,%4,%5,%6,%7,%8,%9,%10,%11,%12,%13,%14,%15")
+                   .arg(formatTime(startUs))
+                   .arg(formatTime(endUs))
+                   .arg(stats.count).arg(stats.failed).arg(stats.dropped).arg(throughput, 0, 'f', 2)
+                   .arg(infer.percentileMs(50), 0, 'f', 3).arg(infer.percentileMs(90), 0, 'f', 3)
+                   .arg(infer.percentileMs(99), 0, 'f', 3).arg(infer.percentileMs(99.9), 0, 'f', 3)
+                   .arg(infer.maxMs(), 0, 'f', 3)
+                   .arg(total.percentileMs(50), 0, 'f', 3).arg(total.percentileMs(99), 0, 'f', 3)
+                   .arg(queue.percentileMs(99), 0, 'f', 3).arg(fetch.percentileMs(99), 0, 'f', 3);
+    };
+
+    // 各路的记录交错写入，时间上只差几个节拍；比最新的时间段早两段以上的就不会再有记录，输出后释放
+    std::map<int64_t, std::unique_ptr<WindowStats>> windows;
+    WindowStats overall;
+    long long late = 0;
+    int64_t flushedUpTo = INT64_MIN;
+    auto flushWindows = [&](int64_t keepFrom) {
+        while (!windows.empty() && windows.begin()->first < keepFrom)
+        {
+            int64_t start = windows.begin()->first;
+            const WindowStats &stats = *windows.begin()->second;
+            report(stats, formatTime(start), start, std::min(start + windowUs, stats.lastUs + 1));
+            flushedUpTo = start;
+            windows.erase(windows.begin());
+        }
+    };
+
+    std::string error;
+    for (const std::string &file : files)
+    {
+        bool ok = readResultLog(file, [&](const ResultLogRecord &record) {
+            if (record.timestampUs < fromUs || record.timestampUs >= toUs
+                || (stream >= 0 && record.stream != stream)
+                || (!includeWarmup && (record.flags & kResultLogWarmup)))
+            {
+                return true;
+            }
+            overall.add(record);
+            if (windowUs > 0)
+            {
+                int64_t base = fromUs != INT64_MIN ? fromUs : 0;
+                int64_t start = base + (record.timestampUs - base) / windowUs * windowUs;
+                if (start <= flushedUpTo)
+                {
+                    // 已经输出过的时间段，只计入总计
+                    ++late;
+                    return true;
+                }
+                auto &window = windows[start];
+                if (!window)
+                {
+                    window.reset(new WindowStats);
+                }
+                window->add(record);
+                flushWindows(windows.rbegin()->first - 2 * windowUs);
+            }
+            return true;
+        }, &error);
+        if (!ok)
+        {
+            std::fprintf(stderr, "%s\n", error.c_str());
+            return 1;
+        }
+    }
+    flushWindows(INT64_MAX);
+
+    if (overall.count + overall.failed + overall.dropped == 0)
+    {
+        std::printf("没有符合条件的记录\n");
+        return 0;
+    }
+    if (windowUs > 0)
+    {
+        std::printf("\n");
+    }
+    // 总计的吞吐量按第一条到最后一条记录的时间算
+    report(overall, "total", overall.firstUs, overall.lastUs);
+    std::printf("\n%s ~ %s, %zu file(s)", qPrintable(formatTime(overall.firstUs)),
+                qPrintable(formatTime(overall.lastUs)), files.size());
+    if (late > 0)
+    {
+        std::printf(", %lld out-of-order record(s) counted only in total", late);
+    }
+    std::printf("\n");
+
+    if (parser.isSet(csvOption))
+    {
+        QSaveFile out(parser.value(csvOption));
+        QByteArray data = csv.join('\n').toUtf8() + '\n';
+        if (!out.open(QIODevice::WriteOnly) || out.write(data) != data.size() || !out.commit())
+        {
+            std::fprintf(stderr, "无法写入 %s\n", qPrintable(parser.value(csvOption)));
+            return 1;
+        }
+    }
+    return 0;
+}